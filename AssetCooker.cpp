@@ -0,0 +1,632 @@
+#include "AssetCooker.hpp"
+#include "AssetPack.hpp"
+#include "EmbeddedFiles.hpp"
+#include "JobSystem.hpp"
+#include "MappedFile.hpp"
+#include "MeshFile.hpp"
+#include "PixelOps.hpp"
+#include "ShaderModuleFile.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "VirtualFileSystem.hpp"
+#include "stb_image.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+static const char MANIFEST_MAGIC[] = "COOKED_MANIFEST";
+
+static std::string lowercase(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return text;
+}
+
+// What a source file turns into, by extension. False for files the cooker doesn't know.
+static bool classify(const fs::path& path, AssetType& type, std::string& outputExtension)
+{
+	std::string extension = lowercase(path.extension().string());
+
+	if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp") {
+		type = AssetType::Image;
+		outputExtension = ".mips";
+		return true;
+	}
+
+	if (extension == ".obj") {
+		type = AssetType::Mesh;
+		outputExtension = ".mesh";
+		return true;
+	}
+
+	// .glsl are files shaders include, .variants lists the variants to build at startup.
+	if (extension == ".vs" || extension == ".fs" || extension == ".glsl" || extension == ".variants") {
+		type = AssetType::Shader;
+		outputExtension = extension;
+		return true;
+	}
+
+	return false;
+}
+
+#if defined(_WIN32)
+static const char NULL_DEVICE[] = "NUL";
+#else
+static const char NULL_DEVICE[] = "/dev/null";
+#endif
+
+// Runs a command line with its output going to 'logPath' (or nowhere). True if it
+// exited with 0.
+static bool runTool(const std::string& command, const std::string& logPath = NULL_DEVICE)
+{
+	std::string line = command + " > \"" + logPath + "\" 2>&1";
+	return std::system(line.c_str()) == 0;
+}
+
+static bool statFile(const std::string& path, uint64_t& size, int64_t& writeTime)
+{
+	std::error_code error;
+	size = (uint64_t)fs::file_size(path, error);
+	if (error)
+		return false;
+
+	writeTime = (int64_t)fs::last_write_time(path, error).time_since_epoch().count();
+	return !error;
+}
+
+AssetCooker::AssetCooker(JobSystem& jobs, const std::string& sourceRoot, const std::string& outputRoot, const MipSettings& mipSettings)
+	: jobs(jobs), sourceRoot(sourceRoot), outputRoot(outputRoot), mipSettings(mipSettings), packing(true),
+	  spirvCompiler("glslangValidator"), spirvOptimizer("spirv-opt"), haveSpirvCompiler(false), haveSpirvOptimizer(false), spirvToolsChecked(false)
+{
+}
+
+void AssetCooker::setPacking(bool enabled)
+{
+	packing = enabled;
+}
+
+void AssetCooker::setSpirvTools(const std::string& compiler, const std::string& optimizer)
+{
+	spirvCompiler = compiler;
+	spirvOptimizer = optimizer;
+	spirvToolsChecked = false;
+}
+
+void AssetCooker::findSpirvTools()
+{
+	// Starting the tools takes a while, and hot reload cooks again every time a file is
+	// saved. They're looked for once, and again only when they're changed.
+	if (spirvToolsChecked)
+		return;
+
+	spirvToolsChecked = true;
+	haveSpirvCompiler = !spirvCompiler.empty() && runTool(spirvCompiler + " --version");
+	haveSpirvOptimizer = haveSpirvCompiler && !spirvOptimizer.empty() && runTool(spirvOptimizer + " --version");
+}
+
+uint64_t AssetCooker::hashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool AssetCooker::hashFile(const std::string& path, uint64_t& hash)
+{
+	MappedFile file;
+	if (file.open(path)) {
+		hash = hashBytes(file.data(), file.size());
+		return true;
+	}
+
+	// Mapping fails on empty files, which still have a perfectly good hash.
+	std::error_code error;
+	if (fs::exists(path, error) && fs::file_size(path, error) == 0 && !error) {
+		hash = hashBytes(nullptr, 0);
+		return true;
+	}
+
+	return false;
+}
+
+std::string AssetCooker::manifestPath() const
+{
+	return outputRoot + "/manifest.txt";
+}
+
+// One line per output: "output<TAB>recipe<TAB>input count", then one line per input:
+// "<TAB>path<TAB>size<TAB>write time<TAB>hash in hex".
+bool AssetCooker::readManifest()
+{
+	manifest.clear();
+
+	std::ifstream file(manifestPath());
+	if (!file)
+		return false;
+
+	std::string line;
+	if (!std::getline(file, line) || line != std::string(MANIFEST_MAGIC) + " " + std::to_string(COOKER_VERSION))
+		return false;
+
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		Entry entry;
+		size_t inputCount = 0;
+
+		std::getline(fields, entry.output, '\t');
+		std::getline(fields, entry.recipe, '\t');
+		fields >> inputCount;
+
+		for (size_t i = 0; i < inputCount && std::getline(file, line); i++) {
+			std::istringstream inputFields(line.substr(std::min<size_t>(1, line.size())));
+			Input input;
+			std::string hash;
+
+			std::getline(inputFields, input.path, '\t');
+			inputFields >> input.size >> input.writeTime >> hash;
+			input.hash = std::strtoull(hash.c_str(), nullptr, 16);
+			entry.inputs.push_back(input);
+		}
+
+		// A cut off entry is just cooked again.
+		if (fields && entry.inputs.size() == inputCount)
+			manifest[entry.output] = entry;
+	}
+
+	return true;
+}
+
+bool AssetCooker::writeManifest() const
+{
+	std::vector<const Entry*> entries;
+	for (const auto& pair : manifest) {
+		entries.push_back(&pair.second);
+	}
+
+	// Sorted, so the file diffs nicely.
+	std::sort(entries.begin(), entries.end(), [](const Entry* a, const Entry* b) { return a->output < b->output; });
+
+	std::string temporary = manifestPath() + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::trunc);
+		if (!file)
+			return false;
+
+		file << MANIFEST_MAGIC << " " << COOKER_VERSION << "\n";
+		for (const Entry* entry : entries) {
+			file << entry->output << "\t" << entry->recipe << "\t" << entry->inputs.size() << "\n";
+
+			for (const Input& input : entry->inputs) {
+				char hash[17];
+				snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)input.hash);
+				file << "\t" << input.path << "\t" << input.size << "\t" << input.writeTime << "\t" << hash << "\n";
+			}
+		}
+
+		if (!file)
+			return false;
+	}
+
+	std::error_code error;
+	fs::rename(temporary, manifestPath(), error);
+	return !error;
+}
+
+// An empty file next to the pack while it's older than the loose outputs.
+std::string AssetCooker::stalePackPath() const
+{
+	return outputRoot + "/assets.pack.stale";
+}
+
+std::string AssetCooker::packPath() const
+{
+	return outputRoot + "/assets.pack";
+}
+
+std::string AssetCooker::embeddedShadersPath() const
+{
+	return outputRoot + "/EmbeddedShaders.inc";
+}
+
+bool AssetCooker::writePack() const
+{
+	// Entries keep their loose paths (Cooked/Meshes/cube.mesh), so the runtime asks for
+	// the same thing whether the pack is mounted or not. Only shaders are compressed: mip
+	// chains are read a few levels at a time straight from the mapping, and meshes are
+	// already compressed with MeshCodec. LZ on top of that still saves about a quarter,
+	// but decompressing it takes longer than reading those bytes from disk would.
+	std::vector<AssetPackSource> sources;
+	for (const auto& item : manifest) {
+		std::string extension = fs::path(item.first).extension().string();
+		sources.push_back({ item.first, item.first, extension != ".mips" && extension != ".mesh" });
+	}
+
+	std::sort(sources.begin(), sources.end(), [](const AssetPackSource& a, const AssetPackSource& b) { return a.name < b.name; });
+
+	size_t compressed = 0;
+	if (!AssetPack::write(packPath(), sources, &compressed))
+		return false;
+
+	uint64_t looseBytes = 0;
+	std::error_code error;
+	for (const AssetPackSource& source : sources) {
+		looseBytes += fs::file_size(source.path, error);
+	}
+
+	std::cout << "Packed " << sources.size() << " files (" << compressed << " compressed) into " << packPath() << ", "
+		<< looseBytes << " -> " << fs::file_size(packPath(), error) << " bytes" << std::endl;
+	return true;
+}
+
+bool AssetCooker::upToDate(const Asset& asset)
+{
+	std::error_code error;
+	if (!fs::exists(asset.output, error))
+		return false;
+
+	std::lock_guard<std::mutex> lock(manifestMutex);
+
+	auto found = manifest.find(asset.output);
+	if (found == manifest.end() || found->second.recipe != asset.recipe)
+		return false;
+
+	for (Input& input : found->second.inputs) {
+		uint64_t size;
+		int64_t writeTime;
+		if (!statFile(input.path, size, writeTime))
+			return false;
+
+		if (size == input.size && writeTime == input.writeTime)
+			continue;
+
+		// Touched: only a different content counts.
+		uint64_t hash;
+		if (size != input.size || !hashFile(input.path, hash) || hash != input.hash)
+			return false;
+
+		input.writeTime = writeTime;
+	}
+
+	return true;
+}
+
+bool AssetCooker::cookImage(const Asset& asset)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load(asset.source.c_str(), &width, &height, &channels, 0);
+
+	if (data == nullptr) {
+		std::cout << "ERROR::ASSET_COOKER::FILE_NOT_SUCCESFULLY_READ " << asset.source << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+	PixelOps::expandToRGBA(data, channels, rgba.data(), (size_t)width * height);
+	stbi_image_free(data);
+
+	// Files store the top row first, GL wants the bottom one first.
+	PixelOps::flipVertically(rgba.data(), width, height, 4);
+
+	MipGenerator generator(jobs, mipSettings);
+	return MipGenerator::writeCache(asset.output, generator.generate(rgba.data(), width, height));
+}
+
+bool AssetCooker::cookMesh(const Asset& asset)
+{
+	return MeshFile::convertObj(asset.source, asset.output);
+}
+
+bool AssetCooker::cookShader(const Asset& asset)
+{
+	std::ifstream in(asset.source, std::ios::binary);
+	if (!in) {
+		std::cout << "ERROR::ASSET_COOKER::FILE_NOT_SUCCESFULLY_READ " << asset.source << std::endl;
+		return false;
+	}
+
+	std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	source.erase(std::remove(source.begin(), source.end(), '\r'), source.end());
+
+	std::ofstream out(asset.output, std::ios::binary | std::ios::trunc);
+	out.write(source.data(), (std::streamsize)source.size());
+	return (bool)out;
+}
+
+bool AssetCooker::compileModule(unsigned int type, const std::string& source, const std::string& path, const std::string& tempPath,
+	std::vector<uint32_t>& module)
+{
+	// glslang takes the stage from the extension.
+	std::string sourcePath = tempPath + (type == GL_VERTEX_SHADER ? ".vert" : ".frag");
+	std::string modulePath = tempPath + ".spv";
+	std::string logPath = tempPath + ".log";
+	std::ofstream(sourcePath, std::ios::binary | std::ios::trunc).write(source.data(), (std::streamsize)source.size());
+
+	// -G is SPIR-V for OpenGL, where glslang defines GL_SPIRV.
+	bool compiled = runTool(spirvCompiler + " -G -o \"" + modulePath + "\" \"" + sourcePath + "\"", logPath);
+	if (compiled && haveSpirvOptimizer)
+		compiled = runTool(spirvOptimizer + " -O \"" + modulePath + "\" -o \"" + modulePath + "\"", logPath);
+
+	std::ifstream in(modulePath, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	compiled = compiled && !bytes.empty() && bytes.size() % sizeof(uint32_t) == 0;
+	if (compiled) {
+		module.resize(bytes.size() / sizeof(uint32_t));
+		memcpy(module.data(), bytes.data(), bytes.size());
+	}
+	else {
+		std::ifstream logFile(logPath);
+		std::string log((std::istreambuf_iterator<char>(logFile)), std::istreambuf_iterator<char>());
+		logFile.close();
+		std::cout << "ERROR::ASSET_COOKER::SPIRV_COMPILATION_FAILED " << path << ", built from GLSL instead\n" << log << std::endl;
+	}
+
+	std::error_code error;
+	fs::remove(sourcePath, error);
+	fs::remove(modulePath, error);
+	fs::remove(logPath, error);
+	return compiled;
+}
+
+bool AssetCooker::cookShaderModules(const Asset& asset, std::vector<std::string>& inputs)
+{
+	std::unordered_map<uint64_t, std::vector<uint32_t>> modules;
+	std::vector<uint64_t> failed;
+	if (!haveSpirvCompiler)
+		return ShaderModuleFile::write(asset.output, modules);
+
+	// Preprocessed from the sources, which give the same text as the cooked copies.
+	VirtualFileSystem files;
+	std::vector<ShaderVariantRequest> requests;
+	if (!ShaderPreprocessor::readVariants(files, asset.source, requests))
+		return false;
+
+	// One for each manifest, they cook in parallel.
+	std::error_code error;
+	std::string tempDirectory = outputRoot + "/spirv-temp-" + std::to_string(hashBytes(asset.output.data(), asset.output.size()));
+	fs::create_directories(tempDirectory, error);
+	std::string tempName = tempDirectory + "/";
+
+	for (const ShaderVariantRequest& request : requests) {
+		// Whether the runtime links whole programs or separate stages depends on the GPU.
+		for (bool separateStages : { false, true }) {
+			PreprocessedVariant variant;
+			if (!ShaderPreprocessor::preprocessVariant(files, request.vertexPath, request.fragmentPath, request.keywords, separateStages, variant)) {
+				fs::remove_all(tempDirectory, error);
+				return false;
+			}
+
+			// Includes too, so changing one cooks this again.
+			for (const std::vector<std::string>* read : { &variant.vertex.files, &variant.fragment.files }) {
+				for (const std::string& path : *read) {
+					if (std::find(inputs.begin(), inputs.end(), path) == inputs.end())
+						inputs.push_back(path);
+				}
+			}
+
+			const PreprocessedShader* shaders[2] = { &variant.vertex, &variant.fragment };
+			for (int stage = 0; stage < 2; stage++) {
+				unsigned int type = stage == 0 ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER;
+				uint64_t key = ShaderModuleFile::hashStage(type, shaders[stage]->source);
+				if (modules.count(key) != 0 || std::count(failed.begin(), failed.end(), key) != 0)
+					continue;
+
+				std::vector<uint32_t> module;
+				if (compileModule(type, shaders[stage]->source, shaders[stage]->files[0], tempName + std::to_string(modules.size()), module))
+					modules[key] = std::move(module);
+				else
+					failed.push_back(key);
+			}
+		}
+	}
+
+	fs::remove_all(tempDirectory, error);
+
+	std::cout << "Compiled " << modules.size() << " shader stages to SPIR-V for " << asset.source << std::endl;
+	return ShaderModuleFile::write(asset.output, modules);
+}
+
+bool AssetCooker::cookAsset(const Asset& asset, std::vector<std::string>& inputs)
+{
+	std::error_code error;
+	fs::create_directories(fs::path(asset.output).parent_path(), error);
+
+	inputs = { asset.source };
+
+	switch (asset.type) {
+	case AssetType::Image: return cookImage(asset);
+	case AssetType::Mesh: return cookMesh(asset);
+	case AssetType::Shader: return cookShader(asset);
+	case AssetType::ShaderModules: return cookShaderModules(asset, inputs);
+	}
+
+	return false;
+}
+
+bool AssetCooker::cook(bool force, CookStats* stats, std::vector<std::string>* changedOutputs)
+{
+	auto start = std::chrono::steady_clock::now();
+	CookStats totals = {};
+
+	std::error_code error;
+	if (!fs::is_directory(sourceRoot, error)) {
+		std::cout << "ERROR::ASSET_COOKER::NO_SOURCE_DIRECTORY " << sourceRoot << std::endl;
+		return false;
+	}
+
+	fs::create_directories(outputRoot, error);
+	if (!force)
+		readManifest();
+
+	// The recipe key: whatever changes the output besides the inputs themselves.
+	std::string version = "v" + std::to_string(COOKER_VERSION);
+	std::string imageRecipe = version + "-image-flip-" + MipGenerator(jobs, mipSettings).settingsKey();
+	std::string meshRecipe = version + "-mesh" + std::to_string(MESH_FILE_VERSION) + "-quantized-compressed";
+	std::string shaderRecipe = version + "-shader";
+
+	// The tools are part of the recipe, so installing them cooks the SPIR-V again.
+	findSpirvTools();
+	std::string moduleRecipe = version + "-spirv" + std::to_string(SHADER_MODULE_FILE_VERSION) + "-"
+		+ (haveSpirvCompiler ? spirvCompiler + (haveSpirvOptimizer ? "+" + spirvOptimizer : "") : "none");
+
+	std::vector<Asset> assets;
+	std::unordered_map<std::string, std::string> sourceOf; // output -> source, to catch clashes
+
+	for (fs::recursive_directory_iterator it(sourceRoot, error), end; it != end; it.increment(error)) {
+		if (error || !it->is_regular_file(error))
+			continue;
+
+		Asset asset;
+		std::string outputExtension;
+		if (!classify(it->path(), asset.type, outputExtension))
+			continue;
+
+		fs::path relative = fs::relative(it->path(), sourceRoot, error);
+		asset.source = it->path().generic_string();
+		asset.output = (fs::path(outputRoot) / relative).replace_extension(outputExtension).generic_string();
+		asset.recipe = asset.type == AssetType::Image ? imageRecipe : asset.type == AssetType::Mesh ? meshRecipe : shaderRecipe;
+
+		auto clash = sourceOf.find(asset.output);
+		if (clash != sourceOf.end()) {
+			std::cout << "ERROR::ASSET_COOKER::OUTPUT_CLASH " << asset.source << " and " << clash->second << " -> " << asset.output << std::endl;
+			totals.failed++;
+			continue;
+		}
+
+		sourceOf[asset.output] = asset.source;
+		assets.push_back(asset);
+
+		// A variant manifest also has every stage it builds compiled ahead of time.
+		if (lowercase(it->path().extension().string()) == ".variants") {
+			asset.type = AssetType::ShaderModules;
+			asset.output = fs::path(asset.output).replace_extension(".spirv").generic_string();
+			asset.recipe = moduleRecipe;
+			sourceOf[asset.output] = asset.source;
+			assets.push_back(asset);
+		}
+	}
+
+	std::sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) { return a.output < b.output; });
+	totals.assets = assets.size();
+
+	std::vector<const Asset*> dirty;
+	for (const Asset& asset : assets) {
+		if (force || !upToDate(asset))
+			dirty.push_back(&asset);
+		else
+			totals.upToDate++;
+	}
+
+	std::vector<char> succeeded(dirty.size(), 0);
+
+	jobs.parallelFor((unsigned int)dirty.size(), [&](unsigned int i) {
+		const Asset& asset = *dirty[i];
+		std::vector<std::string> inputPaths;
+
+		if (!cookAsset(asset, inputPaths)) {
+			std::cout << "ERROR::ASSET_COOKER::COOKING_FAILED " << asset.source << std::endl;
+			return;
+		}
+
+		// Inputs are recorded as they were read, after the fact.
+		Entry entry = { asset.output, asset.recipe, {} };
+		for (const std::string& path : inputPaths) {
+			Input input = { path, 0, 0, 0 };
+			if (!statFile(path, input.size, input.writeTime) || !hashFile(path, input.hash))
+				return;
+
+			entry.inputs.push_back(input);
+		}
+
+		std::lock_guard<std::mutex> lock(manifestMutex);
+		manifest[asset.output] = entry;
+		succeeded[i] = 1;
+	});
+
+	for (size_t i = 0; i < dirty.size(); i++) {
+		if (succeeded[i]) {
+			totals.cooked++;
+			if (changedOutputs != nullptr)
+				changedOutputs->push_back(dirty[i]->output);
+			std::cout << "Cooked " << dirty[i]->source << " -> " << dirty[i]->output << std::endl;
+		}
+		else {
+			totals.failed++;
+			manifest.erase(dirty[i]->output);
+		}
+	}
+
+	// Outputs of sources that are gone.
+	for (auto it = manifest.begin(); it != manifest.end();) {
+		if (sourceOf.count(it->first) == 0) {
+			fs::remove(it->first, error);
+			totals.removed++;
+			if (changedOutputs != nullptr)
+				changedOutputs->push_back(it->first);
+			it = manifest.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	if (!writeManifest()) {
+		std::cout << "ERROR::ASSET_COOKER::MANIFEST_NOT_SUCCESFULLY_WRITTEN " << manifestPath() << std::endl;
+		totals.failed++;
+	}
+
+	bool changed = force || totals.cooked > 0 || totals.removed > 0;
+
+	if (!packing) {
+		if (changed)
+			std::ofstream(stalePackPath()).close();
+	}
+	else if (changed || !fs::exists(packPath(), error) || fs::exists(stalePackPath(), error)) {
+		if (writePack()) {
+			fs::remove(stalePackPath(), error);
+		}
+		else {
+			std::cout << "ERROR::ASSET_COOKER::PACK_NOT_SUCCESFULLY_WRITTEN " << packPath() << std::endl;
+			totals.failed++;
+		}
+	}
+
+	// The shaders again, as C++ for release builds to compile in.
+	if (changed || !fs::exists(embeddedShadersPath(), error)) {
+		std::vector<std::string> shaders;
+		for (const Asset& asset : assets) {
+			if ((asset.type == AssetType::Shader || asset.type == AssetType::ShaderModules) && manifest.count(asset.output) != 0)
+				shaders.push_back(asset.output);
+		}
+
+		if (!EmbeddedFiles::write(embeddedShadersPath(), shaders)) {
+			std::cout << "ERROR::ASSET_COOKER::EMBEDDED_SHADERS_NOT_SUCCESFULLY_WRITTEN " << embeddedShadersPath() << std::endl;
+			totals.failed++;
+		}
+	}
+
+	totals.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Cooked " << totals.cooked << " of " << totals.assets << " assets (" << totals.upToDate << " up to date, "
+		<< totals.failed << " failed, " << totals.removed << " removed) in " << totals.milliseconds << " ms" << std::endl;
+
+	if (stats != nullptr)
+		*stats = totals;
+
+	return totals.failed == 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MipGenerator.hpp"
+
+class JobSystem;
+
+enum class AssetType {
+	Image,  // png/jpg/tga/bmp -> .mips, the whole RGBA8 mip chain, flipped for GL
+	Mesh,   // obj -> .mesh, optimized, quantized and compressed
+	Shader, // vs/fs/glsl/variants -> the same, with line endings normalized
+	ShaderModules // variants -> .spirv too, every stage they build compiled to SPIR-V
+};
+
+struct CookStats {
+	size_t assets;
+	size_t cooked;
+	size_t upToDate;
+	size_t failed;
+	size_t removed;  // outputs whose source is gone
+	double milliseconds;
+};
+
+// Offline build step that turns everything under the source tree (Assets/) into the
+// files the runtime loads as they are (Cooked/), with the same relative paths:
+// Assets/Images/container.jpg -> Cooked/Images/container.mips. Paths always use forward
+// slashes, which Windows accepts too.
+//
+// Every output is recorded in Cooked/manifest.txt with the inputs it was made from
+// (size, write time and a 64-bit content hash of each) and a key for the recipe and
+// its settings. The next run only cooks outputs whose inputs or recipe changed: inputs
+// with the same size and time are trusted, the others are hashed, so touching a file
+// without changing it doesn't rebuild anything. What is left to cook is spread over
+// the job system, and then every output goes into one AssetPack for the runtime, and the
+// shaders into the executable too (EmbeddedFiles).
+class AssetCooker {
+    private:
+	struct Input {
+		std::string path;
+		uint64_t size;
+		int64_t writeTime;
+		uint64_t hash;
+	};
+
+	struct Entry {
+		std::string output;
+		std::string recipe;
+		std::vector<Input> inputs;
+	};
+
+	struct Asset {
+		AssetType type;
+		std::string source;
+		std::string output;
+		std::string recipe;
+	};
+
+	JobSystem& jobs;
+	std::string sourceRoot;
+	std::string outputRoot;
+	MipSettings mipSettings;
+	bool packing;
+	std::string spirvCompiler;
+	std::string spirvOptimizer;
+	bool haveSpirvCompiler;  // whether they ran, checked by the first cook
+	bool haveSpirvOptimizer;
+	bool spirvToolsChecked;
+
+	std::unordered_map<std::string, Entry> manifest; // by output
+	std::mutex manifestMutex;
+
+	std::string manifestPath() const;
+	std::string stalePackPath() const;
+	bool readManifest();
+	bool writeManifest() const;
+	bool writePack() const;
+
+	bool upToDate(const Asset& asset);
+	// Cooks one asset and returns the files it read, which become its inputs.
+	bool cookAsset(const Asset& asset, std::vector<std::string>& inputs);
+	bool cookImage(const Asset& asset);
+	bool cookMesh(const Asset& asset);
+	bool cookShader(const Asset& asset);
+	bool cookShaderModules(const Asset& asset, std::vector<std::string>& inputs);
+	// A preprocessed stage to SPIR-V, through files named 'tempPath' and something. A
+	// source glslang won't take prints its log and is built from GLSL at runtime.
+	bool compileModule(unsigned int type, const std::string& source, const std::string& path, const std::string& tempPath,
+		std::vector<uint32_t>& module);
+	void findSpirvTools();
+    public:
+	// Bump whenever a recipe changes what it writes, so everything gets cooked again.
+	static constexpr uint32_t COOKER_VERSION = 2;
+
+	AssetCooker(JobSystem& jobs, const std::string& sourceRoot = "Assets", const std::string& outputRoot = "Cooked",
+		const MipSettings& mipSettings = MipSettings());
+
+	// 'force' ignores the manifest and cooks everything. Whenever something changed, all
+	// the outputs are packed again into packPath(). The outputs that were cooked (or
+	// removed) go into 'changedOutputs'.
+	bool cook(bool force = false, CookStats* stats = nullptr, std::vector<std::string>* changedOutputs = nullptr);
+
+	// Off, the pack is left alone and only marked as out of date, so the next cook with
+	// packing on writes it even if nothing else changed. For hot reload, which cooks
+	// while the runtime has the pack mapped.
+	void setPacking(bool enabled);
+
+	// The commands the SPIR-V for ShaderModuleFile is made with: glslangValidator and
+	// spirv-opt by default, from the PATH. Without the compiler the .spirv files have
+	// nothing in them and the runtime builds every shader from GLSL. Without the optimizer
+	// the modules are left as glslang writes them.
+	void setSpirvTools(const std::string& compiler, const std::string& optimizer);
+
+	// Cooked/assets.pack, which the runtime mounts.
+	std::string packPath() const;
+	// Cooked/EmbeddedShaders.inc, every cooked shader as C++ for release builds to compile
+	// in (see EmbeddedFiles). Written along with the pack, even when packing is off.
+	std::string embeddedShadersPath() const;
+
+	// FNV-1a, 64 bits.
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+	static bool hashFile(const std::string& path, uint64_t& hash);
+};
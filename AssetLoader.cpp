@@ -0,0 +1,273 @@
+#include "AssetLoader.hpp"
+#include "AsyncIO.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+LoadedFile::LoadedFile()
+	: loader(nullptr), reserved(0)
+{
+}
+
+LoadedFile::~LoadedFile()
+{
+	if (loader != nullptr && reserved > 0)
+		loader->release(reserved);
+}
+
+LoadedFile::LoadedFile(LoadedFile&& other) noexcept
+	: file(std::move(other.file)), loader(other.loader), reserved(other.reserved)
+{
+	other.loader = nullptr;
+	other.reserved = 0;
+}
+
+LoadedFile& LoadedFile::operator=(LoadedFile&& other) noexcept
+{
+	if (this != &other) {
+		if (loader != nullptr && reserved > 0)
+			loader->release(reserved);
+
+		file = std::move(other.file);
+		loader = other.loader;
+		reserved = other.reserved;
+		other.loader = nullptr;
+		other.reserved = 0;
+	}
+
+	return *this;
+}
+
+bool LoadedFile::ok() const
+{
+	return file.data() != nullptr;
+}
+
+const unsigned char* LoadedFile::data() const
+{
+	return file.data();
+}
+
+size_t LoadedFile::size() const
+{
+	return file.size();
+}
+
+FileData& LoadedFile::getFile()
+{
+	return file;
+}
+
+AssetLoader::AssetLoader(JobSystem& jobs, AsyncIO& io, const VirtualFileSystem& files, size_t maxBytesInFlight)
+	: jobs(jobs), io(io), files(files), maxBytesInFlight(maxBytesInFlight), stats()
+{
+}
+
+AssetLoader::~AssetLoader()
+{
+	for (const auto& ioFile : ioFiles) {
+		if (ioFile.second >= 0)
+			io.closeFile(ioFile.second);
+	}
+}
+
+int AssetLoader::ioFileFor(const std::string& filePath)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = ioFiles.find(filePath);
+
+	// Failures are remembered too, so a missing file isn't opened again for every load.
+	if (found == ioFiles.end())
+		found = ioFiles.emplace(filePath, io.openFile(filePath)).first;
+
+	return found->second;
+}
+
+bool AssetLoader::BudgetAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> lock(loader.mutex);
+	AssetLoaderStats& stats = loader.stats;
+
+	// First come first served: nothing jumps ahead of a read that is already waiting,
+	// or big files would never get their turn.
+	if (loader.budgetWaiters.empty() && (stats.bytesInUse == 0 || stats.bytesInUse + bytes <= loader.maxBytesInFlight)) {
+		stats.bytesInUse += bytes;
+		stats.maxBytesInUse = std::max(stats.maxBytesInUse, stats.bytesInUse);
+		return false;
+	}
+
+	loader.budgetWaiters.push_back({ handle, bytes });
+	stats.budgetWaits++;
+	return true;
+}
+
+void AssetLoader::release(size_t bytes)
+{
+	std::vector<std::coroutine_handle<>> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.bytesInUse -= bytes;
+
+		while (!budgetWaiters.empty()) {
+			const BudgetWaiter& waiter = budgetWaiters.front();
+			if (stats.bytesInUse != 0 && stats.bytesInUse + waiter.bytes > maxBytesInFlight)
+				break;
+
+			stats.bytesInUse += waiter.bytes;
+			stats.maxBytesInUse = std::max(stats.maxBytesInUse, stats.bytesInUse);
+			ready.push_back(waiter.handle);
+			budgetWaiters.pop_front();
+		}
+	}
+
+	// Whoever released the memory may be on the GL thread, so the waiting reads go on
+	// from a worker instead of from in here.
+	for (std::coroutine_handle<> handle : ready) {
+		jobs.submit([handle]() { handle.resume(); });
+	}
+}
+
+void AssetLoader::ReadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	// The callback runs on an I/O thread, which shouldn't be kept busy with whatever the
+	// coroutine does next.
+	JobSystem& jobs = loader.jobs;
+	loader.io.read(file, offset, destination, size, [this, handle, &jobs](bool result) {
+		ok = result;
+		jobs.submit([handle]() { handle.resume(); });
+	});
+}
+
+void AssetLoader::finishLoad(bool ok)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.loads++;
+	stats.inFlight--;
+
+	if (!ok)
+		stats.failed++;
+}
+
+Task<LoadedFile> AssetLoader::readFile(std::string path)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.inFlight++;
+		stats.maxInFlight = std::max(stats.maxInFlight, stats.inFlight);
+	}
+
+	LoadedFile loaded;
+	std::string filePath;
+	uint64_t offset, size;
+	int file = files.locate(path, filePath, offset, size) ? ioFileFor(filePath) : -1;
+
+	if (file < 0) {
+		// Compressed (or not there at all). The size is only known once it's been
+		// decompressed, so it's counted against the budget without waiting for it.
+		co_await onWorker();
+
+		if (files.read(path, loaded.file) && !loaded.file.isMapped()) {
+			std::lock_guard<std::mutex> lock(mutex);
+			loaded.loader = this;
+			loaded.reserved = loaded.file.size();
+			stats.bytesInUse += loaded.reserved;
+			stats.maxBytesInUse = std::max(stats.maxBytesInUse, stats.bytesInUse);
+		}
+		else if (loaded.ok() == false) {
+			std::cout << "ERROR::ASSET_LOADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		}
+
+		finishLoad(loaded.ok());
+		co_return loaded;
+	}
+
+	co_await BudgetAwaiter{ *this, (size_t)size };
+	loaded.loader = this;
+	loaded.reserved = (size_t)size;
+
+	std::vector<unsigned char> bytes((size_t)size);
+	bool ok = true;
+	if (size > 0)
+		ok = co_await ReadAwaiter{ *this, file, offset, bytes.data(), (size_t)size, false };
+
+	if (ok) {
+		loaded.file = FileData(std::move(bytes));
+	}
+	else {
+		std::cout << "ERROR::ASSET_LOADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		loaded = LoadedFile();
+	}
+
+	finishLoad(ok);
+	co_return loaded;
+}
+
+void AssetLoader::WorkerAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	jobs.submit([handle]() { handle.resume(); });
+}
+
+void AssetLoader::GLThreadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> lock(loader.mutex);
+	loader.glQueue.push_back(handle);
+	loader.glWork.notify_all();
+}
+
+AssetLoader::WorkerAwaiter AssetLoader::onWorker()
+{
+	return WorkerAwaiter{ jobs };
+}
+
+AssetLoader::GLThreadAwaiter AssetLoader::onGLThread()
+{
+	return GLThreadAwaiter{ *this };
+}
+
+size_t AssetLoader::pump()
+{
+	io.submit();
+
+	std::vector<std::coroutine_handle<>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(glQueue);
+	}
+
+	for (std::coroutine_handle<> handle : ready) {
+		handle.resume();
+	}
+
+	return ready.size();
+}
+
+void AssetLoader::signal(std::atomic<bool>& done)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	done = true;
+	glWork.notify_all();
+}
+
+void AssetLoader::pumpUntil(const std::atomic<bool>& done)
+{
+	while (true) {
+		pump();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if (done)
+			return;
+
+		// Reads queued from a worker are only submitted by the next pump, so don't sleep
+		// for long even when there's nothing for the GL thread.
+		glWork.wait_for(lock, std::chrono::milliseconds(1), [&]() { return done || !glQueue.empty(); });
+	}
+}
+
+AssetLoaderStats AssetLoader::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
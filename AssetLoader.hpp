@@ -0,0 +1,193 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Task.hpp"
+#include "VirtualFileSystem.hpp"
+
+class AsyncIO;
+class AssetLoader;
+class JobSystem;
+
+struct AssetLoaderStats {
+	size_t loads;
+	size_t failed;
+	size_t inFlight;        // readFile calls that haven't returned yet
+	size_t maxInFlight;
+	size_t bytesInUse;      // held by LoadedFiles and reads in flight
+	size_t maxBytesInUse;
+	size_t budgetWaits;     // reads that had to wait for memory to be freed
+};
+
+// A file read by AssetLoader::readFile. It holds on to its share of the loader's memory
+// budget until it's destroyed, so keep it only as long as its bytes are needed (usually
+// until they've been uploaded).
+class LoadedFile {
+    private:
+	FileData file;
+	AssetLoader* loader;
+	size_t reserved;
+
+	friend class AssetLoader;
+    public:
+	LoadedFile();
+	~LoadedFile();
+
+	LoadedFile(LoadedFile&& other) noexcept;
+	LoadedFile& operator=(LoadedFile&& other) noexcept;
+
+	// False when the file couldn't be read.
+	bool ok() const;
+	const unsigned char* data() const;
+	size_t size() const;
+
+	// The bytes themselves, to move into something like MeshFile. The budget stays
+	// reserved until this LoadedFile goes away.
+	FileData& getFile();
+};
+
+// Coroutine front end for loading assets over the JobSystem, AsyncIO and the
+// VirtualFileSystem. A load is written top to bottom as a Task, and the awaits decide
+// where each part runs:
+//
+//   co_await loader.readFile(path)  read without blocking any thread, resumes on a worker
+//   co_await loader.onWorker()      continue on the job system (decoding, validation...)
+//   co_await loader.onGLThread()    continue in the next pump() (uploads)
+//
+// So hundreds of loads can be waiting at once while only the worker and I/O threads
+// exist. What bounds memory is 'maxBytesInFlight': a read only starts once its bytes fit
+// in the budget next to everything read and not yet released, otherwise it waits (in
+// order) for LoadedFiles to be destroyed. A file bigger than the whole budget is read
+// when nothing else is held.
+//
+// Compressed pack entries can't be read with AsyncIO, they're decompressed on a worker
+// through the VirtualFileSystem instead, and so are loose files when there is no AsyncIO
+// file for them.
+class AssetLoader {
+    private:
+	struct BudgetWaiter {
+		std::coroutine_handle<> handle;
+		size_t bytes;
+	};
+
+	JobSystem& jobs;
+	AsyncIO& io;
+	const VirtualFileSystem& files;
+	size_t maxBytesInFlight;
+
+	std::mutex mutex;
+	std::unordered_map<std::string, int> ioFiles;
+	std::deque<BudgetWaiter> budgetWaiters;
+	std::vector<std::coroutine_handle<>> glQueue;
+	std::condition_variable glWork;
+	AssetLoaderStats stats;
+
+	friend class LoadedFile;
+
+	int ioFileFor(const std::string& filePath);
+	void release(size_t bytes);
+	void finishLoad(bool ok);
+
+	// Resumes once 'bytes' fit in the budget, on a worker if it had to wait.
+	struct BudgetAwaiter {
+		AssetLoader& loader;
+		size_t bytes;
+
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	// An AsyncIO read, resumed on a worker when it completes.
+	struct ReadAwaiter {
+		AssetLoader& loader;
+		int file;
+		uint64_t offset;
+		void* destination;
+		size_t size;
+		bool ok;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		bool await_resume() const noexcept { return ok; }
+	};
+
+	// Sets 'done' and wakes run() once the task is over.
+	template <typename T>
+	static Task<void> runAndSignal(Task<T> task, std::optional<T>& result, std::atomic<bool>& done, AssetLoader& loader)
+	{
+		result.emplace(co_await std::move(task));
+		loader.signal(done);
+	}
+
+	static Task<void> runAndSignal(Task<void> task, std::atomic<bool>& done, AssetLoader& loader)
+	{
+		co_await std::move(task);
+		loader.signal(done);
+	}
+
+	void signal(std::atomic<bool>& done);
+	void pumpUntil(const std::atomic<bool>& done);
+    public:
+	struct WorkerAwaiter {
+		JobSystem& jobs;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	struct GLThreadAwaiter {
+		AssetLoader& loader;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	AssetLoader(JobSystem& jobs, AsyncIO& io, const VirtualFileSystem& files, size_t maxBytesInFlight = 64 * 1024 * 1024);
+	// Every load has to be over, and every LoadedFile destroyed.
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// The whole file, read into memory. Resumes on a worker.
+	Task<LoadedFile> readFile(std::string path);
+
+	WorkerAwaiter onWorker();
+	GLThreadAwaiter onGLThread();
+
+	// Call once a frame from the GL thread: submits the reads queued since the last call
+	// in one batch and resumes every coroutine waiting in onGLThread. Returns how many.
+	size_t pump();
+
+	// Runs 'task' to the end from the GL thread, pumping while it waits. For loads that
+	// have to be done before the first frame.
+	template <typename T>
+	T run(Task<T> task)
+	{
+		std::optional<T> result;
+		std::atomic<bool> done(false);
+		spawn(runAndSignal(std::move(task), result, done, *this));
+		pumpUntil(done);
+		return std::move(*result);
+	}
+
+	void run(Task<void> task)
+	{
+		std::atomic<bool> done(false);
+		spawn(runAndSignal(std::move(task), done, *this));
+		pumpUntil(done);
+	}
+
+	AssetLoaderStats getStats();
+};
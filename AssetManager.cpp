@@ -0,0 +1,540 @@
+#include "AssetManager.hpp"
+#include "AssetCooker.hpp"
+#include "AssetLoader.hpp"
+#include "GLResources.hpp"
+#include "MeshFile.hpp"
+#include "MipGenerator.hpp"
+#include "TextureStreamer.hpp"
+#include "VirtualFileSystem.hpp"
+#include <iostream>
+#include <utility>
+
+AssetManager::AssetManager(TextureStreamer& streamer, const VirtualFileSystem& files, size_t cpuBudget, size_t gpuBudget)
+	: streamer(streamer), files(files), cpuBudget(cpuBudget), gpuBudget(gpuBudget), frame(0), deduplicated(0), evicted(0)
+{
+	// Slot 0 is the null handle.
+	textures.push_back({});
+	meshes.push_back({});
+}
+
+AssetManager::~AssetManager()
+{
+	PendingDelete batch = {};
+
+	for (uint32_t i = 1; i < textures.size(); i++) {
+		if (textures[i].used)
+			evictTexture(i, batch);
+	}
+
+	for (uint32_t i = 1; i < meshes.size(); i++) {
+		if (meshes[i].used)
+			evictMesh(i, batch);
+	}
+
+	// GL deletes objects that are still in use once it's done with them, the fences are
+	// only there to keep the memory counted until then. Nothing is counted any more.
+	batch.fence = nullptr;
+	pending.push_back(std::move(batch));
+	collectFinished(true);
+}
+
+template <typename SlotType>
+uint32_t AssetManager::allocate(std::vector<SlotType>& slots, std::vector<uint32_t>& freeSlots)
+{
+	if (freeSlots.empty()) {
+		slots.push_back({});
+		return (uint32_t)slots.size() - 1;
+	}
+
+	uint32_t index = freeSlots.back();
+	freeSlots.pop_back();
+	return index;
+}
+
+TextureHandle AssetManager::shareTexture(uint32_t index, const std::string& path)
+{
+	TextureSlot& slot = textures[index];
+	slot.refCount++;
+	slot.lastUsedFrame = frame;
+	texturePaths[path] = index;
+	return { index, slot.generation };
+}
+
+MeshHandle AssetManager::shareMesh(uint32_t index, const std::string& path)
+{
+	MeshSlot& slot = meshes[index];
+	slot.refCount++;
+	slot.lastUsedFrame = frame;
+	meshPaths[path] = index;
+	return { index, slot.generation };
+}
+
+TextureHandle AssetManager::loadTexture(const std::string& path)
+{
+	auto known = texturePaths.find(path);
+	if (known != texturePaths.end())
+		return shareTexture(known->second, path);
+
+	// Mapped only for the hash in its header, the streamer reads what it needs itself.
+	FileData file;
+	if (!files.read(path, file)) {
+		std::cout << "ERROR::ASSET_MANAGER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return {};
+	}
+
+	uint64_t hash = contentHashOf(file);
+	auto same = hash != 0 ? textureContents.find(hash) : textureContents.end();
+	if (same != textureContents.end()) {
+		deduplicated++;
+		return shareTexture(same->second, path);
+	}
+
+	uint32_t index = allocate(textures, freeTextures);
+	TextureSlot& slot = textures[index];
+	slot.used = true;
+	slot.refCount = 0;
+	slot.hash = hash;
+	slot.streamed = streamer.load(path);
+	slot.reloading = false;
+	if (hash != 0)
+		textureContents[hash] = index;
+	return shareTexture(index, path);
+}
+
+uint64_t AssetManager::contentHashOf(const FileData& file)
+{
+	// Cooked chains carry the hash of their levels, worked out when they were written.
+	// Hashing the whole file here would read every level of it on the GL thread. Source
+	// images don't have one, they're only ever found by name.
+	uint64_t hash = 0;
+	if (!MipGenerator::readCacheHash(file.data(), file.size(), hash))
+		return 0;
+
+	return hash;
+}
+
+Task<MeshHandle> AssetManager::loadMesh(AssetLoader& loader, std::string path, uint32_t attributes)
+{
+	auto known = meshPaths.find(path);
+	if (known != meshPaths.end())
+		co_return shareMesh(known->second, path);
+
+	// On a worker from here: hashing and checking the file are the slow part.
+	LoadedFile file = co_await loader.readFile(path);
+	uint64_t hash = AssetCooker::hashBytes(file.data(), file.size());
+	MeshFile meshFile;
+	bool valid = file.ok() && meshFile.open(std::move(file.getFile()), path) && (meshFile.getHeader().attributes & attributes) == attributes;
+
+	co_await loader.onGLThread();
+
+	// Another load of the same thing may have finished while this one was reading.
+	known = meshPaths.find(path);
+	if (known != meshPaths.end())
+		co_return shareMesh(known->second, path);
+
+	auto same = meshContents.find(hash);
+	if (valid && same != meshContents.end()) {
+		deduplicated++;
+		co_return shareMesh(same->second, path);
+	}
+
+	if (!valid)
+		co_return MeshHandle{};
+
+	MeshAsset mesh;
+	mesh.vertexBuffer = GLResources::createBuffer();
+	mesh.indexBuffer = GLResources::createBuffer();
+
+	if (!meshFile.upload(mesh.vertexBuffer, mesh.indexBuffer)) {
+		GLResources::deleteBuffers(1, &mesh.vertexBuffer);
+		GLResources::deleteBuffers(1, &mesh.indexBuffer);
+		co_return MeshHandle{};
+	}
+
+	const MeshFileHeader& header = meshFile.getHeader();
+	mesh.indexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	mesh.layout = meshFile.getLayout();
+	mesh.dequantization = header.dequantization;
+	mesh.meshlets.assign(meshFile.getMeshlets(), meshFile.getMeshlets() + header.meshletCount);
+	mesh.lods.assign(meshFile.getLods(), meshFile.getLods() + header.lodCount);
+
+	co_return insertMesh(path, hash, std::move(mesh));
+}
+
+MeshHandle AssetManager::addMesh(const std::string& name, MeshAsset mesh)
+{
+	// Nothing to hash these by, so they're only ever found by name.
+	return insertMesh(name, 0, std::move(mesh));
+}
+
+MeshHandle AssetManager::insertMesh(const std::string& path, uint64_t hash, MeshAsset mesh)
+{
+	uint32_t index = allocate(meshes, freeMeshes);
+	MeshSlot& slot = meshes[index];
+	slot.used = true;
+	slot.refCount = 0;
+	slot.hash = hash;
+	slot.mesh = std::move(mesh);
+	slot.gpuBytes = bufferBytes(slot.mesh.vertexBuffer) + bufferBytes(slot.mesh.indexBuffer);
+
+	if (hash != 0)
+		meshContents[hash] = index;
+
+	return shareMesh(index, path);
+}
+
+size_t AssetManager::bufferBytes(GLuint buffer)
+{
+	return (size_t)GLResources::bufferSize(buffer);
+}
+
+void AssetManager::addRef(TextureHandle handle)
+{
+	TextureSlot* slot = slotOf(textures, handle);
+	if (slot != nullptr) {
+		slot->refCount++;
+		slot->lastUsedFrame = frame;
+	}
+}
+
+void AssetManager::addRef(MeshHandle handle)
+{
+	MeshSlot* slot = slotOf(meshes, handle);
+	if (slot != nullptr) {
+		slot->refCount++;
+		slot->lastUsedFrame = frame;
+	}
+}
+
+void AssetManager::release(TextureHandle handle)
+{
+	TextureSlot* slot = slotOf(textures, handle);
+	if (slot != nullptr && slot->refCount > 0) {
+		slot->refCount--;
+		slot->lastUsedFrame = frame;
+	}
+}
+
+void AssetManager::release(MeshHandle handle)
+{
+	MeshSlot* slot = slotOf(meshes, handle);
+	if (slot != nullptr && slot->refCount > 0) {
+		slot->refCount--;
+		slot->lastUsedFrame = frame;
+	}
+}
+
+GLuint AssetManager::getTexture(TextureHandle handle) const
+{
+	const TextureSlot* slot = slotOf(textures, handle);
+	return slot != nullptr ? streamer.getTexture(slot->streamed) : 0;
+}
+
+float AssetManager::getTextureMinLod(TextureHandle handle) const
+{
+	const TextureSlot* slot = slotOf(textures, handle);
+	return slot != nullptr ? streamer.getMinLod(slot->streamed) : 0.0f;
+}
+
+const MeshAsset* AssetManager::getMesh(MeshHandle handle) const
+{
+	const MeshSlot* slot = slotOf(meshes, handle);
+	return slot != nullptr ? &slot->mesh : nullptr;
+}
+
+void AssetManager::requestScreenSize(TextureHandle handle, float screenPixels)
+{
+	TextureSlot* slot = slotOf(textures, handle);
+	if (slot != nullptr) {
+		streamer.requestScreenSize(slot->streamed, screenPixels);
+		slot->lastUsedFrame = frame;
+
+		// So the new version streams in the detail the old one has.
+		if (slot->reloading)
+			streamer.requestScreenSize(slot->reloaded, screenPixels);
+	}
+}
+
+void AssetManager::reloadTexture(const std::string& path)
+{
+	auto known = texturePaths.find(path);
+	if (known == texturePaths.end())
+		return;
+
+	// Other paths share the slot because they had the same bytes, and their files didn't
+	// change. This path gets a slot of its own (or whichever one already has the new
+	// bytes) and the others keep the old texture. The handles given out stay on the old
+	// slot, there's no telling which path they were loaded as.
+	size_t owners = 0;
+	for (const auto& entry : texturePaths) {
+		if (entry.second == known->second)
+			owners++;
+	}
+
+	if (owners > 1) {
+		texturePaths.erase(known);
+		release(loadTexture(path));
+		return;
+	}
+
+	TextureSlot& slot = textures[known->second];
+	PendingDelete batch = {};
+
+	// Saved again before the last reload was done: that one is out of date already.
+	if (slot.reloading)
+		batch.textures.push_back(streamer.unload(slot.reloaded));
+
+	// The bytes changed, and so does what this texture can be shared with.
+	FileData file;
+	if (files.read(path, file)) {
+		auto shared = textureContents.find(slot.hash);
+		if (shared != textureContents.end() && shared->second == known->second)
+			textureContents.erase(shared);
+
+		slot.hash = contentHashOf(file);
+		if (slot.hash != 0)
+			textureContents[slot.hash] = known->second;
+	}
+
+	slot.reloading = true;
+	slot.reloaded = streamer.load(path);
+	slot.reloadWait = 0;
+
+	if (!batch.textures.empty()) {
+		batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pending.push_back(std::move(batch));
+	}
+}
+
+void AssetManager::finishReloads(PendingDelete& batch)
+{
+	// Swapped between frames, so a frame never samples half of one and half of the other.
+	for (uint32_t i = 1; i < textures.size(); i++) {
+		TextureSlot& slot = textures[i];
+		if (!slot.used || !slot.reloading)
+			continue;
+
+		if (streamer.hasFailed(slot.reloaded)) {
+			std::cout << "ERROR::ASSET_MANAGER::RELOAD_FAILED, keeping the old texture" << std::endl;
+			batch.textures.push_back(streamer.unload(slot.reloaded));
+			slot.reloading = false;
+			continue;
+		}
+
+		if (!streamer.isReady(slot.reloaded))
+			continue;
+
+		constexpr unsigned int MAX_RELOAD_WAIT = 30;
+		if (streamer.getResidentLevel(slot.reloaded) > streamer.getResidentLevel(slot.streamed) && ++slot.reloadWait < MAX_RELOAD_WAIT)
+			continue;
+
+		batch.gpuBytes += streamer.getResidentBytes(slot.streamed);
+		batch.textures.push_back(streamer.unload(slot.streamed));
+		slot.streamed = slot.reloaded;
+		slot.reloading = false;
+	}
+}
+
+void AssetManager::evictTexture(uint32_t index, PendingDelete& batch)
+{
+	TextureSlot& slot = textures[index];
+	batch.gpuBytes += streamer.getResidentBytes(slot.streamed);
+	batch.textures.push_back(streamer.unload(slot.streamed));
+
+	if (slot.reloading) {
+		batch.textures.push_back(streamer.unload(slot.reloaded));
+		slot.reloading = false;
+	}
+
+	for (auto it = texturePaths.begin(); it != texturePaths.end();) {
+		it = it->second == index ? texturePaths.erase(it) : std::next(it);
+	}
+	auto shared = textureContents.find(slot.hash);
+	if (shared != textureContents.end() && shared->second == index)
+		textureContents.erase(shared);
+
+	slot.used = false;
+	slot.generation++;
+	freeTextures.push_back(index);
+}
+
+void AssetManager::evictMesh(uint32_t index, PendingDelete& batch)
+{
+	MeshSlot& slot = meshes[index];
+	batch.gpuBytes += slot.gpuBytes;
+	batch.buffers.push_back(slot.mesh.vertexBuffer);
+	batch.buffers.push_back(slot.mesh.indexBuffer);
+
+	for (auto it = meshPaths.begin(); it != meshPaths.end();) {
+		it = it->second == index ? meshPaths.erase(it) : std::next(it);
+	}
+	if (slot.hash != 0)
+		meshContents.erase(slot.hash);
+
+	slot.mesh = MeshAsset();
+	slot.used = false;
+	slot.generation++;
+	freeMeshes.push_back(index);
+}
+
+void AssetManager::collectFinished(bool wait)
+{
+	size_t kept = 0;
+
+	for (size_t i = 0; i < pending.size(); i++) {
+		PendingDelete& batch = pending[i];
+
+		if (batch.fence != nullptr) {
+			// A timeout of 0 only asks, it never stalls the frame.
+			GLenum status = glClientWaitSync(batch.fence, 0, wait ? GL_TIMEOUT_IGNORED : 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED) {
+				// Moving a batch onto itself would empty it.
+				if (kept != i)
+					pending[kept] = std::move(batch);
+				kept++;
+				continue;
+			}
+
+			glDeleteSync(batch.fence);
+		}
+
+		GLResources::deleteTextures((GLsizei)batch.textures.size(), batch.textures.data());
+		GLResources::deleteBuffers((GLsizei)batch.buffers.size(), batch.buffers.data());
+	}
+
+	pending.resize(kept);
+}
+
+size_t AssetManager::cpuBytes() const
+{
+	size_t bytes = 0;
+
+	for (const MeshSlot& slot : meshes) {
+		if (slot.used)
+			bytes += slot.mesh.meshlets.size() * sizeof(Meshlet) + slot.mesh.lods.size() * sizeof(MeshLod);
+	}
+
+	return bytes;
+}
+
+size_t AssetManager::gpuBytes() const
+{
+	size_t bytes = 0;
+
+	for (const TextureSlot& slot : textures) {
+		if (slot.used)
+			bytes += streamer.getResidentBytes(slot.streamed);
+	}
+
+	for (const MeshSlot& slot : meshes) {
+		if (slot.used)
+			bytes += slot.gpuBytes;
+	}
+
+	// Evicted but not deleted yet still takes up memory.
+	for (const PendingDelete& batch : pending) {
+		bytes += batch.gpuBytes;
+	}
+
+	return bytes;
+}
+
+void AssetManager::update()
+{
+	collectFinished(false);
+
+	PendingDelete batch = {};
+	finishReloads(batch);
+
+	// What's waiting for its fence is on its way out already: counting it here would
+	// evict something more every frame until the GPU catches up.
+	size_t cpu = cpuBytes();
+	size_t gpu = gpuBytes();
+	for (const PendingDelete& pendingBatch : pending) {
+		gpu -= pendingBatch.gpuBytes;
+	}
+
+	while (cpu > cpuBudget || gpu > gpuBudget) {
+		// The least recently used asset nobody holds, textures and meshes alike.
+		uint32_t victim = 0;
+		bool victimIsMesh = false;
+		unsigned long long oldest = ~0ull;
+
+		for (uint32_t i = 1; i < textures.size(); i++) {
+			if (textures[i].used && textures[i].refCount == 0 && textures[i].lastUsedFrame < oldest) {
+				victim = i;
+				victimIsMesh = false;
+				oldest = textures[i].lastUsedFrame;
+			}
+		}
+
+		for (uint32_t i = 1; i < meshes.size(); i++) {
+			if (meshes[i].used && meshes[i].refCount == 0 && meshes[i].lastUsedFrame < oldest) {
+				victim = i;
+				victimIsMesh = true;
+				oldest = meshes[i].lastUsedFrame;
+			}
+		}
+
+		if (victim == 0)
+			break;
+
+		// Textures only take up GPU memory, their pixels are never kept on the CPU.
+		if (victimIsMesh) {
+			cpu -= meshes[victim].mesh.meshlets.size() * sizeof(Meshlet) + meshes[victim].mesh.lods.size() * sizeof(MeshLod);
+			gpu -= meshes[victim].gpuBytes;
+			evictMesh(victim, batch);
+		}
+		else {
+			gpu -= streamer.getResidentBytes(textures[victim].streamed);
+			evictTexture(victim, batch);
+		}
+
+		evicted++;
+	}
+
+	// Whatever was drawn with them so far has been submitted, so once the GPU gets past
+	// this fence nothing uses them any more.
+	if (!batch.textures.empty() || !batch.buffers.empty()) {
+		batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pending.push_back(std::move(batch));
+	}
+
+	frame++;
+}
+
+AssetManagerStats AssetManager::getStats() const
+{
+	AssetManagerStats stats = {};
+
+	for (uint32_t i = 1; i < textures.size(); i++) {
+		if (textures[i].used) {
+			stats.textures++;
+			stats.unreferenced += textures[i].refCount == 0;
+		}
+	}
+
+	for (uint32_t i = 1; i < meshes.size(); i++) {
+		if (meshes[i].used) {
+			stats.meshes++;
+			stats.unreferenced += meshes[i].refCount == 0;
+		}
+	}
+
+	for (const PendingDelete& batch : pending) {
+		stats.pendingDeletes += batch.textures.size() + batch.buffers.size();
+	}
+
+	stats.cpuBytes = cpuBytes();
+	stats.gpuBytes = gpuBytes();
+	stats.deduplicated = deduplicated;
+	stats.evicted = evicted;
+	return stats;
+}
+
+void AssetManager::printStats(const AssetManagerStats& stats)
+{
+	std::cout << "Assets: " << stats.textures << " textures, " << stats.meshes << " meshes (" << stats.unreferenced << " unreferenced), "
+		<< stats.cpuBytes / 1024 << " KB CPU, " << stats.gpuBytes / 1024 << " KB GPU, " << stats.deduplicated << " deduplicated, "
+		<< stats.evicted << " evicted, " << stats.pendingDeletes << " waiting for the GPU" << std::endl;
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Task.hpp"
+#include "Meshlets.hpp"
+#include "MeshSimplifier.hpp"
+#include "VertexFormat.hpp"
+#include "VertexQuantizer.hpp"
+
+class AssetLoader;
+class FileData;
+class TextureStreamer;
+class VirtualFileSystem;
+
+// A reference to an asset of one type ('Tag' keeps textures and meshes from being mixed
+// up). The generation is bumped every time a slot is freed, so a handle to an evicted
+// asset is noticed instead of pointing at whatever took its place. Index 0 is never
+// used: a zeroed handle is no asset at all.
+template <typename Tag>
+struct AssetHandle {
+	uint32_t index;
+	uint32_t generation;
+
+	bool isValid() const { return index != 0; }
+	bool operator==(const AssetHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const AssetHandle& other) const { return !(*this == other); }
+};
+
+struct TextureAssetTag;
+struct MeshAssetTag;
+typedef AssetHandle<TextureAssetTag> TextureHandle;
+typedef AssetHandle<MeshAssetTag> MeshHandle;
+
+// Everything needed to draw a mesh. The buffers belong to the AssetManager. There's no
+// VAO per mesh, meshes with the same layout share one (see VertexArrayCache).
+struct MeshAsset {
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	GLenum indexType;
+	VertexLayout layout;
+	VertexDequantization dequantization;
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshLod> lods;
+};
+
+struct AssetManagerStats {
+	size_t textures;
+	size_t meshes;
+	size_t unreferenced;   // still loaded, but only until the memory is needed
+	size_t cpuBytes;
+	size_t gpuBytes;
+	size_t deduplicated;   // loads that got an asset already loaded from the same bytes
+	size_t evicted;
+	size_t pendingDeletes; // GL objects waiting for their fence
+};
+
+// Owns the textures and meshes the renderer uses, so they're loaded once, shared, and
+// given back when nobody needs them any more.
+//
+// Loads return a handle holding one reference; addRef and release count the others.
+// The same path twice, or two paths with the same bytes (by content hash), give the same
+// asset. An asset nobody references isn't destroyed right away: it stays loaded (a later
+// load of it is free) until the CPU or GPU memory in use goes over its budget, and then
+// the least recently used ones go first.
+//
+// The GPU may still be drawing with an asset in the frames after it's evicted, so its
+// GL objects are only deleted once a fence inserted at eviction has been passed. The
+// manager's memory counts them until then.
+//
+// Everything here runs on the GL thread, except the parts of loadMesh after its read.
+class AssetManager {
+    private:
+	struct Slot {
+		uint32_t generation;
+		uint32_t refCount;
+		bool used;
+		uint64_t hash;
+		unsigned long long lastUsedFrame;
+	};
+
+	struct TextureSlot : Slot {
+		unsigned int streamed; // TextureStreamer handle
+		// A new version being loaded next to the old one (see reloadTexture).
+		bool reloading;
+		unsigned int reloaded;
+		unsigned int reloadWait; // frames it's been ready without catching up
+	};
+
+	struct MeshSlot : Slot {
+		MeshAsset mesh;
+		size_t gpuBytes;
+	};
+
+	struct PendingDelete {
+		GLsync fence;
+		std::vector<GLuint> textures;
+		std::vector<GLuint> buffers;
+		size_t gpuBytes;
+	};
+
+	TextureStreamer& streamer;
+	const VirtualFileSystem& files;
+	size_t cpuBudget;
+	size_t gpuBudget;
+	unsigned long long frame;
+	size_t deduplicated;
+	size_t evicted;
+
+	std::vector<TextureSlot> textures;
+	std::vector<MeshSlot> meshes;
+	std::vector<uint32_t> freeTextures;
+	std::vector<uint32_t> freeMeshes;
+	// Every path an asset was loaded as, and the hash of its bytes.
+	std::unordered_map<std::string, uint32_t> texturePaths;
+	std::unordered_map<std::string, uint32_t> meshPaths;
+	std::unordered_map<uint64_t, uint32_t> textureContents;
+	std::unordered_map<uint64_t, uint32_t> meshContents;
+
+	std::vector<PendingDelete> pending;
+
+	// The slot 'handle' refers to, nullptr if it's stale.
+	template <typename Slots, typename Tag>
+	static auto slotOf(Slots& slots, AssetHandle<Tag> handle) -> decltype(&slots[0])
+	{
+		if (handle.index == 0 || handle.index >= slots.size() || !slots[handle.index].used || slots[handle.index].generation != handle.generation)
+			return nullptr;
+
+		return &slots[handle.index];
+	}
+
+	template <typename SlotType>
+	static uint32_t allocate(std::vector<SlotType>& slots, std::vector<uint32_t>& freeSlots);
+
+	TextureHandle shareTexture(uint32_t index, const std::string& path);
+	MeshHandle shareMesh(uint32_t index, const std::string& path);
+	MeshHandle insertMesh(const std::string& path, uint64_t hash, MeshAsset mesh);
+	// What textures are deduplicated by, 0 for nothing.
+	static uint64_t contentHashOf(const FileData& file);
+	void evictTexture(uint32_t index, PendingDelete& batch);
+	void finishReloads(PendingDelete& batch);
+	void evictMesh(uint32_t index, PendingDelete& batch);
+	void collectFinished(bool wait);
+	size_t cpuBytes() const;
+	size_t gpuBytes() const;
+	static size_t bufferBytes(GLuint buffer);
+    public:
+	AssetManager(TextureStreamer& streamer, const VirtualFileSystem& files, size_t cpuBudget, size_t gpuBudget);
+	// Deletes everything, referenced or not.
+	~AssetManager();
+
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	// Starts streaming the texture (see TextureStreamer::load). A null handle if the
+	// file can't be read.
+	TextureHandle loadTexture(const std::string& path);
+
+	// Reads the mesh through 'loader', checks it on a worker and uploads it on the GL
+	// thread. It has to have every bit of 'attributes'. A null handle on failure.
+	Task<MeshHandle> loadMesh(AssetLoader& loader, std::string path, uint32_t attributes = 0);
+	// Takes over a mesh built some other way. 'name' is what later loads find it by.
+	MeshHandle addMesh(const std::string& name, MeshAsset mesh);
+
+	void addRef(TextureHandle handle);
+	void addRef(MeshHandle handle);
+	void release(TextureHandle handle);
+	void release(MeshHandle handle);
+
+	// 0 and nullptr for handles that aren't (or are no longer) loaded. The MeshAsset is
+	// only valid until the next mesh is loaded or added.
+	GLuint getTexture(TextureHandle handle) const;
+	// For the SamplerDesc it's drawn with, see TextureStreamer::getMinLod. 0 for handles
+	// that aren't loaded.
+	float getTextureMinLod(TextureHandle handle) const;
+	const MeshAsset* getMesh(MeshHandle handle) const;
+
+	// Loads the texture at 'path' again, if one was loaded from it. The old version stays
+	// in use until the new one has caught up with its detail (or for a few frames if it
+	// can't), and is kept if the new one can't be loaded. Handles stay valid. If other
+	// paths share the texture (same bytes), only later loads of 'path' see the new one.
+	void reloadTexture(const std::string& path);
+
+	// Passed on to the TextureStreamer, and what keeps the texture recently used.
+	void requestScreenSize(TextureHandle handle, float screenPixels);
+
+	// Once a frame on the GL thread: deletes what the GPU has finished with and evicts
+	// unreferenced assets while over a budget.
+	void update();
+
+	AssetManagerStats getStats() const;
+	static void printStats(const AssetManagerStats& stats);
+};
@@ -0,0 +1,307 @@
+#include "AssetPack.hpp"
+#include "FastLz.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static const char PACK_MAGIC[4] = { 'P', 'A', 'C', 'K' };
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + ASSET_PACK_ALIGNMENT - 1) & ~(ASSET_PACK_ALIGNMENT - 1);
+}
+
+AssetPack::AssetPack()
+	: header(nullptr), hashes(nullptr), entries(nullptr), names(nullptr)
+{
+}
+
+bool AssetPack::open(const std::string& path)
+{
+	close();
+
+	if (!file.open(path))
+		return false;
+
+	const unsigned char* data = file.data();
+	uint64_t size = file.size();
+	const AssetPackHeader* candidate = (const AssetPackHeader*)data;
+
+	if (size < sizeof(AssetPackHeader) || std::equal(candidate->magic, candidate->magic + 4, PACK_MAGIC) == false
+		|| candidate->version != ASSET_PACK_VERSION) {
+		std::cout << "ERROR::ASSET_PACK::NOT_A_PACK " << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	uint64_t count = candidate->entryCount;
+	bool valid = candidate->hashOffset % 8 == 0 && candidate->entryOffset % 8 == 0
+		&& candidate->hashOffset <= size && count * sizeof(uint64_t) <= size - candidate->hashOffset
+		&& candidate->entryOffset <= size && count * sizeof(AssetPackEntry) <= size - candidate->entryOffset
+		&& candidate->nameOffset <= size && candidate->nameBytes <= size - candidate->nameOffset;
+
+	// Every entry has to be inside the file, so nothing handed out later can point past it.
+	const AssetPackEntry* table = valid ? (const AssetPackEntry*)(data + candidate->entryOffset) : nullptr;
+	for (uint64_t i = 0; valid && i < count; i++) {
+		const AssetPackEntry& entry = table[i];
+		valid = entry.offset <= size && entry.storedSize <= size - entry.offset
+			&& (uint64_t)entry.nameOffset + entry.nameLength <= candidate->nameBytes
+			&& ((entry.flags & ASSET_PACK_COMPRESSED) != 0 || entry.storedSize == entry.size);
+	}
+
+	if (!valid) {
+		std::cout << "ERROR::ASSET_PACK::CORRUPT_TABLE_OF_CONTENTS " << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	this->path = path;
+	header = candidate;
+	hashes = (const uint64_t*)(data + header->hashOffset);
+	entries = table;
+	names = (const char*)(data + header->nameOffset);
+	return true;
+}
+
+void AssetPack::close()
+{
+	file.close();
+	path.clear();
+	header = nullptr;
+	hashes = nullptr;
+	entries = nullptr;
+	names = nullptr;
+}
+
+size_t AssetPack::size() const
+{
+	return header != nullptr ? header->entryCount : 0;
+}
+
+const std::string& AssetPack::getPath() const
+{
+	return path;
+}
+
+int AssetPack::find(const std::string& name) const
+{
+	if (header == nullptr)
+		return -1;
+
+	std::string normalized = normalizePath(name);
+	uint64_t hash = hashPath(normalized);
+	const uint64_t* end = hashes + header->entryCount;
+
+	// Two paths can share a hash, so look at every entry that has it.
+	for (const uint64_t* it = std::lower_bound(hashes, end, hash); it != end && *it == hash; it++) {
+		const AssetPackEntry& entry = entries[it - hashes];
+		if (entry.nameLength == normalized.size() && memcmp(names + entry.nameOffset, normalized.data(), entry.nameLength) == 0)
+			return (int)(it - hashes);
+	}
+
+	return -1;
+}
+
+const AssetPackEntry& AssetPack::getEntry(int index) const
+{
+	return entries[index];
+}
+
+std::string AssetPack::getName(int index) const
+{
+	return std::string(names + entries[index].nameOffset, entries[index].nameLength);
+}
+
+const unsigned char* AssetPack::getStoredData(int index) const
+{
+	return file.data() + entries[index].offset;
+}
+
+bool AssetPack::extract(int index, void* destination) const
+{
+	const AssetPackEntry& entry = entries[index];
+
+	if ((entry.flags & ASSET_PACK_COMPRESSED) == 0) {
+		memcpy(destination, getStoredData(index), entry.size);
+		return true;
+	}
+
+	if (!FastLz::decompress(getStoredData(index), entry.storedSize, destination, entry.size)) {
+		std::cout << "ERROR::ASSET_PACK::CORRUPT_ENTRY " << getName(index) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string AssetPack::normalizePath(const std::string& path)
+{
+	std::string normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+	while (normalized.compare(0, 2, "./") == 0) {
+		normalized.erase(0, 2);
+	}
+
+	return normalized;
+}
+
+uint64_t AssetPack::hashPath(const std::string& path)
+{
+	// FNV-1a, 64 bits.
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : path) {
+		hash = (hash ^ c) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool AssetPack::write(const std::string& path, const std::vector<AssetPackSource>& sources, size_t* compressedCount)
+{
+	struct Pending {
+		std::string name;
+		uint64_t hash;
+		uint32_t flags;
+		std::vector<unsigned char> stored; // only when compressed
+		MappedFile original;
+		uint32_t size;
+	};
+
+	std::vector<Pending> pending(sources.size());
+	size_t compressed = 0;
+
+	for (size_t i = 0; i < sources.size(); i++) {
+		Pending& item = pending[i];
+		item.name = normalizePath(sources[i].name);
+		item.hash = hashPath(item.name);
+		item.flags = 0;
+
+		// MappedFile can't map an empty file, but an empty entry is fine.
+		std::error_code error;
+		bool empty = std::filesystem::exists(sources[i].path, error) && std::filesystem::file_size(sources[i].path, error) == 0;
+
+		if (!empty && !item.original.open(sources[i].path)) {
+			std::cout << "ERROR::ASSET_PACK::FILE_NOT_SUCCESFULLY_READ " << sources[i].path << std::endl;
+			return false;
+		}
+
+		if (item.original.size() > UINT32_MAX) {
+			std::cout << "ERROR::ASSET_PACK::FILE_TOO_BIG " << sources[i].path << std::endl;
+			return false;
+		}
+
+		item.size = (uint32_t)item.original.size();
+
+		if (sources[i].compress && item.size > 0) {
+			item.stored.resize(FastLz::compressBound(item.size));
+			size_t storedSize = FastLz::compress(item.original.data(), item.size, item.stored.data(), item.stored.size());
+
+			if (storedSize > 0 && storedSize <= item.size - item.size / 8) {
+				item.stored.resize(storedSize);
+				item.flags |= ASSET_PACK_COMPRESSED;
+				compressed++;
+			}
+			else {
+				item.stored.clear();
+			}
+		}
+	}
+
+	std::vector<size_t> order(pending.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return pending[a].hash != pending[b].hash ? pending[a].hash < pending[b].hash : pending[a].name < pending[b].name;
+	});
+
+	for (size_t i = 1; i < order.size(); i++) {
+		if (pending[order[i]].name == pending[order[i - 1]].name) {
+			std::cout << "ERROR::ASSET_PACK::DUPLICATE_NAME " << pending[order[i]].name << std::endl;
+			return false;
+		}
+	}
+
+	AssetPackHeader header = {};
+	memcpy(header.magic, PACK_MAGIC, 4);
+	header.version = ASSET_PACK_VERSION;
+	header.entryCount = (uint32_t)pending.size();
+	header.hashOffset = alignUp(sizeof(AssetPackHeader));
+	header.entryOffset = alignUp(header.hashOffset + sizeof(uint64_t) * pending.size());
+	header.nameOffset = header.entryOffset + sizeof(AssetPackEntry) * pending.size();
+
+	std::vector<uint64_t> hashes;
+	std::vector<AssetPackEntry> entries;
+	std::string names;
+
+	for (size_t index : order) {
+		const Pending& item = pending[index];
+		AssetPackEntry entry = {};
+		entry.size = item.size;
+		entry.storedSize = (item.flags & ASSET_PACK_COMPRESSED) != 0 ? (uint32_t)item.stored.size() : item.size;
+		entry.nameOffset = (uint32_t)names.size();
+		entry.nameLength = (uint32_t)item.name.size();
+		entry.flags = item.flags;
+
+		hashes.push_back(item.hash);
+		entries.push_back(entry);
+		names += item.name;
+	}
+
+	header.nameBytes = (uint32_t)names.size();
+	header.dataOffset = alignUp(header.nameOffset + names.size());
+
+	uint64_t offset = header.dataOffset;
+	for (AssetPackEntry& entry : entries) {
+		entry.offset = offset;
+		offset = alignUp(offset + entry.storedSize);
+	}
+
+	// Written next to the real name and renamed at the end, like the mip caches.
+	std::string temporary = path + ".tmp";
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+	if (!file)
+		return false;
+
+	static const char padding[ASSET_PACK_ALIGNMENT] = {};
+	auto padTo = [&](uint64_t position) {
+		uint64_t current = (uint64_t)file.tellp();
+		if (position > current)
+			file.write(padding, (std::streamsize)(position - current));
+	};
+
+	file.write((const char*)&header, sizeof(header));
+	padTo(header.hashOffset);
+	file.write((const char*)hashes.data(), (std::streamsize)(hashes.size() * sizeof(uint64_t)));
+	padTo(header.entryOffset);
+	file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(AssetPackEntry)));
+	file.write(names.data(), (std::streamsize)names.size());
+
+	for (size_t i = 0; i < order.size(); i++) {
+		const Pending& item = pending[order[i]];
+		padTo(entries[i].offset);
+
+		if ((item.flags & ASSET_PACK_COMPRESSED) != 0)
+			file.write((const char*)item.stored.data(), (std::streamsize)item.stored.size());
+		else if (item.size > 0)
+			file.write((const char*)item.original.data(), (std::streamsize)item.size);
+	}
+
+	file.close();
+
+	if (!file) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	if (compressedCount != nullptr)
+		*compressedCount = compressed;
+
+	std::remove(path.c_str());
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
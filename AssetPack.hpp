@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+// Many files in one (.pack), so the runtime opens and maps a single file instead of one
+// per asset:
+//
+//   AssetPackHeader
+//   uint64_t hashes[entryCount]         sorted, the path hash of every entry
+//   AssetPackEntry entries[entryCount]  in the same order
+//   names                               the paths, to tell apart two with the same hash
+//   data                                every entry at a multiple of ASSET_PACK_ALIGNMENT
+//
+// A lookup hashes the path and binary searches the hash array, which is 8 bytes per
+// entry and stays in cache. Entries can be stored compressed with FastLz; the others are
+// handed out as pointers into the mapping. The alignment is the same as MeshFile's, so a
+// mesh stored as it is can still go from the mapping to glBufferData without a copy.
+
+constexpr uint32_t ASSET_PACK_VERSION = 1;
+constexpr uint64_t ASSET_PACK_ALIGNMENT = 64;
+
+enum AssetPackEntryFlags : uint32_t {
+	ASSET_PACK_COMPRESSED = 1 << 0
+};
+
+struct AssetPackHeader {
+	char magic[4]; // "PACK"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t nameBytes;
+	uint64_t hashOffset;
+	uint64_t entryOffset;
+	uint64_t nameOffset;
+	uint64_t dataOffset;
+};
+
+struct AssetPackEntry {
+	uint64_t offset;
+	uint32_t size;       // once decompressed
+	uint32_t storedSize; // in the pack
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t flags;      // AssetPackEntryFlags
+	uint32_t reserved;
+};
+
+// A file to put in a pack: 'name' is what it's looked up by, 'path' where it is now.
+struct AssetPackSource {
+	std::string name;
+	std::string path;
+	bool compress;
+};
+
+class AssetPack {
+    private:
+	MappedFile file;
+	std::string path;
+	const AssetPackHeader* header;
+	const uint64_t* hashes;
+	const AssetPackEntry* entries;
+	const char* names;
+    public:
+	AssetPack();
+
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	// Maps the pack and checks the table of contents.
+	bool open(const std::string& path);
+	void close();
+
+	size_t size() const;
+	const std::string& getPath() const;
+
+	// Index of the entry, -1 if the pack doesn't have it.
+	int find(const std::string& name) const;
+
+	const AssetPackEntry& getEntry(int index) const;
+	std::string getName(int index) const;
+	// The entry as stored, compressed or not.
+	const unsigned char* getStoredData(int index) const;
+
+	// Decompresses (or copies) the entry into 'destination', getEntry(index).size bytes.
+	bool extract(int index, void* destination) const;
+
+	// Paths are looked up with forward slashes, whatever the caller used.
+	static std::string normalizePath(const std::string& path);
+	static uint64_t hashPath(const std::string& path);
+
+	// Compressed entries are only kept compressed if that saves at least an eighth,
+	// otherwise they aren't worth the decompression.
+	static bool write(const std::string& path, const std::vector<AssetPackSource>& sources, size_t* compressedCount = nullptr);
+};
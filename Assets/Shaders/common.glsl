@@ -0,0 +1,24 @@
+// Included by the vertex shaders. The attribute locations are VertexSemantic's (see
+// VertexFormat.hpp), the model matrix takes 4 to 7 (INSTANCE_MODEL_LOCATION) and
+// anything extra comes after it. Uniform locations 0 to 3 are taken here.
+#include "locations.glsl"
+#define LOCATION_POSITION 0
+#define LOCATION_TEXCOORD 1
+#define LOCATION_MODEL 4
+#define LOCATION_COLOR 8
+
+// Quantized vertices come in as normalized integers, these put them back in range.
+UNIFORM(0) vec3 positionOffset = vec3(0.0);
+UNIFORM(1) vec3 positionScale = vec3(1.0);
+UNIFORM(2) vec2 texcoordOffset = vec2(0.0);
+UNIFORM(3) vec2 texcoordScale = vec2(1.0);
+
+vec3 dequantizePosition(vec3 position)
+{
+    return positionOffset + position * positionScale;
+}
+
+vec2 dequantizeTexcoord(vec2 texcoord)
+{
+    return texcoordOffset + texcoord * texcoordScale;
+}
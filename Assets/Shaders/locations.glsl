@@ -0,0 +1,17 @@
+// Included first by every shader, before anything that isn't a directive.
+//
+// Compiled to SPIR-V (glslang defines GL_SPIRV) nothing is matched by name: what a stage
+// writes needs the location the next one reads it from, and the runtime sets uniforms by
+// their locations (see ShaderModuleFile::findUniforms). Those have to be different over
+// both stages of a program. From GLSL the driver picks them.
+#if defined(GL_SPIRV) || defined(SEPARATE_STAGES)
+#extension GL_ARB_separate_shader_objects : require
+#endif
+#ifdef GL_SPIRV
+#extension GL_ARB_explicit_uniform_location : require
+#define VARYING(n) layout(location = n)
+#define UNIFORM(n) layout(location = n) uniform
+#else
+#define VARYING(n)
+#define UNIFORM(n) uniform
+#endif
@@ -1,13 +1,29 @@
 #version 330 core
+// BLEND_TEXTURES: mixes texture2 in by transparency. Without it only texture1 is sampled.
+// RUNTIME_BRANCHES: one program for both, picked by the blendTextures uniform instead.
+// Only there to compare against the specialized ones.
+#pragma keywords BLEND_TEXTURES RUNTIME_BRANCHES
+#include "locations.glsl"
 out vec4 FragColor;
 
-in vec2 TexCoord;
+VARYING(0) in vec2 TexCoord;
 
-uniform sampler2D texture1;
-uniform sampler2D texture2;
-uniform float transparency;
+// After the vertex shader's.
+UNIFORM(6) sampler2D texture1;
+UNIFORM(7) sampler2D texture2;
+UNIFORM(8) float transparency;
+#ifdef RUNTIME_BRANCHES
+UNIFORM(9) bool blendTextures;
+#endif
   
 void main()
 {
-     FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), transparency);
+    vec4 color = texture(texture1, TexCoord);
+#if defined(RUNTIME_BRANCHES)
+    if (blendTextures)
+        color = mix(color, texture(texture2, TexCoord), transparency);
+#elif defined(BLEND_TEXTURES)
+    color = mix(color, texture(texture2, TexCoord), transparency);
+#endif
+    FragColor = color;
 }
\ No newline at end of file
@@ -1,16 +1,32 @@
 #version 330 core
-layout (location = 0) in vec3 aPos; // the position variable has attribute position 0
-layout (location = 1) in vec2 aTexCoord;
+// VERTEX_COLOR: passes a color per vertex on to the fragment shader.
+#pragma keywords VERTEX_COLOR
+#include "locations.glsl"
+#include "common.glsl"
+#ifdef SEPARATE_STAGES
+// Built as a separable program (see ShaderVariantCache), which has to say which built-in
+// outputs it writes.
+out gl_PerVertex { vec4 gl_Position; };
+#endif
 
-out vec3 ourColor; // output a color to the fragment shader
-out vec2 TexCoord;
+layout (location = LOCATION_POSITION) in vec3 aPos; // the position variable has attribute position 0
+layout (location = LOCATION_TEXCOORD) in vec2 aTexCoord;
+layout (location = LOCATION_MODEL) in mat4 aModel; // per instance, or the same for the whole draw
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+#ifdef VERTEX_COLOR
+layout (location = LOCATION_COLOR) in vec3 aColor; // the color variable
+VARYING(1) out vec3 ourColor; // output a color to the fragment shader
+#endif
+VARYING(0) out vec2 TexCoord;
+
+UNIFORM(4) mat4 projection;
+UNIFORM(5) mat4 view;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-	TexCoord = aTexCoord; // the texture coordinates
+    gl_Position = projection * view * aModel * vec4(dequantizePosition(aPos), 1.0);
+	TexCoord = dequantizeTexcoord(aTexCoord); // the texture coordinates
+#ifdef VERTEX_COLOR
+    ourColor = aColor; // set ourColor to the input color we got from the vertex data
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,548 @@
+#include "AsyncIO.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#define ASYNCIO_URING 0
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define ASYNCIO_URING 1
+#else
+#define ASYNCIO_URING 0
+#endif
+#endif
+
+// One read never asks for more than this, bigger ones just come back short and go again.
+constexpr size_t MAX_READ_CHUNK = (size_t)1 << 30;
+
+#if ASYNCIO_URING
+// There's no liburing in Vendor/, and the three syscalls are all it would wrap.
+static int uringSetup(unsigned int entries, io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int ring, unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+{
+	return (int)syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int uringRegister(int ring, unsigned int opcode, void* arguments, unsigned int count)
+{
+	return (int)syscall(__NR_io_uring_register, ring, opcode, arguments, count);
+}
+#endif
+
+AsyncIO::AsyncIO(unsigned int queueDepth, unsigned int poolThreads, AsyncIOBackend preferred)
+	: backend(AsyncIOBackend::ThreadPool), queueDepth(std::max(queueDepth, 1u)), inFlight(0), stats(), stopping(false),
+	ring(-1), submissionRing(nullptr), submissionRingSize(0), completionRing(nullptr), completionRingSize(0),
+	submissionEntries(nullptr), submissionEntriesSize(0), submissionHead(nullptr), submissionTail(nullptr),
+	submissionArray(nullptr), submissionMask(0), submissionCount(0), completionHead(nullptr), completionTail(nullptr),
+	completionMask(0), completionEntries(nullptr), ringInFlight(0)
+{
+	if (preferred == AsyncIOBackend::IoUring && setupRing(this->queueDepth)) {
+		backend = AsyncIOBackend::IoUring;
+		completionThread = std::thread(&AsyncIO::completionLoop, this);
+		return;
+	}
+
+	for (unsigned int i = 0; i < std::max(poolThreads, 1u); i++) {
+		workers.emplace_back(&AsyncIO::workerLoop, this);
+	}
+}
+
+AsyncIO::~AsyncIO()
+{
+	waitIdle();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+
+#if ASYNCIO_URING
+		// The completion thread sleeps in io_uring_enter, a no-op wakes it up.
+		if (backend == AsyncIOBackend::IoUring) {
+			unsigned int tail = *submissionTail;
+			unsigned int index = tail & submissionMask;
+			io_uring_sqe* entry = (io_uring_sqe*)submissionEntries + index;
+			memset(entry, 0, sizeof(*entry));
+			entry->opcode = IORING_OP_NOP;
+			entry->user_data = 0;
+			submissionArray[index] = index;
+			__atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+			uringEnter(ring, 1, 0, 0);
+		}
+#endif
+	}
+
+	workAvailable.notify_all();
+
+	if (completionThread.joinable())
+		completionThread.join();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	closeRing();
+
+	for (size_t i = 0; i < files.size(); i++) {
+		closeFile((int)i);
+	}
+}
+
+bool AsyncIO::setupRing(unsigned int entries)
+{
+#if ASYNCIO_URING
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring = uringSetup(entries, &params);
+	if (ring < 0) {
+		ring = -1;
+		return false;
+	}
+
+	// IORING_OP_READ came with 5.6, and so did the probe. No probe, no plain reads.
+	std::vector<unsigned char> probeMemory(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+	io_uring_probe* probe = (io_uring_probe*)probeMemory.data();
+	if (uringRegister(ring, IORING_REGISTER_PROBE, probe, 256) < 0 || probe->last_op < IORING_OP_READ
+		|| (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) == 0) {
+		closeRing();
+		return false;
+	}
+
+	submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	// Newer kernels put both rings in one mapping.
+	bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMapping)
+		submissionRingSize = completionRingSize = std::max(submissionRingSize, completionRingSize);
+
+	void* mapping = mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if (mapping == MAP_FAILED) {
+		closeRing();
+		return false;
+	}
+	submissionRing = (unsigned char*)mapping;
+
+	if (singleMapping) {
+		completionRing = submissionRing;
+	}
+	else {
+		mapping = mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+		if (mapping == MAP_FAILED) {
+			closeRing();
+			return false;
+		}
+		completionRing = (unsigned char*)mapping;
+	}
+
+	submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+	mapping = mmap(nullptr, submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if (mapping == MAP_FAILED) {
+		closeRing();
+		return false;
+	}
+	submissionEntries = mapping;
+
+	submissionHead = (unsigned int*)(submissionRing + params.sq_off.head);
+	submissionTail = (unsigned int*)(submissionRing + params.sq_off.tail);
+	submissionArray = (unsigned int*)(submissionRing + params.sq_off.array);
+	submissionMask = *(unsigned int*)(submissionRing + params.sq_off.ring_mask);
+	submissionCount = params.sq_entries;
+	completionHead = (unsigned int*)(completionRing + params.cq_off.head);
+	completionTail = (unsigned int*)(completionRing + params.cq_off.tail);
+	completionMask = *(unsigned int*)(completionRing + params.cq_off.ring_mask);
+	completionEntries = completionRing + params.cq_off.cqes;
+	return true;
+#else
+	(void)entries;
+	return false;
+#endif
+}
+
+void AsyncIO::closeRing()
+{
+#if ASYNCIO_URING
+	if (submissionEntries != nullptr)
+		munmap(submissionEntries, submissionEntriesSize);
+
+	if (completionRing != nullptr && completionRing != submissionRing)
+		munmap(completionRing, completionRingSize);
+
+	if (submissionRing != nullptr)
+		munmap(submissionRing, submissionRingSize);
+
+	if (ring >= 0)
+		close(ring);
+#endif
+
+	ring = -1;
+	submissionRing = nullptr;
+	completionRing = nullptr;
+	submissionEntries = nullptr;
+}
+
+void AsyncIO::pushToRing()
+{
+#if ASYNCIO_URING
+	unsigned int tail = *submissionTail;
+	unsigned int pushed = 0;
+
+	// The completion ring is twice as big as the submission ring, so keeping no more
+	// than 'submissionCount' reads with the kernel means it can never overflow.
+	while (!queued.empty() && ringInFlight < submissionCount) {
+		Request* request = queued.front();
+		queued.pop_front();
+
+		unsigned int index = tail & submissionMask;
+		io_uring_sqe* entry = (io_uring_sqe*)submissionEntries + index;
+		memset(entry, 0, sizeof(*entry));
+		entry->opcode = request->bufferIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		entry->fd = (int)files[request->file];
+		entry->off = request->offset + request->done;
+		entry->addr = (uint64_t)(uintptr_t)(request->destination + request->done);
+		entry->len = (unsigned int)std::min(request->size - request->done, MAX_READ_CHUNK);
+		entry->buf_index = (uint16_t)std::max(request->bufferIndex, 0);
+		entry->user_data = (uint64_t)(uintptr_t)request;
+		submissionArray[index] = index;
+
+		tail++;
+		pushed++;
+		ringInFlight++;
+	}
+
+	if (pushed == 0)
+		return;
+
+	__atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+
+	// Everything the kernel hasn't consumed yet, in case an earlier call came back short.
+	unsigned int pending = tail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE);
+	uringEnter(ring, pending, 0, 0);
+	stats.syscalls++;
+	stats.maxInFlight = std::max(stats.maxInFlight, (size_t)ringInFlight);
+#endif
+}
+
+void AsyncIO::completionLoop()
+{
+#if ASYNCIO_URING
+	std::vector<std::pair<Request*, bool>> finished;
+
+	for (;;) {
+		uringEnter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+
+		bool wokenUp = false;
+		finished.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			unsigned int head = *completionHead;
+			unsigned int tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+
+			for (; head != tail; head++) {
+				const io_uring_cqe* completion = (const io_uring_cqe*)completionEntries + (head & completionMask);
+				Request* request = (Request*)(uintptr_t)completion->user_data;
+				int result = completion->res;
+
+				if (request == nullptr) {
+					wokenUp = true;
+					continue;
+				}
+
+				ringInFlight--;
+
+				if (result == -EAGAIN || result == -EINTR) {
+					queued.push_front(request);
+					continue;
+				}
+
+				if (result > 0) {
+					request->done += (size_t)result;
+					stats.bytes += (size_t)result;
+
+					// Short read: go again for the rest.
+					if (request->done < request->size) {
+						queued.push_front(request);
+						continue;
+					}
+				}
+
+				finished.push_back({ request, result > 0 });
+			}
+
+			__atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+
+			// Room in the ring again.
+			pushToRing();
+		}
+
+		for (const std::pair<Request*, bool>& item : finished) {
+			finish(item.first, item.second);
+		}
+
+		if (wokenUp) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping)
+				return;
+		}
+	}
+#endif
+}
+
+void AsyncIO::workerLoop()
+{
+	for (;;) {
+		Request* request;
+		intptr_t handle;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [this] { return stopping || !work.empty(); });
+
+			if (work.empty())
+				return;
+
+			request = work.front();
+			work.pop_front();
+			handle = files[request->file];
+		}
+
+		bool ok = true;
+		size_t syscalls = 0;
+
+		while (ok && request->done < request->size) {
+			size_t chunk = std::min(request->size - request->done, MAX_READ_CHUNK);
+			uint64_t offset = request->offset + request->done;
+			syscalls++;
+
+#if defined(_WIN32)
+			OVERLAPPED position = {};
+			position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+			position.OffsetHigh = (DWORD)(offset >> 32);
+			DWORD got = 0;
+			ok = ReadFile((HANDLE)handle, request->destination + request->done, (DWORD)std::min(chunk, (size_t)0x7FFFFFFF), &got, &position) && got > 0;
+			request->done += got;
+#else
+			ssize_t got = pread((int)handle, request->destination + request->done, chunk, (off_t)offset);
+			if (got < 0 && errno == EINTR)
+				continue;
+
+			ok = got > 0;
+			if (ok)
+				request->done += (size_t)got;
+#endif
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.syscalls += syscalls;
+			stats.bytes += request->done;
+		}
+
+		finish(request, ok);
+	}
+}
+
+void AsyncIO::finish(Request* request, bool ok)
+{
+	if (request->callback)
+		request->callback(ok);
+
+	delete request;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.reads++;
+	if (!ok)
+		stats.failed++;
+
+	if (--inFlight == 0)
+		idle.notify_all();
+}
+
+int AsyncIO::bufferFor(const unsigned char* destination, size_t size) const
+{
+	for (size_t i = 0; i < buffers.size(); i++) {
+		const unsigned char* start = (const unsigned char*)buffers[i].data;
+		if (destination >= start && size <= buffers[i].size && (size_t)(destination - start) <= buffers[i].size - size)
+			return (int)i;
+	}
+
+	return -1;
+}
+
+AsyncIOBackend AsyncIO::getBackend() const
+{
+	return backend;
+}
+
+const char* AsyncIO::getBackendName() const
+{
+	return backend == AsyncIOBackend::IoUring ? "io_uring" : "thread pool";
+}
+
+int AsyncIO::openFile(const std::string& path)
+{
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return -1;
+	intptr_t value = (intptr_t)handle;
+#else
+	int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		return -1;
+	intptr_t value = descriptor;
+#endif
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (size_t i = 0; i < files.size(); i++) {
+		if (files[i] == -1) {
+			files[i] = value;
+			return (int)i;
+		}
+	}
+
+	files.push_back(value);
+	return (int)files.size() - 1;
+}
+
+void AsyncIO::closeFile(int file)
+{
+	intptr_t value;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (file < 0 || file >= (int)files.size() || files[file] == -1)
+			return;
+
+		value = files[file];
+		files[file] = -1;
+	}
+
+#if defined(_WIN32)
+	CloseHandle((HANDLE)value);
+#else
+	::close((int)value);
+#endif
+}
+
+bool AsyncIO::registerBuffers(const std::vector<AsyncIOBuffer>& newBuffers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (inFlight > 0)
+		return false;
+
+	buffers.clear();
+
+	if (backend != AsyncIOBackend::IoUring) {
+		buffers = newBuffers;
+		return true;
+	}
+
+#if ASYNCIO_URING
+	uringRegister(ring, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+
+	if (newBuffers.empty())
+		return true;
+
+	std::vector<iovec> vectors(newBuffers.size());
+	for (size_t i = 0; i < newBuffers.size(); i++) {
+		vectors[i].iov_base = newBuffers[i].data;
+		vectors[i].iov_len = newBuffers[i].size;
+	}
+
+	// The pages are pinned, which counts against RLIMIT_MEMLOCK.
+	if (uringRegister(ring, IORING_REGISTER_BUFFERS, vectors.data(), (unsigned int)vectors.size()) < 0) {
+		std::cout << "ERROR::ASYNC_IO::BUFFERS_NOT_REGISTERED " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	buffers = newBuffers;
+#endif
+
+	return true;
+}
+
+void AsyncIO::read(int file, uint64_t offset, void* destination, size_t size, AsyncIOCallback callback)
+{
+	if (size == 0) {
+		if (callback)
+			callback(true);
+		return;
+	}
+
+	Request* request = new Request{ file, offset, (unsigned char*)destination, size, 0, -1, std::move(callback) };
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Registered buffers only mean something to io_uring; the pool just reads.
+	if (backend == AsyncIOBackend::IoUring)
+		request->bufferIndex = bufferFor(request->destination, size);
+
+	queued.push_back(request);
+	inFlight++;
+
+	// Nobody would ever submit more than the ring holds in one go, so don't wait for them to.
+	if (queued.size() >= queueDepth && backend == AsyncIOBackend::IoUring)
+		pushToRing();
+}
+
+std::future<bool> AsyncIO::read(int file, uint64_t offset, void* destination, size_t size)
+{
+	std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+	std::future<bool> result = promise->get_future();
+
+	read(file, offset, destination, size, [promise](bool ok) { promise->set_value(ok); });
+	return result;
+}
+
+void AsyncIO::submit()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (backend == AsyncIOBackend::IoUring) {
+		pushToRing();
+		return;
+	}
+
+	if (queued.empty())
+		return;
+
+	stats.maxInFlight = std::max(stats.maxInFlight, std::min(queued.size() + work.size(), workers.size()));
+	work.insert(work.end(), queued.begin(), queued.end());
+	queued.clear();
+	workAvailable.notify_all();
+}
+
+void AsyncIO::waitIdle()
+{
+	submit();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return inFlight == 0; });
+}
+
+AsyncIOStats AsyncIO::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
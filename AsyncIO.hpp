@@ -0,0 +1,142 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class AsyncIOBackend {
+	IoUring,   // Linux 5.6+: reads are batched into a submission ring, one syscall per batch
+	ThreadPool // everywhere else: a few threads doing blocking positional reads (pread / ReadFile)
+};
+
+struct AsyncIOStats {
+	size_t reads;
+	size_t failed;
+	size_t bytes;
+	size_t syscalls;   // io_uring_enter calls that submitted something, or preads
+	size_t maxInFlight;
+};
+
+// Memory a read can target with io_uring's fixed buffers. The kernel pins it once at
+// registration instead of on every read.
+struct AsyncIOBuffer {
+	void* data;
+	size_t size;
+};
+
+// 'ok' is false on an error or when the file ended before 'size' bytes.
+typedef std::function<void(bool ok)> AsyncIOCallback;
+
+// Asynchronous file reads, so loading hundreds of files keeps the disk busy instead of
+// waiting on one blocking read after the other.
+//
+// Reads are queued by read() and handed over in one go by submit(). With io_uring that
+// is a single syscall for the whole batch, and the kernel keeps all of them in flight at
+// once. Without it (older kernels, Windows, or a sandbox that forbids io_uring) a small
+// pool of I/O threads does positional reads instead, which still keeps several requests
+// in flight. These threads are separate from the JobSystem, so a slow disk never blocks
+// CPU work.
+//
+// Callbacks run on an I/O thread as soon as a read completes. Keep them short, and
+// never call GL from them: hand the result over to the GL thread instead.
+class AsyncIO {
+    private:
+	struct Request {
+		int file;
+		uint64_t offset;
+		unsigned char* destination;
+		size_t size;
+		size_t done;        // short reads are resubmitted for the rest
+		int bufferIndex;    // registered buffer 'destination' is in, or -1
+		AsyncIOCallback callback;
+	};
+
+	AsyncIOBackend backend;
+	unsigned int queueDepth;
+
+	std::mutex mutex;
+	std::vector<intptr_t> files;     // fd or HANDLE, -1 when closed
+	std::vector<AsyncIOBuffer> buffers;
+	std::deque<Request*> queued;     // read() but not submit()ted yet, or to be resubmitted
+	size_t inFlight;                 // read() but not finished
+	std::condition_variable idle;
+	AsyncIOStats stats;
+	bool stopping;
+
+	// io_uring: the two rings and the submission entries are shared with the kernel.
+	int ring;
+	unsigned char* submissionRing;
+	size_t submissionRingSize;
+	unsigned char* completionRing;
+	size_t completionRingSize;
+	void* submissionEntries;
+	size_t submissionEntriesSize;
+	unsigned int* submissionHead;
+	unsigned int* submissionTail;
+	unsigned int* submissionArray;
+	unsigned int submissionMask;
+	unsigned int submissionCount;
+	unsigned int* completionHead;
+	unsigned int* completionTail;
+	unsigned int completionMask;
+	void* completionEntries;
+	unsigned int ringInFlight;       // reads the kernel has, at most 'submissionCount'
+	std::thread completionThread;
+
+	// Thread pool fallback.
+	std::vector<std::thread> workers;
+	std::deque<Request*> work;
+	std::condition_variable workAvailable;
+
+	bool setupRing(unsigned int entries);
+	void closeRing();
+	// Moves as much of 'queued' into the ring as fits. Called with 'mutex' held.
+	void pushToRing();
+	void completionLoop();
+	void workerLoop();
+	// Runs the callback and wakes waitIdle. Called without 'mutex' held.
+	void finish(Request* request, bool ok);
+	int bufferFor(const unsigned char* destination, size_t size) const;
+    public:
+	// 'queueDepth' is how many reads can be with the kernel at once, 'poolThreads' how
+	// many threads the fallback uses. Asking for the thread pool skips io_uring even
+	// where it works, for comparisons.
+	AsyncIO(unsigned int queueDepth = 128, unsigned int poolThreads = 4, AsyncIOBackend preferred = AsyncIOBackend::IoUring);
+	~AsyncIO();
+
+	AsyncIO(const AsyncIO&) = delete;
+	AsyncIO& operator=(const AsyncIO&) = delete;
+
+	AsyncIOBackend getBackend() const;
+	const char* getBackendName() const;
+
+	// Returns a file id, -1 if the file can't be opened.
+	int openFile(const std::string& path);
+	// No reads of the file may be in flight.
+	void closeFile(int file);
+
+	// Replaces the registered buffers. Reads into them are done with READ_FIXED, which
+	// skips pinning the pages on every read. Only while nothing is in flight. Does
+	// nothing (and succeeds) with the thread pool.
+	bool registerBuffers(const std::vector<AsyncIOBuffer>& newBuffers);
+
+	// Queues a read of 'size' bytes at 'offset' into 'destination', which has to stay
+	// valid until the callback ran. Nothing starts until submit().
+	void read(int file, uint64_t offset, void* destination, size_t size, AsyncIOCallback callback);
+	// The same with a future instead of a callback.
+	std::future<bool> read(int file, uint64_t offset, void* destination, size_t size);
+
+	// Hands every queued read to the kernel (or the I/O threads) in one batch.
+	void submit();
+
+	// Submits what's queued and blocks until every read has completed.
+	void waitIdle();
+
+	AsyncIOStats getStats();
+};
@@ -0,0 +1,94 @@
+#include "EmbeddedFiles.hpp"
+#include "AssetPack.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#if defined(NDEBUG) && __has_include("Cooked/EmbeddedShaders.inc")
+// Sorted by path, and always ends with an empty entry.
+#include "Cooked/EmbeddedShaders.inc"
+#else
+static const EmbeddedFile EMBEDDED_FILES[] = { { nullptr, nullptr, 0 } };
+#endif
+
+constexpr size_t EMBEDDED_FILE_COUNT = sizeof(EMBEDDED_FILES) / sizeof(EMBEDDED_FILES[0]) - 1;
+
+const EmbeddedFile* EmbeddedFiles::find(const std::string& path)
+{
+	if (EMBEDDED_FILE_COUNT == 0)
+		return nullptr;
+
+	std::string normalized = AssetPack::normalizePath(path);
+	const EmbeddedFile* end = EMBEDDED_FILES + EMBEDDED_FILE_COUNT;
+	const EmbeddedFile* it = std::lower_bound(EMBEDDED_FILES, end, normalized,
+		[](const EmbeddedFile& file, const std::string& path) { return strcmp(file.path, path.c_str()) < 0; });
+
+	return it != end && normalized == it->path ? it : nullptr;
+}
+
+size_t EmbeddedFiles::count()
+{
+	return EMBEDDED_FILE_COUNT;
+}
+
+bool EmbeddedFiles::write(const std::string& outputPath, std::vector<std::string> paths)
+{
+	for (std::string& path : paths) {
+		path = AssetPack::normalizePath(path);
+	}
+	std::sort(paths.begin(), paths.end());
+
+	static const char HEX[] = "0123456789abcdef";
+	std::ostringstream out;
+	out << "// Written by the AssetCooker (see EmbeddedFiles), don't edit.\n\n";
+
+	std::vector<size_t> sizes;
+	for (size_t i = 0; i < paths.size(); i++) {
+		std::ifstream file(paths[i], std::ios::binary);
+		if (!file) {
+			std::cout << "ERROR::EMBEDDED_FILES::FILE_NOT_SUCCESFULLY_READ " << paths[i] << std::endl;
+			return false;
+		}
+
+		std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		sizes.push_back(bytes.size());
+
+		// An array can't be empty, so an empty file still gets a byte nobody reads.
+		if (bytes.empty())
+			bytes.push_back(0);
+
+		out << "static constexpr unsigned char EMBEDDED_FILE_" << i << "[] = {";
+		for (size_t j = 0; j < bytes.size(); j++) {
+			char byte[] = { '0', 'x', HEX[bytes[j] >> 4], HEX[bytes[j] & 15], ',' };
+			out << (j % 16 == 0 ? "\n\t" : " ");
+			out.write(byte, sizeof(byte));
+		}
+		out << "\n};\n\n";
+	}
+
+	out << "static const EmbeddedFile EMBEDDED_FILES[] = {\n";
+	for (size_t i = 0; i < paths.size(); i++) {
+		out << "\t{ \"" << paths[i] << "\", EMBEDDED_FILE_" << i << ", " << sizes[i] << " },\n";
+	}
+	out << "\t{ nullptr, nullptr, 0 }\n};\n";
+
+	std::string contents = out.str();
+
+	std::ifstream previous(outputPath, std::ios::binary);
+	if (previous && std::string((std::istreambuf_iterator<char>(previous)), std::istreambuf_iterator<char>()) == contents)
+		return true;
+	previous.close();
+
+	std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+	file.write(contents.data(), (std::streamsize)contents.size());
+
+	if (!file) {
+		std::cout << "ERROR::EMBEDDED_FILES::FILE_NOT_SUCCESFULLY_WRITTEN " << outputPath << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One file compiled into the executable.
+struct EmbeddedFile {
+	const char* path; // the way the VirtualFileSystem is asked for it: Cooked/Shaders/shader.vs
+	const unsigned char* data;
+	size_t size;
+};
+
+// Cooked files compiled into the executable as constexpr byte arrays, so release builds
+// read their shaders with no file I/O and no copy: the VirtualFileSystem hands out a view
+// of the array, the same way it does for a mapped pack entry.
+//
+// The AssetCooker writes every cooked shader into Cooked/EmbeddedShaders.inc (see write),
+// and EmbeddedFiles.cpp includes it when NDEBUG is defined, so it's only as fresh as the
+// last cook before the build (build.bat release cooks first). Debug builds, and release
+// builds from a tree that was never cooked, have nothing embedded and keep reading
+// Cooked/ from disk, which is what hot reload needs.
+class EmbeddedFiles {
+    public:
+	// Null when 'path' isn't embedded.
+	static const EmbeddedFile* find(const std::string& path);
+	static size_t count();
+
+	// Writes the files in 'paths' as C++ for EmbeddedFiles.cpp to include, each under its
+	// own path. Only rewrites 'outputPath' when that changes it, so a build that's already
+	// up to date doesn't compile it again.
+	static bool write(const std::string& outputPath, std::vector<std::string> paths);
+};
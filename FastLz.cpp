@@ -0,0 +1,224 @@
+#include "FastLz.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace FastLz {
+
+constexpr size_t MIN_MATCH = 4;
+// The format wants the last 5 bytes to be literals and no match to start in the last 12.
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MATCH_START_LIMIT = 12;
+constexpr size_t MAX_OFFSET = 65535;
+
+constexpr int HASH_BITS = 14;
+// Every 64 bytes without a match the compressor starts stepping further, so it doesn't
+// crawl through data that won't compress anyway.
+constexpr int SKIP_SHIFT = 6;
+
+static uint32_t read32(const unsigned char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t hash32(uint32_t value)
+{
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// A length over 15 goes on as bytes of 255 and whatever is left.
+static bool writeLength(unsigned char*& out, const unsigned char* outEnd, size_t length)
+{
+	for (; length >= 255; length -= 255) {
+		if (out >= outEnd)
+			return false;
+		*out++ = 255;
+	}
+
+	if (out >= outEnd)
+		return false;
+	*out++ = (unsigned char)length;
+	return true;
+}
+
+static bool readLength(const unsigned char*& in, const unsigned char* inEnd, size_t& length)
+{
+	unsigned char byte;
+	do {
+		if (in >= inEnd)
+			return false;
+		byte = *in++;
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+// One sequence: literals, then a match unless it's the last one ('matchLength' 0).
+static bool writeSequence(unsigned char*& out, const unsigned char* outEnd, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	if (out >= outEnd)
+		return false;
+
+	unsigned char* token = out++;
+	size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+	*token = (unsigned char)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+	if (literalCount >= 15 && !writeLength(out, outEnd, literalCount - 15))
+		return false;
+
+	if ((size_t)(outEnd - out) < literalCount)
+		return false;
+	// Empty input has no literals at all, and memcpy mustn't get a null pointer even
+	// for zero bytes.
+	if (literalCount != 0)
+		memcpy(out, literals, literalCount);
+	out += literalCount;
+
+	if (matchLength == 0)
+		return true;
+
+	if (outEnd - out < 2)
+		return false;
+	*out++ = (unsigned char)(offset & 0xFF);
+	*out++ = (unsigned char)(offset >> 8);
+
+	return matchCode < 15 || writeLength(out, outEnd, matchCode - 15);
+}
+
+size_t compressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t compress(const void* source, size_t size, void* destination, size_t capacity)
+{
+	const unsigned char* in = (const unsigned char*)source;
+	const unsigned char* end = in + size;
+	unsigned char* out = (unsigned char*)destination;
+	unsigned char* outEnd = out + capacity;
+	const unsigned char* anchor = in;
+
+	if (size > MATCH_START_LIMIT) {
+		// Positions are relative to 'in'; 0 is as good as "nothing" since a match at the
+		// start is still checked byte for byte.
+		static thread_local uint32_t table[1 << HASH_BITS];
+		memset(table, 0, sizeof(table));
+
+		const unsigned char* matchLimit = end - MATCH_START_LIMIT;
+		const unsigned char* p = in + 1;
+
+		while (p < matchLimit) {
+			uint32_t sequence = read32(p);
+			uint32_t slot = hash32(sequence);
+			const unsigned char* candidate = in + table[slot];
+			table[slot] = (uint32_t)(p - in);
+
+			if (candidate >= p || (size_t)(p - candidate) > MAX_OFFSET || read32(candidate) != sequence) {
+				p += 1 + ((p - anchor) >> SKIP_SHIFT);
+				continue;
+			}
+
+			// Grow the match backwards into the pending literals, then forwards.
+			while (p > anchor && candidate > in && p[-1] == candidate[-1]) {
+				p--;
+				candidate--;
+			}
+
+			size_t length = MIN_MATCH;
+			const unsigned char* forwardLimit = end - LAST_LITERALS;
+			while (p + length < forwardLimit && p[length] == candidate[length]) {
+				length++;
+			}
+
+			if (!writeSequence(out, outEnd, anchor, (size_t)(p - anchor), (size_t)(p - candidate), length))
+				return 0;
+
+			// Whatever the match covered is never looked up again, but the last position
+			// in it is a likely start for the next one.
+			p += length;
+			anchor = p;
+			if (p - 2 > in && p < matchLimit)
+				table[hash32(read32(p - 2))] = (uint32_t)(p - 2 - in);
+		}
+	}
+
+	if (!writeSequence(out, outEnd, anchor, (size_t)(end - anchor), 0, 0))
+		return 0;
+
+	return (size_t)(out - (unsigned char*)destination);
+}
+
+bool decompress(const void* source, size_t size, void* destination, size_t destinationSize)
+{
+	const unsigned char* in = (const unsigned char*)source;
+	const unsigned char* inEnd = in + size;
+	unsigned char* out = (unsigned char*)destination;
+	unsigned char* outStart = out;
+	unsigned char* outEnd = out + destinationSize;
+
+	while (in < inEnd) {
+		unsigned char token = *in++;
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !readLength(in, inEnd, literalCount))
+			return false;
+
+		if ((size_t)(inEnd - in) < literalCount || (size_t)(outEnd - out) < literalCount)
+			return false;
+
+		// Most sequences are short. With room to spare in both buffers a fixed 16 byte copy
+		// (two moves) beats a memcpy call of the exact length; the extra bytes get
+		// overwritten by whatever comes next.
+		if (literalCount <= 16 && inEnd - in >= 16 && outEnd - out >= 16)
+			memcpy(out, in, 16);
+		else if (literalCount != 0)
+			memcpy(out, in, literalCount);
+		in += literalCount;
+		out += literalCount;
+
+		// The last sequence has no match.
+		if (in == inEnd)
+			break;
+
+		if (inEnd - in < 2)
+			return false;
+		size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		in += 2;
+
+		size_t length = token & 15;
+		if (length == 15 && !readLength(in, inEnd, length))
+			return false;
+		length += MIN_MATCH;
+
+		if (offset == 0 || offset > (size_t)(out - outStart) || (size_t)(outEnd - out) < length)
+			return false;
+
+		const unsigned char* match = out - offset;
+		if (offset >= 16 && length <= 16 && outEnd - out >= 16) {
+			memcpy(out, match, 16);
+		}
+		else if (offset >= length) {
+			memcpy(out, match, length);
+		}
+		else {
+			// Overlapping: the match repeats the last 'offset' bytes. Once there's one copy
+			// of them the pattern can be copied from 'offset', 2 * 'offset', 4 * 'offset'...
+			// bytes back, in ever bigger pieces that don't overlap.
+			memcpy(out, match, offset);
+			for (size_t done = offset, step = offset; done < length; step *= 2) {
+				size_t piece = std::min(step, length - done);
+				memcpy(out + done, out + done - step, piece);
+				done += piece;
+			}
+		}
+
+		out += length;
+	}
+
+	return out == outEnd;
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+// Byte oriented LZ77 in the LZ4 block format: a token with the literal and match
+// lengths, the literals, a 16 bit offset back into what was already decoded and more
+// length bytes when a length doesn't fit its 4 bits. There's no entropy coding at all,
+// so it doesn't compress as well as zlib, but decoding is a handful of memcpys per match
+// and runs at a few GB/s, faster than the disk can hand the bytes over.
+//
+// The compressor is the greedy one with a single hash table of recent positions, good
+// enough for an offline step; the decoder checks every length and offset against both
+// buffers, so a corrupt pack entry fails instead of writing past the destination.
+namespace FastLz {
+	// Worst case compressed size (incompressible data grows a tiny bit).
+	size_t compressBound(size_t size);
+
+	// Returns the compressed size, 0 if it doesn't fit in 'capacity'.
+	size_t compress(const void* source, size_t size, void* destination, size_t capacity);
+
+	// 'destinationSize' has to be the exact decompressed size.
+	bool decompress(const void* source, size_t size, void* destination, size_t destinationSize);
+}
@@ -0,0 +1,202 @@
+#include "FileWatcher.hpp"
+#include <filesystem>
+#include <iostream>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+// How often the fallback looks at the write times.
+static const std::chrono::milliseconds SCAN_INTERVAL(250);
+
+FileWatcher::FileWatcher(std::chrono::milliseconds settle)
+	: settle(settle), inotify(-1), stopping(false)
+{
+#if defined(__linux__)
+	inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify < 0)
+		std::cout << "ERROR::FILE_WATCHER::INOTIFY_UNAVAILABLE " << errno << ", polling instead" << std::endl;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+	stopping = true;
+	if (scanner.joinable())
+		scanner.join();
+
+#if defined(__linux__)
+	if (inotify >= 0)
+		close(inotify);
+#endif
+}
+
+const char* FileWatcher::getBackendName() const
+{
+	return inotify >= 0 ? "inotify" : "polling";
+}
+
+bool FileWatcher::watch(const std::string& directory)
+{
+	std::error_code error;
+	if (!fs::is_directory(directory, error)) {
+		std::cout << "ERROR::FILE_WATCHER::NOT_A_DIRECTORY " << directory << std::endl;
+		return false;
+	}
+
+	roots.push_back(fs::path(directory).generic_string());
+
+	if (inotify >= 0) {
+		addWatches(roots.back());
+		return true;
+	}
+
+	// The first scan only records what's there.
+	std::lock_guard<std::mutex> lock(scannedMutex);
+	scan(false);
+	if (!scanner.joinable())
+		scanner = std::thread(&FileWatcher::scanLoop, this);
+
+	return true;
+}
+
+void FileWatcher::addWatches(const std::string& directory)
+{
+#if defined(__linux__)
+	// inotify isn't recursive: every directory needs its own watch.
+	std::error_code error;
+	std::vector<std::string> directories = { directory };
+
+	for (fs::recursive_directory_iterator it(directory, error), end; it != end; it.increment(error)) {
+		if (!error && it->is_directory(error))
+			directories.push_back(it->path().generic_string());
+	}
+
+	for (const std::string& path : directories) {
+		int watch = inotify_add_watch(inotify, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF);
+		if (watch >= 0)
+			watches[watch] = path;
+	}
+#else
+	(void)directory;
+#endif
+}
+
+void FileWatcher::readEvents()
+{
+#if defined(__linux__)
+	alignas(struct inotify_event) char buffer[16 * 1024];
+	Clock::time_point now = Clock::now();
+
+	while (true) {
+		ssize_t length = read(inotify, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (char* at = buffer; at < buffer + length;) {
+			const struct inotify_event* event = (const struct inotify_event*)at;
+			at += sizeof(struct inotify_event) + event->len;
+
+			auto directory = watches.find(event->wd);
+			if (directory == watches.end())
+				continue;
+
+			if ((event->mask & IN_IGNORED) != 0) {
+				watches.erase(directory);
+				continue;
+			}
+
+			if (event->len == 0)
+				continue;
+
+			std::string path = directory->second + "/" + event->name;
+
+			// A new directory: watch it and whatever got put in it before the watch existed.
+			if ((event->mask & IN_ISDIR) != 0) {
+				if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+					addWatches(path);
+
+					std::error_code error;
+					for (fs::recursive_directory_iterator it(path, error), end; it != end; it.increment(error)) {
+						if (!error && it->is_regular_file(error))
+							changed[it->path().generic_string()] = now;
+					}
+				}
+				continue;
+			}
+
+			// A plain create is followed by a close-write once there's something in it.
+			if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0)
+				changed[path] = now;
+		}
+	}
+#endif
+}
+
+void FileWatcher::scanLoop()
+{
+	while (!stopping) {
+		std::this_thread::sleep_for(SCAN_INTERVAL);
+
+		std::lock_guard<std::mutex> lock(scannedMutex);
+		scan(true);
+	}
+}
+
+void FileWatcher::scan(bool report)
+{
+	std::error_code error;
+
+	for (const std::string& root : roots) {
+		for (fs::recursive_directory_iterator it(root, error), end; it != end; it.increment(error)) {
+			if (error || !it->is_regular_file(error))
+				continue;
+
+			int64_t writeTime = (int64_t)it->last_write_time(error).time_since_epoch().count();
+			if (error)
+				continue;
+
+			std::string path = it->path().generic_string();
+			auto known = writeTimes.find(path);
+
+			if (known == writeTimes.end() || known->second != writeTime) {
+				writeTimes[path] = writeTime;
+				if (report)
+					scanned.push_back(path);
+			}
+		}
+	}
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+	Clock::time_point now = Clock::now();
+
+	if (inotify >= 0) {
+		readEvents();
+	}
+	else {
+		std::lock_guard<std::mutex> lock(scannedMutex);
+		for (const std::string& path : scanned) {
+			changed[path] = now;
+		}
+		scanned.clear();
+	}
+
+	std::vector<std::string> settled;
+	for (auto it = changed.begin(); it != changed.end();) {
+		if (now - it->second >= settle) {
+			settled.push_back(it->first);
+			it = changed.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	return settled;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reports files that changed under a few directories (and everything below them).
+//
+// On Linux that's inotify: the kernel queues an event whenever a file is written and
+// closed, or moved in (which is how most editors save), and poll() just reads them out
+// without blocking. Everywhere else a background thread compares write times a few
+// times a second instead.
+//
+// Saving often comes as a burst of events (truncate, write, rename...), so a path is
+// only reported once it's been quiet for 'settle', and only once per burst.
+class FileWatcher {
+    private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::vector<std::string> roots;
+	std::chrono::milliseconds settle;
+	std::unordered_map<std::string, Clock::time_point> changed; // path -> last event
+
+	// inotify
+	int inotify;
+	std::unordered_map<int, std::string> watches; // watch descriptor -> directory
+
+	// Polling fallback
+	std::thread scanner;
+	std::mutex scannedMutex;
+	std::vector<std::string> scanned;
+	std::unordered_map<std::string, int64_t> writeTimes;
+	std::atomic<bool> stopping;
+
+	void addWatches(const std::string& directory);
+	void readEvents();
+	void scanLoop();
+	void scan(bool report);
+    public:
+	FileWatcher(std::chrono::milliseconds settle = std::chrono::milliseconds(100));
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Starts watching a directory. Files created later are reported too.
+	bool watch(const std::string& directory);
+
+	// The files (with forward slashes, starting with the watched directory) that changed
+	// and then settled since the last call. Cheap enough for every frame.
+	std::vector<std::string> poll();
+
+	const char* getBackendName() const;
+};
@@ -0,0 +1,166 @@
+#include "GLExtensions.hpp"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace GLExtensions {
+	bool parallelShaderCompile = false;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR = nullptr;
+
+	bool separateShaderObjects = false;
+	PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;
+	PFNGLGENPROGRAMPIPELINESPROC glGenProgramPipelines = nullptr;
+	PFNGLDELETEPROGRAMPIPELINESPROC glDeleteProgramPipelines = nullptr;
+	PFNGLBINDPROGRAMPIPELINEPROC glBindProgramPipeline = nullptr;
+	PFNGLUSEPROGRAMSTAGESPROC glUseProgramStages = nullptr;
+	PFNGLPROGRAMUNIFORM1IPROC glProgramUniform1i = nullptr;
+	PFNGLPROGRAMUNIFORM1FPROC glProgramUniform1f = nullptr;
+	PFNGLPROGRAMUNIFORM2FPROC glProgramUniform2f = nullptr;
+	PFNGLPROGRAMUNIFORM3FPROC glProgramUniform3f = nullptr;
+	PFNGLPROGRAMUNIFORMMATRIX4FVPROC glProgramUniformMatrix4fv = nullptr;
+
+	bool spirv = false;
+	PFNGLSHADERBINARYPROC glShaderBinary = nullptr;
+	PFNGLSPECIALIZESHADERARBPROC glSpecializeShaderARB = nullptr;
+
+	bool directStateAccess = false;
+	PFNGLCREATETEXTURESPROC glCreateTextures = nullptr;
+	PFNGLTEXTUREPARAMETERIPROC glTextureParameteri = nullptr;
+	PFNGLTEXTUREPARAMETERFPROC glTextureParameterf = nullptr;
+	PFNGLBINDTEXTUREUNITPROC glBindTextureUnit = nullptr;
+	PFNGLCREATEBUFFERSPROC glCreateBuffers = nullptr;
+	PFNGLNAMEDBUFFERSTORAGEPROC glNamedBufferStorage = nullptr;
+	PFNGLNAMEDBUFFERDATAPROC glNamedBufferData = nullptr;
+	PFNGLMAPNAMEDBUFFERRANGEPROC glMapNamedBufferRange = nullptr;
+	PFNGLUNMAPNAMEDBUFFERPROC glUnmapNamedBuffer = nullptr;
+	PFNGLGETNAMEDBUFFERPARAMETERIVPROC glGetNamedBufferParameteriv = nullptr;
+	PFNGLCREATEVERTEXARRAYSPROC glCreateVertexArrays = nullptr;
+	PFNGLVERTEXARRAYELEMENTBUFFERPROC glVertexArrayElementBuffer = nullptr;
+	PFNGLVERTEXARRAYVERTEXBUFFERPROC glVertexArrayVertexBuffer = nullptr;
+	PFNGLVERTEXARRAYATTRIBFORMATPROC glVertexArrayAttribFormat = nullptr;
+	PFNGLVERTEXARRAYATTRIBBINDINGPROC glVertexArrayAttribBinding = nullptr;
+	PFNGLVERTEXARRAYBINDINGDIVISORPROC glVertexArrayBindingDivisor = nullptr;
+	PFNGLENABLEVERTEXARRAYATTRIBPROC glEnableVertexArrayAttrib = nullptr;
+	PFNGLDISABLEVERTEXARRAYATTRIBPROC glDisableVertexArrayAttrib = nullptr;
+
+	bool vertexAttribBinding = false;
+	PFNGLBINDVERTEXBUFFERPROC glBindVertexBuffer = nullptr;
+	PFNGLVERTEXATTRIBFORMATPROC glVertexAttribFormat = nullptr;
+	PFNGLVERTEXATTRIBBINDINGPROC glVertexAttribBinding = nullptr;
+	PFNGLVERTEXBINDINGDIVISORPROC glVertexBindingDivisor = nullptr;
+
+	bool textureFilterAnisotropic = false;
+	float maxTextureAnisotropy = 1.0f;
+
+	bool isSupported(const char* name)
+	{
+		// Core profiles only list them one at a time.
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+		for (GLint i = 0; i < count; i++) {
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension != nullptr && strcmp(extension, name) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	void load(GLADloadproc loader)
+	{
+		// ARB_parallel_shader_compile is the same thing under its older name.
+		const char* name = isSupported("GL_KHR_parallel_shader_compile") ? "glMaxShaderCompilerThreadsKHR"
+			: isSupported("GL_ARB_parallel_shader_compile") ? "glMaxShaderCompilerThreadsARB" : nullptr;
+
+		glMaxShaderCompilerThreadsKHR = name != nullptr ? (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader(name) : nullptr;
+		parallelShaderCompile = glMaxShaderCompilerThreadsKHR != nullptr;
+
+		// 0xFFFFFFFF lets the driver pick how many threads to use.
+		if (parallelShaderCompile)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+
+		std::cout << "Parallel shader compile: " << (parallelShaderCompile ? "yes" : "no") << std::endl;
+
+		// The functions have no suffix, they're the same ones 4.1 has.
+		if (isSupported("GL_ARB_separate_shader_objects")) {
+			glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+			glGenProgramPipelines = (PFNGLGENPROGRAMPIPELINESPROC)loader("glGenProgramPipelines");
+			glDeleteProgramPipelines = (PFNGLDELETEPROGRAMPIPELINESPROC)loader("glDeleteProgramPipelines");
+			glBindProgramPipeline = (PFNGLBINDPROGRAMPIPELINEPROC)loader("glBindProgramPipeline");
+			glUseProgramStages = (PFNGLUSEPROGRAMSTAGESPROC)loader("glUseProgramStages");
+			glProgramUniform1i = (PFNGLPROGRAMUNIFORM1IPROC)loader("glProgramUniform1i");
+			glProgramUniform1f = (PFNGLPROGRAMUNIFORM1FPROC)loader("glProgramUniform1f");
+			glProgramUniform2f = (PFNGLPROGRAMUNIFORM2FPROC)loader("glProgramUniform2f");
+			glProgramUniform3f = (PFNGLPROGRAMUNIFORM3FPROC)loader("glProgramUniform3f");
+			glProgramUniformMatrix4fv = (PFNGLPROGRAMUNIFORMMATRIX4FVPROC)loader("glProgramUniformMatrix4fv");
+		}
+
+		separateShaderObjects = glProgramParameteri != nullptr && glGenProgramPipelines != nullptr && glDeleteProgramPipelines != nullptr
+			&& glBindProgramPipeline != nullptr && glUseProgramStages != nullptr && glProgramUniform1i != nullptr && glProgramUniform1f != nullptr
+			&& glProgramUniform2f != nullptr && glProgramUniform3f != nullptr && glProgramUniformMatrix4fv != nullptr;
+
+		std::cout << "Separate shader objects: " << (separateShaderObjects ? "yes" : "no") << std::endl;
+
+		// glShaderBinary is 4.1's (and ARB_ES2_compatibility's), which the extension needs
+		// anyway.
+		if (isSupported("GL_ARB_gl_spirv")) {
+			glShaderBinary = (PFNGLSHADERBINARYPROC)loader("glShaderBinary");
+			glSpecializeShaderARB = (PFNGLSPECIALIZESHADERARBPROC)loader("glSpecializeShaderARB");
+		}
+
+		spirv = glShaderBinary != nullptr && glSpecializeShaderARB != nullptr;
+
+		std::cout << "SPIR-V shaders: " << (spirv ? "yes" : "no") << std::endl;
+
+		// Named buffer storage is ARB_buffer_storage's (4.4), which the extension builds on.
+		if (isSupported("GL_ARB_direct_state_access") && isSupported("GL_ARB_buffer_storage")) {
+			glCreateTextures = (PFNGLCREATETEXTURESPROC)loader("glCreateTextures");
+			glTextureParameteri = (PFNGLTEXTUREPARAMETERIPROC)loader("glTextureParameteri");
+			glTextureParameterf = (PFNGLTEXTUREPARAMETERFPROC)loader("glTextureParameterf");
+			glBindTextureUnit = (PFNGLBINDTEXTUREUNITPROC)loader("glBindTextureUnit");
+			glCreateBuffers = (PFNGLCREATEBUFFERSPROC)loader("glCreateBuffers");
+			glNamedBufferStorage = (PFNGLNAMEDBUFFERSTORAGEPROC)loader("glNamedBufferStorage");
+			glNamedBufferData = (PFNGLNAMEDBUFFERDATAPROC)loader("glNamedBufferData");
+			glMapNamedBufferRange = (PFNGLMAPNAMEDBUFFERRANGEPROC)loader("glMapNamedBufferRange");
+			glUnmapNamedBuffer = (PFNGLUNMAPNAMEDBUFFERPROC)loader("glUnmapNamedBuffer");
+			glGetNamedBufferParameteriv = (PFNGLGETNAMEDBUFFERPARAMETERIVPROC)loader("glGetNamedBufferParameteriv");
+			glCreateVertexArrays = (PFNGLCREATEVERTEXARRAYSPROC)loader("glCreateVertexArrays");
+			glVertexArrayElementBuffer = (PFNGLVERTEXARRAYELEMENTBUFFERPROC)loader("glVertexArrayElementBuffer");
+			glVertexArrayVertexBuffer = (PFNGLVERTEXARRAYVERTEXBUFFERPROC)loader("glVertexArrayVertexBuffer");
+			glVertexArrayAttribFormat = (PFNGLVERTEXARRAYATTRIBFORMATPROC)loader("glVertexArrayAttribFormat");
+			glVertexArrayAttribBinding = (PFNGLVERTEXARRAYATTRIBBINDINGPROC)loader("glVertexArrayAttribBinding");
+			glVertexArrayBindingDivisor = (PFNGLVERTEXARRAYBINDINGDIVISORPROC)loader("glVertexArrayBindingDivisor");
+			glEnableVertexArrayAttrib = (PFNGLENABLEVERTEXARRAYATTRIBPROC)loader("glEnableVertexArrayAttrib");
+			glDisableVertexArrayAttrib = (PFNGLDISABLEVERTEXARRAYATTRIBPROC)loader("glDisableVertexArrayAttrib");
+		}
+
+		directStateAccess = glCreateTextures != nullptr && glTextureParameteri != nullptr && glTextureParameterf != nullptr && glBindTextureUnit != nullptr
+			&& glCreateBuffers != nullptr && glNamedBufferStorage != nullptr && glNamedBufferData != nullptr && glMapNamedBufferRange != nullptr
+			&& glUnmapNamedBuffer != nullptr && glGetNamedBufferParameteriv != nullptr && glCreateVertexArrays != nullptr
+			&& glVertexArrayElementBuffer != nullptr && glVertexArrayVertexBuffer != nullptr && glVertexArrayAttribFormat != nullptr
+			&& glVertexArrayAttribBinding != nullptr && glVertexArrayBindingDivisor != nullptr && glEnableVertexArrayAttrib != nullptr
+			&& glDisableVertexArrayAttrib != nullptr;
+
+		std::cout << "Direct state access: " << (directStateAccess ? "yes" : "no") << std::endl;
+
+		if (isSupported("GL_ARB_vertex_attrib_binding")) {
+			glBindVertexBuffer = (PFNGLBINDVERTEXBUFFERPROC)loader("glBindVertexBuffer");
+			glVertexAttribFormat = (PFNGLVERTEXATTRIBFORMATPROC)loader("glVertexAttribFormat");
+			glVertexAttribBinding = (PFNGLVERTEXATTRIBBINDINGPROC)loader("glVertexAttribBinding");
+			glVertexBindingDivisor = (PFNGLVERTEXBINDINGDIVISORPROC)loader("glVertexBindingDivisor");
+		}
+
+		vertexAttribBinding = glBindVertexBuffer != nullptr && glVertexAttribFormat != nullptr && glVertexAttribBinding != nullptr
+			&& glVertexBindingDivisor != nullptr;
+
+		std::cout << "Vertex attribute bindings: " << (vertexAttribBinding ? "yes" : "no") << std::endl;
+
+		// Same enums under both names.
+		textureFilterAnisotropic = isSupported("GL_ARB_texture_filter_anisotropic") || isSupported("GL_EXT_texture_filter_anisotropic");
+		if (textureFilterAnisotropic)
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxTextureAnisotropy);
+
+		std::cout << "Anisotropic filtering: " << (textureFilterAnisotropic ? "up to " + std::to_string((int)maxTextureAnisotropy) + "x" : "no") << std::endl;
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <glad/glad.h>
+
+// The few extensions the renderer can use when the driver has them. glad was generated
+// for plain 3.3 core, so they're looked up here by hand after gladLoadGL. Everything
+// works without them, only slower or with more stalls.
+
+// KHR_parallel_shader_compile: compiles and links return right away and the driver
+// builds the program on its own threads. Until GL_COMPLETION_STATUS_KHR says it's done,
+// asking for the compile or link status (or using the program) waits for it.
+constexpr GLenum GL_MAX_SHADER_COMPILER_THREADS_KHR = 0x91B0;
+constexpr GLenum GL_COMPLETION_STATUS_KHR = 0x91B1;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// ARB_separate_shader_objects (core in 4.1): a program can hold a single stage, and a
+// program pipeline object puts stages from different programs together at draw time.
+// Uniforms are set per program with glProgramUniform*, without binding anything.
+constexpr GLenum GL_PROGRAM_SEPARABLE = 0x8258;
+constexpr GLbitfield GL_VERTEX_SHADER_BIT = 0x00000001;
+constexpr GLbitfield GL_FRAGMENT_SHADER_BIT = 0x00000002;
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLGENPROGRAMPIPELINESPROC)(GLsizei n, GLuint* pipelines);
+typedef void (APIENTRYP PFNGLDELETEPROGRAMPIPELINESPROC)(GLsizei n, const GLuint* pipelines);
+typedef void (APIENTRYP PFNGLBINDPROGRAMPIPELINEPROC)(GLuint pipeline);
+typedef void (APIENTRYP PFNGLUSEPROGRAMSTAGESPROC)(GLuint pipeline, GLbitfield stages, GLuint program);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1IPROC)(GLuint program, GLint location, GLint v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1FPROC)(GLuint program, GLint location, GLfloat v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM2FPROC)(GLuint program, GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM3FPROC)(GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORMMATRIX4FVPROC)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+
+// ARB_gl_spirv (core in 4.6): a shader can be SPIR-V compiled offline instead of GLSL,
+// handed over with glShaderBinary and compiled with glSpecializeShader, so the driver's
+// GLSL front end never runs. Nothing in a SPIR-V program is found by name, only by
+// location.
+constexpr GLenum GL_SHADER_BINARY_FORMAT_SPIR_V_ARB = 0x9551;
+typedef void (APIENTRYP PFNGLSHADERBINARYPROC)(GLsizei count, const GLuint* shaders, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLSPECIALIZESHADERARBPROC)(GLuint shader, const GLchar* entryPoint, GLuint constantCount,
+	const GLuint* constantIndices, const GLuint* constantValues);
+
+// ARB_direct_state_access (core in 4.5): objects are created and edited by name instead
+// of through whatever is bound, so setting one up leaves the bindings alone. See
+// GLResources, which falls back to binding on 3.3.
+typedef void (APIENTRYP PFNGLCREATETEXTURESPROC)(GLenum target, GLsizei n, GLuint* textures);
+typedef void (APIENTRYP PFNGLTEXTUREPARAMETERIPROC)(GLuint texture, GLenum pname, GLint param);
+typedef void (APIENTRYP PFNGLTEXTUREPARAMETERFPROC)(GLuint texture, GLenum pname, GLfloat param);
+typedef void (APIENTRYP PFNGLBINDTEXTUREUNITPROC)(GLuint unit, GLuint texture);
+typedef void (APIENTRYP PFNGLCREATEBUFFERSPROC)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSTORAGEPROC)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERDATAPROC)(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+typedef void* (APIENTRYP PFNGLMAPNAMEDBUFFERRANGEPROC)(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRYP PFNGLUNMAPNAMEDBUFFERPROC)(GLuint buffer);
+typedef void (APIENTRYP PFNGLGETNAMEDBUFFERPARAMETERIVPROC)(GLuint buffer, GLenum pname, GLint* params);
+typedef void (APIENTRYP PFNGLCREATEVERTEXARRAYSPROC)(GLsizei n, GLuint* arrays);
+typedef void (APIENTRYP PFNGLVERTEXARRAYELEMENTBUFFERPROC)(GLuint vaobj, GLuint buffer);
+typedef void (APIENTRYP PFNGLVERTEXARRAYVERTEXBUFFERPROC)(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBFORMATPROC)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized,
+	GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBBINDINGPROC)(GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP PFNGLVERTEXARRAYBINDINGDIVISORPROC)(GLuint vaobj, GLuint bindingindex, GLuint divisor);
+typedef void (APIENTRYP PFNGLENABLEVERTEXARRAYATTRIBPROC)(GLuint vaobj, GLuint index);
+typedef void (APIENTRYP PFNGLDISABLEVERTEXARRAYATTRIBPROC)(GLuint vaobj, GLuint index);
+
+// ARB_vertex_attrib_binding (core in 4.3): a VAO's attribute formats are kept apart from
+// the buffers they read. Attributes read a binding, and what buffer and offset a binding
+// reads is changed with glBindVertexBuffer alone, so meshes with the same layout can
+// share a VAO (see VertexArrayCache).
+typedef void (APIENTRYP PFNGLBINDVERTEXBUFFERPROC)(GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNGLVERTEXATTRIBFORMATPROC)(GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXATTRIBBINDINGPROC)(GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP PFNGLVERTEXBINDINGDIVISORPROC)(GLuint bindingindex, GLuint divisor);
+
+// ARB/EXT_texture_filter_anisotropic (core in 4.6): more samples along the direction a
+// texture is squashed in, so surfaces at a grazing angle stay sharp. A sampler parameter,
+// nothing to load.
+constexpr GLenum GL_TEXTURE_MAX_ANISOTROPY = 0x84FE;
+constexpr GLenum GL_MAX_TEXTURE_MAX_ANISOTROPY = 0x84FF;
+
+namespace GLExtensions {
+	extern bool parallelShaderCompile;
+	extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+
+	extern bool separateShaderObjects;
+	extern PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+	extern PFNGLGENPROGRAMPIPELINESPROC glGenProgramPipelines;
+	extern PFNGLDELETEPROGRAMPIPELINESPROC glDeleteProgramPipelines;
+	extern PFNGLBINDPROGRAMPIPELINEPROC glBindProgramPipeline;
+	extern PFNGLUSEPROGRAMSTAGESPROC glUseProgramStages;
+	extern PFNGLPROGRAMUNIFORM1IPROC glProgramUniform1i;
+	extern PFNGLPROGRAMUNIFORM1FPROC glProgramUniform1f;
+	extern PFNGLPROGRAMUNIFORM2FPROC glProgramUniform2f;
+	extern PFNGLPROGRAMUNIFORM3FPROC glProgramUniform3f;
+	extern PFNGLPROGRAMUNIFORMMATRIX4FVPROC glProgramUniformMatrix4fv;
+
+	extern bool spirv;
+	extern PFNGLSHADERBINARYPROC glShaderBinary;
+	extern PFNGLSPECIALIZESHADERARBPROC glSpecializeShaderARB;
+
+	extern bool directStateAccess;
+	extern PFNGLCREATETEXTURESPROC glCreateTextures;
+	extern PFNGLTEXTUREPARAMETERIPROC glTextureParameteri;
+	extern PFNGLTEXTUREPARAMETERFPROC glTextureParameterf;
+	extern PFNGLBINDTEXTUREUNITPROC glBindTextureUnit;
+	extern PFNGLCREATEBUFFERSPROC glCreateBuffers;
+	extern PFNGLNAMEDBUFFERSTORAGEPROC glNamedBufferStorage;
+	extern PFNGLNAMEDBUFFERDATAPROC glNamedBufferData;
+	extern PFNGLMAPNAMEDBUFFERRANGEPROC glMapNamedBufferRange;
+	extern PFNGLUNMAPNAMEDBUFFERPROC glUnmapNamedBuffer;
+	extern PFNGLGETNAMEDBUFFERPARAMETERIVPROC glGetNamedBufferParameteriv;
+	extern PFNGLCREATEVERTEXARRAYSPROC glCreateVertexArrays;
+	extern PFNGLVERTEXARRAYELEMENTBUFFERPROC glVertexArrayElementBuffer;
+	extern PFNGLVERTEXARRAYVERTEXBUFFERPROC glVertexArrayVertexBuffer;
+	extern PFNGLVERTEXARRAYATTRIBFORMATPROC glVertexArrayAttribFormat;
+	extern PFNGLVERTEXARRAYATTRIBBINDINGPROC glVertexArrayAttribBinding;
+	extern PFNGLVERTEXARRAYBINDINGDIVISORPROC glVertexArrayBindingDivisor;
+	extern PFNGLENABLEVERTEXARRAYATTRIBPROC glEnableVertexArrayAttrib;
+	extern PFNGLDISABLEVERTEXARRAYATTRIBPROC glDisableVertexArrayAttrib;
+
+	extern bool vertexAttribBinding;
+	extern PFNGLBINDVERTEXBUFFERPROC glBindVertexBuffer;
+	extern PFNGLVERTEXATTRIBFORMATPROC glVertexAttribFormat;
+	extern PFNGLVERTEXATTRIBBINDINGPROC glVertexAttribBinding;
+	extern PFNGLVERTEXBINDINGDIVISORPROC glVertexBindingDivisor;
+
+	extern bool textureFilterAnisotropic;
+	extern float maxTextureAnisotropy; // 1 without the extension
+
+	// Call once with the context current, with the same loader as glad
+	// (glfwGetProcAddress).
+	void load(GLADloadproc loader);
+
+	bool isSupported(const char* name);
+}
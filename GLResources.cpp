@@ -0,0 +1,248 @@
+#include "GLResources.hpp"
+#include "GLExtensions.hpp"
+#include "StateCache.hpp"
+#include "VertexArrayCache.hpp"
+
+using namespace GLExtensions;
+
+GLuint GLResources::createTexture()
+{
+	GLuint texture;
+
+	// A name from glGenTextures is only a texture once it's first bound, which the first
+	// edit does.
+	if (directStateAccess)
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	else
+		glGenTextures(1, &texture);
+
+	return texture;
+}
+
+void GLResources::textureParameter(GLuint texture, GLenum name, GLint value)
+{
+	if (directStateAccess) {
+		glTextureParameteri(texture, name, value);
+		return;
+	}
+
+	StateCache::current().bindTextureForEdit(texture);
+	glTexParameteri(GL_TEXTURE_2D, name, value);
+}
+
+void GLResources::textureParameter(GLuint texture, GLenum name, GLfloat value)
+{
+	if (directStateAccess) {
+		glTextureParameterf(texture, name, value);
+		return;
+	}
+
+	StateCache::current().bindTextureForEdit(texture);
+	glTexParameterf(GL_TEXTURE_2D, name, value);
+}
+
+void GLResources::textureImage(GLuint texture, GLint level, GLsizei width, GLsizei height, const void* pixels, GLuint pixelBuffer)
+{
+	// The unpack buffer applies to every upload, so it's also unbound for the ones from
+	// memory.
+	StateCache& cache = StateCache::current();
+	cache.bindTextureForEdit(texture);
+	cache.bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+void GLResources::deleteTextures(GLsizei count, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		StateCache::current().forgetTexture(textures[i]);
+	}
+
+	glDeleteTextures(count, textures);
+}
+
+GLuint GLResources::createBuffer()
+{
+	GLuint buffer;
+
+	if (directStateAccess)
+		glCreateBuffers(1, &buffer);
+	else
+		glGenBuffers(1, &buffer);
+
+	return buffer;
+}
+
+void GLResources::bufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags)
+{
+	if (directStateAccess) {
+		glNamedBufferStorage(buffer, size, data, flags);
+		return;
+	}
+
+	StateCache::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_STATIC_DRAW);
+}
+
+void GLResources::bufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage)
+{
+	if (directStateAccess) {
+		glNamedBufferData(buffer, size, data, usage);
+		return;
+	}
+
+	StateCache::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+}
+
+void* GLResources::mapBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	if (directStateAccess)
+		return glMapNamedBufferRange(buffer, offset, length, access);
+
+	StateCache::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length, access);
+}
+
+bool GLResources::unmapBuffer(GLuint buffer)
+{
+	if (directStateAccess)
+		return glUnmapNamedBuffer(buffer) == GL_TRUE;
+
+	StateCache::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	return glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+}
+
+GLint GLResources::bufferSize(GLuint buffer)
+{
+	GLint size = 0;
+
+	if (directStateAccess) {
+		glGetNamedBufferParameteriv(buffer, GL_BUFFER_SIZE, &size);
+		return size;
+	}
+
+	StateCache::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glGetBufferParameteriv(GL_COPY_WRITE_BUFFER, GL_BUFFER_SIZE, &size);
+	return size;
+}
+
+void GLResources::deleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		StateCache::current().forgetBuffer(buffers[i]);
+		VertexArrayCache::current().forgetBuffer(buffers[i]);
+	}
+
+	glDeleteBuffers(count, buffers);
+}
+
+GLuint GLResources::createVertexArray()
+{
+	GLuint vertexArray;
+
+	if (directStateAccess)
+		glCreateVertexArrays(1, &vertexArray);
+	else
+		glGenVertexArrays(1, &vertexArray);
+
+	return vertexArray;
+}
+
+// Without DSA a vertex array is edited while it's bound, and whatever was bound before
+// comes back afterwards.
+class BoundVertexArray {
+    private:
+	GLuint previous;
+    public:
+	explicit BoundVertexArray(GLuint vertexArray)
+		: previous(StateCache::current().getVertexArray())
+	{
+		StateCache::current().bindVertexArray(vertexArray);
+	}
+
+	~BoundVertexArray()
+	{
+		if (previous != StateCache::UNKNOWN)
+			StateCache::current().bindVertexArray(previous);
+	}
+};
+
+void GLResources::vertexArrayElementBuffer(GLuint vertexArray, GLuint buffer)
+{
+	if (directStateAccess) {
+		glVertexArrayElementBuffer(vertexArray, buffer);
+		return;
+	}
+
+	BoundVertexArray bound(vertexArray);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+}
+
+void GLResources::vertexArrayAttribute(GLuint vertexArray, GLuint location, GLuint buffer, GLintptr offset, GLsizei stride, GLint components,
+	GLenum type, GLboolean normalized, GLuint divisor)
+{
+	// Every attribute gets a binding of its own (the one with its number), which is what
+	// glVertexAttribPointer does behind the scenes. 'stride' has to be the real one, 0
+	// doesn't mean tightly packed here.
+	if (directStateAccess) {
+		glVertexArrayVertexBuffer(vertexArray, location, buffer, offset, stride);
+		glVertexArrayAttribFormat(vertexArray, location, components, type, normalized, 0);
+		glVertexArrayAttribBinding(vertexArray, location, location);
+		glVertexArrayBindingDivisor(vertexArray, location, divisor);
+		glEnableVertexArrayAttrib(vertexArray, location);
+		return;
+	}
+
+	BoundVertexArray bound(vertexArray);
+	StateCache::current().bindBuffer(GL_ARRAY_BUFFER, buffer);
+	glVertexAttribPointer(location, components, type, normalized, stride, (const void*)offset);
+	glVertexAttribDivisor(location, divisor);
+	glEnableVertexAttribArray(location);
+}
+
+void GLResources::vertexArrayAttributeFormat(GLuint vertexArray, GLuint location, GLuint binding, GLint components, GLenum type,
+	GLboolean normalized, GLuint relativeOffset)
+{
+	if (directStateAccess) {
+		glVertexArrayAttribFormat(vertexArray, location, components, type, normalized, relativeOffset);
+		glVertexArrayAttribBinding(vertexArray, location, binding);
+		glEnableVertexArrayAttrib(vertexArray, location);
+		return;
+	}
+
+	BoundVertexArray bound(vertexArray);
+	glVertexAttribFormat(location, components, type, normalized, relativeOffset);
+	glVertexAttribBinding(location, binding);
+	glEnableVertexAttribArray(location);
+}
+
+void GLResources::vertexArrayBindingDivisor(GLuint vertexArray, GLuint binding, GLuint divisor)
+{
+	if (directStateAccess) {
+		glVertexArrayBindingDivisor(vertexArray, binding, divisor);
+		return;
+	}
+
+	BoundVertexArray bound(vertexArray);
+	glVertexBindingDivisor(binding, divisor);
+}
+
+void GLResources::vertexArrayVertexBuffer(GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+{
+	if (directStateAccess) {
+		glVertexArrayVertexBuffer(vertexArray, binding, buffer, offset, stride);
+		return;
+	}
+
+	BoundVertexArray bound(vertexArray);
+	glBindVertexBuffer(binding, buffer, offset, stride);
+}
+
+void GLResources::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		StateCache::current().forgetVertexArray(vertexArrays[i]);
+	}
+
+	glDeleteVertexArrays(count, vertexArrays);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <glad/glad.h>
+
+// Creating and editing textures, buffers and vertex arrays without disturbing what the
+// renderer has bound. With direct state access (GL 4.5, see GLExtensions) every call
+// names the object it works on and binds nothing. On plain 3.3 the same calls bind the
+// object where nothing draws from it, through the StateCache, so it's only rebound when
+// it isn't there already: textures on StateCache::EDIT_UNIT, buffers on
+// GL_COPY_WRITE_BUFFER, and vertex arrays are put back the way they were.
+//
+// GL thread only, like the rest of GL.
+class GLResources {
+    public:
+	// GL_TEXTURE_2D.
+	static GLuint createTexture();
+	static void textureParameter(GLuint texture, GLenum name, GLint value);
+	static void textureParameter(GLuint texture, GLenum name, GLfloat value);
+	// One RGBA8 level. Storage stays mutable, levels come and go with streaming (see
+	// TextureStreamer). With 'pixelBuffer', 'pixels' is an offset into it. There's no
+	// DSA call for this, so it's edited on EDIT_UNIT either way.
+	static void textureImage(GLuint texture, GLint level, GLsizei width, GLsizei height, const void* pixels, GLuint pixelBuffer = 0);
+	static void deleteTextures(GLsizei count, const GLuint* textures);
+
+	static GLuint createBuffer();
+	// Sized once and never again. Immutable with DSA, so the driver knows it can place it
+	// for good; 'flags' are glBufferStorage's (GL_MAP_WRITE_BIT to map it).
+	static void bufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+	// Can be given new storage every time, for buffers refilled every frame.
+	static void bufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+	static void* mapBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	// False when the contents got lost while mapped (mode switches and such).
+	static bool unmapBuffer(GLuint buffer);
+	static GLint bufferSize(GLuint buffer);
+	static void deleteBuffers(GLsizei count, const GLuint* buffers);
+
+	static GLuint createVertexArray();
+	static void vertexArrayElementBuffer(GLuint vertexArray, GLuint buffer);
+	// Attribute 'location' reads 'components' of 'type' at 'offset' + i * 'stride' in
+	// 'buffer', i being the vertex, or the instance divided by 'divisor'. Calling it again
+	// with a different offset is how a draw starts further into the buffer.
+	static void vertexArrayAttribute(GLuint vertexArray, GLuint location, GLuint buffer, GLintptr offset, GLsizei stride, GLint components,
+		GLenum type, GLboolean normalized, GLuint divisor = 0);
+
+	// The same split into formats and bindings ARB_vertex_attrib_binding makes, only
+	// with GLExtensions::vertexAttribBinding. Attribute 'location' reads 'components' of
+	// 'type' at 'relativeOffset' into each vertex of 'binding', and a binding is pointed at
+	// a buffer on its own, so moving it doesn't touch the formats (see VertexArrayCache).
+	static void vertexArrayAttributeFormat(GLuint vertexArray, GLuint location, GLuint binding, GLint components, GLenum type, GLboolean normalized,
+		GLuint relativeOffset);
+	static void vertexArrayBindingDivisor(GLuint vertexArray, GLuint binding, GLuint divisor);
+	static void vertexArrayVertexBuffer(GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+	static void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+};
@@ -0,0 +1,72 @@
+#include "GpuTimer.hpp"
+
+GpuTimer::GpuTimer()
+	: next(0), measuring(false), totalMilliseconds(0.0), samples(0)
+{
+	glGenQueries(QUERY_COUNT, queries);
+
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		inFlight[i] = false;
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(QUERY_COUNT, queries);
+}
+
+void GpuTimer::collect()
+{
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		if (!inFlight[i])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+		totalMilliseconds += nanoseconds / 1000000.0;
+		samples++;
+		inFlight[i] = false;
+	}
+}
+
+void GpuTimer::begin()
+{
+	collect();
+
+	// Still waiting on the GPU for every query: skip this one rather than wait.
+	measuring = !inFlight[next];
+	if (measuring)
+		glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void GpuTimer::end()
+{
+	if (!measuring)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	inFlight[next] = true;
+	next = (next + 1) % QUERY_COUNT;
+	measuring = false;
+}
+
+double GpuTimer::getAverageMilliseconds() const
+{
+	return samples > 0 ? totalMilliseconds / samples : 0.0;
+}
+
+unsigned int GpuTimer::getSampleCount() const
+{
+	return samples;
+}
+
+void GpuTimer::reset()
+{
+	totalMilliseconds = 0.0;
+	samples = 0;
+}
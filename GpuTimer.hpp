@@ -0,0 +1,38 @@
+#pragma once
+#include <glad/glad.h>
+
+// How long the GPU spends on the commands between begin() and end(), with GL_TIME_ELAPSED
+// queries (core since 3.3).
+//
+// A query's result only shows up a frame or two after it ends, and asking for it before
+// then waits for the GPU. So the queries go round a small ring and are only read once
+// GL_QUERY_RESULT_AVAILABLE says so. If every query is still in flight, that begin/end
+// isn't measured.
+class GpuTimer {
+    private:
+	static constexpr int QUERY_COUNT = 4;
+
+	GLuint queries[QUERY_COUNT];
+	bool inFlight[QUERY_COUNT];
+	int next;
+	bool measuring;
+	double totalMilliseconds;
+	unsigned int samples;
+
+	void collect();
+    public:
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// Can't be nested, with this timer or any other.
+	void begin();
+	void end();
+
+	// Over every result read since the last reset.
+	double getAverageMilliseconds() const;
+	unsigned int getSampleCount() const;
+	void reset();
+};
@@ -0,0 +1,157 @@
+#include "HotReloader.hpp"
+#include "AssetLoader.hpp"
+#include "AssetManager.hpp"
+#include "AssetPack.hpp"
+#include "JobSystem.hpp"
+#include "Shader.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "VirtualFileSystem.hpp"
+#include <glad/glad.h>
+#include <iostream>
+#include <thread>
+
+HotReloader::HotReloader(JobSystem& jobs, AssetLoader& loader, VirtualFileSystem& files, AssetManager& assets,
+	const std::string& sourceRoot, const std::string& outputRoot)
+	: jobs(jobs), loader(loader), files(files), assets(assets), cooker(jobs, sourceRoot, outputRoot),
+	  cooking(false), cookAgain(false), shaderBuilds(0)
+{
+	// Rewriting the pack takes as long as every asset together and would change the file
+	// under the mapping, so it waits for the next full cook.
+	cooker.setPacking(false);
+	watcher.watch(sourceRoot);
+}
+
+HotReloader::~HotReloader()
+{
+	{
+		std::unique_lock<std::mutex> lock(cookMutex);
+		cookAgain = false;
+		cookDone.wait(lock, [this] { return !cooking; });
+	}
+
+	// The builds finish on the GL thread, which is this one.
+	while (shaderBuilds > 0) {
+		loader.pump();
+		std::this_thread::yield();
+	}
+}
+
+const char* HotReloader::getBackendName() const
+{
+	return watcher.getBackendName();
+}
+
+void HotReloader::addShader(Shader& shader, std::function<void(Shader&)> onReload)
+{
+	shaders.push_back(std::make_unique<WatchedShader>(WatchedShader{ &shader, std::move(onReload), 0 }));
+}
+
+void HotReloader::startCook()
+{
+	// Called with cookMutex held.
+	cooking = true;
+	jobs.submit([this] {
+		std::vector<std::string> outputs;
+		cooker.cook(false, nullptr, &outputs);
+
+		std::lock_guard<std::mutex> lock(cookMutex);
+		cookedOutputs.insert(cookedOutputs.end(), outputs.begin(), outputs.end());
+		if (cookAgain) {
+			cookAgain = false;
+			startCook();
+			return;
+		}
+		cooking = false;
+		cookDone.notify_all();
+	});
+}
+
+void HotReloader::update()
+{
+	std::vector<std::string> outputs;
+	{
+		std::lock_guard<std::mutex> lock(cookMutex);
+
+		// The cooker looks at every source again anyway, so which files changed doesn't
+		// matter, only that some did.
+		if (!watcher.poll().empty()) {
+			if (cooking)
+				cookAgain = true;
+			else
+				startCook();
+		}
+
+		outputs.swap(cookedOutputs);
+	}
+
+	for (const std::string& output : outputs) {
+		apply(output);
+	}
+}
+
+void HotReloader::apply(const std::string& output)
+{
+	// The pack still has the old bytes.
+	files.preferLooseFile(output);
+
+	std::string extension = output.substr(output.find_last_of('.') + 1);
+	if (extension == "mips") {
+		assets.reloadTexture(output);
+		return;
+	}
+
+	// Which shaders include a file isn't kept anywhere, and there are few enough of them to
+	// rebuild them all.
+	bool included = extension == "glsl";
+
+	std::string path = AssetPack::normalizePath(output);
+	for (std::unique_ptr<WatchedShader>& watched : shaders) {
+		if (included || AssetPack::normalizePath(watched->shader->getVertexPath()) == path || AssetPack::normalizePath(watched->shader->getFragmentPath()) == path) {
+			std::cout << "Reloading " << watched->shader->getVertexPath() << " + " << watched->shader->getFragmentPath() << std::endl;
+			shaderBuilds++;
+			spawn(reloadShader(*watched, ++watched->generation));
+		}
+	}
+}
+
+Task<void> HotReloader::reloadShader(WatchedShader& watched, unsigned int generation)
+{
+	co_await loader.onWorker();
+
+	// Preprocessed the same way as the first time, includes and all.
+	PreprocessedShader vertexShader, fragmentShader;
+	const std::vector<std::string>& defines = watched.shader->getDefines();
+	bool read = ShaderPreprocessor::preprocess(files, watched.shader->getVertexPath(), defines, vertexShader)
+		&& ShaderPreprocessor::preprocess(files, watched.shader->getFragmentPath(), defines, fragmentShader);
+
+	co_await loader.onGLThread();
+
+	if (!read) {
+		std::cout << "ERROR::HOT_RELOADER::SHADER_NOT_SUCCESFULLY_READ, keeping the old program" << std::endl;
+		shaderBuilds--;
+		co_return;
+	}
+
+	// With KHR_parallel_shader_compile the driver compiles on its own threads, and this
+	// only checks on it once a frame. Without it, finishBuild is where the compile happens.
+	ShaderBuild build = Shader::beginBuild(vertexShader.source, fragmentShader.source);
+	while (!Shader::isBuildDone(build)) {
+		co_await loader.onGLThread();
+	}
+
+	unsigned int program = Shader::finishBuild(build);
+	if (program == 0) {
+		std::cout << "ERROR::HOT_RELOADER::SHADER_REBUILD_FAILED, keeping the old program" << std::endl;
+	}
+	else if (generation != watched.generation) {
+		// Saved again while this one was building, the newer build wins.
+		glDeleteProgram(program);
+	}
+	else {
+		watched.shader->replaceProgram(program);
+		if (watched.onReload)
+			watched.onReload(*watched.shader);
+	}
+
+	shaderBuilds--;
+}
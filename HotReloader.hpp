@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "AssetCooker.hpp"
+#include "FileWatcher.hpp"
+#include "Task.hpp"
+
+class AssetLoader;
+class AssetManager;
+class JobSystem;
+class Shader;
+class VirtualFileSystem;
+
+// Picks up edits to the source assets while the program runs.
+//
+// The FileWatcher reports saves under Assets/, the AssetCooker cooks what changed on a
+// worker (only what changed, by content hash, and without writing the pack: the cooked
+// files are read loose from then on), and the results are swapped in between frames:
+//
+//   shaders   compiled and linked with KHR_parallel_shader_compile where there is one,
+//             checked once a frame until the driver is done, then swapped in
+//   textures  streamed in next to the old ones and swapped once they've caught up (see
+//             AssetManager::reloadTexture)
+//
+// So nothing waits on a cook, a compile or a read. When a rebuild fails, the old version
+// stays and the error is printed. Meshes aren't reloaded: the renderer holds on to their
+// GL objects.
+class HotReloader {
+    private:
+	struct WatchedShader {
+		Shader* shader;
+		std::function<void(Shader&)> onReload;
+		unsigned int generation; // bumped per reload, so an older build finishing late is dropped
+	};
+
+	JobSystem& jobs;
+	AssetLoader& loader;
+	VirtualFileSystem& files;
+	AssetManager& assets;
+	AssetCooker cooker;
+	FileWatcher watcher;
+	std::vector<std::unique_ptr<WatchedShader>> shaders;
+
+	// The cook running on a worker, and whether more changes came in meanwhile.
+	std::mutex cookMutex;
+	std::condition_variable cookDone;
+	bool cooking;
+	bool cookAgain;
+	std::vector<std::string> cookedOutputs;
+
+	std::atomic<int> shaderBuilds;
+
+	void startCook();
+	void apply(const std::string& output);
+	Task<void> reloadShader(WatchedShader& watched, unsigned int generation);
+    public:
+	HotReloader(JobSystem& jobs, AssetLoader& loader, VirtualFileSystem& files, AssetManager& assets,
+		const std::string& sourceRoot = "Assets", const std::string& outputRoot = "Cooked");
+	// Waits for the cook and the shader builds still going.
+	~HotReloader();
+
+	HotReloader(const HotReloader&) = delete;
+	HotReloader& operator=(const HotReloader&) = delete;
+
+	// Rebuilds 'shader' when one of its cooked files changes, then calls 'onReload'. The
+	// uniforms it had already go to the new program by themselves (see Shader::flush).
+	void addShader(Shader& shader, std::function<void(Shader&)> onReload = nullptr);
+
+	// Once a frame on the GL thread, before AssetLoader::pump and AssetManager::update.
+	void update();
+
+	const char* getBackendName() const;
+};
@@ -0,0 +1,121 @@
+#include "JobSystem.hpp"
+#include <atomic>
+#include <memory>
+
+JobSystem::JobSystem(unsigned int workerCount)
+	: runningJobs(0), stopping(false)
+{
+	if (workerCount == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = cores > 1 ? cores - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&JobSystem::workerLoop, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	jobAvailable.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void JobSystem::workerLoop()
+{
+	while (true) {
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			// Drain the queue before leaving so nobody waits on a job that never runs.
+			if (jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			runningJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			runningJobs--;
+
+			if (runningJobs == 0 && jobs.empty())
+				idle.notify_all();
+		}
+	}
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+
+	jobAvailable.notify_one();
+}
+
+void JobSystem::parallelFor(unsigned int count, const std::function<void(unsigned int)>& body)
+{
+	if (count == 0)
+		return;
+
+	struct Batch {
+		std::atomic<unsigned int> next{ 0 };
+		std::atomic<unsigned int> finished{ 0 };
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+
+	std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+	const std::function<void(unsigned int)>* bodyPtr = &body;
+
+	// Helpers may start after every index was taken (even after we returned), so they
+	// only touch 'body' when they actually got an index.
+	auto run = [batch, bodyPtr, count]() {
+		unsigned int index;
+		while ((index = batch->next.fetch_add(1)) < count) {
+			(*bodyPtr)(index);
+
+			if (batch->finished.fetch_add(1) + 1 == count) {
+				std::lock_guard<std::mutex> lock(batch->mutex);
+				batch->done.notify_all();
+			}
+		}
+	};
+
+	unsigned int helpers = count - 1 < (unsigned int)workers.size() ? count - 1 : (unsigned int)workers.size();
+	for (unsigned int i = 0; i < helpers; i++) {
+		submit(run);
+	}
+
+	run();
+
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	batch->done.wait(lock, [&batch, count] { return batch->finished.load() == count; });
+}
+
+void JobSystem::waitIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return runningJobs == 0 && jobs.empty(); });
+}
+
+unsigned int JobSystem::getWorkerCount() const
+{
+	return (unsigned int)workers.size();
+}
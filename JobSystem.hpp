@@ -0,0 +1,38 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+// A small pool of worker threads. Anything that should not run on the GL thread
+// (decoding images, building mips, reading files...) is pushed here as a job.
+class JobSystem {
+    private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable idle;
+	unsigned int runningJobs;
+	bool stopping;
+
+	void workerLoop();
+    public:
+	// workerCount == 0 means "one worker per core, minus the main thread".
+	JobSystem(unsigned int workerCount = 0);
+	~JobSystem();
+
+	void submit(std::function<void()> job);
+
+	// Runs body(0) ... body(count - 1) spread across the workers and blocks until all of
+	// them are done. The calling thread also takes indices, so this is safe to call
+	// from inside another job.
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& body);
+
+	// Blocks until the queue is empty and no job is running.
+	void waitIdle();
+
+	unsigned int getWorkerCount() const;
+};
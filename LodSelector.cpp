@@ -0,0 +1,69 @@
+#include "LodSelector.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+LodSelector::LodSelector(float thresholdPixels, float hysteresis)
+	: thresholdPixels(thresholdPixels), hysteresis(hysteresis), pixelsPerUnit(1.0f)
+{
+}
+
+void LodSelector::setView(float fovRadians, int viewportHeight)
+{
+	pixelsPerUnit = (float)viewportHeight / (2.0f * std::tan(fovRadians * 0.5f));
+}
+
+float LodSelector::projectedError(float error, float distance) const
+{
+	if (error <= 0.0f)
+		return 0.0f;
+
+	// Camera inside the bounds: anything but full detail would show.
+	if (distance <= 0.0f)
+		return FLT_MAX;
+
+	return error * pixelsPerUnit / distance;
+}
+
+int LodSelector::coarsestWithin(const MeshLod* lods, size_t lodCount, float distance, float limitPixels) const
+{
+	for (size_t level = lodCount; level > 1; level--) {
+		if (projectedError(lods[level - 1].error, distance) <= limitPixels)
+			return (int)level - 1;
+	}
+
+	return 0;
+}
+
+int LodSelector::select(const MeshLod* lods, size_t lodCount, float distance, int current) const
+{
+	int wanted = coarsestWithin(lods, lodCount, distance, thresholdPixels);
+
+	if (current < 0 || current >= (int)lodCount || wanted == current)
+		return wanted;
+
+	// Coarser only once the error is well under the threshold, finer only once the
+	// current level's error is well over it.
+	if (wanted > current)
+		return std::max(current, coarsestWithin(lods, lodCount, distance, thresholdPixels * (1.0f - hysteresis)));
+
+	return projectedError(lods[current].error, distance) <= thresholdPixels * (1.0f + hysteresis) ? current : wanted;
+}
+
+void LodSelector::printStats(const LodStats& stats)
+{
+	if (stats.frames == 0)
+		return;
+
+	double frames = (double)stats.frames;
+
+	std::cout << "LODs per frame: instances";
+	for (uint32_t level = 0; level < MESH_MAX_LODS; level++) {
+		if (stats.instances[level] > 0)
+			std::cout << " " << level << ":" << stats.instances[level] / frames;
+	}
+
+	std::cout << ", " << stats.instancedDraws / frames << " instanced draws, triangles " << stats.triangles / frames
+		<< " of " << stats.fullDetailTriangles / frames << " at full detail" << std::endl;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include "MeshSimplifier.hpp"
+
+// Per frame totals of what the LOD selection saved.
+struct LodStats {
+	size_t frames;
+	size_t instances[MESH_MAX_LODS]; // drawn at each level
+	size_t instancedDraws;           // glDrawElementsInstanced calls for the coarser levels
+	size_t triangles;                // what was drawn
+	size_t fullDetailTriangles;      // what level 0 everywhere would have drawn
+};
+
+// Picks a level of detail per instance from how many pixels its error covers on screen.
+// Levels only change when the error is clearly past the threshold, so instances right at
+// the edge don't flicker between two of them every frame.
+class LodSelector {
+    private:
+	float thresholdPixels;
+	float hysteresis;
+	float pixelsPerUnit; // at distance 1
+
+	int coarsestWithin(const MeshLod* lods, size_t lodCount, float distance, float limitPixels) const;
+    public:
+	// 'hysteresis' is the fraction of the threshold a level has to be past to switch.
+	LodSelector(float thresholdPixels = 1.0f, float hysteresis = 0.25f);
+
+	// Has to follow the projection, fov changes with the scroll wheel.
+	void setView(float fovRadians, int viewportHeight);
+
+	// Pixels an error of 'error' units covers at 'distance' from the camera.
+	float projectedError(float error, float distance) const;
+
+	// 'distance' is from the camera to the closest point of the instance's bounds and
+	// 'current' its level last frame (-1 for none).
+	int select(const MeshLod* lods, size_t lodCount, float distance, int current) const;
+
+	// Averages over the frames the stats cover, on one line.
+	static void printStats(const LodStats& stats);
+};
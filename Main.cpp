@@ -1,7 +1,39 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <thread>
 #include "Shader.hpp"
+#include "ShaderVariantCache.hpp"
+#include "GpuTimer.hpp"
+#include "JobSystem.hpp"
+#include "AsyncIO.hpp"
+#include "AssetLoader.hpp"
+#include "AssetManager.hpp"
+#include "TextureStreamer.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshFile.hpp"
+#include "Meshlets.hpp"
+#include "LodSelector.hpp"
+#include "AssetCooker.hpp"
+#include "HotReloader.hpp"
+#include "GLExtensions.hpp"
+#include "GLResources.hpp"
+#include "StateCache.hpp"
+#include "SamplerCache.hpp"
+#include "VertexArrayCache.hpp"
+#include "PipelineState.hpp"
+#include "VirtualFileSystem.hpp"
+#include "EmbeddedFiles.hpp"
+#include "PixelOps.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -15,10 +47,52 @@ constexpr int HEIGHT = 768;
 
 // Main window
 Shader* shader;
+// Every variant of the cube's shader, and the GPU time of the cube pass with the
+// specialized ones and with the one that branches at runtime.
+ShaderVariantCache* shaderVariants;
+GpuTimer* specializedTimer;
+GpuTimer* branchingTimer;
+
+// Texture streaming
+constexpr size_t TEXTURE_BUDGET = 64 * 1024 * 1024;
+JobSystem* jobSystem;
+AsyncIO* asyncIO;
+AssetLoader* assetLoader;
+TextureStreamer* textureStreamer;
+
+// Asset memory. Unreferenced assets stay loaded until these are reached.
+constexpr size_t ASSET_CPU_BUDGET = 64 * 1024 * 1024;
+constexpr size_t ASSET_GPU_BUDGET = 256 * 1024 * 1024;
+AssetManager* assets;
+
+// Rebuilds shaders and textures when their sources are saved.
+HotReloader* hotReloader;
+
+// How textures are filtered. Q steps through the tiers, which only changes the few
+// sampler objects there are, never the textures.
+struct SamplerTier {
+	const char* name;
+	SamplerQuality quality;
+};
+const SamplerTier SAMPLER_TIERS[] = {
+	{ "low", { 1.0f, 1.0f, false } },
+	{ "medium", { 4.0f, 0.0f, true } },
+	{ "high", { 16.0f, 0.0f, true } },
+};
+constexpr int SAMPLER_TIER_COUNT = sizeof(SAMPLER_TIERS) / sizeof(SAMPLER_TIERS[0]);
+int samplerTier = SAMPLER_TIER_COUNT - 1;
+SamplerCache* samplers;
+
+// Bounding sphere radius of the unit cube.
+constexpr float CUBE_RADIUS = 0.87f;
+
+// The model matrix is a vertex attribute (a mat4 takes locations 4 to 7), per instance
+// for instanced draws and a constant value otherwise.
+constexpr GLuint INSTANCE_MODEL_LOCATION = VERTEX_SEMANTIC_COUNT;
 
 // Transparency settings
 constexpr float transparency = 0.1f;
-float currentTransparency = 0.0f;
+float currentTransparency = transparency;
 
 // Delta time
 float lastFrame = 0.0f, deltaTime = 0.0f;
@@ -33,6 +107,9 @@ float fov = 45.0f;
 
 bool wireframeToggle = false;
 bool shaderToggle = false;
+// V switches between fragment shaders specialized for what's drawn and one that branches
+// on uniforms, to compare their GPU time.
+bool runtimeBranches = false;
 
 glm::vec3 viewVector = glm::vec3(0.0f, 0.0f, -3.0f);
 float modelRotation = -55.0f;
@@ -60,22 +137,23 @@ void printMatrix(const glm::mat4& matrix) {
 void wireframeCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 	if (action == GLFW_RELEASE) {
 		if (key == GLFW_KEY_F) {
-			if (wireframeToggle) {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-				wireframeToggle = false;
-			}
-			else {
-				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-				wireframeToggle = true;
-			}
+			// Only picks the wireframe pipeline states, the draws set the polygon mode.
+			wireframeToggle = !wireframeToggle;
 		}
 		else if (key == GLFW_KEY_UP) {
 			currentTransparency += transparency;
-			shader->setFloat("transparency", currentTransparency);
 		}
 		else if (key == GLFW_KEY_DOWN) {
 			currentTransparency -= transparency;
-			shader->setFloat("transparency", currentTransparency);
+		}
+		else if (key == GLFW_KEY_V) {
+			runtimeBranches = !runtimeBranches;
+			std::cout << "Fragment shader: " << (runtimeBranches ? "runtime branches" : "specialized") << std::endl;
+		}
+		else if (key == GLFW_KEY_Q) {
+			samplerTier = (samplerTier + 1) % SAMPLER_TIER_COUNT;
+			samplers->setQuality(SAMPLER_TIERS[samplerTier].quality);
+			std::cout << "Texture filtering: " << SAMPLER_TIERS[samplerTier].name << std::endl;
 		}
 		else if (key == GLFW_KEY_ESCAPE) {
 			exit(1);
@@ -149,7 +227,407 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 		fov = 45.0f;
 }
 
-int main(void) {
+// One load of the benchmark below: read, "decode" on a worker (a checksum of the bytes
+// stands in for it), then finish on the GL thread like an upload would.
+Task<void> benchLoad(AssetLoader& loader, std::string path, std::atomic<uint64_t>& checksum, std::atomic<int>& remaining)
+{
+	LoadedFile file = co_await loader.readFile(path);
+
+	co_await loader.onWorker();
+	uint64_t sum = 0;
+	for (size_t i = 0; i < file.size(); i += 64) {
+		sum += file.data()[i];
+	}
+	checksum += sum;
+
+	co_await loader.onGLThread();
+	remaining--;
+}
+
+// program.exe --load-bench [count]: starts 'count' loads of the cooked assets at once
+// and pumps them like the render loop would, to show how far the memory in use stays
+// under the loader's budget however many loads are waiting.
+int runLoadBench(int count)
+{
+	const char* paths[] = {
+		"Cooked/Images/container.mips", "Cooked/Images/awesomeface.mips", "Cooked/Meshes/cube.mesh",
+		"Cooked/Shaders/shader.vs", "Cooked/Shaders/shader.fs"
+	};
+	constexpr size_t BENCH_BUDGET = 8 * 1024 * 1024;
+
+	VirtualFileSystem files;
+	files.mount("Cooked/assets.pack");
+	JobSystem jobs;
+	AsyncIO io;
+	AssetLoader loader(jobs, io, files, BENCH_BUDGET);
+
+	std::atomic<uint64_t> checksum(0);
+	std::atomic<int> remaining(count);
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < count; i++) {
+		spawn(benchLoad(loader, paths[i % 5], checksum, remaining));
+	}
+
+	// A "frame" every millisecond.
+	while (remaining > 0) {
+		loader.pump();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	AssetLoaderStats stats = loader.getStats();
+	std::cout << "Loaded " << stats.loads << " files (" << stats.failed << " failed) with " << io.getBackendName() << " in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	std::cout << "At most " << stats.maxInFlight << " loads in flight, " << stats.budgetWaits << " waited for memory, peak "
+		<< stats.maxBytesInUse / 1024 << " KB of a " << BENCH_BUDGET / 1024 << " KB budget (checksum " << checksum << ")" << std::endl;
+
+	// Every file here is far smaller than the budget, so going over it is a loader bug.
+	if (stats.maxBytesInUse > BENCH_BUDGET) {
+		std::cout << "ERROR::LOAD_BENCH::BUDGET_EXCEEDED " << stats.maxBytesInUse << " > " << BENCH_BUDGET << std::endl;
+		return 1;
+	}
+
+	return stats.failed == 0 ? 0 : 1;
+}
+
+// program.exe --pixel-bench [image]: runs every PixelOps kernel on the image at each SIMD
+// level the CPU has and prints GB/s (bytes read), checking every level against the scalar
+// results. Fails if one doesn't match: bit for bit, except Kaiser, whose float sums may
+// round 1 off.
+int runPixelBench(const char* path)
+{
+	int width, height, channels;
+	unsigned char* image = stbi_load(path, &width, &height, &channels, 0);
+	if (image == nullptr) {
+		std::cout << "ERROR::PIXEL_BENCH::LOAD_FAILED " << path << std::endl;
+		return 1;
+	}
+
+	size_t pixels = (size_t)width * height;
+	std::vector<unsigned char> rgb(pixels * 3);
+	std::vector<unsigned char> rgba(pixels * 4);
+	PixelOps::expandToRGBA(image, channels, rgba.data(), pixels);
+	for (size_t i = 0; i < pixels; i++) {
+		memcpy(&rgb[i * 3], &rgba[i * 4], 3);
+	}
+	stbi_image_free(image);
+
+	std::vector<float> linear(pixels * 4);
+	PixelOps::srgbToLinear(rgba.data(), linear.data(), linear.size());
+	size_t halfSize = (size_t)std::max(width >> 1, 1) * std::max(height >> 1, 1) * 4;
+
+	// Each kernel gets a fresh copy of the input, writes 'output' and reads 'bytes'.
+	struct Kernel {
+		const char* name;
+		size_t bytes;
+		int tolerance;
+		std::function<void(std::vector<unsigned char>& output)> run;
+	};
+	std::vector<unsigned char> work;
+	std::vector<float> floats(linear.size());
+	const Kernel kernels[] = {
+		{ "expand rgb", rgb.size(), 0, [&](std::vector<unsigned char>& out) { out.resize(rgba.size()); PixelOps::expandToRGBA(rgb.data(), 3, out.data(), pixels); } },
+		{ "premultiply", rgba.size(), 0, [&](std::vector<unsigned char>& out) { out = rgba; PixelOps::premultiplyAlpha(out.data(), pixels); } },
+		{ "srgb->linear", rgba.size(), 0, [&](std::vector<unsigned char>& out) {
+			PixelOps::srgbToLinear(rgba.data(), floats.data(), floats.size());
+			out.assign((const unsigned char*)floats.data(), (const unsigned char*)(floats.data() + floats.size()));
+		} },
+		{ "linear->srgb", linear.size() * sizeof(float), 0, [&](std::vector<unsigned char>& out) { out.resize(linear.size()); PixelOps::linearToSrgb(linear.data(), out.data(), linear.size()); } },
+		{ "flip", rgba.size(), 0, [&](std::vector<unsigned char>& out) { out = rgba; PixelOps::flipVertically(out.data(), width, height, 4); } },
+		{ "box", rgba.size(), 0, [&](std::vector<unsigned char>& out) { out.resize(halfSize); PixelOps::downsampleBox(rgba.data(), width, height, out.data()); } },
+		{ "kaiser", rgba.size(), 1, [&](std::vector<unsigned char>& out) { out.resize(halfSize); PixelOps::downsampleKaiser(rgba.data(), width, height, out.data()); } },
+	};
+
+	PixelOps::SimdLevel best = PixelOps::detectSimdLevel();
+	std::cout << "Pixel kernels on " << path << " (" << width << "x" << height << "), GB/s:" << std::endl;
+	bool matched = true;
+
+	for (const Kernel& kernel : kernels) {
+		std::vector<unsigned char> reference;
+		std::cout << "  " << kernel.name << ":";
+
+		for (int level = 0; level <= (int)best; level++) {
+			PixelOps::setSimdLevel((PixelOps::SimdLevel)level);
+
+			// Enough rounds for about 256 MB, the copies of the input included.
+			int rounds = (int)std::max<size_t>(3, (256u << 20) / kernel.bytes);
+			auto start = std::chrono::steady_clock::now();
+			for (int r = 0; r < rounds; r++) {
+				kernel.run(work);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << " " << PixelOps::simdLevelName((PixelOps::SimdLevel)level) << " " << (double)kernel.bytes * rounds / seconds / 1e9;
+
+			if (level == 0) {
+				reference = work;
+				continue;
+			}
+
+			for (size_t i = 0; i < work.size(); i++) {
+				if (std::abs((int)work[i] - (int)reference[i]) > kernel.tolerance) {
+					std::cout << " (MISMATCH at byte " << i << ")";
+					matched = false;
+					break;
+				}
+			}
+		}
+
+		std::cout << std::endl;
+	}
+
+	PixelOps::setSimdLevel(best);
+	return matched ? 0 : 1;
+}
+
+// A size x size vertex heightfield as OBJ text, with texcoords and normals, for the mesh
+// bench when it isn't given a file.
+static bool writeGridObj(const std::string& path, int size)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			float height = 0.1f * std::sin(x * 0.37f) * std::cos(z * 0.23f);
+			file << "v " << x * 0.01f << " " << height << " " << z * 0.01f << "\n";
+		}
+	}
+
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			file << "vt " << (float)x / (size - 1) << " " << (float)z / (size - 1) << "\n";
+		}
+	}
+
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			glm::vec3 normal = glm::normalize(glm::vec3(-0.037f * std::cos(x * 0.37f) * std::cos(z * 0.23f), 0.01f,
+				0.023f * std::sin(x * 0.37f) * std::sin(z * 0.23f)));
+			file << "vn " << normal.x << " " << normal.y << " " << normal.z << "\n";
+		}
+	}
+
+	// OBJ counts from 1, and position, texcoord and normal share the index here.
+	for (int z = 0; z + 1 < size; z++) {
+		for (int x = 0; x + 1 < size; x++) {
+			int a = z * size + x + 1, b = a + 1, c = a + size, d = c + 1;
+			file << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+			file << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+		}
+	}
+
+	return (bool)file;
+}
+
+// Whether two triangle lists have the same triangles in the same order, each allowed to
+// start at another corner (MeshCodec keeps the winding, not the first vertex).
+static bool sameTriangles(const void* a, const void* b, size_t indexCount, size_t indexSize)
+{
+	auto index = [indexSize](const void* indices, size_t i) -> uint32_t {
+		return indexSize == 2 ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+	};
+
+	for (size_t t = 0; t + 2 < indexCount; t += 3) {
+		uint32_t x[3] = { index(a, t), index(a, t + 1), index(a, t + 2) };
+		uint32_t y[3] = { index(b, t), index(b, t + 1), index(b, t + 2) };
+
+		bool same = false;
+		for (int r = 0; r < 3 && !same; r++) {
+			same = x[0] == y[r] && x[1] == y[(r + 1) % 3] && x[2] == y[(r + 2) % 3];
+		}
+
+		if (!same)
+			return false;
+	}
+
+	return true;
+}
+
+// program.exe --mesh-bench [input.obj]: how much faster a .mesh loads than the OBJ text
+// it was made from. Parsing the OBJ is timed against mapping the .mesh and copying its
+// blobs out (what glBufferData does with them), without a GL context. Then the sizes of
+// the mesh with float and quantized vertices, raw and compressed with MeshCodec, and how
+// fast MeshCodec decodes at each SIMD level, checked against the raw blobs. Without an
+// input a 1024 x 1024 vertex grid is written to the temp directory first. The .mesh files
+// were just written, so they come out of the OS cache: this is the cost of the format,
+// not of the disk.
+int runMeshBench(const char* input)
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "mesh-bench";
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::string objPath = input != nullptr ? input : (directory / "grid.obj").string();
+	if (input == nullptr && !writeGridObj(objPath, 1024)) {
+		std::cout << "ERROR::MESH_BENCH::FILE_NOT_SUCCESFULLY_WRITTEN " << objPath << std::endl;
+		return 1;
+	}
+
+	MeshData mesh;
+	uint32_t attributes = 0;
+	std::vector<MeshFileSubmesh> submeshes;
+	auto parseStart = std::chrono::steady_clock::now();
+	if (!MeshFile::loadObj(objPath, mesh, attributes, submeshes))
+		return 1;
+	double parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+
+	// Laid out like the cooker does it (MeshFile::convertObj), minus the meshlets and LODs.
+	MeshOptimizer::fixWinding(mesh);
+	for (const MeshFileSubmesh& submesh : submeshes) {
+		std::vector<unsigned int> range(mesh.indices.begin() + submesh.firstIndex, mesh.indices.begin() + submesh.firstIndex + submesh.indexCount);
+		MeshOptimizer::optimizeVertexCache(range, mesh.vertexCount());
+		std::copy(range.begin(), range.end(), mesh.indices.begin() + submesh.firstIndex);
+		MeshOptimizer::optimizeOverdraw(mesh, submesh.firstIndex, submesh.indexCount);
+	}
+	MeshOptimizer::optimizeVertexFetch(mesh);
+
+	std::string meshPath = (directory / "float-raw.mesh").string();
+	if (!MeshFile::write(meshPath, mesh, attributes, VertexLayout::floats(attributes))) {
+		std::cout << "ERROR::MESH_BENCH::FILE_NOT_SUCCESFULLY_WRITTEN " << meshPath << std::endl;
+		return 1;
+	}
+
+	uintmax_t objBytes = std::filesystem::file_size(objPath, error);
+	uintmax_t meshBytes = std::filesystem::file_size(meshPath, error);
+	std::cout << "Mesh bench on " << objPath << ": " << mesh.vertexCount() << " vertices, " << mesh.triangleCount() << " triangles" << std::endl;
+	std::cout << "  OBJ text parse  " << objBytes / 1e6 << " MB in " << parseSeconds * 1000.0 << " ms, " << objBytes / 1e6 / parseSeconds << " MB/s" << std::endl;
+
+	// Loose files only, whatever is cooked.
+	VirtualFileSystem files;
+	std::vector<unsigned char> vertices, indices;
+	const int rounds = 10;
+	auto loadStart = std::chrono::steady_clock::now();
+
+	for (int r = 0; r < rounds; r++) {
+		MeshFile file;
+		if (!file.open(files, meshPath))
+			return 1;
+
+		const MeshFileHeader& header = file.getHeader();
+		const unsigned char* vertexData = (const unsigned char*)file.getVertexData();
+		const unsigned char* indexData = (const unsigned char*)file.getIndexData();
+		vertices.assign(vertexData, vertexData + header.vertexBytes);
+		indices.assign(indexData, indexData + header.indexBytes);
+	}
+
+	double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count() / rounds;
+	std::cout << "  .mesh map+copy  " << meshBytes / 1e6 << " MB in " << loadSeconds * 1000.0 << " ms, " << meshBytes / 1e6 / loadSeconds << " MB/s" << std::endl;
+
+	// Each vertex layout raw and compressed. The compressed ones have to decode to the same
+	// bytes as the raw one.
+	struct Encoding {
+		const char* name;
+		VertexLayout layout;
+		std::string rawPath;
+		std::string codecPath;
+	};
+	Encoding encodings[] = {
+		{ "float", VertexLayout::floats(attributes), meshPath, (directory / "float-codec.mesh").string() },
+		{ "quantized", VertexLayout::quantized(attributes), (directory / "quantized-raw.mesh").string(), (directory / "quantized-codec.mesh").string() },
+	};
+
+	PixelOps::SimdLevel best = PixelOps::detectSimdLevel();
+	bool matched = true;
+
+	for (const Encoding& encoding : encodings) {
+		if ((encoding.rawPath != meshPath && !MeshFile::write(encoding.rawPath, mesh, attributes, encoding.layout))
+			|| !MeshFile::write(encoding.codecPath, mesh, attributes, encoding.layout, {}, {}, {}, MESH_ENCODING_CODEC)) {
+			std::cout << "ERROR::MESH_BENCH::FILE_NOT_SUCCESFULLY_WRITTEN " << encoding.codecPath << std::endl;
+			return 1;
+		}
+
+		MeshFile raw, codec;
+		if (!raw.open(files, encoding.rawPath) || !codec.open(files, encoding.codecPath))
+			return 1;
+
+		const MeshFileHeader& rawHeader = raw.getHeader();
+		const MeshFileHeader& codecHeader = codec.getHeader();
+		std::cout << "  " << encoding.name << ": " << rawHeader.vertexStride << " bytes per vertex, vertices " << rawHeader.vertexBytes / 1e6 << " -> "
+			<< codecHeader.vertexBytes / 1e6 << " MB (" << (double)rawHeader.vertexBytes / codecHeader.vertexBytes << "x), indices "
+			<< rawHeader.indexBytes / 1e6 << " -> " << codecHeader.indexBytes / 1e6 << " MB (" << (double)rawHeader.indexBytes / codecHeader.indexBytes
+			<< "x, " << codecHeader.indexBytes * 8.0 / (codecHeader.indexCount / 3) << " bits per triangle)" << std::endl;
+
+		// Throughput is of the decoded bytes, the ones that end up in the GL buffers.
+		vertices.resize(rawHeader.vertexBytes);
+		indices.resize(rawHeader.indexBytes);
+		for (int level = 0; level <= (int)best; level++) {
+			PixelOps::setSimdLevel((PixelOps::SimdLevel)level);
+
+			auto vertexStart = std::chrono::steady_clock::now();
+			bool decoded = true;
+			for (int r = 0; r < rounds; r++) {
+				decoded = decoded && codec.decodeVertices(vertices.data());
+			}
+			double vertexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - vertexStart).count() / rounds;
+
+			auto indexStart = std::chrono::steady_clock::now();
+			for (int r = 0; r < rounds; r++) {
+				decoded = decoded && codec.decodeIndices(indices.data());
+			}
+			double indexSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - indexStart).count() / rounds;
+
+			std::cout << "    decode " << PixelOps::simdLevelName((PixelOps::SimdLevel)level) << ": vertices " << rawHeader.vertexBytes / 1e9 / vertexSeconds
+				<< " GB/s, indices " << rawHeader.indexBytes / 1e9 / indexSeconds << " GB/s";
+
+			if (!decoded || memcmp(vertices.data(), raw.getVertexData(), vertices.size()) != 0
+				|| !sameTriangles(indices.data(), raw.getIndexData(), rawHeader.indexCount, rawHeader.indexSize)) {
+				std::cout << " (MISMATCH)";
+				matched = false;
+			}
+
+			std::cout << std::endl;
+		}
+
+		PixelOps::setSimdLevel(best);
+	}
+
+	for (const Encoding& encoding : encodings) {
+		std::filesystem::remove(encoding.rawPath, error);
+		std::filesystem::remove(encoding.codecPath, error);
+	}
+	if (input == nullptr)
+		std::filesystem::remove(objPath, error);
+
+	return matched ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	// Offline conversion: program.exe --convert-mesh input.obj output.mesh [--float] [--raw]
+	// Vertices are quantized unless "--float" asks for full precision, and both buffers
+	// are compressed unless "--raw" asks for them as they are.
+	if (argc >= 4 && std::string(argv[1]) == "--convert-mesh") {
+		bool quantize = true, compress = true;
+		for (int i = 4; i < argc; i++) {
+			if (std::string(argv[i]) == "--float")
+				quantize = false;
+			else if (std::string(argv[i]) == "--raw")
+				compress = false;
+		}
+		bool converted = MeshFile::convertObj(argv[2], argv[3], quantize, compress);
+		std::cout << (converted ? "Converted " : "Failed to convert ") << argv[2] << std::endl;
+		return converted ? 0 : 1;
+	}
+
+	// Offline cooking: program.exe --cook [--force]
+	// Everything under Assets/ that changed since the last run goes to Cooked/, which is
+	// all the renderer below ever loads. build.bat runs this after compiling.
+	if (argc >= 2 && std::string(argv[1]) == "--cook") {
+		bool force = argc >= 3 && std::string(argv[2]) == "--force";
+		JobSystem jobs;
+		AssetCooker cooker(jobs);
+		return cooker.cook(force) ? 0 : 1;
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--pixel-bench")
+		return runPixelBench(argc >= 3 ? argv[2] : "Assets/Images/container.jpg");
+
+	if (argc >= 2 && std::string(argv[1]) == "--mesh-bench")
+		return runMeshBench(argc >= 3 ? argv[2] : nullptr);
+
+	if (argc >= 2 && std::string(argv[1]) == "--load-bench")
+		return runLoadBench(argc >= 3 ? std::max(1, atoi(argv[2])) : 500);
+
 	glfwInit();
     
 	shader = nullptr;
@@ -236,6 +714,7 @@ int main(void) {
     
 	// Make glad load OpenGL.
 	gladLoadGL();
+	GLExtensions::load((GLADloadproc)glfwGetProcAddress);
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	
@@ -247,116 +726,212 @@ int main(void) {
 	// so it needs to know the screen size beforehand.)
 	glViewport(0, 0, WIDTH, HEIGHT);
     
-	// The vertex array and vertex buffer objects.
-	GLuint VAO, VBO;
-    
-	// Always generate the VAO before the VBO (and EBO apparently).
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-    
-	glBindVertexArray(VAO);
-    
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-	// Vertices
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// Texture coordinates
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-   
-	// nrChannels -> Number of color channels
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load("Assets\\Images\\container.jpg", &width, &height, &nrChannels, 0);
-    
-	GLuint texture;
-	// Generate a texture
-	glGenTextures(1, &texture);
-    
-	// Bind the texture to the current context, meaning that every action
-	// from now on will be done for this texture.
-	// Another thing to note is that its only bound for GL_TEXTURE_2D: no
-	// other type of texture (GL_TEXTURE_1D or GL_TEXTURE_3D) will be modified 
-	// in the following actions.
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-    
-	// Specifying how OpenGL should deal with the image if it
-	// happens to be smaller than the rendered object.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-	// Generate the texture in OpenGL.
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    
-	// Generate its mipmap for long distance rendering.
-	glGenerateMipmap(GL_TEXTURE_2D);
-    
-	// Freeing the loaded image.
-	stbi_image_free(data);
-    
-    // Flip the image on load.
-    // NOTE(Ruan): Why do I need to flip the image before loading?
-    // It's a PNG image and it looks fine in Windows' image viewer.
-	// Maybe it's because it's a PNG and it should always be interpreted
-	// differently? Maybe... but I'm not entirely sure why.
-	//stbi_set_flip_vertically_on_load(true);
-    
-	// Loading the second image.
-	data = stbi_load("Assets\\Images\\awesomeface.png", &width, &height, &nrChannels, 0);
-    
-	// Now generate the second texture
-	GLuint texture2;
-	glGenTextures(1, &texture2);
-    
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-    
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-	// In this case, the image is the .png format instead of .jpg, meaning that it has a new
-	// channel (Alpha, for transparency). So the value for the number of channels should be
-	// RGBA instead of RGB.
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    
-	glGenerateMipmap(GL_TEXTURE_2D);
-    
-	// Freeing the loaded image
-	stbi_image_free(data);
-    
-	shader = new Shader("Assets\\Shaders\\shader.vs", "Assets\\Shaders\\shader.fs");
-	shader->use();
-    
-	// This call is kinda optional when dealing with a single texture.
-	// We can assign a location to get the texture and render it in
-	// the fragment shader. The currently loaded texture has a default position of 0,
-	// but not every graphics card manufacturer has this default "texture unit" set,
-	// so it's better to set it manually.
-	// OpenGL has at least 16 positions to set textures at a time (from GL_TEXTURE0 to GL_TEXTURE16).
-    
-    shader->setInt("texture1", 0);
-    shader->setInt("texture2", 1);
-    
-    // Another important detail to highlight is that while GL_TEXTURE0 expands to 0x0,
-    // GL_TEXTURE1 **DOES NOT** expand to 0x1. So when setting a value for a fragment shader to read,
-    // always pass in the actual integers that correspond to their unit values.
+	// Every asset below comes through the file system: out of the pack the cooker wrote
+	// (one file mapped once, entries found by the hash of their path), or from the loose
+	// files in Cooked/ when there's no pack. Release builds have the shaders compiled in
+	// (see EmbeddedFiles) and don't read those from disk at all.
+	auto assetsStart = std::chrono::steady_clock::now();
+	VirtualFileSystem files;
+	if (!files.mount("Cooked/assets.pack"))
+		std::cout << "No asset pack, loading loose files" << std::endl;
+
+	// Programs are started first and only picked up once everything else is loaded, so
+	// the driver compiles them (on its own threads with KHR_parallel_shader_compile)
+	// while the mesh and textures load. The manifest lists every variant the frame can ask
+	// for, anything else is built the first time it's used.
+	shaderVariants = new ShaderVariantCache(files);
+	auto prewarmStart = std::chrono::steady_clock::now();
+	size_t prewarmed = shaderVariants->prewarm("Cooked/Shaders/shader.variants");
+	double prewarmMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - prewarmStart).count();
+
+	// Loads are coroutines (see AssetLoader): reads go through AsyncIO (io_uring where
+	// there is one), checking and decoding through the job system, and uploads wait for
+	// the GL thread to pump them.
+	jobSystem = new JobSystem();
+	asyncIO = new AsyncIO();
+	std::cout << "Async I/O: " << asyncIO->getBackendName() << std::endl;
+	assetLoader = new AssetLoader(*jobSystem, *asyncIO, files);
+
+	// Textures are streamed: only their small mips are loaded up front, and the
+	// finer ones come in (and go out again) depending on how big the cubes are on screen.
+	// Finer levels are read with AsyncIO (io_uring where there is one) straight into
+	// pixel buffers, so many textures loading at once keep the disk busy.
+	textureStreamer = new TextureStreamer(*jobSystem, files, asyncIO, TEXTURE_BUDGET);
+
+	// Textures and meshes belong to the asset manager, which hands out handles to them
+	// instead of GL names. Loading the same file twice shares it, and whatever nobody
+	// holds any more is deleted once the memory is needed (and the GPU is done with it).
+	assets = new AssetManager(*textureStreamer, files, ASSET_CPU_BUDGET, ASSET_GPU_BUDGET);
+	samplers = new SamplerCache(SAMPLER_TIERS[samplerTier].quality);
+
+	// The cube comes from a .mesh file (cooked from Assets/Meshes/cube.obj). Its compressed blobs are decoded straight
+	// into the mapped buffers, so nothing is parsed first. Its vertices are
+	// quantized to 12 bytes instead of 20, the vertex shader scales them back.
+	MeshHandle cube = assetLoader->run(assets->loadMesh(*assetLoader, "Cooked/Meshes/cube.mesh", MESH_ATTRIBUTE_TEXCOORD));
+	if (!cube.isValid()) {
+		// No mesh file: fall back to the array above. It is a plain triangle list, 36 vertices
+		// where only a few are actually different, so weld them into an index buffer and
+		// let the optimizer sort it out.
+		MeshData cubeMesh = MeshOptimizer::weldVertices(vertices, 36, 5);
+		VertexCacheStats before = MeshOptimizer::analyzeVertexCache(cubeMesh.indices, cubeMesh.vertexCount());
+		MeshOptimizer::optimize(cubeMesh);
+		VertexCacheStats after = MeshOptimizer::analyzeVertexCache(cubeMesh.indices, cubeMesh.vertexCount());
+
+		std::cout << "Cube: 36 -> " << cubeMesh.vertexCount() << " vertices, ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+		// Buffers don't have a type, the index buffer only becomes one when a VAO draws
+		// from it.
+		MeshAsset fallback;
+		fallback.vertexBuffer = GLResources::createBuffer();
+		fallback.indexBuffer = GLResources::createBuffer();
+		GLResources::bufferStorage(fallback.vertexBuffer, cubeMesh.vertices.size() * sizeof(float), cubeMesh.vertices.data(), 0);
+		GLResources::bufferStorage(fallback.indexBuffer, cubeMesh.indices.size() * sizeof(unsigned int), cubeMesh.indices.data(), 0);
+
+		fallback.indexType = GL_UNSIGNED_INT;
+		fallback.layout = VertexLayout::floats(MESH_ATTRIBUTE_POSITION | MESH_ATTRIBUTE_TEXCOORD);
+		fallback.dequantization = VertexDequantization::identity();
+		Meshlets::build(cubeMesh, 0, cubeMesh.indices.size(), 0, fallback.meshlets);
+		fallback.lods = { { 0, (uint32_t)cubeMesh.indices.size(), 0.0f } };
+		cube = assets->addMesh("cube", std::move(fallback));
+	}
+
+	// Positions go to location 0 and texture coordinates to 1, in whatever format they're
+	// stored. No other mesh is loaded, so the reference stays good.
+	const MeshAsset& cubeAsset = *assets->getMesh(cube);
+	VertexArrayDesc cubeInput = VertexArrayDesc::fromLayout(cubeAsset.layout);
+	GLenum cubeIndexType = cubeAsset.indexType;
+	const VertexDequantization& cubeDequantization = cubeAsset.dequantization;
+	const std::vector<MeshLod>& cubeLods = cubeAsset.lods;
+
+	// Every cube is drawn meshlet by meshlet, skipping the ones off screen or facing away.
+	// A whole cube is a single meshlet, so for now this is per object culling, but bigger
+	// meshes lose whatever parts can't be seen.
+	MeshletCuller cubeCuller;
+	cubeCuller.load(cubeAsset.meshlets.data(), cubeAsset.meshlets.size(), cubeIndexType == GL_UNSIGNED_SHORT ? 2 : 4);
+	MeshletDraws cubeDraws;
+	MeshletCullStats meshletStats = {};
+
+	// Cubes far enough away for a coarser level of detail are drawn instanced instead, one
+	// draw per level, with their model matrices in 'instanceVBO'. The cube itself is too
+	// simple to have any (every collapse is a big visible dent), but a converted OBJ
+	// usually does.
+	// The matrices are a second binding read once per instance, next to the vertices.
+	GLuint instanceVBO = GLResources::createBuffer();
+	VertexArrayDesc instancedInput = cubeInput;
+	uint32_t instanceBinding = instancedInput.addBinding(sizeof(glm::mat4), 1);
+	for (GLuint c = 0; c < 4; c++) {
+		instancedInput.addAttribute(INSTANCE_MODEL_LOCATION + c, instanceBinding, VertexFormat::Float4, c * sizeof(glm::vec4));
+	}
+	VertexStream cubeStreams[2] = { { cubeAsset.vertexBuffer, 0 }, { instanceVBO, 0 } };
+	VertexArrayCache& vertexArrays = VertexArrayCache::current();
+
+	LodSelector lodSelector;
+	std::vector<int> cubeLevels(10, -1);
+	std::vector<glm::mat4> cubeModels(10);
+	std::vector<glm::mat4> instanceModels;
+	LodStats lodStats = {};
+	float lastStatsReport = 0.0f;
+
+	// The cooker flips images when it builds their mip chains (PixelOps::flipVertically
+	// instead of stbi_set_flip_vertically_on_load): files store the top row first, but
+	// OpenGL expects the first row it gets to be the bottom of the texture. It has nothing
+	// to do with the file being a PNG, the JPG was upside down too, it just doesn't show.
+	TextureHandle texture = assets->loadTexture("Cooked/Images/container.mips");
+	TextureHandle texture2 = assets->loadTexture("Cooked/Images/awesomeface.mips");
     
-    // Set the transparency uniform value so we can change it later.
-	shader->setFloat("transparency", transparency);
+	ShaderVariantStats variantStats = shaderVariants->getStats();
+	std::cout << "Shaders: " << prewarmed << " variants prewarmed (" << variantStats.programs << " programs, " << variantStats.links << " links"
+		<< (variantStats.stages > 0 ? " of separate stages" : "") << ", " << variantStats.fromSpirv << " from SPIR-V), "
+		<< variantStats.building << " still building when needed" << std::endl;
+	// Reading and preprocessing the sources and handing them to the driver, which is where
+	// having them in the executable shows.
+	std::cout << "Shader sources read and submitted in " << prewarmMilliseconds << " ms (from "
+		<< (EmbeddedFiles::count() > 0 ? "the executable, " + std::to_string(EmbeddedFiles::count()) + " files embedded" : files.mountedPacks() > 0 ? "the pack" : "loose files")
+		<< ")" << std::endl;
+
+	// Mesh and shaders are in, the textures' small mips are on their way.
+	std::cout << "Assets loaded in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - assetsStart).count()
+		<< " ms (" << (files.mountedPacks() > 0 ? "pack" : "loose files") << ")" << std::endl;
+
+	// Everything the shader needs that doesn't change every frame. The Shader keeps them,
+	// a reloaded one sends them to its new program by itself.
+	auto setupShader = [&cubeDequantization](Shader& shader) {
+		shader.use();
+
+		// This call is kinda optional when dealing with a single texture.
+		// We can assign a location to get the texture and render it in
+		// the fragment shader. The currently loaded texture has a default position of 0,
+		// but not every graphics card manufacturer has this default "texture unit" set,
+		// so it's better to set it manually.
+		// OpenGL has at least 16 positions to set textures at a time (from GL_TEXTURE0 to GL_TEXTURE16).
+		shader.setInt("texture1", 0);
+		shader.setInt("texture2", 1);
+
+		// Another important detail to highlight is that while GL_TEXTURE0 expands to 0x0,
+		// GL_TEXTURE1 **DOES NOT** expand to 0x1. So when setting a value for a fragment shader to read,
+		// always pass in the actual integers that correspond to their unit values.
+
+		// Set the transparency uniform value so we can change it later.
+		shader.setFloat("transparency", currentTransparency);
+
+		// Undoes the quantization of the cube's vertices.
+		shader.setVec3f("positionOffset", cubeDequantization.positionOffset[0], cubeDequantization.positionOffset[1], cubeDequantization.positionOffset[2]);
+		shader.setVec3f("positionScale", cubeDequantization.positionScale[0], cubeDequantization.positionScale[1], cubeDequantization.positionScale[2]);
+		shader.setVec2f("texcoordOffset", cubeDequantization.texcoordOffset[0], cubeDequantization.texcoordOffset[1]);
+		shader.setVec2f("texcoordScale", cubeDequantization.texcoordScale[0], cubeDequantization.texcoordScale[1]);
+	};
+
+	// Saving anything under Assets/ cooks it again in the background, and the shader or
+	// texture it belongs to is swapped in a few frames later.
+	hotReloader = new HotReloader(*jobSystem, *assetLoader, files, *assets);
+	std::cout << "Hot reload: watching Assets/ (" << hotReloader->getBackendName() << ")" << std::endl;
+
+	shaderVariants->setOnCreate([&setupShader](Shader& variant) {
+		setupShader(variant);
+		hotReloader->addShader(variant);
+	});
+
+	// The fragment shader only samples the second texture when it's blended in at all. The
+	// variant is picked every frame, and the view and projection go to whichever it is.
+	const std::vector<std::string> singleTexture = {};
+	const std::vector<std::string> blendTextures = { "BLEND_TEXTURES" };
+	const std::vector<std::string> branchingShader = { "RUNTIME_BRANCHES" };
+	specializedTimer = new GpuTimer();
+	branchingTimer = new GpuTimer();
+	shader = shaderVariants->get("Cooked/Shaders/shader.vs", "Cooked/Shaders/shader.fs", singleTexture);
+
+	// Building from SPIR-V skips the driver's GLSL front end. Compare this with and
+	// without a .spirv cooked (it's empty without glslangValidator on the PATH).
+	variantStats = shaderVariants->getStats();
+	std::cout << "Shader builds: " << variantStats.milliseconds << " ms on the GL thread so far, " << variantStats.fromSpirv << " of "
+		<< variantStats.links << " links from SPIR-V" << std::endl;
 
 	model = glm::rotate(model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-	shader->setMatrix4fv("model", model);
-	shader->setMatrix4fv("view", view);
-	shader->setMatrix4fv("projection", projection);
+	// Every pipeline state the loop draws with: a shader variant, solid or wireframe, and
+	// one cube at a time or instanced. The rest is the defaults, depth tested and opaque
+	// (the textures are mixed in the shader, not blended). The optimizer made every
+	// triangle wind counter clockwise seen from outside (MeshFile::convertObj when the
+	// cube was cooked, MeshOptimizer::optimize for the fallback), so the back half of each
+	// cube is culled. Each is made the first time it's drawn with, as getting a variant waits for
+	// its program: making them all here would wait for every prewarmed build right away.
+	PipelineStateCache pipelines;
+	const std::vector<std::string>* variantKeywords[] = { &singleTexture, &blendTextures, &branchingShader };
+	const PipelineState* cubePipelines[3][2][2] = {};
 
-	glEnable(GL_DEPTH_TEST);
+	auto cubePipelineFor = [&](int variant, int wireframe, int instanced) -> const PipelineState& {
+		const PipelineState*& state = cubePipelines[variant][wireframe][instanced];
+		if (state == nullptr) {
+			PipelineStateDesc desc;
+			desc.shader = shaderVariants->get("Cooked/Shaders/shader.vs", "Cooked/Shaders/shader.fs", *variantKeywords[variant]);
+			desc.vertexInput = instanced ? instancedInput : cubeInput;
+			desc.raster.polygonMode = wireframe ? GL_LINE : GL_FILL;
+			state = &pipelines.create(desc);
+		}
+
+		return *state;
+	};
 
 	// MAIN LOOP
 	// While loop so the window does not close.
@@ -371,13 +946,52 @@ int main(void) {
         glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-		
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
-       
-        glBindVertexArray(VAO);
+		// Both textures are on every cube, so each cube asks for the detail it needs.
+		for (unsigned i = 0; i < 10; i++) {
+			float pixels = TextureStreamer::projectedDiameter(cubePositions[i], CUBE_RADIUS, view, glm::radians(fov), HEIGHT);
+			assets->requestScreenSize(texture, pixels);
+			assets->requestScreenSize(texture2, pixels);
+		}
+
+		textureStreamer->update();
+		hotReloader->update();
+		assetLoader->pump();
+		assets->update();
+
+		// Only the state that differs from the last draw goes to GL, which is nothing at all
+		// unless the variant or the wireframe toggle changed.
+		int variant = runtimeBranches ? 2 : currentTransparency != 0.0f ? 1 : 0;
+		const PipelineState& cubePipeline = cubePipelineFor(variant, wireframeToggle, 0);
+		const PipelineState& instancedPipeline = cubePipelineFor(variant, wireframeToggle, 1);
+		pipelines.bind(cubePipeline);
+		shader = cubePipeline.getDesc().shader;
+		// Only what changed since the last frame is sent, which is usually the view at most.
+		shader->setMatrix4fv("view", view);
+		shader->setMatrix4fv("projection", projection);
+		shader->setFloat("transparency", currentTransparency);
+		shader->setBool("blendTextures", currentTransparency != 0.0f);
+		shader->flush();
+
+		GpuTimer& frameTimer = runtimeBranches ? *branchingTimer : *specializedTimer;
+		frameTimer.begin();
+
+		// All of it is bound already from the last frame, so the cache sends none of it.
+		StateCache& state = StateCache::current();
+		state.bindTexture(0, assets->getTexture(texture));
+		state.bindTexture(1, assets->getTexture(texture2));
+		pipelines.bindVertexBuffers(cubeStreams, cubeAsset.indexBuffer);
+
+		// Same sampler unless a texture is fading in a new level, then one per step of the
+		// fade (there are only a handful, see TextureStreamer::getMinLod).
+		SamplerDesc sampler;
+		sampler.maxAnisotropy = 16.0f;
+		sampler.minLod = assets->getTextureMinLod(texture);
+		samplers->bind(0, sampler);
+		sampler.minLod = assets->getTextureMinLod(texture2);
+		samplers->bind(1, sampler);
+
+		lodSelector.setView(glm::radians(fov), HEIGHT);
+		size_t levelInstances[MESH_MAX_LODS] = {};
 
 		for (unsigned i = 0; i < 10; i++) {
 			glm::mat4 model = glm::mat4(1.0f);
@@ -388,17 +1002,113 @@ int main(void) {
 				model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
 			}
 
-			shader->setMatrix4fv("model", model);
+			float distance = glm::length(cubePositions[i] - cameraPos) - CUBE_RADIUS;
+			int level = lodSelector.select(cubeLods.data(), cubeLods.size(), distance, cubeLevels[i]);
+			cubeLevels[i] = level;
+			cubeModels[i] = model;
+			levelInstances[level]++;
+			lodStats.fullDetailTriangles += cubeLods[0].indexCount / 3;
+
+			if (level != 0)
+				continue;
+
+			// Full detail: one cube at a time, with only the meshlets that can be seen.
+			for (GLuint c = 0; c < 4; c++) {
+				glVertexAttrib4fv(INSTANCE_MODEL_LOCATION + c, &model[c][0]);
+			}
+
+			// Culling happens in the cube's own space, where the meshlet bounds are.
+			glm::vec3 cameraInModel = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+			cubeCuller.cull(projection * view * model, cameraInModel, cubeDraws, meshletStats);
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			if (!cubeDraws.counts.empty())
+				glMultiDrawElements(GL_TRIANGLES, cubeDraws.counts.data(), cubeIndexType, cubeDraws.offsets.data(), (GLsizei)cubeDraws.counts.size());
+
+			for (int count : cubeDraws.counts) {
+				lodStats.triangles += count / 3;
+			}
+		}
+
+		// Everything coarser, grouped by level.
+		instanceModels.clear();
+		for (size_t level = 1; level < cubeLods.size(); level++) {
+			for (unsigned i = 0; i < 10; i++) {
+				if (cubeLevels[i] == (int)level)
+					instanceModels.push_back(cubeModels[i]);
+			}
+		}
+
+		if (!instanceModels.empty()) {
+			// Same shader and fixed function state, only the vertex input is different.
+			pipelines.bind(instancedPipeline);
+			GLResources::bufferData(instanceVBO, instanceModels.size() * sizeof(glm::mat4), instanceModels.data(), GL_STREAM_DRAW);
+
+			size_t firstInstance = 0;
+			for (size_t level = 1; level < cubeLods.size(); level++) {
+				if (levelInstances[level] == 0)
+					continue;
+
+				// GL 3.3 has no base instance, so the binding moves to the group instead. Only
+				// its offset changes, the VAO stays the same.
+				cubeStreams[instanceBinding].offset = (GLintptr)(firstInstance * sizeof(glm::mat4));
+				pipelines.bindVertexBuffers(cubeStreams, cubeAsset.indexBuffer);
+
+				const MeshLod& lod = cubeLods[level];
+				size_t indexSize = cubeIndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+				glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)lod.indexCount, cubeIndexType, (void*)((size_t)lod.firstIndex * indexSize), (GLsizei)levelInstances[level]);
+
+				firstInstance += levelInstances[level];
+				lodStats.instancedDraws++;
+				lodStats.triangles += lod.indexCount / 3 * levelInstances[level];
+			}
+		}
+
+		frameTimer.end();
+
+		for (size_t level = 0; level < cubeLods.size(); level++) {
+			lodStats.instances[level] += levelInstances[level];
+		}
+
+		meshletStats.frames++;
+		lodStats.frames++;
+		if (currentFrame - lastStatsReport > 5.0f) {
+			Meshlets::printStats(meshletStats);
+			LodSelector::printStats(lodStats);
+			AssetManager::printStats(assets->getStats());
+			std::cout << "Cube pass GPU time: specialized " << specializedTimer->getAverageMilliseconds() << " ms (" << specializedTimer->getSampleCount()
+				<< " frames), runtime branches " << branchingTimer->getAverageMilliseconds() << " ms (" << branchingTimer->getSampleCount() << " frames)" << std::endl;
+			// Every variant built so far, including the ones first drawn with after startup. Run
+			// it with and without a cooked .spirv to compare the two.
+			ShaderVariantStats shaderStats = shaderVariants->getStats();
+			std::cout << "Shader builds: " << shaderStats.programs << " programs in " << shaderStats.milliseconds << " ms on the GL thread, "
+				<< shaderStats.fromSpirv << " of " << shaderStats.links << " links from SPIR-V" << std::endl;
+			ShaderUniformStats uniformStats = Shader::getUniformStats();
+			std::cout << "Uniforms: " << uniformStats.sets << " set, " << uniformStats.skipped << " skipped as unchanged, "
+				<< uniformStats.uploads << " uploads" << std::endl;
+			StateCacheStats stateStats = StateCache::current().getStats();
+			std::cout << "Bindings: " << stateStats.binds << " sent to GL, " << stateStats.skipped << " skipped as already bound" << std::endl;
+			std::cout << "Sampler objects: " << samplers->size() << " (" << SAMPLER_TIERS[samplerTier].name << " filtering)" << std::endl;
+			PipelineStateStats pipelineStats = pipelines.getStats();
+			std::cout << "Pipeline states: " << pipelines.size() << ", " << pipelineStats.binds << " binds (" << pipelineStats.skipped
+				<< " already bound), " << pipelineStats.stateChanges << " state changes sent to GL" << std::endl;
+			VertexArrayCacheStats vertexArrayStats = vertexArrays.getStats();
+			std::cout << "Vertex arrays: " << vertexArrays.size() << " (" << vertexArrayStats.created << " made), " << vertexArrayStats.switches
+				<< " switches, " << vertexArrayStats.bufferChanges << " buffer changes, " << vertexArrayStats.skipped << " binds already in place" << std::endl;
+			specializedTimer->reset();
+			branchingTimer->reset();
+			Shader::resetUniformStats();
+			StateCache::current().resetStats();
+			vertexArrays.resetStats();
+			pipelines.resetStats();
+			meshletStats = {};
+			lodStats = {};
+			lastStatsReport = currentFrame;
 		}
 
 		// Since the camera is moving, we have to always update the view matrix
-		// in the fragment shader.
+		// (it goes to the shader at the start of the next frame).
 		view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-		shader->setMatrix4fv("view", view);
 		projection = glm::perspective(glm::radians(fov), (float)WIDTH / (float)HEIGHT, 0.1f, 1000.0f);
-		shader->setMatrix4fv("projection", projection);
         
 		// This call swaps the back and front buffers, so it needs to be here.
         glfwSwapBuffers(window);
@@ -407,7 +1117,22 @@ int main(void) {
         glfwPollEvents();
 	}
     
-	glDeleteVertexArrays(1, &VAO);
+	GLResources::deleteBuffers(1, &instanceVBO);
+
+	delete hotReloader;
+	assets->release(cube);
+	assets->release(texture);
+	assets->release(texture2);
+	delete samplers;
+	delete specializedTimer;
+	delete branchingTimer;
+	delete shaderVariants;
+	delete assets;
+	vertexArrays.clear();
+	delete textureStreamer;
+	delete assetLoader;
+	delete asyncIO;
+	delete jobSystem;
     
 	// Destroy the window when the program is about to exit.
 	glfwDestroyWindow(window);
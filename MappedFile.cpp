@@ -0,0 +1,122 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: bytes(nullptr), length(0),
+#if defined(_WIN32)
+	fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+#else
+	descriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#if defined(_WIN32)
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr) {
+		close();
+		return false;
+	}
+
+	bytes = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	length = (size_t)fileSize.QuadPart;
+#else
+	descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+
+	bytes = (const unsigned char*)mapping;
+	length = (size_t)info.st_size;
+#endif
+
+	if (bytes == nullptr) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+	if (bytes != nullptr)
+		UnmapViewOfFile(bytes);
+
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (bytes != nullptr)
+		munmap((void*)bytes, length);
+
+	if (descriptor >= 0)
+		::close(descriptor);
+
+	descriptor = -1;
+#endif
+
+	bytes = nullptr;
+	length = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return bytes != nullptr;
+}
+
+const unsigned char* MappedFile::data() const
+{
+	return bytes;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
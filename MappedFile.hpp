@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// A read only file mapped into memory (mmap on Linux, a file mapping on Windows).
+// The OS pages it in on demand, so "loading" costs nothing until the bytes are used,
+// and they can be handed straight to GL without copying them anywhere first.
+class MappedFile {
+    private:
+	const unsigned char* bytes;
+	size_t length;
+#if defined(_WIN32)
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int descriptor;
+#endif
+    public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const;
+	const unsigned char* data() const;
+	size_t size() const;
+};
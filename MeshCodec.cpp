@@ -0,0 +1,610 @@
+#include "MeshCodec.hpp"
+#include "PixelOps.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MESHCODEC_X86 1
+#include <emmintrin.h>
+#else
+#define MESHCODEC_X86 0
+#endif
+
+namespace MeshCodec {
+
+// First byte of a stream, the low bits are the format version.
+constexpr unsigned char VERTEX_STREAM_TAG = 0xA0 | 1;
+constexpr unsigned char INDEX_STREAM_TAG = 0xB0 | 1;
+
+constexpr size_t GROUP_SIZE = 16;
+constexpr size_t BLOCK_MAX_VERTICES = 256;
+// A block's byte planes are decoded into a scratch buffer before being interleaved, so
+// it's kept small enough to stay in L1.
+constexpr size_t BLOCK_MAX_BYTES = 8192;
+
+static size_t blockVertices(size_t vertexSize)
+{
+	return std::min((BLOCK_MAX_BYTES / vertexSize) & ~(GROUP_SIZE - 1), BLOCK_MAX_VERTICES);
+}
+
+// Bytes the packed data of a group takes, by its 2 bit header code (0, 2, 4 or 8 bits per value).
+static const size_t GROUP_BYTES[4] = { 0, 4, 8, 16 };
+
+static unsigned char zigzag8(unsigned char value)
+{
+	return (unsigned char)((value << 1) ^ (unsigned char)((signed char)value >> 7));
+}
+
+static uint32_t zigzag32(uint32_t value)
+{
+	return (value << 1) ^ (uint32_t)((int32_t)value >> 31);
+}
+
+static uint32_t unzigzag32(uint32_t value)
+{
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+// ---- Encoding ---------------------------------------------------------------------
+
+// A plane is a 2 bit code per group (four to a byte), then the packed groups. Values are
+// packed so that the decoder only needs uniform shifts: with 2 bits, value j is in byte
+// j % 4 at bit 2 * (j / 4), with 4 bits it's in byte j % 8 at bit 4 * (j / 8).
+static void encodePlane(const unsigned char* values, size_t count, std::vector<unsigned char>& out)
+{
+	size_t groupCount = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+	size_t headerStart = out.size();
+	out.resize(out.size() + (groupCount + 3) / 4, 0);
+
+	for (size_t g = 0; g < groupCount; g++) {
+		unsigned char group[GROUP_SIZE] = {};
+		size_t valueCount = std::min(GROUP_SIZE, count - g * GROUP_SIZE);
+		memcpy(group, values + g * GROUP_SIZE, valueCount);
+
+		unsigned char bits = 0;
+		for (size_t j = 0; j < GROUP_SIZE; j++) {
+			bits |= group[j];
+		}
+
+		int code = bits == 0 ? 0 : bits < 4 ? 1 : bits < 16 ? 2 : 3;
+		out[headerStart + g / 4] |= (unsigned char)(code << ((g % 4) * 2));
+
+		unsigned char packed[GROUP_SIZE] = {};
+		for (size_t j = 0; j < GROUP_SIZE; j++) {
+			if (code == 1)
+				packed[j % 4] |= (unsigned char)(group[j] << (2 * (j / 4)));
+			else if (code == 2)
+				packed[j % 8] |= (unsigned char)(group[j] << (4 * (j / 8)));
+			else
+				packed[j] = group[j];
+		}
+
+		out.insert(out.end(), packed, packed + GROUP_BYTES[code]);
+	}
+}
+
+
+std::vector<unsigned char> encodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	if (vertexSize == 0 || vertexSize % 4 != 0 || vertexSize > 256) {
+		std::cout << "ERROR::MESH_CODEC::UNSUPPORTED_VERTEX_SIZE " << vertexSize << std::endl;
+		return {};
+	}
+
+	const unsigned char* data = (const unsigned char*)vertices;
+	size_t blockSize = blockVertices(vertexSize);
+	std::vector<unsigned char> previous(vertexSize, 0);
+	unsigned char plane[BLOCK_MAX_VERTICES];
+
+	std::vector<unsigned char> out;
+	out.reserve(vertexCount * vertexSize / 2 + 16);
+	out.push_back(VERTEX_STREAM_TAG);
+
+	// Byte k of every vertex in the block, as the zigzagged difference to the vertex before.
+	for (size_t first = 0; first < vertexCount; first += blockSize) {
+		size_t blockCount = std::min(blockSize, vertexCount - first);
+
+		for (size_t k = 0; k < vertexSize; k++) {
+			for (size_t i = 0; i < blockCount; i++) {
+				unsigned char value = data[(first + i) * vertexSize + k];
+				plane[i] = zigzag8((unsigned char)(value - previous[k]));
+				previous[k] = value;
+			}
+
+			encodePlane(plane, blockCount, out);
+		}
+	}
+
+	return out;
+}
+
+// Triangles are coded against two small FIFOs of what was seen recently: edges and
+// vertices. In an optimized mesh almost every triangle shares an edge with one of the
+// last few triangles, and its third vertex is either the next one never used before
+// (vertices are in fetch order) or one of the last few new ones. Then the whole
+// triangle is a single code byte: the edge slot in the high nibble and the third
+// vertex in the low one (0 = next, 1-14 = vertex slot, 15 = explicit). Triangles without
+// a known edge get code 0xF? with one nibble code per vertex, and explicit vertices are
+// varints of the zigzagged difference to the previous explicit one. Triangles may be
+// rotated to put the shared edge first, which keeps their winding.
+struct TriangleFifos {
+	uint32_t edges[16][2];
+	uint32_t vertices[16];
+	size_t edgeOffset = 0;
+	size_t vertexOffset = 0;
+	uint32_t next = 0;
+	uint32_t last = 0;
+
+	TriangleFifos()
+	{
+		memset(edges, 0xFF, sizeof(edges));
+		memset(vertices, 0xFF, sizeof(vertices));
+	}
+
+	void pushEdge(uint32_t a, uint32_t b)
+	{
+		edges[edgeOffset & 15][0] = a;
+		edges[edgeOffset & 15][1] = b;
+		edgeOffset++;
+	}
+
+	void pushVertex(uint32_t v)
+	{
+		vertices[vertexOffset & 15] = v;
+		vertexOffset++;
+	}
+
+	// Slot i is the i-th most recent entry.
+	const uint32_t* edge(size_t slot) const
+	{
+		return edges[(edgeOffset - 1 - slot) & 15];
+	}
+
+	uint32_t vertex(size_t slot) const
+	{
+		return vertices[(vertexOffset - 1 - slot) & 15];
+	}
+};
+
+constexpr int EDGE_SLOTS = 15;
+constexpr int VERTEX_SLOTS = 14;
+constexpr int VERTEX_NEXT = 0;
+constexpr int VERTEX_EXPLICIT = 15;
+
+static void writeVarint(uint32_t value, std::vector<unsigned char>& out)
+{
+	while (value >= 0x80) {
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back((unsigned char)value);
+}
+
+// Nibble code of a vertex; updates the FIFOs the same way the decoder will.
+static int encodeVertex(uint32_t v, TriangleFifos& fifos, std::vector<unsigned char>& data)
+{
+	if (v == fifos.next) {
+		fifos.next++;
+		fifos.pushVertex(v);
+		return VERTEX_NEXT;
+	}
+
+	for (int slot = 0; slot < VERTEX_SLOTS; slot++) {
+		if (fifos.vertex(slot) == v)
+			return slot + 1;
+	}
+
+	writeVarint(zigzag32(v - fifos.last), data);
+	fifos.last = v;
+	fifos.pushVertex(v);
+	return VERTEX_EXPLICIT;
+}
+
+std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices, size_t indexCount)
+{
+	if (indexCount % 3 != 0) {
+		std::cout << "ERROR::MESH_CODEC::NOT_A_TRIANGLE_LIST " << indexCount << std::endl;
+		return {};
+	}
+
+	size_t triangleCount = indexCount / 3;
+	std::vector<unsigned char> codes(triangleCount);
+	std::vector<unsigned char> data;
+	TriangleFifos fifos;
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		uint32_t triangle[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+
+		int edgeSlot = -1, rotation = 0;
+		for (int slot = 0; slot < EDGE_SLOTS && edgeSlot < 0; slot++) {
+			const uint32_t* edge = fifos.edge(slot);
+
+			for (int r = 0; r < 3; r++) {
+				if (edge[0] == triangle[r] && edge[1] == triangle[(r + 1) % 3]) {
+					edgeSlot = slot;
+					rotation = r;
+					break;
+				}
+			}
+		}
+
+		uint32_t a = triangle[rotation], b = triangle[(rotation + 1) % 3], c = triangle[(rotation + 2) % 3];
+
+		if (edgeSlot >= 0) {
+			codes[t] = (unsigned char)((edgeSlot << 4) | encodeVertex(c, fifos, data));
+			fifos.pushEdge(c, b);
+			fifos.pushEdge(a, c);
+		}
+		else {
+			int codeA = encodeVertex(a, fifos, data);
+			// The second code byte goes with the rest of the data.
+			data.push_back(0);
+			size_t second = data.size() - 1;
+			int codeB = encodeVertex(b, fifos, data);
+			int codeC = encodeVertex(c, fifos, data);
+
+			codes[t] = (unsigned char)(0xF0 | codeA);
+			data[second] = (unsigned char)((codeB << 4) | codeC);
+
+			fifos.pushEdge(b, a);
+			fifos.pushEdge(c, b);
+			fifos.pushEdge(a, c);
+		}
+	}
+
+	std::vector<unsigned char> out;
+	out.reserve(1 + codes.size() + data.size());
+	out.push_back(INDEX_STREAM_TAG);
+	out.insert(out.end(), codes.begin(), codes.end());
+	out.insert(out.end(), data.begin(), data.end());
+	return out;
+}
+
+// ---- Decoding ---------------------------------------------------------------------
+
+// Unpacks one plane into 'plane' (rounded up to whole groups). Returns where the next
+// plane starts, or nullptr if the data runs out.
+static const unsigned char* decodePlaneScalar(const unsigned char* data, const unsigned char* end, unsigned char* plane, size_t count)
+{
+	size_t groupCount = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+	size_t headerBytes = (groupCount + 3) / 4;
+
+	if ((size_t)(end - data) < headerBytes)
+		return nullptr;
+
+	const unsigned char* header = data;
+	data += headerBytes;
+
+	for (size_t g = 0; g < groupCount; g++) {
+		int code = (header[g / 4] >> ((g % 4) * 2)) & 3;
+
+		if ((size_t)(end - data) < GROUP_BYTES[code])
+			return nullptr;
+
+		unsigned char* group = plane + g * GROUP_SIZE;
+
+		for (size_t j = 0; j < GROUP_SIZE; j++) {
+			if (code == 0)
+				group[j] = 0;
+			else if (code == 1)
+				group[j] = (data[j % 4] >> (2 * (j / 4))) & 3;
+			else if (code == 2)
+				group[j] = (data[j % 8] >> (4 * (j / 8))) & 15;
+			else
+				group[j] = data[j];
+		}
+
+		data += GROUP_BYTES[code];
+	}
+
+	return data;
+}
+
+static void undeltaScalar(unsigned char* plane, size_t count, unsigned char& previous)
+{
+	unsigned char value = previous;
+
+	for (size_t i = 0; i < count; i++) {
+		unsigned char zigzag = plane[i];
+		value += (unsigned char)((zigzag >> 1) ^ (0u - (zigzag & 1)));
+		plane[i] = value;
+	}
+
+	previous = value;
+}
+
+// Interleaves byte planes ('stride' bytes apart) back into vertices.
+static void interleaveScalar(const unsigned char* planes, size_t stride, size_t count, size_t vertexSize, unsigned char* out)
+{
+	for (size_t i = 0; i < count; i++) {
+		for (size_t k = 0; k < vertexSize; k++) {
+			out[i * vertexSize + k] = planes[k * stride + i];
+		}
+	}
+}
+
+#if MESHCODEC_X86
+static inline __m128i unpackGroupSSE(const unsigned char* data, int code)
+{
+	const __m128i mask2 = _mm_set1_epi8(3);
+	const __m128i mask4 = _mm_set1_epi8(15);
+
+	// The 16-bit shifts drag bits over from the neighbouring byte, but only into bits
+	// the mask throws away.
+	switch (code) {
+	case 0:
+		return _mm_setzero_si128();
+	case 1: {
+		int32_t word;
+		memcpy(&word, data, sizeof(word));
+		__m128i packed = _mm_cvtsi32_si128(word);
+		__m128i low = _mm_unpacklo_epi32(packed, _mm_srli_epi16(packed, 2));
+		__m128i high = _mm_unpacklo_epi32(_mm_srli_epi16(packed, 4), _mm_srli_epi16(packed, 6));
+		return _mm_and_si128(_mm_unpacklo_epi64(low, high), mask2);
+	}
+	case 2: {
+		__m128i packed = _mm_loadl_epi64((const __m128i*)data);
+		return _mm_and_si128(_mm_unpacklo_epi64(packed, _mm_srli_epi16(packed, 4)), mask4);
+	}
+	default:
+		return _mm_loadu_si128((const __m128i*)data);
+	}
+}
+
+// Same as the scalar version, with the delta decoding done on the fly.
+static const unsigned char* decodePlaneSSE(const unsigned char* data, const unsigned char* end, unsigned char* plane, size_t count, unsigned char& previous)
+{
+	size_t groupCount = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+	size_t headerBytes = (groupCount + 3) / 4;
+
+	if ((size_t)(end - data) < headerBytes)
+		return nullptr;
+
+	const unsigned char* header = data;
+	data += headerBytes;
+
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i low7 = _mm_set1_epi8(0x7F);
+	__m128i carry = _mm_set1_epi8((char)previous);
+
+	for (size_t g = 0; g < groupCount; g++) {
+		int code = (header[g / 4] >> ((g % 4) * 2)) & 3;
+
+		if ((size_t)(end - data) < GROUP_BYTES[code])
+			return nullptr;
+
+		__m128i values = unpackGroupSSE(data, code);
+		data += GROUP_BYTES[code];
+
+		values = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(values, 1), low7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(values, one)));
+
+		// Prefix sum over the 16 bytes, then add what came before.
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 1));
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 2));
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 4));
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 8));
+		values = _mm_add_epi8(values, carry);
+
+		// Broadcast the last byte for the next group.
+		__m128i high = _mm_unpackhi_epi8(values, values);
+		carry = _mm_shuffle_epi32(_mm_unpackhi_epi16(high, high), _MM_SHUFFLE(3, 3, 3, 3));
+
+		_mm_storeu_si128((__m128i*)(plane + g * GROUP_SIZE), values);
+	}
+
+	previous = plane[count - 1];
+	return data;
+}
+
+static inline void storePiece(unsigned char* destination, __m128i piece)
+{
+	int32_t value = _mm_cvtsi128_si32(piece);
+	memcpy(destination, &value, sizeof(value));
+}
+
+// Four planes at a time: byte unpacks turn 16 bytes of each plane into 16 4-byte pieces
+// of consecutive vertices.
+static void interleaveSSE(const unsigned char* planes, size_t stride, size_t count, size_t vertexSize, unsigned char* out)
+{
+	for (size_t k = 0; k < vertexSize; k += 4) {
+		const unsigned char* plane = planes + k * stride;
+
+		for (size_t i = 0; i < count; i += GROUP_SIZE) {
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(plane + i));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(plane + stride + i));
+			__m128i p2 = _mm_loadu_si128((const __m128i*)(plane + stride * 2 + i));
+			__m128i p3 = _mm_loadu_si128((const __m128i*)(plane + stride * 3 + i));
+
+			__m128i p01Low = _mm_unpacklo_epi8(p0, p1), p01High = _mm_unpackhi_epi8(p0, p1);
+			__m128i p23Low = _mm_unpacklo_epi8(p2, p3), p23High = _mm_unpackhi_epi8(p2, p3);
+			__m128i pieces[4] = {
+				_mm_unpacklo_epi16(p01Low, p23Low), _mm_unpackhi_epi16(p01Low, p23Low),
+				_mm_unpacklo_epi16(p01High, p23High), _mm_unpackhi_epi16(p01High, p23High)
+			};
+
+			unsigned char* destination = out + i * vertexSize + k;
+
+			if (count - i >= GROUP_SIZE) {
+				for (int q = 0; q < 4; q++) {
+					unsigned char* row = destination + q * 4 * vertexSize;
+					storePiece(row, pieces[q]);
+					storePiece(row + vertexSize, _mm_shuffle_epi32(pieces[q], 1));
+					storePiece(row + vertexSize * 2, _mm_shuffle_epi32(pieces[q], 2));
+					storePiece(row + vertexSize * 3, _mm_shuffle_epi32(pieces[q], 3));
+				}
+				continue;
+			}
+
+			for (size_t j = 0; j < count - i; j++) {
+				storePiece(destination + j * vertexSize, pieces[j / 4]);
+				pieces[j / 4] = _mm_srli_si128(pieces[j / 4], 4);
+			}
+		}
+	}
+}
+#endif
+
+bool decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const unsigned char* buffer, size_t bufferSize)
+{
+	if (vertexSize == 0 || vertexSize % 4 != 0 || vertexSize > 256 || bufferSize < 1 || buffer[0] != VERTEX_STREAM_TAG)
+		return false;
+
+	const unsigned char* data = buffer + 1;
+	const unsigned char* end = buffer + bufferSize;
+
+	size_t blockSize = blockVertices(vertexSize);
+	std::vector<unsigned char> planes(blockSize * vertexSize);
+	std::vector<unsigned char> block(blockSize * vertexSize);
+	std::vector<unsigned char> previous(vertexSize, 0);
+
+#if MESHCODEC_X86
+	bool simd = PixelOps::getSimdLevel() != PixelOps::SimdLevel::Scalar;
+#else
+	bool simd = false;
+#endif
+
+	for (size_t first = 0; first < vertexCount; first += blockSize) {
+		size_t blockCount = std::min(blockSize, vertexCount - first);
+
+		for (size_t k = 0; k < vertexSize && data != nullptr; k++) {
+			unsigned char* plane = &planes[k * blockSize];
+
+#if MESHCODEC_X86
+			if (simd) {
+				data = decodePlaneSSE(data, end, plane, blockCount, previous[k]);
+				continue;
+			}
+#endif
+
+			data = decodePlaneScalar(data, end, plane, blockCount);
+			if (data != nullptr)
+				undeltaScalar(plane, blockCount, previous[k]);
+		}
+
+		if (data == nullptr)
+			return false;
+
+#if MESHCODEC_X86
+		if (simd)
+			interleaveSSE(planes.data(), blockSize, blockCount, vertexSize, block.data());
+		else
+#endif
+			interleaveScalar(planes.data(), blockSize, blockCount, vertexSize, block.data());
+
+		// Interleaving scatters small stores all over the block. It's done in a scratch
+		// block so that the destination, usually a mapped GL buffer in write combined
+		// memory, only ever sees one sequential copy.
+		memcpy((unsigned char*)destination + first * vertexSize, block.data(), blockCount * vertexSize);
+	}
+
+	return data == end;
+}
+
+static bool readVarint(const unsigned char*& data, const unsigned char* end, uint32_t& value)
+{
+	value = 0;
+
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (data == end)
+			return false;
+
+		unsigned char byte = *data++;
+		value |= (uint32_t)(byte & 0x7F) << shift;
+
+		if (byte < 0x80)
+			return true;
+	}
+
+	return false;
+}
+
+static bool decodeVertex(int code, TriangleFifos& fifos, const unsigned char*& data, const unsigned char* end, uint32_t& v)
+{
+	if (code == VERTEX_NEXT) {
+		v = fifos.next++;
+		fifos.pushVertex(v);
+		return true;
+	}
+
+	if (code != VERTEX_EXPLICIT) {
+		v = fifos.vertex(code - 1);
+		return true;
+	}
+
+	uint32_t delta;
+	if (!readVarint(data, end, delta))
+		return false;
+
+	v = fifos.last + unzigzag32(delta);
+	fifos.last = v;
+	fifos.pushVertex(v);
+	return true;
+}
+
+template <typename Index>
+static bool decodeTriangles(Index* indices, size_t triangleCount, size_t vertexCount, const unsigned char* codes, const unsigned char* data, const unsigned char* end)
+{
+	TriangleFifos fifos;
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		unsigned char code = codes[t];
+		uint32_t a, b, c;
+
+		if ((code >> 4) != 0xF) {
+			const uint32_t* edge = fifos.edge(code >> 4);
+			a = edge[0];
+			b = edge[1];
+
+			if (!decodeVertex(code & 15, fifos, data, end, c))
+				return false;
+
+			fifos.pushEdge(c, b);
+			fifos.pushEdge(a, c);
+		}
+		else {
+			if (!decodeVertex(code & 15, fifos, data, end, a) || data == end)
+				return false;
+
+			unsigned char second = *data++;
+			if (!decodeVertex(second >> 4, fifos, data, end, b) || !decodeVertex(second & 15, fifos, data, end, c))
+				return false;
+
+			fifos.pushEdge(b, a);
+			fifos.pushEdge(c, b);
+			fifos.pushEdge(a, c);
+		}
+
+		// Also catches slots of the FIFOs that were never filled (all bits set), and
+		// anything that wouldn't fit in a 16 bit index.
+		if (a >= vertexCount || b >= vertexCount || c >= vertexCount)
+			return false;
+
+		indices[t * 3] = (Index)a;
+		indices[t * 3 + 1] = (Index)b;
+		indices[t * 3 + 2] = (Index)c;
+	}
+
+	return data == end;
+}
+
+bool decodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, size_t vertexCount, const unsigned char* buffer, size_t bufferSize)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if ((indexSize != 2 && indexSize != 4) || indexCount % 3 != 0 || bufferSize < 1 + triangleCount || buffer[0] != INDEX_STREAM_TAG)
+		return false;
+
+	const unsigned char* codes = buffer + 1;
+	const unsigned char* data = codes + triangleCount;
+	const unsigned char* end = buffer + bufferSize;
+
+	if (indexSize == 2)
+		return decodeTriangles((uint16_t*)destination, triangleCount, std::min(vertexCount, (size_t)65536), codes, data, end);
+
+	return decodeTriangles((uint32_t*)destination, triangleCount, vertexCount, codes, data, end);
+}
+
+}
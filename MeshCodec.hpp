@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Lossless compression for vertex and index buffers, in the spirit of meshoptimizer's
+// codecs: cheap enough to decode that reading fewer bytes from disk is a net win.
+//
+// Vertices are split into byte planes (byte k of every vertex), each byte is stored as
+// the difference to the same byte of the previous vertex, zigzagged so small negative
+// differences become small numbers, and then packed in groups of 16 at 0, 2, 4 or 8 bits
+// each, whatever the largest value in the group needs. Optimized meshes fetch vertices
+// in order and neighbours are close in space, so most groups end up tiny.
+//
+// Triangles are coded against FIFOs of recently seen edges and vertices, which takes
+// about a byte per triangle for an optimized mesh (see encodeIndexBuffer). They can come
+// back rotated, but never with a different winding.
+//
+// Both decoders write their output front to back in one pass, so the destination can be
+// a mapped GL buffer.
+//
+// Decoding uses SSE2 when PixelOps says the CPU has SSE (PixelOps::setSimdLevel forces
+// the scalar version, for comparisons).
+namespace MeshCodec {
+	// 'vertexSize' has to be a multiple of 4 and at most 256.
+	std::vector<unsigned char> encodeVertexBuffer(const void* vertices, size_t vertexCount, size_t vertexSize);
+	bool decodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const unsigned char* buffer, size_t bufferSize);
+
+	// A triangle list. 'indexSize' is the size of the decoded indices, 2 or 4 bytes.
+	// Decoding fails on any index that's not below 'vertexCount'.
+	std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices, size_t indexCount);
+	bool decodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, size_t vertexCount, const unsigned char* buffer, size_t bufferSize);
+}
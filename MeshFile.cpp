@@ -0,0 +1,627 @@
+#include "MeshFile.hpp"
+#include "GLResources.hpp"
+#include "MeshCodec.hpp"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + MESH_FILE_ALIGNMENT - 1) & ~(MESH_FILE_ALIGNMENT - 1);
+}
+
+static VertexLayout layoutOf(const MeshFileHeader& header)
+{
+	return VertexLayout::fromFormats((VertexFormat)header.vertexFormats[VERTEX_POSITION], (VertexFormat)header.vertexFormats[VERTEX_TEXCOORD],
+		(VertexFormat)header.vertexFormats[VERTEX_NORMAL], (VertexFormat)header.vertexFormats[VERTEX_TANGENT]);
+}
+
+MeshFile::MeshFile()
+	: header(nullptr)
+{
+}
+
+bool MeshFile::open(const VirtualFileSystem& files, const std::string& path)
+{
+	FileData data;
+	if (!files.read(path, data)) {
+		close();
+		return false;
+	}
+
+	return open(std::move(data), path);
+}
+
+bool MeshFile::open(FileData data, const std::string& path)
+{
+	close();
+	file = std::move(data);
+
+	if (file.size() < sizeof(MeshFileHeader)) {
+		close();
+		return false;
+	}
+
+	const MeshFileHeader* candidate = (const MeshFileHeader*)file.data();
+	uint64_t size = file.size();
+
+	bool knownFormats = true;
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		knownFormats = knownFormats && candidate->vertexFormats[s] <= (uint8_t)VertexFormat::Snorm10x3_2;
+	}
+
+	// Everything the accessors hand out has to be inside the file.
+	bool valid = memcmp(candidate->magic, "MESH", 4) == 0
+		&& candidate->version == MESH_FILE_VERSION
+		&& (candidate->indexSize == 2 || candidate->indexSize == 4)
+		&& knownFormats
+		&& layoutOf(*candidate).attributes() == candidate->attributes
+		&& candidate->vertexStride == layoutOf(*candidate).stride
+		&& (candidate->encoding == MESH_ENCODING_CODEC || (candidate->encoding == MESH_ENCODING_RAW
+			&& candidate->vertexBytes == (uint64_t)candidate->vertexStride * candidate->vertexCount
+			&& candidate->indexBytes == (uint64_t)candidate->indexSize * candidate->indexCount))
+		&& candidate->submeshOffset + (uint64_t)candidate->submeshCount * sizeof(MeshFileSubmesh) <= size
+		&& candidate->meshletOffset + (uint64_t)candidate->meshletCount * sizeof(Meshlet) <= size
+		&& candidate->lodOffset + (uint64_t)candidate->lodCount * sizeof(MeshLod) <= size
+		&& candidate->lodCount >= 1 && candidate->lodCount <= MESH_MAX_LODS
+		&& candidate->vertexOffset + candidate->vertexBytes <= size
+		&& candidate->indexOffset + candidate->indexBytes <= size;
+
+	// So are the index ranges the meshlets and levels of detail draw.
+	const Meshlet* meshlets = (const Meshlet*)(file.data() + candidate->meshletOffset);
+	for (uint32_t m = 0; valid && m < candidate->meshletCount; m++) {
+		valid = (uint64_t)meshlets[m].firstIndex + (uint64_t)meshlets[m].triangleCount * 3 <= candidate->indexCount;
+	}
+
+	const MeshLod* lods = (const MeshLod*)(file.data() + candidate->lodOffset);
+	for (uint32_t l = 0; valid && l < candidate->lodCount; l++) {
+		valid = (uint64_t)lods[l].firstIndex + lods[l].indexCount <= candidate->indexCount;
+	}
+
+	if (!valid) {
+		std::cout << "ERROR::MESH_FILE::INVALID_FILE " << path << std::endl;
+		close();
+		return false;
+	}
+
+	header = candidate;
+	return true;
+}
+
+void MeshFile::close()
+{
+	file.clear();
+	header = nullptr;
+}
+
+const MeshFileHeader& MeshFile::getHeader() const
+{
+	return *header;
+}
+
+const MeshFileSubmesh* MeshFile::getSubmeshes() const
+{
+	return (const MeshFileSubmesh*)(file.data() + header->submeshOffset);
+}
+
+const Meshlet* MeshFile::getMeshlets() const
+{
+	return (const Meshlet*)(file.data() + header->meshletOffset);
+}
+
+const MeshLod* MeshFile::getLods() const
+{
+	return (const MeshLod*)(file.data() + header->lodOffset);
+}
+
+const void* MeshFile::getVertexData() const
+{
+	return file.data() + header->vertexOffset;
+}
+
+const void* MeshFile::getIndexData() const
+{
+	return file.data() + header->indexOffset;
+}
+
+VertexLayout MeshFile::getLayout() const
+{
+	return layoutOf(*header);
+}
+
+bool MeshFile::decodeVertices(void* destination) const
+{
+	if (header->encoding == MESH_ENCODING_RAW) {
+		memcpy(destination, getVertexData(), header->vertexBytes);
+		return true;
+	}
+
+	return MeshCodec::decodeVertexBuffer(destination, header->vertexCount, header->vertexStride, (const unsigned char*)getVertexData(), header->vertexBytes);
+}
+
+// An index past the last vertex would have the GPU read outside the vertex buffer. The
+// codec checks while it decodes; raw blobs are checked here before they're used.
+static bool indicesInRange(const void* indices, size_t indexCount, size_t indexSize, size_t vertexCount)
+{
+	uint32_t highest = 0;
+
+	if (indexSize == 2) {
+		for (size_t i = 0; i < indexCount; i++) {
+			highest = std::max<uint32_t>(highest, ((const uint16_t*)indices)[i]);
+		}
+	}
+	else {
+		for (size_t i = 0; i < indexCount; i++) {
+			highest = std::max(highest, ((const uint32_t*)indices)[i]);
+		}
+	}
+
+	return indexCount == 0 || highest < vertexCount;
+}
+
+bool MeshFile::decodeIndices(void* destination) const
+{
+	if (header->encoding == MESH_ENCODING_RAW) {
+		if (!indicesInRange(getIndexData(), header->indexCount, header->indexSize, header->vertexCount))
+			return false;
+
+		memcpy(destination, getIndexData(), header->indexBytes);
+		return true;
+	}
+
+	return MeshCodec::decodeIndexBuffer(destination, header->indexCount, header->indexSize, header->vertexCount,
+		(const unsigned char*)getIndexData(), header->indexBytes);
+}
+
+bool MeshFile::upload(unsigned int vertexBuffer, unsigned int indexBuffer) const
+{
+	// Neither is ever resized, so both get immutable storage where there's DSA.
+	if (header->encoding == MESH_ENCODING_RAW) {
+		if (!indicesInRange(getIndexData(), header->indexCount, header->indexSize, header->vertexCount)) {
+			std::cout << "ERROR::MESH_FILE::INDEX_OUT_OF_RANGE" << std::endl;
+			return false;
+		}
+
+		GLResources::bufferStorage(vertexBuffer, (GLsizeiptr)header->vertexBytes, getVertexData(), 0);
+		GLResources::bufferStorage(indexBuffer, (GLsizeiptr)header->indexBytes, getIndexData(), 0);
+		return true;
+	}
+
+	GLsizeiptr vertexSize = (GLsizeiptr)header->vertexStride * header->vertexCount;
+	GLsizeiptr indexSize = (GLsizeiptr)header->indexSize * header->indexCount;
+
+	// The mapped memory is usually write combined: fine to write in order, awful to read
+	// back, which is why the decoders only ever write front to back.
+	GLResources::bufferStorage(vertexBuffer, vertexSize, nullptr, GL_MAP_WRITE_BIT);
+	void* vertices = GLResources::mapBufferRange(vertexBuffer, 0, vertexSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	// Unmapping a buffer that isn't mapped is a GL error, so only after a map that worked.
+	bool decoded = vertices != nullptr && decodeVertices(vertices);
+	if (vertices != nullptr)
+		decoded = GLResources::unmapBuffer(vertexBuffer) && decoded;
+
+	GLResources::bufferStorage(indexBuffer, indexSize, nullptr, GL_MAP_WRITE_BIT);
+	void* indices = GLResources::mapBufferRange(indexBuffer, 0, indexSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	bool indicesDecoded = indices != nullptr && decodeIndices(indices);
+	if (indices != nullptr)
+		indicesDecoded = GLResources::unmapBuffer(indexBuffer) && indicesDecoded;
+	decoded = decoded && indicesDecoded;
+
+	if (!decoded)
+		std::cout << "ERROR::MESH_FILE::DECODING_FAILED" << std::endl;
+
+	return decoded;
+}
+
+static void computeBounds(const MeshData& mesh, uint32_t firstIndex, uint32_t indexCount, float* boundsMin, float* boundsMax)
+{
+	for (int c = 0; c < 3; c++) {
+		boundsMin[c] = FLT_MAX;
+		boundsMax[c] = -FLT_MAX;
+	}
+
+	for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++) {
+		const float* position = &mesh.vertices[(size_t)mesh.indices[i] * mesh.floatsPerVertex];
+
+		for (int c = 0; c < 3; c++) {
+			boundsMin[c] = std::min(boundsMin[c], position[c]);
+			boundsMax[c] = std::max(boundsMax[c], position[c]);
+		}
+	}
+}
+
+bool MeshFile::write(const std::string& path, const MeshData& mesh, uint32_t attributes, const VertexLayout& layout,
+	std::vector<MeshFileSubmesh> submeshes, std::vector<Meshlet> meshlets, std::vector<MeshLod> lods, MeshEncoding encoding, QuantizationError* error)
+{
+	QuantizedVertices vertices;
+	if (!VertexQuantizer::quantize(mesh, attributes, layout, vertices))
+		return false;
+
+	if (error != nullptr)
+		*error = vertices.error;
+
+	if (lods.empty())
+		lods.push_back({ 0, (uint32_t)mesh.indices.size(), 0.0f });
+
+	if (submeshes.empty()) {
+		MeshFileSubmesh whole = {};
+		whole.indexCount = lods[0].indexCount;
+		submeshes.push_back(whole);
+	}
+
+	for (MeshFileSubmesh& submesh : submeshes) {
+		computeBounds(mesh, submesh.firstIndex, submesh.indexCount, submesh.boundsMin, submesh.boundsMax);
+	}
+
+	// The spheres and errors were measured on the float positions, the GPU sees the quantized ones.
+	for (Meshlet& meshlet : meshlets) {
+		meshlet.radius += vertices.error.positionMax;
+	}
+
+	for (MeshLod& lod : lods) {
+		lod.error += vertices.error.positionMax;
+	}
+
+	MeshFileHeader header = {};
+	memcpy(header.magic, "MESH", 4);
+	header.version = MESH_FILE_VERSION;
+	header.attributes = attributes;
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		header.vertexFormats[s] = (uint8_t)layout.formats[s];
+	}
+	header.vertexStride = layout.stride;
+	header.vertexCount = (uint32_t)mesh.vertexCount();
+	header.indexCount = (uint32_t)mesh.indices.size();
+	// 16-bit indices whenever they fit: half the index bandwidth.
+	header.indexSize = mesh.vertexCount() <= 0xFFFF ? 2 : 4;
+	header.submeshCount = (uint32_t)submeshes.size();
+	header.encoding = encoding;
+	header.meshletCount = (uint32_t)meshlets.size();
+	header.lodCount = (uint32_t)lods.size();
+	computeBounds(mesh, 0, header.indexCount, header.boundsMin, header.boundsMax);
+	header.dequantization = vertices.dequantization;
+
+	std::vector<unsigned char> vertexBlob, indexBlob;
+	if (encoding == MESH_ENCODING_CODEC) {
+		vertexBlob = MeshCodec::encodeVertexBuffer(vertices.data.data(), header.vertexCount, header.vertexStride);
+		indexBlob = MeshCodec::encodeIndexBuffer(mesh.indices.data(), header.indexCount);
+	}
+	else {
+		vertexBlob = std::move(vertices.data);
+		indexBlob.resize((size_t)header.indexSize * header.indexCount);
+		if (header.indexSize == 2) {
+			std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+			memcpy(indexBlob.data(), shortIndices.data(), indexBlob.size());
+		}
+		else {
+			memcpy(indexBlob.data(), mesh.indices.data(), indexBlob.size());
+		}
+	}
+
+	header.submeshOffset = alignUp(sizeof(MeshFileHeader));
+	header.meshletOffset = alignUp(header.submeshOffset + submeshes.size() * sizeof(MeshFileSubmesh));
+	header.lodOffset = alignUp(header.meshletOffset + meshlets.size() * sizeof(Meshlet));
+	header.vertexOffset = alignUp(header.lodOffset + lods.size() * sizeof(MeshLod));
+	header.vertexBytes = vertexBlob.size();
+	header.indexOffset = alignUp(header.vertexOffset + header.vertexBytes);
+	header.indexBytes = indexBlob.size();
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	const char padding[MESH_FILE_ALIGNMENT] = {};
+	auto padTo = [&out, &padding](uint64_t offset) {
+		uint64_t position = (uint64_t)out.tellp();
+		out.write(padding, (std::streamsize)(offset - position));
+	};
+
+	out.write((const char*)&header, sizeof(header));
+	padTo(header.submeshOffset);
+	out.write((const char*)submeshes.data(), submeshes.size() * sizeof(MeshFileSubmesh));
+	padTo(header.meshletOffset);
+	out.write((const char*)meshlets.data(), meshlets.size() * sizeof(Meshlet));
+	padTo(header.lodOffset);
+	out.write((const char*)lods.data(), lods.size() * sizeof(MeshLod));
+	padTo(header.vertexOffset);
+	out.write((const char*)vertexBlob.data(), header.vertexBytes);
+	padTo(header.indexOffset);
+	out.write((const char*)indexBlob.data(), header.indexBytes);
+
+	return (bool)out;
+}
+
+// Level k keeps about LOD_RATIO^k of the triangles. Every level is simplified from level
+// 0, so its error is measured against the real surface, and the chain stops once a level
+// barely shrinks (everything left is seams and borders) or would need more error than
+// LOD_MAX_ERROR of the mesh size, past which it stops looking like the same object.
+constexpr float LOD_RATIO = 0.5f;
+constexpr float LOD_MIN_SHRINK = 0.85f;
+constexpr float LOD_MAX_ERROR = 0.05f;
+
+static std::vector<MeshLod> buildLods(MeshData& mesh, const std::vector<MeshFileSubmesh>& submeshes)
+{
+	std::vector<MeshLod> lods = { { 0, (uint32_t)mesh.indices.size(), 0.0f } };
+
+	float boundsMin[3], boundsMax[3];
+	computeBounds(mesh, 0, lods[0].indexCount, boundsMin, boundsMax);
+	float extent = std::max({ boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] });
+
+	for (uint32_t level = 1; level < MESH_MAX_LODS; level++) {
+		float ratio = std::pow(LOD_RATIO, (float)level);
+		float levelError = lods.back().error;
+		std::vector<unsigned int> levelIndices;
+
+		// Submeshes stay apart, in order, inside every level.
+		for (const MeshFileSubmesh& submesh : submeshes) {
+			size_t target = (size_t)(submesh.indexCount * ratio) / 3 * 3;
+			float error = 0.0f;
+			std::vector<unsigned int> simplified = MeshSimplifier::simplify(mesh, mesh.indices.data() + submesh.firstIndex,
+				submesh.indexCount, target, LOD_MAX_ERROR * extent, error);
+
+			MeshOptimizer::optimizeVertexCache(simplified, mesh.vertexCount());
+			levelIndices.insert(levelIndices.end(), simplified.begin(), simplified.end());
+			levelError = std::max(levelError, error);
+		}
+
+		if (levelIndices.empty() || levelIndices.size() > lods.back().indexCount * LOD_MIN_SHRINK)
+			break;
+
+		lods.push_back({ (uint32_t)mesh.indices.size(), (uint32_t)levelIndices.size(), levelError });
+		mesh.indices.insert(mesh.indices.end(), levelIndices.begin(), levelIndices.end());
+	}
+
+	return lods;
+}
+
+// ---- OBJ --------------------------------------------------------------------------
+
+struct ObjCorner {
+	int position;
+	int texcoord;
+	int normal;
+
+	bool operator==(const ObjCorner& other) const
+	{
+		return position == other.position && texcoord == other.texcoord && normal == other.normal;
+	}
+};
+
+struct ObjCornerHash {
+	size_t operator()(const ObjCorner& corner) const
+	{
+		return (size_t)corner.position * 73856093u ^ (size_t)corner.texcoord * 19349663u ^ (size_t)corner.normal * 83492791u;
+	}
+};
+
+// OBJ indices start at 1 and negative ones count back from the end.
+static int resolveObjIndex(long value, size_t count)
+{
+	if (value > 0)
+		return (int)(value - 1);
+	if (value < 0)
+		return (int)((long)count + value);
+	return -1;
+}
+
+bool MeshFile::loadObj(const std::string& path, MeshData& mesh, uint32_t& attributes, std::vector<MeshFileSubmesh>& submeshes)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		std::cout << "ERROR::MESH_FILE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return false;
+	}
+
+	std::string text((size_t)file.tellg(), '\0');
+	file.seekg(0);
+	file.read(&text[0], (std::streamsize)text.size());
+	text.push_back('\0');
+
+	std::vector<float> positions, texcoords, normals;
+	std::vector<ObjCorner> corners; // three per triangle
+	std::vector<std::pair<size_t, std::string>> groups; // first corner, name
+	bool hasTexcoords = false, hasNormals = false;
+
+	const char* cursor = text.c_str();
+	const char* end = cursor + text.size() - 1;
+
+	while (cursor < end) {
+		const char* lineEnd = cursor;
+		while (lineEnd < end && *lineEnd != '\n') {
+			lineEnd++;
+		}
+
+		char* next;
+		if (cursor[0] == 'v' && cursor[1] == ' ') {
+			cursor += 2;
+			for (int c = 0; c < 3; c++) {
+				positions.push_back(strtof(cursor, &next));
+				cursor = next;
+			}
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 't' && cursor[2] == ' ') {
+			cursor += 3;
+			for (int c = 0; c < 2; c++) {
+				texcoords.push_back(strtof(cursor, &next));
+				cursor = next;
+			}
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 'n' && cursor[2] == ' ') {
+			cursor += 3;
+			for (int c = 0; c < 3; c++) {
+				normals.push_back(strtof(cursor, &next));
+				cursor = next;
+			}
+		}
+		else if (cursor[0] == 'f' && cursor[1] == ' ') {
+			cursor += 2;
+			std::vector<ObjCorner> polygon;
+
+			while (cursor < lineEnd) {
+				while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+					cursor++;
+				}
+				if (cursor >= lineEnd)
+					break;
+
+				ObjCorner corner = { -1, -1, -1 };
+				corner.position = resolveObjIndex(strtol(cursor, &next, 10), positions.size() / 3);
+				cursor = next;
+
+				if (*cursor == '/') {
+					cursor++;
+					if (*cursor != '/') {
+						corner.texcoord = resolveObjIndex(strtol(cursor, &next, 10), texcoords.size() / 2);
+						cursor = next;
+					}
+
+					if (*cursor == '/') {
+						cursor++;
+						corner.normal = resolveObjIndex(strtol(cursor, &next, 10), normals.size() / 3);
+						cursor = next;
+					}
+				}
+
+				if (corner.position < 0 || corner.position >= (int)(positions.size() / 3)) {
+					std::cout << "ERROR::MESH_FILE::INVALID_OBJ_FACE " << path << std::endl;
+					return false;
+				}
+
+				hasTexcoords = hasTexcoords || corner.texcoord >= 0;
+				hasNormals = hasNormals || corner.normal >= 0;
+				polygon.push_back(corner);
+			}
+
+			// Fan triangulation, fine for the convex polygons exporters write.
+			for (size_t i = 2; i < polygon.size(); i++) {
+				corners.push_back(polygon[0]);
+				corners.push_back(polygon[i - 1]);
+				corners.push_back(polygon[i]);
+			}
+		}
+		else if ((cursor[0] == 'o' || cursor[0] == 'g') && cursor[1] == ' ') {
+			groups.push_back({ corners.size(), std::string(cursor + 2, lineEnd) });
+		}
+		else if (strncmp(cursor, "usemtl ", 7) == 0) {
+			groups.push_back({ corners.size(), std::string(cursor + 7, lineEnd) });
+		}
+
+		cursor = lineEnd + 1;
+	}
+
+	attributes = MESH_ATTRIBUTE_POSITION | (hasTexcoords ? (uint32_t)MESH_ATTRIBUTE_TEXCOORD : 0) | (hasNormals ? (uint32_t)MESH_ATTRIBUTE_NORMAL : 0);
+	mesh.floatsPerVertex = (int)(VertexLayout::floats(attributes).stride / sizeof(float));
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.indices.reserve(corners.size());
+
+	// One vertex per distinct position/texcoord/normal combination.
+	std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> unique;
+	unique.reserve(corners.size());
+
+	for (const ObjCorner& corner : corners) {
+		auto found = unique.find(corner);
+		if (found != unique.end()) {
+			mesh.indices.push_back(found->second);
+			continue;
+		}
+
+		unsigned int index = (unsigned int)mesh.vertexCount();
+		unique.emplace(corner, index);
+		mesh.indices.push_back(index);
+
+		mesh.vertices.insert(mesh.vertices.end(), &positions[corner.position * 3], &positions[corner.position * 3] + 3);
+
+		if (hasTexcoords) {
+			bool valid = corner.texcoord >= 0 && corner.texcoord < (int)(texcoords.size() / 2);
+			mesh.vertices.push_back(valid ? texcoords[corner.texcoord * 2] : 0.0f);
+			mesh.vertices.push_back(valid ? texcoords[corner.texcoord * 2 + 1] : 0.0f);
+		}
+
+		if (hasNormals) {
+			bool valid = corner.normal >= 0 && corner.normal < (int)(normals.size() / 3);
+			for (int c = 0; c < 3; c++) {
+				mesh.vertices.push_back(valid ? normals[corner.normal * 3 + c] : 0.0f);
+			}
+		}
+	}
+
+	// Groups become submeshes; empty ones (a 'g' right before a 'usemtl') are skipped.
+	submeshes.clear();
+	groups.push_back({ corners.size(), "" });
+	size_t first = 0;
+	std::string name = "default";
+
+	for (const auto& group : groups) {
+		if (group.first > first) {
+			MeshFileSubmesh submesh = {};
+			submesh.firstIndex = (uint32_t)first;
+			submesh.indexCount = (uint32_t)(group.first - first);
+			strncpy(submesh.name, name.c_str(), sizeof(submesh.name) - 1);
+			submeshes.push_back(submesh);
+		}
+
+		first = group.first;
+		name = group.second;
+	}
+
+	return true;
+}
+
+bool MeshFile::convertObj(const std::string& objPath, const std::string& meshPath, bool quantize, bool compress)
+{
+	MeshData mesh;
+	uint32_t attributes = 0;
+	std::vector<MeshFileSubmesh> submeshes;
+
+	if (!loadObj(objPath, mesh, attributes, submeshes))
+		return false;
+
+	// The runtime culls back faces, so everything has to wind the same way, outwards,
+	// whatever the OBJ did. Across the whole mesh, a surface can go on in another submesh.
+	VertexCacheStats before = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+	size_t flipped = MeshOptimizer::fixWinding(mesh);
+
+	// Submeshes are drawn separately, so each one is cache optimized, sorted against
+	// overdraw and split into meshlets on its own. Renumbering the vertices afterwards
+	// doesn't move any triangle.
+	std::vector<Meshlet> meshlets;
+	for (size_t s = 0; s < submeshes.size(); s++) {
+		const MeshFileSubmesh& submesh = submeshes[s];
+		std::vector<unsigned int> range(mesh.indices.begin() + submesh.firstIndex, mesh.indices.begin() + submesh.firstIndex + submesh.indexCount);
+		MeshOptimizer::optimizeVertexCache(range, mesh.vertexCount());
+		std::copy(range.begin(), range.end(), mesh.indices.begin() + submesh.firstIndex);
+		MeshOptimizer::optimizeOverdraw(mesh, submesh.firstIndex, submesh.indexCount);
+
+		Meshlets::build(mesh, submesh.firstIndex, submesh.indexCount, (uint32_t)s, meshlets);
+	}
+
+	VertexCacheStats after = MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+	std::cout << objPath << ": " << flipped << " triangles flipped, ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+	std::vector<MeshLod> lods = buildLods(mesh, submeshes);
+	MeshOptimizer::optimizeVertexFetch(mesh);
+
+	VertexLayout layout = quantize ? VertexLayout::quantized(attributes) : VertexLayout::floats(attributes);
+	QuantizationError error;
+
+	if (!write(meshPath, mesh, attributes, layout, submeshes, meshlets, lods, compress ? MESH_ENCODING_CODEC : MESH_ENCODING_RAW, &error)) {
+		std::cout << "ERROR::MESH_FILE::FILE_NOT_SUCCESFULLY_WRITTEN " << meshPath << std::endl;
+		return false;
+	}
+
+	VertexQuantizer::printReport(layout, error);
+	std::cout << "Meshlets: " << meshlets.size() << " for " << lods[0].indexCount / 3 << " triangles" << std::endl;
+	for (size_t l = 1; l < lods.size(); l++) {
+		std::cout << "LOD " << l << ": " << lods[l].indexCount / 3 << " triangles, error " << lods[l].error << std::endl;
+	}
+
+	return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshOptimizer.hpp"
+#include "Meshlets.hpp"
+#include "MeshSimplifier.hpp"
+#include "VertexFormat.hpp"
+#include "VertexQuantizer.hpp"
+#include "VirtualFileSystem.hpp"
+
+// Binary mesh container (.mesh), laid out so the runtime never parses anything:
+//
+//   MeshFileHeader
+//   MeshFileSubmesh[submeshCount]
+//   Meshlet[meshletCount]
+//   MeshLod[lodCount]
+//   vertex blob (interleaved in the stored VertexLayout, 'vertexStride' bytes per vertex)
+//   index blob (16 or 32-bit indices)
+//
+// Every blob starts at a multiple of MESH_FILE_ALIGNMENT, so once the file is mapped
+// the vertex and index pointers can go straight into glBufferData.
+//
+// Version 2 stores the vertex format of every attribute plus the dequantization the
+// shader needs, so the vertices can be quantized. Version 3 can store both blobs
+// compressed with MeshCodec instead, in which case they're decoded straight into
+// mapped GL buffers (see upload). Version 4 adds the meshlets, which split the index
+// buffer into clusters that can be culled on their own. Version 5 adds the levels of
+// detail: coarser index ranges after the full one, over the same vertices.
+
+constexpr uint32_t MESH_FILE_VERSION = 5;
+constexpr uint64_t MESH_FILE_ALIGNMENT = 64;
+
+// What a mesh has, one bit per VertexSemantic. In float form that's 3/2/3/4 floats per
+// attribute, in this order.
+enum MeshAttribute : uint32_t {
+	MESH_ATTRIBUTE_POSITION = 1 << VERTEX_POSITION,
+	MESH_ATTRIBUTE_TEXCOORD = 1 << VERTEX_TEXCOORD,
+	MESH_ATTRIBUTE_NORMAL = 1 << VERTEX_NORMAL,
+	MESH_ATTRIBUTE_TANGENT = 1 << VERTEX_TANGENT  // xyz + handedness in w
+};
+
+enum MeshEncoding : uint32_t {
+	MESH_ENCODING_RAW = 0,
+	MESH_ENCODING_CODEC = 1  // MeshCodec vertex and index streams
+};
+
+struct MeshFileHeader {
+	char magic[4]; // "MESH"
+	uint32_t version;
+	uint32_t attributes;
+	uint8_t vertexFormats[VERTEX_SEMANTIC_COUNT]; // VertexFormat of each semantic
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t submeshCount;
+	uint32_t encoding; // MeshEncoding
+	uint32_t meshletCount; // of level 0
+	uint32_t lodCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	VertexDequantization dequantization;
+	uint64_t submeshOffset;
+	uint64_t meshletOffset;
+	uint64_t lodOffset;
+	uint64_t vertexOffset;
+	uint64_t vertexBytes; // as stored, compressed or not
+	uint64_t indexOffset;
+	uint64_t indexBytes;
+};
+
+struct MeshFileSubmesh {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	char name[32];
+};
+
+class MeshFile {
+    private:
+	FileData file;
+	const MeshFileHeader* header;
+    public:
+	MeshFile();
+
+	// Gets the file from 'files' and checks the header; nothing else is read. Loose files
+	// and meshes stored as they are in a pack stay mapped.
+	bool open(const VirtualFileSystem& files, const std::string& path);
+	// The same with bytes that have already been read (AssetLoader::readFile); 'path' is
+	// only for the error message.
+	bool open(FileData data, const std::string& path);
+	void close();
+
+	const MeshFileHeader& getHeader() const;
+	const MeshFileSubmesh* getSubmeshes() const;
+	const Meshlet* getMeshlets() const;
+	const MeshLod* getLods() const;
+	// The blobs as stored in the file.
+	const void* getVertexData() const;
+	const void* getIndexData() const;
+	VertexLayout getLayout() const;
+
+	// Uncompressed vertices (vertexCount * vertexStride bytes) and indices (indexCount * indexSize bytes).
+	// Indices fail to decode if any of them is past the last vertex.
+	bool decodeVertices(void* destination) const;
+	bool decodeIndices(void* destination) const;
+
+	// Fills the two buffers, which have to be new ones: their storage is only ever set
+	// once (GLResources::bufferStorage). Raw blobs go straight from the file's bytes,
+	// compressed ones are decoded into the mapped buffers.
+	bool upload(unsigned int vertexBuffer, unsigned int indexBuffer) const;
+
+	// 'mesh.floatsPerVertex' has to match 'attributes', and the vertices are stored in
+	// 'layout' (VertexLayout::floats keeps them as they are). Without submeshes the whole
+	// mesh is written as one, and without levels of detail the whole index buffer is
+	// level 0. Meshlet spheres and LOD errors grow by the quantization error.
+	static bool write(const std::string& path, const MeshData& mesh, uint32_t attributes, const VertexLayout& layout,
+		std::vector<MeshFileSubmesh> submeshes = {}, std::vector<Meshlet> meshlets = {}, std::vector<MeshLod> lods = {}, MeshEncoding encoding = MESH_ENCODING_RAW, QuantizationError* error = nullptr);
+
+	// Text OBJ (v/vt/vn/f, groups and usemtl become submeshes, polygons are fanned).
+	static bool loadObj(const std::string& path, MeshData& mesh, uint32_t& attributes, std::vector<MeshFileSubmesh>& submeshes);
+
+	// OBJ -> .mesh, with every submesh run through the vertex cache optimizer and split
+	// into meshlets, a chain of simplified levels of detail, the vertices quantized to VertexLayout::quantized unless 'quantize' is off and both
+	// blobs compressed unless 'compress' is.
+	static bool convertObj(const std::string& objPath, const std::string& meshPath, bool quantize = true, bool compress = true);
+};
@@ -0,0 +1,551 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <glm/glm.hpp>
+
+size_t MeshData::vertexCount() const
+{
+	return floatsPerVertex > 0 ? vertices.size() / floatsPerVertex : 0;
+}
+
+size_t MeshData::triangleCount() const
+{
+	return indices.size() / 3;
+}
+
+namespace MeshOptimizer {
+
+// Gives every element of 'data' the id of the first bit-identical element, using an
+// open addressing hash table. Returns the ids and how many distinct ones there are.
+static std::vector<unsigned int> remapIdentical(const unsigned char* data, size_t count, size_t stride, size_t bytes, size_t& uniqueCount)
+{
+	size_t tableSize = 1;
+	while (tableSize < count * 2) {
+		tableSize <<= 1;
+	}
+
+	const unsigned int empty = ~0u;
+	std::vector<unsigned int> table(tableSize, empty);
+	std::vector<unsigned int> firstOf; // unique id -> element
+	std::vector<unsigned int> ids(count);
+
+	for (size_t i = 0; i < count; i++) {
+		const unsigned char* element = data + i * stride;
+
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t b = 0; b < bytes; b++) {
+			hash = (hash ^ element[b]) * 1099511628211ull;
+		}
+
+		size_t slot = (size_t)hash & (tableSize - 1);
+		while (table[slot] != empty && memcmp(data + (size_t)firstOf[table[slot]] * stride, element, bytes) != 0) {
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] == empty) {
+			table[slot] = (unsigned int)firstOf.size();
+			firstOf.push_back((unsigned int)i);
+		}
+
+		ids[i] = table[slot];
+	}
+
+	uniqueCount = firstOf.size();
+	return ids;
+}
+
+static glm::vec3 positionOf(const MeshData& mesh, unsigned int vertex)
+{
+	const float* p = &mesh.vertices[(size_t)vertex * mesh.floatsPerVertex];
+	return glm::vec3(p[0], p[1], p[2]);
+}
+
+MeshData weldVertices(const float* vertices, size_t vertexCount, int floatsPerVertex)
+{
+	MeshData mesh;
+	mesh.floatsPerVertex = floatsPerVertex;
+
+	size_t uniqueCount = 0;
+	size_t stride = sizeof(float) * floatsPerVertex;
+	std::vector<unsigned int> ids = remapIdentical((const unsigned char*)vertices, vertexCount, stride, stride, uniqueCount);
+
+	mesh.vertices.resize(uniqueCount * floatsPerVertex);
+	mesh.indices.resize(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		memcpy(&mesh.vertices[(size_t)ids[i] * floatsPerVertex], vertices + i * floatsPerVertex, stride);
+		mesh.indices[i] = ids[i];
+	}
+
+	return mesh;
+}
+
+std::vector<unsigned int> positionIds(const MeshData& mesh, size_t& uniqueCount)
+{
+	return remapIdentical((const unsigned char*)mesh.vertices.data(), mesh.vertexCount(),
+		sizeof(float) * mesh.floatsPerVertex, sizeof(float) * 3, uniqueCount);
+}
+
+size_t fixWinding(MeshData& mesh)
+{
+	size_t triangleCount = mesh.triangleCount();
+	size_t uniquePositions = 0;
+	std::vector<unsigned int> positionIds = MeshOptimizer::positionIds(mesh, uniquePositions);
+
+	// Every directed edge, sorted so the two sides of an edge end up next to each other.
+	struct Edge {
+		uint64_t key;
+		unsigned int triangle;
+		bool forward; // goes from the lower position id to the higher one
+	};
+
+	std::vector<Edge> edges;
+	edges.reserve(triangleCount * 3);
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		unsigned int p0 = positionIds[mesh.indices[t * 3]];
+		unsigned int p1 = positionIds[mesh.indices[t * 3 + 1]];
+		unsigned int p2 = positionIds[mesh.indices[t * 3 + 2]];
+
+		// Collapsed triangles have no direction and would only link their neighbours wrong.
+		if (p0 == p1 || p1 == p2 || p0 == p2)
+			continue;
+
+		for (int e = 0; e < 3; e++) {
+			unsigned int a = positionIds[mesh.indices[t * 3 + e]];
+			unsigned int b = positionIds[mesh.indices[t * 3 + (e + 1) % 3]];
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			edges.push_back({ key, (unsigned int)t, a < b });
+		}
+	}
+
+	std::sort(edges.begin(), edges.end(), [](const Edge& x, const Edge& y) { return x.key < y.key; });
+
+	// Neighbour lists: (triangle, "we walk the edge in the same direction").
+	std::vector<std::vector<std::pair<unsigned int, bool>>> neighbours(triangleCount);
+	for (size_t i = 0; i < edges.size();) {
+		size_t j = i;
+		while (j < edges.size() && edges[j].key == edges[i].key) {
+			j++;
+		}
+
+		// Non manifold edges just link everything to the first triangle.
+		for (size_t k = i + 1; k < j; k++) {
+			bool same = edges[i].forward == edges[k].forward;
+			neighbours[edges[i].triangle].push_back({ edges[k].triangle, same });
+			neighbours[edges[k].triangle].push_back({ edges[i].triangle, same });
+		}
+
+		i = j;
+	}
+
+	std::vector<char> flipped(triangleCount, 0);
+	std::vector<char> visited(triangleCount, 0);
+	std::vector<unsigned int> component;
+	size_t flipCount = 0;
+
+	for (size_t seed = 0; seed < triangleCount; seed++) {
+		if (visited[seed])
+			continue;
+
+		// Flood fill: neighbours must walk shared edges in opposite directions.
+		component.clear();
+		std::deque<unsigned int> queue = { (unsigned int)seed };
+		visited[seed] = 1;
+
+		while (!queue.empty()) {
+			unsigned int t = queue.front();
+			queue.pop_front();
+			component.push_back(t);
+
+			for (const auto& neighbour : neighbours[t]) {
+				if (visited[neighbour.first])
+					continue;
+
+				visited[neighbour.first] = 1;
+				flipped[neighbour.first] = neighbour.second ? !flipped[t] : flipped[t];
+				queue.push_back(neighbour.first);
+			}
+		}
+
+		// Now consistent, but maybe all inside out: check the signed volume.
+		glm::vec3 center(0.0f);
+		for (unsigned int t : component) {
+			center += positionOf(mesh, mesh.indices[t * 3]);
+		}
+		center /= (float)component.size();
+
+		float volume = 0.0f;
+		for (unsigned int t : component) {
+			glm::vec3 a = positionOf(mesh, mesh.indices[t * 3]) - center;
+			glm::vec3 b = positionOf(mesh, mesh.indices[t * 3 + 1]) - center;
+			glm::vec3 c = positionOf(mesh, mesh.indices[t * 3 + 2]) - center;
+			float v = glm::dot(a, glm::cross(b, c));
+			volume += flipped[t] ? -v : v;
+		}
+
+		bool insideOut = volume < 0.0f;
+
+		for (unsigned int t : component) {
+			if ((flipped[t] != 0) != insideOut) {
+				std::swap(mesh.indices[t * 3 + 1], mesh.indices[t * 3 + 2]);
+				flipCount++;
+			}
+		}
+	}
+
+	return flipCount;
+}
+
+// ---- Vertex cache (Forsyth) -----------------------------------------------------
+
+constexpr int FORSYTH_CACHE_SIZE = 32;
+
+static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0) {
+		// The last triangle's vertices get a fixed score so we don't just keep
+		// using them; after that the score decays with the position in the cache.
+		if (cachePosition < 3) {
+			score = 0.75f;
+		}
+		else {
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler, 1.5f);
+		}
+	}
+
+	// Vertices with few triangles left get a boost so we finish them off and don't
+	// leave lonely triangles behind.
+	score += 2.0f * std::pow((float)remainingTriangles, -0.5f);
+	return score;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles of every vertex, as one flat array.
+	std::vector<unsigned int> triangleStart(vertexCount + 1, 0);
+	for (unsigned int index : indices) {
+		triangleStart[index + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		triangleStart[v + 1] += triangleStart[v];
+	}
+
+	std::vector<unsigned int> vertexTriangles(indices.size());
+	std::vector<unsigned int> fill(triangleStart.begin(), triangleStart.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		vertexTriangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<unsigned int> remaining(vertexCount);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		remaining[v] = triangleStart[v + 1] - triangleStart[v];
+		score[v] = vertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache;
+	size_t scanPosition = 0;
+	int best = -1;
+
+	while (result.size() < indices.size()) {
+		if (best < 0) {
+			// Nothing good in the cache: take the best triangle anywhere. Emitted ones
+			// are never worth it, so the scan only ever moves forward past them.
+			while (scanPosition < triangleCount && emitted[scanPosition]) {
+				scanPosition++;
+			}
+
+			best = (int)scanPosition;
+			for (size_t t = scanPosition; t < triangleCount; t++) {
+				if (!emitted[t] && triangleScore[t] > triangleScore[best])
+					best = (int)t;
+			}
+		}
+
+		emitted[best] = 1;
+		unsigned int corners[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+
+		for (unsigned int v : corners) {
+			result.push_back(v);
+			remaining[v]--;
+
+			// Take this triangle out of the vertex's list so scores only count live ones.
+			unsigned int* first = &vertexTriangles[triangleStart[v]];
+			unsigned int* last = first + remaining[v] + 1;
+			unsigned int* found = std::find(first, last, (unsigned int)best);
+			if (found != last)
+				std::swap(*found, *(last - 1));
+		}
+
+		// Move the three vertices to the front of the LRU cache.
+		std::vector<unsigned int> newCache(corners, corners + 3);
+		for (unsigned int v : cache) {
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+				newCache.push_back(v);
+		}
+
+		// Everything that moved (including what fell out) gets a new score, and so do
+		// the triangles using it.
+		for (size_t i = 0; i < newCache.size(); i++) {
+			unsigned int v = newCache[i];
+			int position = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+			cachePosition[v] = position;
+
+			float newScore = vertexScore(position, remaining[v]);
+			float delta = newScore - score[v];
+			score[v] = newScore;
+
+			for (unsigned int k = 0; k < remaining[v]; k++) {
+				triangleScore[vertexTriangles[triangleStart[v] + k]] += delta;
+			}
+		}
+
+		if (newCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+
+		// Next triangle: the best one touching the cache.
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int v : cache) {
+			for (unsigned int k = 0; k < remaining[v]; k++) {
+				unsigned int t = vertexTriangles[triangleStart[v] + k];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+// ---- Overdraw -------------------------------------------------------------------
+
+// Cache misses of triangle t with a FIFO cache of 'cacheSize' vertices. A vertex is in
+// the cache if it was added less than cacheSize misses ago; timestamps has one entry per
+// vertex, and adding cacheSize + 1 to 'time' empties the cache.
+static unsigned int fifoTriangleMisses(const std::vector<unsigned int>& indices, size_t t, unsigned int cacheSize, std::vector<unsigned int>& timestamps, unsigned int& time)
+{
+	unsigned int count = 0;
+
+	for (int k = 0; k < 3; k++) {
+		unsigned int v = indices[t * 3 + k];
+		if (time - timestamps[v] > cacheSize) {
+			timestamps[v] = time++;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+// Cache misses of each triangle of [first, last) with a FIFO cache that starts cold.
+static std::vector<unsigned char> fifoMisses(const std::vector<unsigned int>& indices, size_t first, size_t last, unsigned int cacheSize, std::vector<unsigned int>& timestamps, unsigned int& time)
+{
+	std::vector<unsigned char> misses;
+	time += cacheSize + 1; // everything from before is now too old
+
+	for (size_t t = first; t < last; t++) {
+		misses.push_back((unsigned char)fifoTriangleMisses(indices, t, cacheSize, timestamps, time));
+	}
+
+	return misses;
+}
+
+void optimizeOverdraw(MeshData& mesh, float threshold)
+{
+	optimizeOverdraw(mesh, 0, mesh.indices.size(), threshold);
+}
+
+void optimizeOverdraw(MeshData& mesh, size_t firstIndex, size_t indexCount, float threshold)
+{
+	const unsigned int cacheSize = 16;
+	size_t firstTriangle = firstIndex / 3;
+	size_t triangleCount = firstTriangle + indexCount / 3; // one past the range's last triangle
+	size_t vertexCount = mesh.vertexCount();
+	if (triangleCount == firstTriangle)
+		return;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = 0;
+
+	// Hard boundaries: triangles where the cache had nothing, so starting a cluster
+	// there costs nothing extra.
+	std::vector<unsigned char> misses = fifoMisses(mesh.indices, firstTriangle, triangleCount, cacheSize, timestamps, time);
+	std::vector<size_t> hard;
+	for (size_t t = firstTriangle; t < triangleCount; t++) {
+		if (t == firstTriangle || misses[t - firstTriangle] == 3)
+			hard.push_back(t);
+	}
+	hard.push_back(triangleCount);
+
+	// Soft boundaries: cut a cluster again as soon as its prefix (from a cold cache)
+	// is within the threshold of the whole cluster's ACMR.
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		size_t first = hard[h], last = hard[h + 1];
+		std::vector<unsigned char> clusterMisses = fifoMisses(mesh.indices, first, last, cacheSize, timestamps, time);
+
+		size_t total = 0;
+		for (unsigned char m : clusterMisses) {
+			total += m;
+		}
+		float clusterAcmr = (float)total / (float)(last - first);
+
+		// The cache is emptied at each cluster's start and then follows it one triangle at a
+		// time, up to the first cut, so every triangle is simulated once however long the
+		// hard cluster is.
+		size_t start = first;
+		while (start < last) {
+			clusters.push_back(start);
+			time += cacheSize + 1;
+			size_t sum = 0, end = last;
+
+			for (size_t t = start; t < last; t++) {
+				sum += fifoTriangleMisses(mesh.indices, t, cacheSize, timestamps, time);
+				if (t + 1 < last && (float)sum / (float)(t + 1 - start) <= clusterAcmr * threshold) {
+					end = t + 1;
+					break;
+				}
+			}
+
+			start = end;
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// The center of what's sorted: a submesh is drawn on its own, so it's its center that
+	// tells its front from its back.
+	glm::vec3 meshCenter(0.0f);
+	for (size_t i = firstTriangle * 3; i < triangleCount * 3; i++) {
+		meshCenter += positionOf(mesh, mesh.indices[i]);
+	}
+	meshCenter /= (float)((triangleCount - firstTriangle) * 3);
+
+	// Clusters that face away from the center are the ones most likely to be in
+	// front, so they're drawn first and hide the rest behind the depth test.
+	struct Cluster {
+		size_t first;
+		size_t last;
+		float sortKey;
+	};
+
+	std::vector<Cluster> sorted;
+	for (size_t c = 0; c + 1 < clusters.size(); c++) {
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area = 0.0f;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			glm::vec3 a = positionOf(mesh, mesh.indices[t * 3]);
+			glm::vec3 b = positionOf(mesh, mesh.indices[t * 3 + 1]);
+			glm::vec3 d = positionOf(mesh, mesh.indices[t * 3 + 2]);
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float triangleArea = glm::length(n);
+
+			center += (a + b + d) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+
+		if (area > 0.0f)
+			center /= area;
+
+		float length = glm::length(normal);
+		float key = length > 0.0f ? glm::dot(center - meshCenter, normal / length) : 0.0f;
+		sorted.push_back({ clusters[c], clusters[c + 1], key });
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> result;
+	result.reserve((triangleCount - firstTriangle) * 3);
+	for (const Cluster& cluster : sorted) {
+		result.insert(result.end(), mesh.indices.begin() + cluster.first * 3, mesh.indices.begin() + cluster.last * 3);
+	}
+
+	std::copy(result.begin(), result.end(), mesh.indices.begin() + firstTriangle * 3);
+}
+
+// ---- Vertex fetch ---------------------------------------------------------------
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(mesh.vertexCount(), unused);
+	std::vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+	unsigned int next = 0;
+
+	for (unsigned int& index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = next++;
+			const float* vertex = &mesh.vertices[(size_t)index * mesh.floatsPerVertex];
+			vertices.insert(vertices.end(), vertex, vertex + mesh.floatsPerVertex);
+		}
+
+		index = remap[index];
+	}
+
+	// Vertices no triangle uses are dropped.
+	mesh.vertices.swap(vertices);
+}
+
+void optimize(MeshData& mesh)
+{
+	fixWinding(mesh);
+	optimizeVertexCache(mesh.indices, mesh.vertexCount());
+	optimizeOverdraw(mesh);
+	optimizeVertexFetch(mesh);
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<char> used(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0, unique = 0;
+
+	for (unsigned int index : indices) {
+		if (time - timestamps[index] > cacheSize) {
+			timestamps[index] = time++;
+			misses++;
+		}
+
+		if (!used[index]) {
+			used[index] = 1;
+			unique++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = indices.empty() ? 0.0f : (float)misses / (float)(indices.size() / 3);
+	stats.atvr = unique == 0 ? 0.0f : (float)misses / (float)unique;
+	return stats;
+}
+
+}
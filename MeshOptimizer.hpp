@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// An indexed triangle mesh with interleaved float vertices. The first three floats
+// of every vertex are always its position.
+struct MeshData {
+	std::vector<float> vertices;
+	int floatsPerVertex = 0;
+	std::vector<unsigned int> indices;
+
+	size_t vertexCount() const;
+	size_t triangleCount() const;
+};
+
+struct VertexCacheStats {
+	float acmr; // average cache miss ratio: transformed vertices per triangle (0.5 is the best possible, 3 the worst)
+	float atvr; // average transformed vertex ratio: transformed vertices per unique vertex (1 is perfect)
+};
+
+// Turns raw triangle soups into meshes that are cheap for the GPU: shared vertices
+// are welded into an index buffer, triangles are reordered so the post transform
+// cache gets hits, clusters are sorted outside-in to cut overdraw, vertices are laid
+// out in the order they're fetched, and winding is made consistent so back faces
+// can be culled.
+namespace MeshOptimizer {
+	// Merges bit-identical vertices of a non-indexed triangle list.
+	MeshData weldVertices(const float* vertices, size_t vertexCount, int floatsPerVertex);
+
+	// Gives every vertex an id shared by all vertices at the same position, so vertices
+	// split only by UV or normal seams count as one.
+	std::vector<unsigned int> positionIds(const MeshData& mesh, size_t& uniqueCount);
+
+	// Points every triangle the same way as its neighbours and makes the result face
+	// outwards (positive volume). Triangles are connected through shared positions,
+	// so seams in UVs or normals don't split the mesh. Returns how many were flipped.
+	size_t fixWinding(MeshData& mesh);
+
+	// Tom Forsyth's linear speed vertex cache optimization (LRU cache model).
+	void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+	// Splits the cache optimized order into clusters and sorts them so triangles
+	// facing away from the mesh center come first (Tipsify style). 'threshold' is how
+	// much worse than the input the ACMR may get (1.05 = 5%).
+	void optimizeOverdraw(MeshData& mesh, float threshold = 1.05f);
+	// The same for the triangles in [firstIndex, firstIndex + indexCount) only, a submesh
+	// that's drawn on its own. The rest of the index buffer is left alone.
+	void optimizeOverdraw(MeshData& mesh, size_t firstIndex, size_t indexCount, float threshold = 1.05f);
+
+	// Renumbers vertices in the order the index buffer first uses them.
+	void optimizeVertexFetch(MeshData& mesh);
+
+	// Everything above, in the right order.
+	void optimize(MeshData& mesh);
+
+	// Simulates a FIFO post transform cache of 'cacheSize' vertices.
+	VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+}
@@ -0,0 +1,261 @@
+#include "MeshSimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Sum of squared distances to a set of planes, weighted by triangle area: a symmetric
+// 4x4 matrix stored as its upper triangle, plus the total weight so the error can be
+// turned back into a distance.
+struct Quadric {
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double weight;
+};
+
+static void addPlane(Quadric& q, const glm::dvec3& normal, double distance, double weight)
+{
+	q.a00 += weight * normal.x * normal.x;
+	q.a01 += weight * normal.x * normal.y;
+	q.a02 += weight * normal.x * normal.z;
+	q.a03 += weight * normal.x * distance;
+	q.a11 += weight * normal.y * normal.y;
+	q.a12 += weight * normal.y * normal.z;
+	q.a13 += weight * normal.y * distance;
+	q.a22 += weight * normal.z * normal.z;
+	q.a23 += weight * normal.z * distance;
+	q.a33 += weight * distance * distance;
+	q.weight += weight;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00;
+	q.a01 += other.a01;
+	q.a02 += other.a02;
+	q.a03 += other.a03;
+	q.a11 += other.a11;
+	q.a12 += other.a12;
+	q.a13 += other.a13;
+	q.a22 += other.a22;
+	q.a23 += other.a23;
+	q.a33 += other.a33;
+	q.weight += other.weight;
+}
+
+// Mean squared distance of 'p' to the planes.
+static double evaluate(const Quadric& q, const glm::dvec3& p)
+{
+	double sum = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z + q.a33
+		+ 2.0 * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z + q.a03 * p.x + q.a13 * p.y + q.a23 * p.z);
+
+	return q.weight > 0.0 ? std::max(sum, 0.0) / q.weight : 0.0;
+}
+
+static glm::dvec3 positionOf(const MeshData& mesh, unsigned int vertex)
+{
+	const float* p = &mesh.vertices[(size_t)vertex * mesh.floatsPerVertex];
+	return glm::dvec3(p[0], p[1], p[2]);
+}
+
+namespace MeshSimplifier {
+
+struct Collapse {
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+std::vector<unsigned int> simplify(const MeshData& mesh, const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, float& error)
+{
+	size_t vertexCount = mesh.vertexCount();
+	std::vector<unsigned int> triangles(indices, indices + indexCount);
+	error = 0.0f;
+
+	size_t uniquePositions = 0;
+	std::vector<unsigned int> positionIds = MeshOptimizer::positionIds(mesh, uniquePositions);
+
+	// Vertices that have to stay: on a seam (another vertex shares the position) or on an
+	// edge that doesn't have exactly two triangles, counted by position.
+	std::vector<unsigned int> verticesAtPosition(uniquePositions, 0);
+	std::vector<bool> used(vertexCount, false);
+	for (unsigned int v : triangles) {
+		used[v] = true;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		if (used[v])
+			verticesAtPosition[positionIds[v]]++;
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+	std::vector<uint64_t> edges;
+	edges.reserve(indexCount);
+
+	for (size_t i = 0; i < indexCount; i += 3) {
+		for (int e = 0; e < 3; e++) {
+			unsigned int a = positionIds[triangles[i + e]];
+			unsigned int b = positionIds[triangles[i + (e + 1) % 3]];
+			edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+	std::vector<bool> lockedPosition(uniquePositions, false);
+
+	for (size_t i = 0; i < edges.size();) {
+		size_t j = i;
+		while (j < edges.size() && edges[j] == edges[i]) {
+			j++;
+		}
+
+		if (j - i != 2) {
+			lockedPosition[edges[i] >> 32] = true;
+			lockedPosition[edges[i] & 0xFFFFFFFFu] = true;
+		}
+
+		i = j;
+	}
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		locked[v] = lockedPosition[positionIds[v]] || verticesAtPosition[positionIds[v]] > 1;
+	}
+
+	// Every vertex starts with the planes of its triangles.
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t i = 0; i < indexCount; i += 3) {
+		glm::dvec3 a = positionOf(mesh, triangles[i]);
+		glm::dvec3 normal = glm::cross(positionOf(mesh, triangles[i + 1]) - a, positionOf(mesh, triangles[i + 2]) - a);
+		double doubleArea = glm::length(normal);
+		if (doubleArea == 0.0)
+			continue;
+
+		normal /= doubleArea;
+		for (int c = 0; c < 3; c++) {
+			addPlane(quadrics[triangles[i + c]], normal, -glm::dot(normal, a), doubleArea * 0.5);
+		}
+	}
+
+	double maxCost = (double)maxError * maxError;
+	double worstCost = 0.0;
+
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+
+	// Collapses happen in passes: the cheapest edges first, each vertex (and the fan
+	// around a collapsing one) at most once per pass, then the triangles are rebuilt.
+	while (triangles.size() > targetIndexCount) {
+		size_t triangleCount = triangles.size() / 3;
+
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (unsigned int v : triangles) {
+			adjacencyOffsets[v + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+
+		adjacency.resize(triangles.size());
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangles.size(); i++) {
+			adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < triangles.size(); i++) {
+			unsigned int a = triangles[i];
+			unsigned int b = triangles[i - i % 3 + (i + 1) % 3];
+
+			// Both directions; the cheaper one that's allowed wins.
+			Quadric sum = quadrics[a];
+			addQuadric(sum, quadrics[b]);
+			double toB = locked[a] ? HUGE_VAL : evaluate(sum, positionOf(mesh, b));
+			double toA = locked[b] ? HUGE_VAL : evaluate(sum, positionOf(mesh, a));
+
+			if (toB <= toA && toB != HUGE_VAL)
+				collapses.push_back({ a, b, toB });
+			else if (toA < toB)
+				collapses.push_back({ b, a, toA });
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		for (size_t v = 0; v < vertexCount; v++) {
+			remap[v] = (unsigned int)v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Most collapses inside a mesh remove two triangles.
+		size_t trianglesLeft = triangleCount;
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t applied = 0;
+
+		for (const Collapse& collapse : collapses) {
+			if (collapse.cost > maxCost || trianglesLeft <= targetTriangles)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// Moving 'from' onto 'to' must not turn any of the other triangles around it over.
+			glm::dvec3 target = positionOf(mesh, collapse.to);
+			bool flips = false;
+
+			for (unsigned int a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+				const unsigned int* triangle = &triangles[(size_t)adjacency[a] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					continue;
+
+				glm::dvec3 before[3], after[3];
+				for (int c = 0; c < 3; c++) {
+					before[c] = positionOf(mesh, triangle[c]);
+					after[c] = triangle[c] == collapse.from ? target : before[c];
+				}
+
+				glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				flips = glm::dot(normalBefore, normalAfter) <= 0.0;
+			}
+
+			if (flips)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			worstCost = std::max(worstCost, collapse.cost);
+
+			for (unsigned int a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+				const unsigned int* triangle = &triangles[(size_t)adjacency[a] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+
+			trianglesLeft = trianglesLeft >= 2 ? trianglesLeft - 2 : 0;
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		size_t kept = 0;
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			unsigned int a = remap[triangles[i]], b = remap[triangles[i + 1]], c = remap[triangles[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			triangles[kept++] = a;
+			triangles[kept++] = b;
+			triangles[kept++] = c;
+		}
+
+		triangles.resize(kept);
+	}
+
+	error = (float)std::sqrt(worstCost);
+	return triangles;
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MeshOptimizer.hpp"
+
+constexpr uint32_t MESH_MAX_LODS = 8;
+
+// One level of detail: a range of the mesh's index buffer. Every level uses the same
+// vertices, so a chain only costs index memory. Stored as is in .mesh files.
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // roughly how far (object space units) the surface moved from level 0
+};
+
+// Offline level of detail generation with Garland and Heckbert's quadric error metric.
+// Edges collapse onto one of their two vertices, never onto a new point, so no vertex
+// is created and texture coordinates stay valid. Vertices on UV seams and open borders
+// never move, which keeps seams closed and submeshes from separating.
+namespace MeshSimplifier {
+	// Collapses the cheapest edges of indices[0, indexCount) until at most
+	// 'targetIndexCount' indices are left, or the next collapse would cost more than
+	// 'maxError'. 'error' gets the error of the result.
+	std::vector<unsigned int> simplify(const MeshData& mesh, const unsigned int* indices, size_t indexCount,
+		size_t targetIndexCount, float maxError, float& error);
+}
@@ -0,0 +1,424 @@
+#include "Meshlets.hpp"
+#include "PixelOps.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MESHLETS_X86 1
+#include <emmintrin.h>
+#else
+#define MESHLETS_X86 0
+#endif
+
+// How much a triangle facing away from the meshlet's average direction counts against
+// it, in new vertices. Tighter cones cull more, but cost vertices.
+constexpr float CONE_WEIGHT = 0.5f;
+
+// Below this the normals spread too far for the cone to ever cull anything.
+constexpr float MIN_CONE_DOT = 0.1f;
+
+static glm::vec3 positionOf(const MeshData& mesh, unsigned int vertex)
+{
+	const float* p = &mesh.vertices[(size_t)vertex * mesh.floatsPerVertex];
+	return glm::vec3(p[0], p[1], p[2]);
+}
+
+// Unit normal, or zero for degenerate triangles.
+static glm::vec3 triangleNormal(const MeshData& mesh, const unsigned int* triangle)
+{
+	glm::vec3 a = positionOf(mesh, triangle[0]);
+	glm::vec3 normal = glm::cross(positionOf(mesh, triangle[1]) - a, positionOf(mesh, triangle[2]) - a);
+	float length = glm::length(normal);
+
+	return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+namespace Meshlets {
+
+void build(MeshData& mesh, size_t firstIndex, size_t indexCount, uint32_t submesh, std::vector<Meshlet>& meshlets,
+	uint32_t maxVertices, uint32_t maxTriangles)
+{
+	const unsigned int* indices = mesh.indices.data() + firstIndex;
+	size_t triangleCount = indexCount / 3;
+	size_t vertexCount = mesh.vertexCount();
+
+	// The triangles of every vertex.
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacencyOffsets[indices[i] + 1]++;
+	}
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<glm::vec3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		normals[t] = triangleNormal(mesh, indices + t * 3);
+	}
+
+	std::vector<unsigned int> order;
+	order.reserve(triangleCount * 3);
+
+	std::vector<bool> emitted(triangleCount, false);
+	// The meshlet that last used each vertex, so membership is a single compare.
+	std::vector<uint32_t> vertexMeshlet(vertexCount, ~0u);
+	std::vector<unsigned int> candidates;
+
+	size_t firstMeshlet = meshlets.size();
+	size_t scan = 0; // everything before it is emitted
+
+	while (true) {
+		while (scan < triangleCount && emitted[scan]) {
+			scan++;
+		}
+
+		if (scan == triangleCount)
+			break;
+
+		uint32_t id = (uint32_t)(meshlets.size() - firstMeshlet);
+		Meshlet meshlet = {};
+		meshlet.firstIndex = (uint32_t)(firstIndex + order.size());
+		meshlet.submesh = submesh;
+
+		glm::vec3 normalSum(0.0f);
+		candidates.clear();
+		size_t next = scan;
+
+		auto newVertices = [&](size_t t) {
+			const unsigned int* triangle = indices + t * 3;
+			return (uint32_t)(vertexMeshlet[triangle[0]] != id) + (vertexMeshlet[triangle[1]] != id) + (vertexMeshlet[triangle[2]] != id);
+		};
+
+		while (true) {
+			const unsigned int* triangle = indices + next * 3;
+			emitted[next] = true;
+			order.insert(order.end(), triangle, triangle + 3);
+			meshlet.triangleCount++;
+			normalSum += normals[next];
+
+			for (int c = 0; c < 3; c++) {
+				unsigned int v = triangle[c];
+				if (vertexMeshlet[v] == id)
+					continue;
+
+				vertexMeshlet[v] = id;
+				meshlet.vertexCount++;
+
+				for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++) {
+					if (!emitted[adjacency[a]])
+						candidates.push_back(adjacency[a]);
+				}
+			}
+
+			if (meshlet.triangleCount == maxTriangles)
+				break;
+
+			float sumLength = glm::length(normalSum);
+			glm::vec3 averageNormal = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f);
+
+			// Emitted candidates are dropped on the way. Ties go to the earlier triangle,
+			// which keeps the vertex cache order as much as possible.
+			size_t best = triangleCount;
+			float bestScore = 0.0f;
+			size_t kept = 0;
+
+			for (size_t i = 0; i < candidates.size(); i++) {
+				unsigned int t = candidates[i];
+				if (emitted[t])
+					continue;
+
+				candidates[kept++] = t;
+
+				uint32_t added = newVertices(t);
+				if (meshlet.vertexCount + added > maxVertices)
+					continue;
+
+				float score = (float)added + CONE_WEIGHT * (1.0f - glm::dot(normals[t], averageNormal));
+				if (best == triangleCount || score < bestScore || (score == bestScore && t < best)) {
+					best = t;
+					bestScore = score;
+				}
+			}
+
+			candidates.resize(kept);
+
+			// Nothing connected left (seams, separate pieces): carry on with the next
+			// triangle in order, if it fits.
+			if (best == triangleCount) {
+				while (scan < triangleCount && emitted[scan]) {
+					scan++;
+				}
+
+				if (scan < triangleCount && meshlet.vertexCount + newVertices(scan) <= maxVertices)
+					best = scan;
+			}
+
+			if (best == triangleCount)
+				break;
+
+			next = best;
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(order.begin(), order.end(), mesh.indices.begin() + firstIndex);
+
+	for (size_t m = firstMeshlet; m < meshlets.size(); m++) {
+		computeBounds(mesh, meshlets[m]);
+	}
+}
+
+void computeBounds(const MeshData& mesh, Meshlet& meshlet)
+{
+	const unsigned int* indices = mesh.indices.data() + meshlet.firstIndex;
+	size_t cornerCount = (size_t)meshlet.triangleCount * 3;
+
+	// Ritter's sphere: start from two far apart points and grow it for the ones outside.
+	glm::vec3 first = positionOf(mesh, indices[0]);
+	glm::vec3 a = first, b = first;
+	float farthest = 0.0f;
+
+	for (size_t i = 0; i < cornerCount; i++) {
+		glm::vec3 p = positionOf(mesh, indices[i]);
+		float distance = glm::dot(p - first, p - first);
+		if (distance > farthest) {
+			farthest = distance;
+			a = p;
+		}
+	}
+
+	farthest = 0.0f;
+	for (size_t i = 0; i < cornerCount; i++) {
+		glm::vec3 p = positionOf(mesh, indices[i]);
+		float distance = glm::dot(p - a, p - a);
+		if (distance > farthest) {
+			farthest = distance;
+			b = p;
+		}
+	}
+
+	glm::vec3 center = (a + b) * 0.5f;
+	float radius = glm::length(b - a) * 0.5f;
+
+	for (size_t i = 0; i < cornerCount; i++) {
+		glm::vec3 p = positionOf(mesh, indices[i]);
+		float distance = glm::length(p - center);
+		if (distance > radius) {
+			float grown = (radius + distance) * 0.5f;
+			center += (p - center) * ((grown - radius) / distance);
+			radius = grown;
+		}
+	}
+
+	// The cone: the average normal and how far the worst triangle is from it.
+	glm::vec3 normalSum(0.0f);
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+		normalSum += triangleNormal(mesh, indices + t * 3);
+	}
+
+	float sumLength = glm::length(normalSum);
+	glm::vec3 axis = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f);
+	float minDot = sumLength > 0.0f ? 1.0f : -1.0f;
+
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+		glm::vec3 normal = triangleNormal(mesh, indices + t * 3);
+		if (normal != glm::vec3(0.0f))
+			minDot = std::min(minDot, glm::dot(normal, axis));
+	}
+
+	for (int c = 0; c < 3; c++) {
+		meshlet.center[c] = center[c];
+	}
+	meshlet.radius = radius;
+
+	if (minDot < MIN_CONE_DOT) {
+		meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+		meshlet.coneCutoff = 1.0f;
+	}
+	else {
+		for (int c = 0; c < 3; c++) {
+			meshlet.coneAxis[c] = axis[c];
+		}
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+void printStats(const MeshletCullStats& stats)
+{
+	if (stats.frames == 0)
+		return;
+
+	double frames = (double)stats.frames;
+	double culled = stats.triangles > 0 ? 100.0 * (double)(stats.triangles - stats.trianglesDrawn) / (double)stats.triangles : 0.0;
+
+	std::cout << "Meshlets per frame: " << stats.meshlets / frames << " tested, " << stats.frustumCulled / frames
+		<< " outside the frustum, " << stats.backfaceCulled / frames << " back facing; triangles "
+		<< stats.triangles / frames << " -> " << stats.trianglesDrawn / frames << " (" << culled << "% culled) in "
+		<< stats.drawRanges / frames << " ranges instead of " << stats.objects / frames << " draws, culling took "
+		<< stats.cullMilliseconds / frames << " ms" << std::endl;
+}
+
+}
+
+MeshletCuller::MeshletCuller()
+	: count(0), indexSize(4)
+{
+}
+
+void MeshletCuller::load(const Meshlet* meshlets, size_t meshletCount, unsigned int indexSize)
+{
+	this->count = meshletCount;
+	this->indexSize = indexSize;
+
+	// Padding never gets looked at, the results stop at 'count'.
+	size_t padded = (meshletCount + 3) & ~(size_t)3;
+	for (std::vector<float>* lane : { &centerX, &centerY, &centerZ, &radius, &axisX, &axisY, &axisZ, &cutoff }) {
+		lane->assign(padded, 0.0f);
+	}
+	firstIndex.assign(padded, 0);
+	triangleCount.assign(padded, 0);
+
+	for (size_t i = 0; i < meshletCount; i++) {
+		const Meshlet& meshlet = meshlets[i];
+		centerX[i] = meshlet.center[0];
+		centerY[i] = meshlet.center[1];
+		centerZ[i] = meshlet.center[2];
+		radius[i] = meshlet.radius;
+		axisX[i] = meshlet.coneAxis[0];
+		axisY[i] = meshlet.coneAxis[1];
+		axisZ[i] = meshlet.coneAxis[2];
+		cutoff[i] = meshlet.coneCutoff;
+		firstIndex[i] = meshlet.firstIndex;
+		triangleCount[i] = meshlet.triangleCount;
+	}
+}
+
+size_t MeshletCuller::size() const
+{
+	return count;
+}
+
+void MeshletCuller::cull(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, MeshletDraws& draws, MeshletCullStats& stats) const
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// The frustum planes in the mesh's space, straight from the matrix rows (Gribb and
+	// Hartmann), normalized so they give distances. glm indexes [column][row].
+	float planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		int row = p / 2;
+		float sign = (p & 1) ? -1.0f : 1.0f;
+
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = modelViewProjection[c][3] + sign * modelViewProjection[c][row];
+		}
+
+		float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] /= length;
+		}
+	}
+
+	// Per meshlet: 0 = visible, 1 = outside the frustum, 2 = back facing.
+	std::vector<unsigned char> verdicts(centerX.size());
+
+	// Back facing when every point of the sphere sees every triangle from behind:
+	// dot(center - camera, axis) >= cutoff * |center - camera| + radius.
+#if MESHLETS_X86
+	if (PixelOps::getSimdLevel() != PixelOps::SimdLevel::Scalar) {
+		__m128 cameraX = _mm_set1_ps(cameraPosition.x);
+		__m128 cameraY = _mm_set1_ps(cameraPosition.y);
+		__m128 cameraZ = _mm_set1_ps(cameraPosition.z);
+
+		for (size_t i = 0; i < count; i += 4) {
+			__m128 x = _mm_loadu_ps(&centerX[i]);
+			__m128 y = _mm_loadu_ps(&centerY[i]);
+			__m128 z = _mm_loadu_ps(&centerZ[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p][0])), _mm_mul_ps(y, _mm_set1_ps(planes[p][1]))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p][2])), _mm_set1_ps(planes[p][3])));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+			}
+
+			__m128 dx = _mm_sub_ps(x, cameraX);
+			__m128 dy = _mm_sub_ps(y, cameraY);
+			__m128 dz = _mm_sub_ps(z, cameraZ);
+			__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&axisX[i])), _mm_mul_ps(dy, _mm_loadu_ps(&axisY[i]))),
+				_mm_mul_ps(dz, _mm_loadu_ps(&axisZ[i])));
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 backfacing = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cutoff[i]), distance), r));
+
+			int outsideMask = _mm_movemask_ps(outside);
+			int backfacingMask = _mm_movemask_ps(backfacing);
+			for (int lane = 0; lane < 4; lane++) {
+				verdicts[i + lane] = ((outsideMask >> lane) & 1) ? 1 : ((backfacingMask >> lane) & 1) ? 2 : 0;
+			}
+		}
+	}
+	else
+#endif
+	{
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+			bool outside = false;
+
+			for (int p = 0; p < 6; p++) {
+				outside = outside || center.x * planes[p][0] + center.y * planes[p][1] + center.z * planes[p][2] + planes[p][3] < -radius[i];
+			}
+
+			glm::vec3 toCenter = center - cameraPosition;
+			bool backfacing = glm::dot(toCenter, glm::vec3(axisX[i], axisY[i], axisZ[i])) >= cutoff[i] * glm::length(toCenter) + radius[i];
+
+			verdicts[i] = outside ? 1 : backfacing ? 2 : 0;
+		}
+	}
+
+	// Meshlets are consecutive in the index buffer, so runs of visible ones are one draw.
+	draws.counts.clear();
+	draws.offsets.clear();
+	uint32_t rangeEnd = ~0u;
+
+	for (size_t i = 0; i < count; i++) {
+		stats.triangles += triangleCount[i];
+
+		if (verdicts[i] != 0) {
+			stats.frustumCulled += verdicts[i] == 1;
+			stats.backfaceCulled += verdicts[i] == 2;
+			continue;
+		}
+
+		stats.trianglesDrawn += triangleCount[i];
+		int indexCount = (int)triangleCount[i] * 3;
+
+		if (firstIndex[i] == rangeEnd) {
+			draws.counts.back() += indexCount;
+		}
+		else {
+			draws.counts.push_back(indexCount);
+			draws.offsets.push_back((const void*)((uintptr_t)firstIndex[i] * indexSize));
+		}
+
+		rangeEnd = firstIndex[i] + (uint32_t)indexCount;
+	}
+
+	stats.objects++;
+	stats.meshlets += count;
+	stats.drawRanges += draws.counts.size();
+	stats.cullMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MeshOptimizer.hpp"
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A small cluster of triangles that share vertices: a contiguous range of the mesh's
+// index buffer with at most MESHLET_MAX_VERTICES different vertices. Small enough that
+// one bounding sphere and one normal cone describe it well, so whole clusters can be
+// skipped when they're off screen or facing away. Stored as is in .mesh files.
+struct Meshlet {
+	uint32_t firstIndex;
+	uint32_t triangleCount;
+	uint32_t vertexCount;
+	uint32_t submesh;
+	float center[3];   // bounding sphere
+	float radius;
+	float coneAxis[3]; // the direction the triangles face, on average
+	float coneCutoff;  // sin of the angle between the axis and the furthest normal, 1 = never back facing
+};
+
+// Per frame totals of MeshletCuller::cull.
+struct MeshletCullStats {
+	size_t frames;
+	size_t objects;         // cull calls, what would have been one draw each
+	size_t meshlets;
+	size_t frustumCulled;
+	size_t backfaceCulled;
+	size_t triangles;
+	size_t trianglesDrawn;
+	size_t drawRanges;      // sub draws handed to glMultiDrawElements
+	double cullMilliseconds;
+};
+
+// What glMultiDrawElements takes: index counts and byte offsets into the index buffer.
+struct MeshletDraws {
+	std::vector<int> counts;
+	std::vector<const void*> offsets;
+};
+
+namespace Meshlets {
+	// Reorders the triangles in indices[firstIndex, firstIndex + indexCount) so they form
+	// meshlets and appends those. Meshlets grow through triangles that share vertices with
+	// them, preferring ones that add the fewest new vertices and face the same way. Run it
+	// after the vertex cache optimization: ties keep that order.
+	void build(MeshData& mesh, size_t firstIndex, size_t indexCount, uint32_t submesh, std::vector<Meshlet>& meshlets,
+		uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+	// Fills center, radius and the cone from the triangles of the meshlet.
+	void computeBounds(const MeshData& mesh, Meshlet& meshlet);
+
+	// Averages over the frames the stats cover, on one line.
+	void printStats(const MeshletCullStats& stats);
+}
+
+// Frustum and back face culling of a mesh's meshlets on the CPU, four at a time with
+// SSE (PixelOps::setSimdLevel forces the scalar version). GL 3.3 has no compute shaders
+// or indirect draws, so what survives goes to glMultiDrawElements, with neighbouring
+// ranges merged into one.
+class MeshletCuller {
+    private:
+	// Structure of arrays, padded to a multiple of 4.
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;
+	std::vector<uint32_t> firstIndex, triangleCount;
+	size_t count;
+	unsigned int indexSize;
+
+    public:
+	MeshletCuller();
+
+	// 'indexSize' is 2 or 4, for the byte offsets of the draws.
+	void load(const Meshlet* meshlets, size_t meshletCount, unsigned int indexSize);
+	size_t size() const;
+
+	// 'modelViewProjection' takes the mesh to clip space and 'cameraPosition' is in the
+	// mesh's own space. The cone test assumes the model matrix scales uniformly.
+	// Replaces the contents of 'draws' and adds to 'stats'.
+	void cull(const glm::mat4& modelViewProjection, const glm::vec3& cameraPosition, MeshletDraws& draws, MeshletCullStats& stats) const;
+};
@@ -0,0 +1,414 @@
+#include "MipGenerator.hpp"
+#include "AssetCooker.hpp"
+#include "JobSystem.hpp"
+#include "PixelOps.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Weights for halving an image, see PixelOps::kaiserWeights. The sizes match the
+// comments on MipFilter.
+static std::vector<float> weightsFor(MipFilter filter)
+{
+	switch (filter) {
+		case MipFilter::Kaiser:
+			return PixelOps::kaiserWeights(8);
+		case MipFilter::Lanczos:
+			return PixelOps::lanczosWeights(12);
+		case MipFilter::Box:
+		default:
+			return { 0.5f, 0.5f };
+	}
+}
+
+// Filters the output rectangle [x0, x1) x [y0, y1) of the next level. Each tile does
+// its own horizontal pass over the source rows it needs, so tiles share nothing.
+static void downsampleTile(const std::vector<float>& source, int width, int height, std::vector<float>& destination, int newWidth,
+	const std::vector<float>& weights, int x0, int x1, int y0, int y1)
+{
+	const int taps = (int)weights.size();
+	const int firstRow = std::max(y0 * 2 - taps / 2 + 1, 0);
+	const int lastRow = std::min((y1 - 1) * 2 + taps / 2, height - 1);
+	const int tileWidth = x1 - x0;
+
+	std::vector<float> rows((size_t)(lastRow - firstRow + 1) * tileWidth * 4);
+
+	for (int sy = firstRow; sy <= lastRow; sy++) {
+		PixelOps::downsampleRow(&source[(size_t)sy * width * 4], width, x0, x1, weights.data(), taps,
+			&rows[(size_t)(sy - firstRow) * tileWidth * 4]);
+	}
+
+	std::vector<const float*> tapRows(taps);
+
+	for (int y = y0; y < y1; y++) {
+		for (int t = 0; t < taps; t++) {
+			int sy = std::max(0, std::min(y * 2 + t - taps / 2 + 1, height - 1));
+			tapRows[t] = &rows[(size_t)(sy - firstRow) * tileWidth * 4];
+		}
+
+		PixelOps::blendRows(tapRows.data(), weights.data(), taps, (size_t)tileWidth * 4, &destination[((size_t)y * newWidth + x0) * 4]);
+	}
+}
+
+static float alphaCoverage(const std::vector<float>& pixels, float scale, float reference)
+{
+	size_t count = pixels.size() / 4;
+	size_t covered = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (pixels[i * 4 + 3] * scale > reference)
+			covered++;
+	}
+
+	return count > 0 ? (float)covered / (float)count : 0.0f;
+}
+
+MipGenerator::MipGenerator(JobSystem& jobs, const MipSettings& settings)
+	: jobs(jobs), settings(settings)
+{
+}
+
+const MipSettings& MipGenerator::getSettings() const
+{
+	return settings;
+}
+
+std::string MipGenerator::settingsKey() const
+{
+	char key[64];
+	snprintf(key, sizeof(key), "f%d-g%d-c%d-%.3f", (int)settings.filter, settings.gammaCorrect ? 1 : 0,
+		settings.preserveAlphaCoverage ? 1 : 0, settings.alphaReference);
+	return key;
+}
+
+int MipGenerator::levelCount(int width, int height)
+{
+	int levels = 1;
+	int size = std::max(width, height);
+
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+std::vector<MipLevel> MipGenerator::generate(const unsigned char* rgba, int width, int height, int lastLevel) const
+{
+	if (lastLevel < 0 || lastLevel >= levelCount(width, height))
+		lastLevel = levelCount(width, height) - 1;
+
+	std::vector<MipLevel> levels;
+	levels.push_back({ width, height, std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4) });
+
+	if (lastLevel == 0)
+		return levels;
+
+	const std::vector<float> weights = weightsFor(settings.filter);
+	const unsigned int bands = (unsigned int)((height + TILE_SIZE - 1) / TILE_SIZE);
+
+	// Level 0 to linear, premultiplied floats. Premultiplying keeps the color of fully
+	// transparent texels from bleeding into their neighbours.
+	std::vector<float> current((size_t)width * height * 4);
+	jobs.parallelFor(bands, [&](unsigned int band) {
+		int y0 = band * TILE_SIZE;
+		int y1 = std::min(y0 + TILE_SIZE, height);
+		size_t first = (size_t)y0 * width * 4;
+		size_t count = (size_t)(y1 - y0) * width * 4;
+
+		if (settings.gammaCorrect) {
+			PixelOps::srgbToLinear(rgba + first, &current[first], count);
+		}
+		else {
+			for (size_t i = first; i < first + count; i++) {
+				current[i] = rgba[i] / 255.0f;
+			}
+		}
+
+		for (size_t i = first; i < first + count; i += 4) {
+			float alpha = rgba[i + 3] / 255.0f;
+			current[i + 0] *= alpha;
+			current[i + 1] *= alpha;
+			current[i + 2] *= alpha;
+			current[i + 3] = alpha;
+		}
+	});
+
+	float targetCoverage = settings.preserveAlphaCoverage ? alphaCoverage(current, 1.0f, settings.alphaReference) : 0.0f;
+
+	std::vector<float> next;
+	int levelWidth = width, levelHeight = height;
+
+	for (int level = 1; level <= lastLevel; level++) {
+		int newWidth = std::max(levelWidth >> 1, 1);
+		int newHeight = std::max(levelHeight >> 1, 1);
+		int tilesX = (newWidth + TILE_SIZE - 1) / TILE_SIZE;
+		int tilesY = (newHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+		next.assign((size_t)newWidth * newHeight * 4, 0.0f);
+		jobs.parallelFor((unsigned int)(tilesX * tilesY), [&](unsigned int tile) {
+			int x0 = (tile % tilesX) * TILE_SIZE;
+			int y0 = (tile / tilesX) * TILE_SIZE;
+			downsampleTile(current, levelWidth, levelHeight, next, newWidth, weights,
+				x0, std::min(x0 + TILE_SIZE, newWidth), y0, std::min(y0 + TILE_SIZE, newHeight));
+		});
+
+		// Binary search for the alpha scale that gives back level 0's coverage.
+		float alphaScale = 1.0f;
+		if (settings.preserveAlphaCoverage && targetCoverage > 0.0f) {
+			float low = 0.0f, high = 16.0f;
+
+			for (int i = 0; i < 16; i++) {
+				float middle = (low + high) * 0.5f;
+				if (alphaCoverage(next, middle, settings.alphaReference) < targetCoverage)
+					low = middle;
+				else
+					high = middle;
+			}
+
+			alphaScale = high;
+		}
+
+		// Back to straight alpha and 8-bit, in tiles of rows as well.
+		MipLevel mip = { newWidth, newHeight, std::vector<unsigned char>((size_t)newWidth * newHeight * 4) };
+		unsigned int levelBands = (unsigned int)((newHeight + TILE_SIZE - 1) / TILE_SIZE);
+
+		jobs.parallelFor(levelBands, [&](unsigned int band) {
+			int y0 = band * TILE_SIZE;
+			int y1 = std::min(y0 + TILE_SIZE, newHeight);
+			size_t first = (size_t)y0 * newWidth * 4;
+			size_t count = (size_t)(y1 - y0) * newWidth * 4;
+			std::vector<float> straight(&next[first], &next[first] + count);
+
+			for (size_t i = 0; i < count; i += 4) {
+				float alpha = straight[i + 3];
+				if (alpha > 0.0f) {
+					straight[i + 0] /= alpha;
+					straight[i + 1] /= alpha;
+					straight[i + 2] /= alpha;
+				}
+			}
+
+			unsigned char* out = &mip.pixels[first];
+			if (settings.gammaCorrect) {
+				PixelOps::linearToSrgb(straight.data(), out, count);
+			}
+			else {
+				for (size_t i = 0; i < count; i++) {
+					out[i] = (unsigned char)(std::min(straight[i], 1.0f) * 255.0f + 0.5f);
+				}
+			}
+
+			// Alpha was never gamma encoded.
+			for (size_t i = 3; i < count; i += 4) {
+				out[i] = (unsigned char)(std::min(straight[i] * alphaScale, 1.0f) * 255.0f + 0.5f);
+			}
+		});
+
+		levels.push_back(std::move(mip));
+
+		current.swap(next);
+		levelWidth = newWidth;
+		levelHeight = newHeight;
+	}
+
+	return levels;
+}
+
+// ---- Cache file ----------------------------------------------------------------
+
+static const char CACHE_MAGIC[4] = { 'M', 'I', 'P', 'C' };
+static const uint32_t CACHE_VERSION = 2;
+// Magic, version, level count and the content hash, then the level table.
+static const size_t CACHE_TABLE_OFFSET = 4 + sizeof(uint32_t) * 2 + sizeof(uint64_t);
+
+struct CacheLevelEntry {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;
+	uint64_t size;
+};
+
+bool MipGenerator::writeCache(const std::string& path, const std::vector<MipLevel>& levels)
+{
+	// Written next to the real name and renamed at the end, so a reader on another
+	// thread never sees half a file. The temporary name is unique per write (thread and
+	// counter), or two jobs caching the same chain would write into one file together.
+	static std::atomic<uint32_t> writes(0);
+	size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+	std::string temporary = path + "." + std::to_string(thread) + "." + std::to_string(writes++) + ".tmp";
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+	if (!file)
+		return false;
+
+	// Hashed once here, so whoever wants to know if two chains are the same only has to
+	// read the header (see AssetManager).
+	uint64_t hash = AssetCooker::hashBytes(nullptr, 0);
+	for (const MipLevel& level : levels) {
+		uint32_t size[2] = { (uint32_t)level.width, (uint32_t)level.height };
+		hash = AssetCooker::hashBytes(size, sizeof(size), hash);
+		hash = AssetCooker::hashBytes(level.pixels.data(), level.pixels.size(), hash);
+	}
+
+	uint32_t count = (uint32_t)levels.size();
+	file.write(CACHE_MAGIC, 4);
+	file.write((const char*)&CACHE_VERSION, sizeof(CACHE_VERSION));
+	file.write((const char*)&count, sizeof(count));
+	file.write((const char*)&hash, sizeof(hash));
+
+	uint64_t offset = CACHE_TABLE_OFFSET + sizeof(CacheLevelEntry) * count;
+	for (const MipLevel& level : levels) {
+		CacheLevelEntry entry = { (uint32_t)level.width, (uint32_t)level.height, offset, level.pixels.size() };
+		file.write((const char*)&entry, sizeof(entry));
+		offset += entry.size;
+	}
+
+	for (const MipLevel& level : levels) {
+		file.write((const char*)level.pixels.data(), level.pixels.size());
+	}
+
+	file.close();
+
+	if (!file) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	std::remove(path.c_str());
+	if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool MipGenerator::readCache(const std::string& path, int firstLevel, int lastLevel, std::vector<MipLevel>& levels, int& baseWidth, int& baseHeight)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	char magic[4];
+	uint32_t version = 0, count = 0;
+	uint64_t hash = 0;
+	file.read(magic, 4);
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&count, sizeof(count));
+	file.read((char*)&hash, sizeof(hash));
+
+	if (!file || std::equal(magic, magic + 4, CACHE_MAGIC) == false || version != CACHE_VERSION || count == 0)
+		return false;
+
+	std::vector<CacheLevelEntry> entries(count);
+	file.read((char*)entries.data(), sizeof(CacheLevelEntry) * count);
+
+	if (!file)
+		return false;
+
+	baseWidth = (int)entries[0].width;
+	baseHeight = (int)entries[0].height;
+	lastLevel = std::min(lastLevel, (int)count - 1);
+
+	for (int level = std::max(firstLevel, 0); level <= lastLevel; level++) {
+		const CacheLevelEntry& entry = entries[level];
+		MipLevel mip = { (int)entry.width, (int)entry.height, std::vector<unsigned char>(entry.size) };
+
+		file.seekg((std::streamoff)entry.offset);
+		file.read((char*)mip.pixels.data(), entry.size);
+
+		if (!file)
+			return false;
+
+		levels.push_back(std::move(mip));
+	}
+
+	return true;
+}
+
+bool MipGenerator::readCache(const unsigned char* data, size_t size, int firstLevel, int lastLevel, std::vector<MipLevel>& levels, int& baseWidth, int& baseHeight)
+{
+	size_t tableOffset = CACHE_TABLE_OFFSET;
+	uint32_t version = 0, count = 0;
+
+	if (data == nullptr || size < tableOffset || std::equal(data, data + 4, CACHE_MAGIC) == false)
+		return false;
+
+	memcpy(&version, data + 4, sizeof(version));
+	memcpy(&count, data + 8, sizeof(count));
+
+	if (version != CACHE_VERSION || count == 0 || (size - tableOffset) / sizeof(CacheLevelEntry) < count)
+		return false;
+
+	std::vector<CacheLevelEntry> entries(count);
+	memcpy(entries.data(), data + tableOffset, sizeof(CacheLevelEntry) * count);
+
+	baseWidth = (int)entries[0].width;
+	baseHeight = (int)entries[0].height;
+	lastLevel = std::min(lastLevel, (int)count - 1);
+
+	// Only the pages of the levels asked for are touched, the rest of a mapped file
+	// never gets read from disk.
+	for (int level = std::max(firstLevel, 0); level <= lastLevel; level++) {
+		const CacheLevelEntry& entry = entries[level];
+
+		if (entry.offset > size || entry.size > size - entry.offset)
+			return false;
+
+		levels.push_back({ (int)entry.width, (int)entry.height, std::vector<unsigned char>(data + entry.offset, data + entry.offset + entry.size) });
+	}
+
+	return true;
+}
+
+bool MipGenerator::readCacheOffsets(const unsigned char* data, size_t size, std::vector<uint64_t>& offsets)
+{
+	size_t tableOffset = CACHE_TABLE_OFFSET;
+	uint32_t version = 0, count = 0;
+
+	if (data == nullptr || size < tableOffset || std::equal(data, data + 4, CACHE_MAGIC) == false)
+		return false;
+
+	memcpy(&version, data + 4, sizeof(version));
+	memcpy(&count, data + 8, sizeof(count));
+
+	if (version != CACHE_VERSION || count == 0 || (size - tableOffset) / sizeof(CacheLevelEntry) < count)
+		return false;
+
+	offsets.clear();
+	for (uint32_t level = 0; level < count; level++) {
+		CacheLevelEntry entry;
+		memcpy(&entry, data + tableOffset + sizeof(CacheLevelEntry) * level, sizeof(entry));
+
+		if (entry.offset > size || entry.size > size - entry.offset || entry.size != (uint64_t)entry.width * entry.height * 4)
+			return false;
+
+		offsets.push_back(entry.offset);
+	}
+
+	return true;
+}
+
+bool MipGenerator::readCacheHash(const unsigned char* data, size_t size, uint64_t& hash)
+{
+	uint32_t version = 0;
+
+	if (data == nullptr || size < CACHE_TABLE_OFFSET || std::equal(data, data + 4, CACHE_MAGIC) == false)
+		return false;
+
+	memcpy(&version, data + 4, sizeof(version));
+	if (version != CACHE_VERSION)
+		return false;
+
+	memcpy(&hash, data + 12, sizeof(hash));
+	return true;
+}
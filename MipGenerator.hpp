@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+enum class MipFilter {
+	Box,     // 2x2 average, what glGenerateMipmap does on most drivers
+	Kaiser,  // 8 tap Kaiser windowed sinc, sharp with little ringing
+	Lanczos  // 12 tap Lanczos 3, the sharpest, rings a bit more
+};
+
+struct MipSettings {
+	MipFilter filter = MipFilter::Kaiser;
+	// Filter color in linear space instead of on the raw sRGB values, so mips don't
+	// get darker than the image they come from.
+	bool gammaCorrect = true;
+	// Rescale alpha on every level so the same fraction of texels passes the alpha
+	// test as on level 0 (otherwise cutouts fade away in the distance).
+	bool preserveAlphaCoverage = false;
+	float alphaReference = 0.5f;
+};
+
+struct MipLevel {
+	int width;
+	int height;
+	std::vector<unsigned char> pixels; // RGBA8
+};
+
+// Builds full mip chains on the CPU, spread over the job system in tiles, so that
+// textures can be uploaded level by level with glTexImage2D instead of calling
+// glGenerateMipmap on the GL thread. Chains can be written to a cache file and
+// single levels read back without decoding the image again.
+class MipGenerator {
+    private:
+	JobSystem& jobs;
+	MipSettings settings;
+    public:
+	static constexpr int TILE_SIZE = 64;
+
+	MipGenerator(JobSystem& jobs, const MipSettings& settings = MipSettings());
+
+	// 'rgba' is level 0. Returns levels 0 ... lastLevel (-1 for the whole chain down to 1x1).
+	std::vector<MipLevel> generate(const unsigned char* rgba, int width, int height, int lastLevel = -1) const;
+
+	const MipSettings& getSettings() const;
+
+	// A short string that changes whenever the settings change the output, to be
+	// mixed into cache keys.
+	std::string settingsKey() const;
+
+	static int levelCount(int width, int height);
+
+	// Cache file: a header (with a hash of all the levels), a table with the size and
+	// offset of every level, and the pixels of each level one after the other.
+	static bool writeCache(const std::string& path, const std::vector<MipLevel>& levels);
+	// Reads levels firstLevel ... lastLevel (clamped to what's in the file). An empty
+	// range (firstLevel > lastLevel) only reads the size of level 0.
+	static bool readCache(const std::string& path, int firstLevel, int lastLevel, std::vector<MipLevel>& levels, int& baseWidth, int& baseHeight);
+	// The same out of a file that's already in memory (mapped, or out of a pack).
+	static bool readCache(const unsigned char* data, size_t size, int firstLevel, int lastLevel, std::vector<MipLevel>& levels, int& baseWidth, int& baseHeight);
+	// Where each level's pixels start in the file, for reading them some other way.
+	static bool readCacheOffsets(const unsigned char* data, size_t size, std::vector<uint64_t>& offsets);
+	// The hash of the levels writeCache stored, without touching any of them.
+	static bool readCacheHash(const unsigned char* data, size_t size, uint64_t& hash);
+};
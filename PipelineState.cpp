@@ -0,0 +1,211 @@
+#include "PipelineState.hpp"
+#include "AssetCooker.hpp"
+#include "Shader.hpp"
+#include <iostream>
+
+uint64_t PipelineStateDesc::hash() const
+{
+	// The shader is the Shader object, which keeps its identity when its program is
+	// rebuilt (see HotReloader).
+	uintptr_t shaderAddress = (uintptr_t)shader;
+	uint64_t hash = AssetCooker::hashBytes(&shaderAddress, sizeof(shaderAddress));
+
+	uint64_t vertexInputHash = vertexInput.hash();
+	hash = AssetCooker::hashBytes(&vertexInputHash, sizeof(vertexInputHash), hash);
+
+	// Field by field, so padding doesn't count.
+	uint32_t words[12] = {
+		depth.test, depth.write, depth.func,
+		blend.enabled, blend.colorSource, blend.colorDestination, blend.alphaSource, blend.alphaDestination, blend.equation,
+		raster.cullFace, raster.frontFace, raster.polygonMode
+	};
+
+	return AssetCooker::hashBytes(words, sizeof(words), hash);
+}
+
+bool PipelineStateDesc::operator==(const PipelineStateDesc& other) const
+{
+	return shader == other.shader && vertexInput == other.vertexInput
+		&& depth.test == other.depth.test && depth.write == other.depth.write && depth.func == other.depth.func
+		&& blend.enabled == other.blend.enabled && blend.colorSource == other.blend.colorSource
+		&& blend.colorDestination == other.blend.colorDestination && blend.alphaSource == other.blend.alphaSource
+		&& blend.alphaDestination == other.blend.alphaDestination && blend.equation == other.blend.equation
+		&& raster.cullFace == other.raster.cullFace && raster.frontFace == other.raster.frontFace
+		&& raster.polygonMode == other.raster.polygonMode;
+}
+
+PipelineState::PipelineState(const PipelineStateDesc& desc, uint64_t hash)
+	: desc(desc), hash(hash)
+{
+}
+
+const PipelineStateDesc& PipelineState::getDesc() const
+{
+	return desc;
+}
+
+uint64_t PipelineState::getHash() const
+{
+	return hash;
+}
+
+PipelineStateCache::PipelineStateCache()
+	: bound(nullptr), applied(), stats()
+{
+}
+
+const PipelineState& PipelineStateCache::create(const PipelineStateDesc& desc)
+{
+	// Keyed by the whole description: a hash alone could hand two different ones the
+	// same state.
+	auto known = states.find(desc);
+	if (known != states.end())
+		return known->second;
+
+	// Map nodes don't move, so the reference stays good as more are made.
+	return states.emplace(desc, PipelineState(desc, desc.hash())).first->second;
+}
+
+void PipelineStateCache::applyDepth(const DepthState& depth)
+{
+	if (!applied.known || applied.depth.test != depth.test) {
+		if (depth.test)
+			glEnable(GL_DEPTH_TEST);
+		else
+			glDisable(GL_DEPTH_TEST);
+		stats.stateChanges++;
+	}
+
+	if (!applied.known || applied.depth.write != depth.write) {
+		glDepthMask(depth.write ? GL_TRUE : GL_FALSE);
+		stats.stateChanges++;
+	}
+
+	if (!applied.known || applied.depth.func != depth.func) {
+		glDepthFunc(depth.func);
+		stats.stateChanges++;
+	}
+
+	applied.depth = depth;
+}
+
+void PipelineStateCache::applyBlend(const BlendState& blend)
+{
+	if (!applied.known || applied.blend.enabled != blend.enabled) {
+		if (blend.enabled)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+		stats.stateChanges++;
+	}
+
+	applied.blend.enabled = blend.enabled;
+
+	// The factors of a state that doesn't blend don't matter, they're left as they are.
+	if (!blend.enabled)
+		return;
+
+	if (!applied.blendFactorsKnown || applied.blend.colorSource != blend.colorSource || applied.blend.colorDestination != blend.colorDestination
+		|| applied.blend.alphaSource != blend.alphaSource || applied.blend.alphaDestination != blend.alphaDestination) {
+		glBlendFuncSeparate(blend.colorSource, blend.colorDestination, blend.alphaSource, blend.alphaDestination);
+		stats.stateChanges++;
+	}
+
+	if (!applied.blendFactorsKnown || applied.blend.equation != blend.equation) {
+		glBlendEquation(blend.equation);
+		stats.stateChanges++;
+	}
+
+	applied.blend = blend;
+	applied.blendFactorsKnown = true;
+}
+
+void PipelineStateCache::applyRaster(const RasterState& raster)
+{
+	bool cull = raster.cullFace != GL_NONE;
+	if (!applied.known || applied.cull != cull) {
+		if (cull)
+			glEnable(GL_CULL_FACE);
+		else
+			glDisable(GL_CULL_FACE);
+		stats.stateChanges++;
+	}
+
+	applied.cull = cull;
+
+	if (cull && (!applied.cullFaceKnown || applied.cullFace != raster.cullFace)) {
+		glCullFace(raster.cullFace);
+		applied.cullFace = raster.cullFace;
+		applied.cullFaceKnown = true;
+		stats.stateChanges++;
+	}
+
+	if (!applied.known || applied.frontFace != raster.frontFace) {
+		glFrontFace(raster.frontFace);
+		applied.frontFace = raster.frontFace;
+		stats.stateChanges++;
+	}
+
+	// Core profiles only have GL_FRONT_AND_BACK here.
+	if (!applied.known || applied.polygonMode != raster.polygonMode) {
+		glPolygonMode(GL_FRONT_AND_BACK, raster.polygonMode);
+		applied.polygonMode = raster.polygonMode;
+		stats.stateChanges++;
+	}
+}
+
+void PipelineStateCache::bind(const PipelineState& state)
+{
+	const PipelineStateDesc& desc = state.getDesc();
+
+	// Always asked for, the StateCache skips it when it's in use. A hot reload can give
+	// the same Shader a new program.
+	if (desc.shader != nullptr)
+		desc.shader->use();
+
+	if (bound == &state && applied.known) {
+		stats.skipped++;
+		return;
+	}
+
+	applyDepth(desc.depth);
+	applyBlend(desc.blend);
+	applyRaster(desc.raster);
+	applied.known = true;
+
+	bound = &state;
+	stats.binds++;
+}
+
+GLuint PipelineStateCache::bindVertexBuffers(const VertexStream* streams, GLuint indexBuffer)
+{
+	if (bound == nullptr) {
+		std::cout << "ERROR::PIPELINE_STATE::NOTHING_BOUND" << std::endl;
+		return 0;
+	}
+
+	return VertexArrayCache::current().bind(bound->getDesc().vertexInput, streams, indexBuffer);
+}
+
+void PipelineStateCache::invalidate()
+{
+	applied.known = false;
+	applied.blendFactorsKnown = false;
+	applied.cullFaceKnown = false;
+	bound = nullptr;
+}
+
+size_t PipelineStateCache::size() const
+{
+	return states.size();
+}
+
+PipelineStateStats PipelineStateCache::getStats() const
+{
+	return stats;
+}
+
+void PipelineStateCache::resetStats()
+{
+	stats = {};
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "VertexArrayCache.hpp"
+
+class Shader;
+
+// The defaults are what the cubes draw with: depth tested, back faces culled, opaque.
+struct DepthState {
+	bool test = true;
+	bool write = true;
+	GLenum func = GL_LESS;
+};
+
+struct BlendState {
+	bool enabled = false;
+	GLenum colorSource = GL_ONE;
+	GLenum colorDestination = GL_ZERO;
+	GLenum alphaSource = GL_ONE;
+	GLenum alphaDestination = GL_ZERO;
+	GLenum equation = GL_FUNC_ADD;
+};
+
+struct RasterState {
+	GLenum cullFace = GL_BACK;    // GL_NONE draws both sides
+	GLenum frontFace = GL_CCW;
+	GLenum polygonMode = GL_FILL; // GL_LINE for wireframe
+};
+
+// Everything a draw needs set apart from its buffers, textures and uniforms.
+struct PipelineStateDesc {
+	Shader* shader = nullptr;
+	VertexArrayDesc vertexInput;
+	DepthState depth;
+	BlendState blend;
+	RasterState raster;
+
+	uint64_t hash() const;
+	bool operator==(const PipelineStateDesc& other) const;
+};
+
+struct PipelineStateDescHash {
+	size_t operator()(const PipelineStateDesc& desc) const
+	{
+		return (size_t)desc.hash();
+	}
+};
+
+// A PipelineStateDesc that's been made into a state once, and never changes afterwards.
+class PipelineState {
+    private:
+	PipelineStateDesc desc;
+	uint64_t hash;
+    public:
+	PipelineState(const PipelineStateDesc& desc, uint64_t hash);
+
+	const PipelineStateDesc& getDesc() const;
+	uint64_t getHash() const;
+};
+
+struct PipelineStateStats {
+	size_t binds;        // binds of a state other than the bound one
+	size_t skipped;      // binds of the state that was bound already
+	size_t stateChanges; // depth, blend and raster calls that went to GL
+};
+
+// Pipeline states made up front (create), found by their description, so equal
+// descriptions get the same state (two that only share a hash get one each). Binding one compares it with what GL has,
+// field by field, and only makes the GL calls for the fields that differ: going from a
+// solid to a wireframe state is one glPolygonMode, and two states that only differ in
+// their vertex input don't change any fixed function state at all. Programs and VAOs go
+// through the StateCache and the VertexArrayCache, which skip what's bound already.
+//
+// Everything that changes depth, blend or raster state has to do it through here (or
+// call invalidate), or the diff is against the wrong state. GL thread only.
+class PipelineStateCache {
+    private:
+	// What GL has. 'known' is false until the first bind (and after invalidate), which
+	// sets everything. Blend factors and the cull face are only set while they're used,
+	// so they're known on their own.
+	struct AppliedState {
+		bool known;
+		bool blendFactorsKnown;
+		bool cullFaceKnown;
+		DepthState depth;
+		BlendState blend;
+		bool cull;
+		GLenum cullFace;
+		GLenum frontFace;
+		GLenum polygonMode;
+	};
+
+	std::unordered_map<PipelineStateDesc, PipelineState, PipelineStateDescHash> states;
+	const PipelineState* bound;
+	AppliedState applied;
+	PipelineStateStats stats;
+
+	void applyDepth(const DepthState& depth);
+	void applyBlend(const BlendState& blend);
+	void applyRaster(const RasterState& raster);
+    public:
+	PipelineStateCache();
+
+	PipelineStateCache(const PipelineStateCache&) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+	// The state for 'desc', made the first time. It stays valid as long as the cache.
+	const PipelineState& create(const PipelineStateDesc& desc);
+
+	// Uses the state's shader and sets whatever of the rest differs from what's set.
+	void bind(const PipelineState& state);
+	// The bound state's vertex input reading binding i from streams[i] and indices from
+	// 'indexBuffer' (see VertexArrayCache::bind). Returns the VAO.
+	GLuint bindVertexBuffers(const VertexStream* streams, GLuint indexBuffer);
+
+	// After state was changed behind the cache's back: the next bind sets everything.
+	void invalidate();
+
+	size_t size() const;
+
+	PipelineStateStats getStats() const;
+	void resetStats();
+};
@@ -0,0 +1,1009 @@
+#include "PixelOps.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXELOPS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define PIXELOPS_X86 0
+#endif
+
+// GCC and Clang only allow intrinsics of extensions the function was compiled for.
+// MSVC allows them anywhere.
+#if PIXELOPS_X86 && !defined(_MSC_VER)
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+namespace PixelOps {
+
+static SimdLevel currentLevel = detectSimdLevel();
+
+SimdLevel detectSimdLevel()
+{
+#if PIXELOPS_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+
+	if (maxLeaf >= 7 && osxsave && avx) {
+		// The OS also has to save the YMM registers on context switches.
+		bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool ssse3 = __builtin_cpu_supports("ssse3");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (avx2)
+		return SimdLevel::AVX2;
+
+	if (ssse3)
+		return SimdLevel::SSE;
+#endif
+
+	return SimdLevel::Scalar;
+}
+
+SimdLevel getSimdLevel()
+{
+	return currentLevel;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+	currentLevel = std::min(level, detectSimdLevel());
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+	switch (level) {
+		case SimdLevel::AVX2: return "AVX2";
+		case SimdLevel::SSE: return "SSE";
+		default: return "Scalar";
+	}
+}
+
+// ---- RGB(A) expansion ---------------------------------------------------------
+
+static void expandScalar(const unsigned char* source, int channels, unsigned char* destination, size_t pixelCount)
+{
+	for (size_t i = 0; i < pixelCount; i++) {
+		const unsigned char* in = source + i * channels;
+		unsigned char* out = destination + i * 4;
+
+		switch (channels) {
+			case 1:
+				out[0] = out[1] = out[2] = in[0];
+				out[3] = 255;
+				break;
+			case 2:
+				out[0] = out[1] = out[2] = in[0];
+				out[3] = in[1];
+				break;
+			case 3:
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+				out[3] = 255;
+				break;
+			default:
+				memcpy(out, in, 4);
+				break;
+		}
+	}
+}
+
+#if PIXELOPS_X86
+// Returns how many pixels were done; the caller finishes the rest with the scalar version.
+TARGET_SSSE3 static size_t expandRGBSSE(const unsigned char* source, unsigned char* destination, size_t pixelCount)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	size_t i = 0;
+
+	// Each step reads 16 bytes but only uses 12, so stop while 16 are still readable.
+	for (; i + 6 <= pixelCount; i += 4) {
+		__m128i rgb = _mm_loadu_si128((const __m128i*)(source + i * 3));
+		__m128i rgba = _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha);
+		_mm_storeu_si128((__m128i*)(destination + i * 4), rgba);
+	}
+
+	return i;
+}
+
+TARGET_AVX2 static size_t expandRGBAVX2(const unsigned char* source, unsigned char* destination, size_t pixelCount)
+{
+	const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+	size_t i = 0;
+
+	// 8 pixels: bytes 0..11 go in the low lane and 12..23 in the high one.
+	for (; i + 10 <= pixelCount; i += 8) {
+		__m128i low = _mm_loadu_si128((const __m128i*)(source + i * 3));
+		__m128i high = _mm_loadu_si128((const __m128i*)(source + i * 3 + 12));
+		__m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		__m256i rgba = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha);
+		_mm256_storeu_si256((__m256i*)(destination + i * 4), rgba);
+	}
+
+	return i;
+}
+#endif
+
+void expandToRGBA(const unsigned char* source, int channels, unsigned char* destination, size_t pixelCount)
+{
+	size_t done = 0;
+
+#if PIXELOPS_X86
+	if (channels == 3) {
+		if (currentLevel == SimdLevel::AVX2)
+			done = expandRGBAVX2(source, destination, pixelCount);
+		else if (currentLevel == SimdLevel::SSE)
+			done = expandRGBSSE(source, destination, pixelCount);
+	}
+#endif
+
+	if (channels == 4 && source != destination) {
+		memcpy(destination, source, pixelCount * 4);
+		return;
+	}
+
+	expandScalar(source + done * channels, channels, destination + done * 4, pixelCount - done);
+}
+
+// ---- Premultiplied alpha ------------------------------------------------------
+
+// Exact round(x / 255) for x in [0, 255 * 255].
+static inline unsigned int divide255(unsigned int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static void premultiplyScalar(unsigned char* rgba, size_t pixelCount)
+{
+	for (size_t i = 0; i < pixelCount; i++) {
+		unsigned char* pixel = rgba + i * 4;
+		unsigned int a = pixel[3];
+		pixel[0] = (unsigned char)divide255(pixel[0] * a);
+		pixel[1] = (unsigned char)divide255(pixel[1] * a);
+		pixel[2] = (unsigned char)divide255(pixel[2] * a);
+	}
+}
+
+#if PIXELOPS_X86
+static inline __m128i premultiplyHalf(__m128i pixels)
+{
+	// Two pixels as 16-bit lanes: broadcast each alpha over its pixel, but multiply
+	// alpha itself by 255 so it comes out unchanged.
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_or_si128(_mm_and_si128(alpha, _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0)), _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+
+	__m128i product = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+static size_t premultiplySSE(unsigned char* rgba, size_t pixelCount)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 4 <= pixelCount; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+		__m128i low = premultiplyHalf(_mm_unpacklo_epi8(pixels, zero));
+		__m128i high = premultiplyHalf(_mm_unpackhi_epi8(pixels, zero));
+		_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_packus_epi16(low, high));
+	}
+
+	return i;
+}
+
+TARGET_AVX2 static size_t premultiplyAVX2(unsigned char* rgba, size_t pixelCount)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i keepColor = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+	const __m256i alphaOne = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+	const __m256i half = _mm256_set1_epi16(128);
+	size_t i = 0;
+
+	for (; i + 8 <= pixelCount; i += 8) {
+		__m256i pixels = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+		__m256i halves[2] = { _mm256_unpacklo_epi8(pixels, zero), _mm256_unpackhi_epi8(pixels, zero) };
+
+		for (__m256i& value : halves) {
+			__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(value, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			alpha = _mm256_or_si256(_mm256_and_si256(alpha, keepColor), alphaOne);
+			__m256i product = _mm256_add_epi16(_mm256_mullo_epi16(value, alpha), half);
+			value = _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+		}
+
+		// unpack and pack both work per 128-bit lane, so the pixel order survives.
+		_mm256_storeu_si256((__m256i*)(rgba + i * 4), _mm256_packus_epi16(halves[0], halves[1]));
+	}
+
+	return i;
+}
+#endif
+
+void premultiplyAlpha(unsigned char* rgba, size_t pixelCount)
+{
+	size_t done = 0;
+
+#if PIXELOPS_X86
+	if (currentLevel == SimdLevel::AVX2)
+		done = premultiplyAVX2(rgba, pixelCount);
+	else if (currentLevel == SimdLevel::SSE)
+		done = premultiplySSE(rgba, pixelCount);
+#endif
+
+	premultiplyScalar(rgba + done * 4, pixelCount - done);
+}
+
+// ---- sRGB <-> linear ----------------------------------------------------------
+
+static float srgbDecode(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+// Linear to sRGB buckets: the float's exponent and top mantissa bits index a table
+// holding the answer for the bottom of the bucket. Buckets are small enough that at
+// most one rounding threshold falls inside one, so a single compare fixes it up.
+constexpr int BUCKET_MANTISSA_BITS = 7;
+constexpr unsigned int BUCKET_FIRST = 114u << 23; // bits of 2^-13; below that everything rounds to 0
+constexpr unsigned int BUCKET_LAST = 0x3F7FFFFFu;   // bits of the float right below 1.0
+constexpr int BUCKET_COUNT = ((BUCKET_LAST - BUCKET_FIRST) >> (23 - BUCKET_MANTISSA_BITS)) + 1;
+
+static inline unsigned int floatBits(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, 4);
+	return bits;
+}
+
+struct SrgbTables {
+	float toLinear[256];
+	// threshold[k] is the linear value halfway (in sRGB space) between k and k + 1.
+	// The last entry is never crossed, so the fix up can't go past 255.
+	float threshold[256];
+	int bucket[BUCKET_COUNT];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++) {
+			toLinear[i] = srgbDecode(i / 255.0f);
+			threshold[i] = i < 255 ? srgbDecode((i + 0.5f) / 255.0f) : 3.0e38f;
+		}
+
+		int index = 0;
+		for (int i = 0; i < BUCKET_COUNT; i++) {
+			unsigned int bits = BUCKET_FIRST + ((unsigned int)i << (23 - BUCKET_MANTISSA_BITS));
+			float start;
+			memcpy(&start, &bits, 4);
+
+			while (threshold[index] < start) {
+				index++;
+			}
+
+			bucket[i] = index;
+		}
+	}
+};
+
+static const SrgbTables srgbTables;
+
+static void srgbToLinearScalar(const unsigned char* source, float* destination, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		destination[i] = srgbTables.toLinear[source[i]];
+	}
+}
+
+static void linearToSrgbScalar(const float* source, unsigned char* destination, size_t count)
+{
+	const float low = 1.0f / 8192.0f;
+	const float high = 0.99999994f;
+
+	for (size_t i = 0; i < count; i++) {
+		// Written so NaN ends up at the low end.
+		float value = source[i] > low ? source[i] : low;
+		value = value < high ? value : high;
+
+		int index = srgbTables.bucket[(floatBits(value) - BUCKET_FIRST) >> (23 - BUCKET_MANTISSA_BITS)];
+		if (srgbTables.threshold[index] < value)
+			index++;
+
+		destination[i] = (unsigned char)index;
+	}
+}
+
+#if PIXELOPS_X86
+TARGET_AVX2 static size_t srgbToLinearAVX2(const unsigned char* source, float* destination, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + i)));
+		_mm256_storeu_ps(destination + i, _mm256_i32gather_ps(srgbTables.toLinear, indices, 4));
+	}
+
+	return i;
+}
+
+TARGET_AVX2 static size_t linearToSrgbAVX2(const float* source, unsigned char* destination, size_t count)
+{
+	const __m256 low = _mm256_set1_ps(1.0f / 8192.0f);
+	const __m256 high = _mm256_set1_ps(0.99999994f);
+	const __m256i first = _mm256_set1_epi32((int)BUCKET_FIRST);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i packOrder = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		// max/min return the second operand for NaN, same as the scalar version.
+		__m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source + i), low), high);
+
+		__m256i bucket = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_castps_si256(value), first), 23 - BUCKET_MANTISSA_BITS);
+		__m256i index = _mm256_i32gather_epi32(srgbTables.bucket, bucket, 4);
+		__m256 threshold = _mm256_i32gather_ps(srgbTables.threshold, index, 4);
+		__m256i below = _mm256_castps_si256(_mm256_cmp_ps(threshold, value, _CMP_LT_OQ));
+		index = _mm256_add_epi32(index, _mm256_and_si256(below, one));
+
+		__m256i bytes = _mm256_shuffle_epi8(index, packOrder);
+		unsigned int lowBytes = (unsigned int)_mm256_extract_epi32(bytes, 0);
+		unsigned int highBytes = (unsigned int)_mm256_extract_epi32(bytes, 4);
+		memcpy(destination + i, &lowBytes, 4);
+		memcpy(destination + i + 4, &highBytes, 4);
+	}
+
+	return i;
+}
+#endif
+
+void srgbToLinear(const unsigned char* source, float* destination, size_t count)
+{
+	size_t done = 0;
+
+#if PIXELOPS_X86
+	// Below AVX2 there's no gather, and the table lookup is already as cheap as it gets.
+	if (currentLevel == SimdLevel::AVX2)
+		done = srgbToLinearAVX2(source, destination, count);
+#endif
+
+	srgbToLinearScalar(source + done, destination + done, count - done);
+}
+
+void linearToSrgb(const float* source, unsigned char* destination, size_t count)
+{
+	size_t done = 0;
+
+#if PIXELOPS_X86
+	if (currentLevel == SimdLevel::AVX2)
+		done = linearToSrgbAVX2(source, destination, count);
+#endif
+
+	linearToSrgbScalar(source + done, destination + done, count - done);
+}
+
+// ---- Vertical flip ------------------------------------------------------------
+
+static void swapRowsScalar(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; i++) {
+		unsigned char temp = a[i];
+		a[i] = b[i];
+		b[i] = temp;
+	}
+}
+
+#if PIXELOPS_X86
+static size_t swapRowsSSE(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i rowA = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i rowB = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(a + i), rowB);
+		_mm_storeu_si128((__m128i*)(b + i), rowA);
+	}
+
+	return i;
+}
+
+TARGET_AVX2 static size_t swapRowsAVX2(unsigned char* a, unsigned char* b, size_t bytes)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= bytes; i += 32) {
+		__m256i rowA = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i rowB = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(a + i), rowB);
+		_mm256_storeu_si256((__m256i*)(b + i), rowA);
+	}
+
+	return i;
+}
+#endif
+
+void flipVertically(unsigned char* pixels, int width, int height, int bytesPerPixel)
+{
+	size_t rowBytes = (size_t)width * bytesPerPixel;
+
+	for (int y = 0; y < height / 2; y++) {
+		unsigned char* top = pixels + (size_t)y * rowBytes;
+		unsigned char* bottom = pixels + (size_t)(height - 1 - y) * rowBytes;
+		size_t done = 0;
+
+#if PIXELOPS_X86
+		if (currentLevel == SimdLevel::AVX2)
+			done = swapRowsAVX2(top, bottom, rowBytes);
+		else if (currentLevel == SimdLevel::SSE)
+			done = swapRowsSSE(top, bottom, rowBytes);
+#endif
+
+		swapRowsScalar(top + done, bottom + done, rowBytes - done);
+	}
+}
+
+// ---- Box downsampling ---------------------------------------------------------
+
+// Output pixels [firstX, lastX) of one row.
+static void boxRowScalar(const unsigned char* row0, const unsigned char* row1, int width, unsigned char* destination, int firstX, int lastX)
+{
+	for (int x = firstX; x < lastX; x++) {
+		int x0 = std::min(x * 2, width - 1) * 4;
+		int x1 = std::min(x * 2 + 1, width - 1) * 4;
+
+		for (int c = 0; c < 4; c++) {
+			int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+			destination[x * 4 + c] = (unsigned char)((sum + 2) >> 2);
+		}
+	}
+}
+
+#if PIXELOPS_X86
+static int boxRowSSE(const unsigned char* row0, const unsigned char* row1, int width, unsigned char* destination)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	int x = 0;
+
+	// 8 source pixels per row make 4 output pixels.
+	for (; x * 2 + 8 <= width; x += 4) {
+		__m128i sums[2];
+
+		for (int half = 0; half < 2; half++) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + (x * 2 + half * 4) * 4));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + (x * 2 + half * 4) * 4));
+
+			// Vertical sums, two pixels per register, then each pair added horizontally.
+			__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+			high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+
+			sums[half] = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), two), 2);
+		}
+
+		_mm_storeu_si128((__m128i*)(destination + x * 4), _mm_packus_epi16(sums[0], sums[1]));
+	}
+
+	return x;
+}
+
+TARGET_AVX2 static int boxRowAVX2(const unsigned char* row0, const unsigned char* row1, int width, unsigned char* destination)
+{
+	const __m256i two = _mm256_set1_epi16(2);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	int x = 0;
+
+	// 16 source pixels per row make 8 output pixels.
+	for (; x * 2 + 16 <= width; x += 8) {
+		__m256i pairs[2];
+
+		for (int half = 0; half < 2; half++) {
+			const unsigned char* a = row0 + (x * 2 + half * 8) * 4;
+			const unsigned char* b = row1 + (x * 2 + half * 8) * 4;
+
+			// Four source pixels per register, as 16-bit lanes: [p0 p1 | p2 p3].
+			__m256i low = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)a)), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)b)));
+			__m256i high = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + 16))), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + 16))));
+			low = _mm256_add_epi16(low, _mm256_srli_si256(low, 8));
+			high = _mm256_add_epi16(high, _mm256_srli_si256(high, 8));
+
+			// [p01 p45 | p23 p67]
+			pairs[half] = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(low, high), two), 2);
+		}
+
+		// Packing gives [p01 p45 q01 q45 | p23 p67 q23 q67] as 32-bit pixels; put them back in order.
+		__m256i packed = _mm256_packus_epi16(pairs[0], pairs[1]);
+		_mm256_storeu_si256((__m256i*)(destination + x * 4), _mm256_permutevar8x32_epi32(packed, order));
+	}
+
+	return x;
+}
+#endif
+
+void downsampleBox(const unsigned char* source, int width, int height, unsigned char* destination)
+{
+	int newWidth = std::max(width >> 1, 1);
+	int newHeight = std::max(height >> 1, 1);
+
+	for (int y = 0; y < newHeight; y++) {
+		const unsigned char* row0 = source + (size_t)std::min(y * 2, height - 1) * width * 4;
+		const unsigned char* row1 = source + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+		unsigned char* out = destination + (size_t)y * newWidth * 4;
+		int done = 0;
+
+#if PIXELOPS_X86
+		if (currentLevel == SimdLevel::AVX2)
+			done = boxRowAVX2(row0, row1, width, out);
+		else if (currentLevel == SimdLevel::SSE)
+			done = boxRowSSE(row0, row1, width, out);
+#endif
+
+		boxRowScalar(row0, row1, width, out, done, newWidth);
+	}
+}
+
+// ---- Kaiser downsampling ------------------------------------------------------
+
+constexpr int KAISER_TAPS = 6;
+
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static double sinc(double x)
+{
+	const double pi = 3.14159265358979323846;
+
+	if (std::abs(x) < 1e-8)
+		return 1.0;
+
+	return std::sin(pi * x) / (pi * x);
+}
+
+static std::vector<float> normalized(const std::vector<double>& weights)
+{
+	double total = 0.0;
+	for (double weight : weights) {
+		total += weight;
+	}
+
+	std::vector<float> result;
+	for (double weight : weights) {
+		result.push_back((float)(weight / total));
+	}
+
+	return result;
+}
+
+std::vector<float> kaiserWeights(int taps)
+{
+	const double radius = taps / 2.0;
+	const double beta = 4.0;
+	std::vector<double> weights;
+
+	for (int t = 0; t < taps; t++) {
+		double d = t - radius + 0.5;
+		double ratio = d / radius;
+		weights.push_back(sinc(d / 2.0) * besselI0(beta * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / besselI0(beta));
+	}
+
+	return normalized(weights);
+}
+
+std::vector<float> lanczosWeights(int taps)
+{
+	const double radius = taps / 2.0;
+	std::vector<double> weights;
+
+	for (int t = 0; t < taps; t++) {
+		double d = t - radius + 0.5;
+		weights.push_back(sinc(d / 2.0) * sinc(d / radius));
+	}
+
+	return normalized(weights);
+}
+
+static const std::vector<float> kaiserTable = kaiserWeights(KAISER_TAPS);
+
+static void kaiserScalar(const unsigned char* source, int width, int height, unsigned char* destination)
+{
+	int newWidth = std::max(width >> 1, 1);
+	int newHeight = std::max(height >> 1, 1);
+	std::vector<float> rows((size_t)newWidth * height * 4);
+
+	// Horizontal pass into floats, then vertical pass back to bytes. Edges clamp.
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < newWidth; x++) {
+			for (int c = 0; c < 4; c++) {
+				float sum = 0.0f;
+
+				for (int t = 0; t < KAISER_TAPS; t++) {
+					int sx = std::max(0, std::min(x * 2 + t - KAISER_TAPS / 2 + 1, width - 1));
+					sum += kaiserTable[t] * source[((size_t)y * width + sx) * 4 + c];
+				}
+
+				rows[((size_t)y * newWidth + x) * 4 + c] = sum;
+			}
+		}
+	}
+
+	for (int y = 0; y < newHeight; y++) {
+		for (int x = 0; x < newWidth; x++) {
+			for (int c = 0; c < 4; c++) {
+				float sum = 0.0f;
+
+				for (int t = 0; t < KAISER_TAPS; t++) {
+					int sy = std::max(0, std::min(y * 2 + t - KAISER_TAPS / 2 + 1, height - 1));
+					sum += kaiserTable[t] * rows[((size_t)sy * newWidth + x) * 4 + c];
+				}
+
+				destination[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)std::max(0.0f, std::min(sum + 0.5f, 255.0f));
+			}
+		}
+	}
+}
+
+#if PIXELOPS_X86
+// One RGBA pixel is exactly one __m128, so every tap is a single multiply-add.
+static void kaiserSSE(const unsigned char* source, int width, int height, unsigned char* destination)
+{
+	int newWidth = std::max(width >> 1, 1);
+	int newHeight = std::max(height >> 1, 1);
+	std::vector<float> rows((size_t)newWidth * height * 4);
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128 weights[KAISER_TAPS];
+	for (int t = 0; t < KAISER_TAPS; t++) {
+		weights[t] = _mm_set1_ps(kaiserTable[t]);
+	}
+
+	for (int y = 0; y < height; y++) {
+		const unsigned char* row = source + (size_t)y * width * 4;
+
+		for (int x = 0; x < newWidth; x++) {
+			__m128 sum = _mm_setzero_ps();
+
+			for (int t = 0; t < KAISER_TAPS; t++) {
+				int sx = std::max(0, std::min(x * 2 + t - KAISER_TAPS / 2 + 1, width - 1));
+				int packed;
+				memcpy(&packed, row + sx * 4, 4);
+				__m128i pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+				sum = _mm_add_ps(sum, _mm_mul_ps(weights[t], _mm_cvtepi32_ps(pixel)));
+			}
+
+			_mm_storeu_ps(&rows[((size_t)y * newWidth + x) * 4], sum);
+		}
+	}
+
+	for (int y = 0; y < newHeight; y++) {
+		for (int x = 0; x < newWidth; x++) {
+			__m128 sum = _mm_setzero_ps();
+
+			for (int t = 0; t < KAISER_TAPS; t++) {
+				int sy = std::max(0, std::min(y * 2 + t - KAISER_TAPS / 2 + 1, height - 1));
+				sum = _mm_add_ps(sum, _mm_mul_ps(weights[t], _mm_loadu_ps(&rows[((size_t)sy * newWidth + x) * 4])));
+			}
+
+			// cvtps rounds to nearest and the packs saturate to [0, 255].
+			__m128i value = _mm_cvtps_epi32(sum);
+			value = _mm_packus_epi16(_mm_packs_epi32(value, value), zero);
+			int packed = _mm_cvtsi128_si32(value);
+			memcpy(destination + ((size_t)y * newWidth + x) * 4, &packed, 4);
+		}
+	}
+}
+
+// Two output pixels per __m256, one in each lane. The horizontal pass gathers the two
+// source pixels of a tap (they're two pixels apart) into one register; the vertical pass
+// reads two neighbouring pixels of the float rows at once.
+TARGET_AVX2 static void kaiserAVX2(const unsigned char* source, int width, int height, unsigned char* destination)
+{
+	int newWidth = std::max(width >> 1, 1);
+	int newHeight = std::max(height >> 1, 1);
+	std::vector<float> rows((size_t)newWidth * height * 4);
+
+	__m256 weights[KAISER_TAPS];
+	for (int t = 0; t < KAISER_TAPS; t++) {
+		weights[t] = _mm256_set1_ps(kaiserTable[t]);
+	}
+
+	for (int y = 0; y < height; y++) {
+		const unsigned char* row = source + (size_t)y * width * 4;
+		float* out = &rows[(size_t)y * newWidth * 4];
+		int x = 0;
+
+		for (; x + 2 <= newWidth; x += 2) {
+			__m256 sum = _mm256_setzero_ps();
+
+			for (int t = 0; t < KAISER_TAPS; t++) {
+				int sx0 = std::max(0, std::min(x * 2 + t - KAISER_TAPS / 2 + 1, width - 1));
+				int sx1 = std::max(0, std::min(x * 2 + 2 + t - KAISER_TAPS / 2 + 1, width - 1));
+				int packed[2];
+				memcpy(&packed[0], row + sx0 * 4, 4);
+				memcpy(&packed[1], row + sx1 * 4, 4);
+				__m128i pixels = _mm_loadl_epi64((const __m128i*)packed);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(weights[t], _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(pixels))));
+			}
+
+			_mm256_storeu_ps(out + x * 4, sum);
+		}
+
+		// An odd width leaves one pixel, done like the scalar version.
+		for (; x < newWidth; x++) {
+			for (int c = 0; c < 4; c++) {
+				float sum = 0.0f;
+
+				for (int t = 0; t < KAISER_TAPS; t++) {
+					int sx = std::max(0, std::min(x * 2 + t - KAISER_TAPS / 2 + 1, width - 1));
+					sum += kaiserTable[t] * row[sx * 4 + c];
+				}
+
+				out[x * 4 + c] = sum;
+			}
+		}
+	}
+
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	for (int y = 0; y < newHeight; y++) {
+		const float* taps[KAISER_TAPS];
+		for (int t = 0; t < KAISER_TAPS; t++) {
+			int sy = std::max(0, std::min(y * 2 + t - KAISER_TAPS / 2 + 1, height - 1));
+			taps[t] = &rows[(size_t)sy * newWidth * 4];
+		}
+
+		unsigned char* out = destination + (size_t)y * newWidth * 4;
+		size_t floats = (size_t)newWidth * 4;
+		size_t i = 0;
+
+		for (; i + 8 <= floats; i += 8) {
+			__m256 sum = _mm256_setzero_ps();
+
+			for (int t = 0; t < KAISER_TAPS; t++) {
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(weights[t], _mm256_loadu_ps(taps[t] + i)));
+			}
+
+			// cvtps rounds to nearest and the packs saturate to [0, 255]. Packing works per
+			// lane, so each lane's pixel ends up in its first 4 bytes.
+			__m256i value = _mm256_cvtps_epi32(sum);
+			value = _mm256_packus_epi16(_mm256_packs_epi32(value, value), value);
+			value = _mm256_permutevar8x32_epi32(value, order);
+			_mm_storel_epi64((__m128i*)(out + i), _mm256_castsi256_si128(value));
+		}
+
+		for (; i < floats; i++) {
+			float sum = 0.0f;
+
+			for (int t = 0; t < KAISER_TAPS; t++) {
+				sum += kaiserTable[t] * taps[t][i];
+			}
+
+			out[i] = (unsigned char)std::max(0.0f, std::min(sum + 0.5f, 255.0f));
+		}
+	}
+}
+#endif
+
+void downsampleKaiser(const unsigned char* source, int width, int height, unsigned char* destination)
+{
+#if PIXELOPS_X86
+	if (currentLevel == SimdLevel::AVX2) {
+		kaiserAVX2(source, width, height, destination);
+		return;
+	}
+
+	if (currentLevel == SimdLevel::SSE) {
+		kaiserSSE(source, width, height, destination);
+		return;
+	}
+#endif
+
+	kaiserScalar(source, width, height, destination);
+}
+
+// ---- Float filter passes ------------------------------------------------------
+
+// The SIMD versions keep one register of every weight, which covers all the filters here.
+constexpr int MAX_FILTER_TAPS = 16;
+
+static void downsampleRowScalar(const float* source, int width, int firstX, int lastX, const float* weights, int taps, float* destination)
+{
+	for (int x = firstX; x < lastX; x++) {
+		float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for (int t = 0; t < taps; t++) {
+			int sx = std::max(0, std::min(x * 2 + t - taps / 2 + 1, width - 1));
+			for (int c = 0; c < 4; c++) {
+				sum[c] += weights[t] * source[sx * 4 + c];
+			}
+		}
+
+		for (int c = 0; c < 4; c++) {
+			destination[(x - firstX) * 4 + c] = sum[c];
+		}
+	}
+}
+
+static void blendRowsScalar(const float* const* rows, const float* weights, int taps, size_t first, size_t count, float* destination)
+{
+	for (size_t i = first; i < count; i++) {
+		float sum = 0.0f;
+
+		for (int t = 0; t < taps; t++) {
+			sum += weights[t] * rows[t][i];
+		}
+
+		destination[i] = std::max(0.0f, std::min(sum, 1.0f));
+	}
+}
+
+#if PIXELOPS_X86
+// Same layout as the Kaiser kernels: one RGBA pixel per __m128.
+static void downsampleRowSSE(const float* source, int width, int firstX, int lastX, const float* weights, int taps, float* destination)
+{
+	__m128 weight[MAX_FILTER_TAPS];
+	for (int t = 0; t < taps; t++) {
+		weight[t] = _mm_set1_ps(weights[t]);
+	}
+
+	for (int x = firstX; x < lastX; x++) {
+		__m128 sum = _mm_setzero_ps();
+
+		for (int t = 0; t < taps; t++) {
+			int sx = std::max(0, std::min(x * 2 + t - taps / 2 + 1, width - 1));
+			sum = _mm_add_ps(sum, _mm_mul_ps(weight[t], _mm_loadu_ps(source + sx * 4)));
+		}
+
+		_mm_storeu_ps(destination + (x - firstX) * 4, sum);
+	}
+}
+
+static size_t blendRowsSSE(const float* const* rows, const float* weights, int taps, size_t count, float* destination)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	size_t i = 0;
+
+	__m128 weight[MAX_FILTER_TAPS];
+	for (int t = 0; t < taps; t++) {
+		weight[t] = _mm_set1_ps(weights[t]);
+	}
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+
+		for (int t = 0; t < taps; t++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(weight[t], _mm_loadu_ps(rows[t] + i)));
+		}
+
+		_mm_storeu_ps(destination + i, _mm_min_ps(_mm_max_ps(sum, zero), one));
+	}
+
+	return i;
+}
+
+// Two output pixels per __m256, one in each lane. Their source pixels for a tap are two
+// pixels apart, so each lane gets its own load.
+TARGET_AVX2 static void downsampleRowAVX2(const float* source, int width, int firstX, int lastX, const float* weights, int taps, float* destination)
+{
+	__m256 weight[MAX_FILTER_TAPS];
+	for (int t = 0; t < taps; t++) {
+		weight[t] = _mm256_set1_ps(weights[t]);
+	}
+
+	int x = firstX;
+
+	for (; x + 2 <= lastX; x += 2) {
+		__m256 sum = _mm256_setzero_ps();
+
+		for (int t = 0; t < taps; t++) {
+			int sx0 = std::max(0, std::min(x * 2 + t - taps / 2 + 1, width - 1));
+			int sx1 = std::max(0, std::min(x * 2 + 2 + t - taps / 2 + 1, width - 1));
+			__m256 pixels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(source + sx0 * 4)), _mm_loadu_ps(source + sx1 * 4), 1);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(weight[t], pixels));
+		}
+
+		_mm256_storeu_ps(destination + (x - firstX) * 4, sum);
+	}
+
+	// An odd count leaves one pixel.
+	if (x < lastX)
+		downsampleRowScalar(source, width, x, lastX, weights, taps, destination + (x - firstX) * 4);
+}
+
+TARGET_AVX2 static size_t blendRowsAVX2(const float* const* rows, const float* weights, int taps, size_t count, float* destination)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	size_t i = 0;
+
+	__m256 weight[MAX_FILTER_TAPS];
+	for (int t = 0; t < taps; t++) {
+		weight[t] = _mm256_set1_ps(weights[t]);
+	}
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+
+		for (int t = 0; t < taps; t++) {
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(weight[t], _mm256_loadu_ps(rows[t] + i)));
+		}
+
+		_mm256_storeu_ps(destination + i, _mm256_min_ps(_mm256_max_ps(sum, zero), one));
+	}
+
+	return i;
+}
+#endif
+
+void downsampleRow(const float* source, int width, int firstX, int lastX, const float* weights, int taps, float* destination)
+{
+#if PIXELOPS_X86
+	if (taps <= MAX_FILTER_TAPS) {
+		if (currentLevel == SimdLevel::AVX2) {
+			downsampleRowAVX2(source, width, firstX, lastX, weights, taps, destination);
+			return;
+		}
+
+		if (currentLevel == SimdLevel::SSE) {
+			downsampleRowSSE(source, width, firstX, lastX, weights, taps, destination);
+			return;
+		}
+	}
+#endif
+
+	downsampleRowScalar(source, width, firstX, lastX, weights, taps, destination);
+}
+
+void blendRows(const float* const* rows, const float* weights, int taps, size_t count, float* destination)
+{
+	size_t done = 0;
+
+#if PIXELOPS_X86
+	if (taps <= MAX_FILTER_TAPS) {
+		if (currentLevel == SimdLevel::AVX2)
+			done = blendRowsAVX2(rows, weights, taps, count, destination);
+		else if (currentLevel == SimdLevel::SSE)
+			done = blendRowsSSE(rows, weights, taps, count, destination);
+	}
+#endif
+
+	blendRowsScalar(rows, weights, taps, done, count, destination);
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Pixel preparation kernels that run between stbi_load and the GL upload, so the
+// driver always gets tightly packed RGBA8 and never has to convert anything itself.
+//
+// Every operation has a plain scalar version and SSE (SSSE3)/AVX2 versions. The best
+// one the CPU supports is picked at startup; setSimdLevel can force a lower one,
+// which is how the SIMD versions are compared against the scalar ones.
+namespace PixelOps {
+	enum class SimdLevel {
+		Scalar,
+		SSE,
+		AVX2
+	};
+
+	SimdLevel detectSimdLevel();
+	SimdLevel getSimdLevel();
+	// Clamped to what the CPU supports.
+	void setSimdLevel(SimdLevel level);
+	const char* simdLevelName(SimdLevel level);
+
+	// Any channel count (1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA) to RGBA8.
+	// Missing alpha becomes 255. 'destination' must hold pixelCount * 4 bytes.
+	void expandToRGBA(const unsigned char* source, int channels, unsigned char* destination, size_t pixelCount);
+
+	// In place, RGBA8: rgb = rgb * a / 255 (rounded).
+	void premultiplyAlpha(unsigned char* rgba, size_t pixelCount);
+
+	// Per byte. sRGB 8-bit values to linear floats in [0, 1].
+	void srgbToLinear(const unsigned char* source, float* destination, size_t count);
+	// Per float. Linear values (clamped to [0, 1]) to the nearest sRGB 8-bit value.
+	void linearToSrgb(const float* source, unsigned char* destination, size_t count);
+
+	// In place. Images are stored top row first, but OpenGL expects the first row
+	// of texture data to be the bottom one.
+	void flipVertically(unsigned char* pixels, int width, int height, int bytesPerPixel);
+
+	// RGBA8, halves both sides (odd sizes repeat the last row/column).
+	// 'destination' must hold max(width / 2, 1) * max(height / 2, 1) * 4 bytes.
+	void downsampleBox(const unsigned char* source, int width, int height, unsigned char* destination);
+	// Same, but with a 6 tap Kaiser windowed sinc, which keeps more detail and aliases less.
+	void downsampleKaiser(const unsigned char* source, int width, int height, unsigned char* destination);
+
+	// Normalized weights for halving an image with a separable filter 'taps' wide (even).
+	// Tap t sits at (t - taps / 2 + 0.5) source pixels from the output pixel's center,
+	// and both are sinc(d / 2), the ideal half band low pass, cut off at taps / 2 pixels
+	// by a Kaiser window (beta 4) or a Lanczos window.
+	std::vector<float> kaiserWeights(int taps);
+	std::vector<float> lanczosWeights(int taps);
+
+	// The two passes of such a filter on linear RGBA floats, for callers that keep their
+	// own float images (the mip generator works on tiles of one).
+	// Output pixels [firstX, lastX) of a row 'width' pixels wide. Tap t of output x reads
+	// source pixel x * 2 + t - taps / 2 + 1, clamped to the row.
+	void downsampleRow(const float* source, int width, int firstX, int lastX, const float* weights, int taps, float* destination);
+	// destination[i] = the sum of weights[t] * rows[t][i], clamped to [0, 1] (sharp
+	// filters overshoot a little around hard edges).
+	void blendRows(const float* const* rows, const float* weights, int taps, size_t count, float* destination);
+}
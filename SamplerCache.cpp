@@ -0,0 +1,92 @@
+#include "SamplerCache.hpp"
+#include "AssetCooker.hpp"
+#include "GLExtensions.hpp"
+#include "StateCache.hpp"
+#include <algorithm>
+#include <cstring>
+
+uint64_t SamplerDesc::hash() const
+{
+	// Field by field, so padding never makes two equal descriptions different.
+	uint32_t words[9] = { wrapS, wrapT, minFilter, magFilter, 0, 0, 0, compareMode, compareFunc };
+	memcpy(&words[4], &maxAnisotropy, sizeof(float));
+	memcpy(&words[5], &lodBias, sizeof(float));
+	memcpy(&words[6], &minLod, sizeof(float));
+
+	return AssetCooker::hashBytes(words, sizeof(words));
+}
+
+SamplerCache::SamplerCache(const SamplerQuality& quality)
+	: quality(quality)
+{
+}
+
+SamplerCache::~SamplerCache()
+{
+	for (auto& sampler : samplers) {
+		StateCache::current().forgetSampler(sampler.second.sampler);
+		glDeleteSamplers(1, &sampler.second.sampler);
+	}
+}
+
+void SamplerCache::apply(const Sampler& sampler) const
+{
+	const SamplerDesc& desc = sampler.desc;
+
+	GLenum minFilter = desc.minFilter;
+	if (!quality.trilinear && minFilter == GL_LINEAR_MIPMAP_LINEAR)
+		minFilter = GL_LINEAR_MIPMAP_NEAREST;
+
+	glSamplerParameteri(sampler.sampler, GL_TEXTURE_WRAP_S, desc.wrapS);
+	glSamplerParameteri(sampler.sampler, GL_TEXTURE_WRAP_T, desc.wrapT);
+	glSamplerParameteri(sampler.sampler, GL_TEXTURE_MIN_FILTER, minFilter);
+	glSamplerParameteri(sampler.sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+	glSamplerParameterf(sampler.sampler, GL_TEXTURE_LOD_BIAS, desc.lodBias + quality.lodBias);
+	glSamplerParameterf(sampler.sampler, GL_TEXTURE_MIN_LOD, desc.minLod);
+	glSamplerParameteri(sampler.sampler, GL_TEXTURE_COMPARE_MODE, desc.compareMode);
+	glSamplerParameteri(sampler.sampler, GL_TEXTURE_COMPARE_FUNC, desc.compareFunc);
+
+	if (GLExtensions::textureFilterAnisotropic) {
+		float anisotropy = std::min(std::min(desc.maxAnisotropy, quality.maxAnisotropy), GLExtensions::maxTextureAnisotropy);
+		glSamplerParameterf(sampler.sampler, GL_TEXTURE_MAX_ANISOTROPY, std::max(anisotropy, 1.0f));
+	}
+}
+
+GLuint SamplerCache::get(const SamplerDesc& desc)
+{
+	uint64_t key = desc.hash();
+	auto known = samplers.find(key);
+	if (known != samplers.end())
+		return known->second.sampler;
+
+	Sampler sampler = { desc, 0 };
+	glGenSamplers(1, &sampler.sampler);
+	apply(sampler);
+
+	samplers[key] = sampler;
+	return sampler.sampler;
+}
+
+void SamplerCache::bind(GLuint unit, const SamplerDesc& desc)
+{
+	StateCache::current().bindSampler(unit, get(desc));
+}
+
+void SamplerCache::setQuality(const SamplerQuality& quality)
+{
+	this->quality = quality;
+
+	for (const auto& sampler : samplers) {
+		apply(sampler.second);
+	}
+}
+
+const SamplerQuality& SamplerCache::getQuality() const
+{
+	return quality;
+}
+
+size_t SamplerCache::size() const
+{
+	return samplers.size();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// How a texture is sampled, apart from the texture itself.
+struct SamplerDesc {
+	GLenum wrapS = GL_REPEAT;
+	GLenum wrapT = GL_REPEAT;
+	GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+	GLenum magFilter = GL_LINEAR;
+	float maxAnisotropy = 1.0f; // 1 is off
+	float lodBias = 0.0f;
+	// Where a texture that's still streaming in blends a new level in from (see
+	// TextureStreamer::getMinLod). -1000 is GL's default, no limit.
+	float minLod = -1000.0f;
+	// GL_COMPARE_REF_TO_TEXTURE for depth textures sampled as shadows.
+	GLenum compareMode = GL_NONE;
+	GLenum compareFunc = GL_LEQUAL;
+
+	uint64_t hash() const;
+};
+
+// What a performance tier changes for every sampler at once, whatever its description.
+struct SamplerQuality {
+	float maxAnisotropy = 16.0f; // caps what descriptions ask for
+	float lodBias = 0.0f;        // added to theirs, positive is blurrier and cheaper
+	bool trilinear = true;       // off blends within one mip level only
+};
+
+// One sampler object per description, found by its hash. Sampler objects (core in 3.3)
+// override the filtering and wrapping of whatever texture is on their unit, so textures
+// only carry their pixels and their levels: the same texture can be sampled in different
+// ways, and changing the quality tier changes a handful of samplers instead of every
+// texture.
+//
+// GL thread only.
+class SamplerCache {
+    private:
+	struct Sampler {
+		SamplerDesc desc;
+		GLuint sampler;
+	};
+
+	std::unordered_map<uint64_t, Sampler> samplers;
+	SamplerQuality quality;
+
+	void apply(const Sampler& sampler) const;
+    public:
+	explicit SamplerCache(const SamplerQuality& quality = SamplerQuality());
+	~SamplerCache();
+
+	SamplerCache(const SamplerCache&) = delete;
+	SamplerCache& operator=(const SamplerCache&) = delete;
+
+	// Made the first time it's asked for.
+	GLuint get(const SamplerDesc& desc);
+	// Binds it on 'unit' through the StateCache.
+	void bind(GLuint unit, const SamplerDesc& desc);
+
+	// Applies 'quality' to every sampler there is, and to the ones made from now on.
+	void setQuality(const SamplerQuality& quality);
+	const SamplerQuality& getQuality() const;
+
+	size_t size() const;
+};
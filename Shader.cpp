@@ -1,130 +1,403 @@
 #include "Shader.hpp"
+#include "GLExtensions.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "StateCache.hpp"
 #include <glad/glad.h>
-#include <sstream>
-#include <fstream>
+#include <cstring>
 #include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
-{
-	// 1. retrieve the vertex/fragment source code from filePath
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-    
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    
-	try
-	{
-		// open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		// read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-	}
-	catch (std::ifstream::failure e)
+ShaderUniformStats Shader::uniformStats = {};
+
+Shader::Shader(const VirtualFileSystem& files, const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+	: pipeline(0), stages{ 0, 0 }, vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), spirvStages{ false, false }
+{
+	// 1. retrieve the vertex/fragment source code through the file system, with their
+	// includes pasted in and the defines added.
+	PreprocessedShader vertexShader;
+	PreprocessedShader fragmentShader;
+
+	if (!ShaderPreprocessor::preprocess(files, vertexPath, defines, vertexShader) || !ShaderPreprocessor::preprocess(files, fragmentPath, defines, fragmentShader))
 	{
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
-    
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
-    
-	// 2. compile shaders
-	unsigned int vertex, fragment;
+
+	// 2. compile and link, and wait for it: nothing can be drawn without it anyway.
+	ShaderBuild build = beginBuild(vertexShader.source, fragmentShader.source);
+	ID = finishBuild(build);
+}
+
+Shader::Shader(unsigned int program, const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
+	: ID(program), pipeline(0), stages{ 0, 0 }, vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), spirvStages{ false, false }
+{
+}
+
+Shader::Shader(const ShaderPipelineStages& stages, const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
+	: ID(0), pipeline(stages.pipeline), stages{ stages.vertex, stages.fragment }, vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines),
+	  spirvStages{ false, false }
+{
+}
+
+// The steps of a build that only hand things to GL. No status is asked for here: with
+// KHR_parallel_shader_compile that is what would wait for the driver's threads.
+static GLuint compileSource(GLenum type, const std::string& source)
+{
+	// GL takes the length of the source, so it doesn't need to be null terminated. A
+	// missing file is an empty source, which at least fails with a log.
+	const char* code = source.data();
+	GLint length = (GLint)source.size();
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &code, &length);
+	glCompileShader(shader);
+	return shader;
+}
+
+static GLuint compileModule(GLenum type, const std::vector<uint32_t>& module)
+{
+	// Specializing is the compile, the compile status tells how it went. The shaders have
+	// no specialization constants.
+	GLuint shader = glCreateShader(type);
+	GLExtensions::glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, module.data(), (GLsizei)(module.size() * sizeof(uint32_t)));
+	GLExtensions::glSpecializeShaderARB(shader, "main", 0, nullptr, nullptr);
+	return shader;
+}
+
+static ShaderBuild linkProgram(GLuint vertex, GLuint fragment)
+{
+	ShaderBuild build;
+	build.vertex = vertex;
+	build.fragment = fragment;
+	build.program = glCreateProgram();
+	glAttachShader(build.program, build.vertex);
+	glAttachShader(build.program, build.fragment);
+	glLinkProgram(build.program);
+	return build;
+}
+
+static ShaderBuild linkStage(GLenum type, GLuint shader)
+{
+	// Separable has to be set before the link: it's what keeps the outputs of a stage
+	// nothing in the same program reads.
+	ShaderBuild build = {};
+	build.program = glCreateProgram();
+	GLExtensions::glProgramParameteri(build.program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	glAttachShader(build.program, shader);
+	glLinkProgram(build.program);
+
+	if (type == GL_VERTEX_SHADER)
+		build.vertex = shader;
+	else
+		build.fragment = shader;
+
+	return build;
+}
+
+ShaderBuild Shader::beginBuild(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	return linkProgram(compileSource(GL_VERTEX_SHADER, vertexSource), compileSource(GL_FRAGMENT_SHADER, fragmentSource));
+}
+
+ShaderBuild Shader::beginBuild(const std::vector<uint32_t>& vertexModule, const std::vector<uint32_t>& fragmentModule)
+{
+	return linkProgram(compileModule(GL_VERTEX_SHADER, vertexModule), compileModule(GL_FRAGMENT_SHADER, fragmentModule));
+}
+
+ShaderBuild Shader::beginStageBuild(unsigned int type, const std::string& source)
+{
+	return linkStage(type, compileSource(type, source));
+}
+
+ShaderBuild Shader::beginStageBuild(unsigned int type, const std::vector<uint32_t>& module)
+{
+	return linkStage(type, compileModule(type, module));
+}
+
+bool Shader::isBuildDone(const ShaderBuild& build)
+{
+	if (!GLExtensions::parallelShaderCompile)
+		return true;
+
+	// The link can't finish before the compiles do, so the program is all there is to ask.
+	int done;
+	glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+	return done != 0;
+}
+
+unsigned int Shader::finishBuild(ShaderBuild& build)
+{
 	int success;
 	char infoLog[512];
-    
-	// vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-    
-	// print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    
+
+	// print compile errors if any (a stage program only has one of them)
+	success = 1;
+	if (build.vertex != 0)
+		glGetShaderiv(build.vertex, GL_COMPILE_STATUS, &success);
+
 	if (!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(build.vertex, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
 	};
-    
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-    
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    
+
+	success = 1;
+	if (build.fragment != 0)
+		glGetShaderiv(build.fragment, GL_COMPILE_STATUS, &success);
+
 	if (!success)
 	{
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+		glGetShaderInfoLog(build.fragment, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 	};
-    
-	// shader Program
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
+
 	// print linking errors if any
-	glGetProgramiv(ID, GL_LINK_STATUS, &success);
-    
+	glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+
 	if (!success)
 	{
-		glGetProgramInfoLog(ID, 512, NULL, infoLog);
+		glGetProgramInfoLog(build.program, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 	}
-    
+
 	// delete the shaders as they're linked into our program now and no longer necessary
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(build.vertex);
+	glDeleteShader(build.fragment);
+
+	unsigned int program = build.program;
+	if (!success)
+	{
+		glDeleteProgram(program);
+		program = 0;
+	}
+
+	build = {};
+	return program;
+}
+
+void Shader::replaceProgram(unsigned int program)
+{
+	glDeleteProgram(ID);
+	ID = program;
+	pipeline = 0;
+
+	// Rebuilt from GLSL.
+	for (int stage = 0; stage < 2; stage++) {
+		spirvStages[stage] = false;
+		uniformLocations[stage].clear();
+	}
+
+	resetUniforms();
+}
+
+void Shader::setSpirvUniforms(int stage, const std::unordered_map<std::string, int>& locations)
+{
+	spirvStages[stage] = true;
+	uniformLocations[stage] = locations;
+	resetUniforms();
+}
+
+const std::string& Shader::getVertexPath() const
+{
+	return vertexPath;
+}
+
+const std::string& Shader::getFragmentPath() const
+{
+	return fragmentPath;
+}
+
+const std::vector<std::string>& Shader::getDefines() const
+{
+	return defines;
 }
 
 void Shader::use()
 {
-	glUseProgram(ID);
+	// Nothing is bound again when this one already is.
+	if (pipeline != 0)
+		StateCache::current().bindProgramPipeline(pipeline);
+	else
+		StateCache::current().useProgram(ID);
+
+	flush();
+}
+
+int Shader::getStageUniformLocation(int stage, const std::string& name) const
+{
+	if (!spirvStages[stage])
+		return glGetUniformLocation(pipeline != 0 ? stages[stage] : ID, name.c_str());
+
+	auto found = uniformLocations[stage].find(name);
+	return found != uniformLocations[stage].end() ? found->second : -1;
+}
+
+int Shader::getUniformLocation(const std::string& name) const
+{
+	// A GLSL program finds it in either stage by itself.
+	GLint location = getStageUniformLocation(0, name);
+	if (location < 0 && spirvStages[1])
+		location = getStageUniformLocation(1, name);
+
+	return location;
+}
+
+void Shader::findLocations(const std::string& name, Uniform& uniform) const
+{
+	if (pipeline != 0) {
+		uniform.locations[0] = getStageUniformLocation(0, name);
+		uniform.locations[1] = getStageUniformLocation(1, name);
+	}
+	else {
+		uniform.locations[0] = getUniformLocation(name);
+		uniform.locations[1] = -1;
+	}
+}
+
+void Shader::resetUniforms()
+{
+	dirtyUniforms.clear();
+
+	for (const auto& index : uniformIndices) {
+		Uniform& uniform = uniforms[index.second];
+		findLocations(index.first, uniform);
+		uniform.dirty = true;
+		dirtyUniforms.push_back(index.second);
+	}
+}
+
+void Shader::setUniform(const std::string& name, UniformType type, const void* value)
+{
+	uniformStats.sets++;
+
+	// By UniformType. Ints take as much room as floats.
+	static const size_t FLOAT_COUNTS[] = { 1, 1, 2, 3, 16 };
+	size_t size = FLOAT_COUNTS[(int)type] * sizeof(GLfloat);
+
+	auto found = uniformIndices.find(name);
+	if (found == uniformIndices.end()) {
+		Uniform uniform = { type, (unsigned int)uniformValues.size(), { -1, -1 }, true };
+		findLocations(name, uniform);
+
+		uniformValues.resize(uniformValues.size() + size);
+		memcpy(&uniformValues[uniform.offset], value, size);
+
+		uniformIndices[name] = (unsigned int)uniforms.size();
+		dirtyUniforms.push_back((unsigned int)uniforms.size());
+		uniforms.push_back(uniform);
+		return;
+	}
+
+	Uniform& uniform = uniforms[found->second];
+	if (uniform.type != type) {
+		std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << name << std::endl;
+		return;
+	}
+
+	unsigned char* current = &uniformValues[uniform.offset];
+	if (memcmp(current, value, size) == 0) {
+		uniformStats.skipped++;
+		return;
+	}
+
+	memcpy(current, value, size);
+	if (!uniform.dirty) {
+		uniform.dirty = true;
+		dirtyUniforms.push_back(found->second);
+	}
+}
+
+void Shader::uploadUniform(const Uniform& uniform)
+{
+	const GLint* ints = (const GLint*)&uniformValues[uniform.offset];
+	const GLfloat* floats = (const GLfloat*)&uniformValues[uniform.offset];
+
+	if (pipeline == 0) {
+		GLint location = uniform.locations[0];
+		if (location < 0)
+			return;
+
+		switch (uniform.type) {
+		case UniformType::Int: glUniform1iv(location, 1, ints); break;
+		case UniformType::Float: glUniform1fv(location, 1, floats); break;
+		case UniformType::Vec2: glUniform2fv(location, 1, floats); break;
+		case UniformType::Vec3: glUniform3fv(location, 1, floats); break;
+		case UniformType::Mat4: glUniformMatrix4fv(location, 1, GL_FALSE, floats); break;
+		}
+
+		uniformStats.uploads++;
+		return;
+	}
+
+	// Each stage program that has it gets its own copy.
+	for (int stage = 0; stage < 2; stage++) {
+		GLuint program = stages[stage];
+		GLint location = uniform.locations[stage];
+		if (location < 0)
+			continue;
+
+		switch (uniform.type) {
+		case UniformType::Int: GLExtensions::glProgramUniform1i(program, location, ints[0]); break;
+		case UniformType::Float: GLExtensions::glProgramUniform1f(program, location, floats[0]); break;
+		case UniformType::Vec2: GLExtensions::glProgramUniform2f(program, location, floats[0], floats[1]); break;
+		case UniformType::Vec3: GLExtensions::glProgramUniform3f(program, location, floats[0], floats[1], floats[2]); break;
+		case UniformType::Mat4: GLExtensions::glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, floats); break;
+		}
+
+		uniformStats.uploads++;
+	}
+}
+
+void Shader::flush()
+{
+	for (unsigned int index : dirtyUniforms) {
+		uploadUniform(uniforms[index]);
+		uniforms[index].dirty = false;
+	}
+
+	dirtyUniforms.clear();
+}
+
+void Shader::setBool(const std::string& name, bool value)
+{
+	setInt(name, value);
+}
+
+void Shader::setInt(const std::string& name, int value)
+{
+	setUniform(name, UniformType::Int, &value);
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::setFloat(const std::string& name, float value)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	setUniform(name, UniformType::Float, &value);
 }
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::setVec2f(const std::string& name, float x, float y)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	float value[2] = { x, y };
+	setUniform(name, UniformType::Vec2, value);
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::setVec3f(const std::string& name, float x, float y, float z)
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	float value[3] = { x, y, z };
+	setUniform(name, UniformType::Vec3, value);
 }
 
-void Shader::setVec2f(const std::string& name, float x, float y) const
+void Shader::setMatrix4fv(const std::string& name, glm::mat4 value)
 {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	setUniform(name, UniformType::Mat4, glm::value_ptr(value));
 }
 
-void Shader::setVec3f(const std::string& name, float x, float y, float z) const
+ShaderUniformStats Shader::getUniformStats()
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	return uniformStats;
 }
 
-void Shader::setMatrix4fv(const std::string& name, glm::mat4 value) const
+void Shader::resetUniformStats()
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	uniformStats = {};
 }
 
 Shader::~Shader()
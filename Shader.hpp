@@ -1,19 +1,127 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 
+class VirtualFileSystem;
+
+// A program on its way: compiled and linked, but maybe not done yet (see
+// Shader::isBuildDone).
+struct ShaderBuild {
+	unsigned int program;
+	unsigned int vertex;
+	unsigned int fragment;
+};
+
+// Stage programs put together by a program pipeline (ARB_separate_shader_objects). They
+// belong to whoever built them (see ShaderVariantCache), several shaders can share them.
+struct ShaderPipelineStages {
+	unsigned int pipeline;
+	unsigned int vertex;
+	unsigned int fragment;
+};
+
+// What the uniform setters did, over every Shader since the last reset.
+struct ShaderUniformStats {
+	size_t sets;    // setter calls
+	size_t skipped; // of those, the ones that set the value the uniform already had
+	size_t uploads; // glUniform* calls made by flush
+};
+
 class Shader {
     private:
+	enum class UniformType { Int, Float, Vec2, Vec3, Mat4 };
+
+	// A uniform as it was last set. Its location is asked for once, the first time.
+	struct Uniform {
+		UniformType type;
+		unsigned int offset; // of the value in 'uniformValues'
+		int locations[2];    // per stage with a pipeline, or [0] for the whole program; -1 where it isn't
+		bool dirty;
+	};
+
 	unsigned int ID;
+	// Instead of ID when the stages are separate programs.
+	unsigned int pipeline;
+	unsigned int stages[2];
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::vector<std::string> defines;
+	// Stages built from SPIR-V, which keeps no names GL would look at. Their uniforms are
+	// found by the locations in the module instead (see ShaderModuleFile::findUniforms).
+	bool spirvStages[2];
+	std::unordered_map<std::string, int> uniformLocations[2];
+
+	// A copy of every uniform that's been set, so setting the value one already has does
+	// nothing, and the ones that changed go to GL together in flush().
+	std::unordered_map<std::string, unsigned int> uniformIndices;
+	std::vector<Uniform> uniforms;
+	std::vector<unsigned char> uniformValues; // all of them, one after the other
+	std::vector<unsigned int> dirtyUniforms;
+	static ShaderUniformStats uniformStats;
+
+	int getUniformLocation(const std::string& name) const;
+	int getStageUniformLocation(int stage, const std::string& name) const;
+	void findLocations(const std::string& name, Uniform& uniform) const;
+	// After the program changed: the locations may be others, and it has none of the values.
+	void resetUniforms();
+	void setUniform(const std::string& name, UniformType type, const void* value);
+	void uploadUniform(const Uniform& uniform);
     public:
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// Both files go through the ShaderPreprocessor with 'defines'.
+	Shader(const VirtualFileSystem& files, const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {});
+	// Takes over a program built some other way (see ShaderBuilder). 0 is a shader that
+	// failed to build.
+	Shader(unsigned int program, const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
+	// Draws with a pipeline. Uniforms go to whichever stages have them, with
+	// glProgramUniform*.
+	Shader(const ShaderPipelineStages& stages, const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
 	~Shader();
+
+	const std::string& getVertexPath() const;
+	const std::string& getFragmentPath() const;
+	// What it was preprocessed with, to build it again the same way.
+	const std::vector<std::string>& getDefines() const;
+
+	// Building a program in steps, so a reload doesn't stall the frame: beginBuild hands
+	// the sources to GL, isBuildDone tells when the driver has finished with them (always
+	// true without KHR_parallel_shader_compile, then the work happens in finishBuild), and
+	// finishBuild checks the result. It returns the program, or 0 after printing the log.
+	static ShaderBuild beginBuild(const std::string& vertexSource, const std::string& fragmentSource);
+	static bool isBuildDone(const ShaderBuild& build);
+	static unsigned int finishBuild(ShaderBuild& build);
+	// The same for a single stage (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER) in a separable
+	// program, to go in a pipeline.
+	static ShaderBuild beginStageBuild(unsigned int type, const std::string& source);
+	// Both again with SPIR-V modules compiled offline (ARB_gl_spirv, see ShaderModuleFile).
+	// GL can't link SPIR-V and GLSL shaders into one program, so it's both stages or none.
+	static ShaderBuild beginBuild(const std::vector<uint32_t>& vertexModule, const std::vector<uint32_t>& fragmentModule);
+	static ShaderBuild beginStageBuild(unsigned int type, const std::vector<uint32_t>& module);
+
+	// Tells that 'stage' (0 vertex, 1 fragment) was built from SPIR-V, and where its
+	// uniforms are.
+	void setSpirvUniforms(int stage, const std::unordered_map<std::string, int>& locations);
+
+	// Uses 'program' from now on and deletes the old one (a pipeline's stages are left to
+	// their owner). The uniforms set so far go to the new program at the next flush.
+	void replaceProgram(unsigned int program);
     
+	// Binds the program and flushes.
 	void use();
-	void setBool(const std::string& name, bool value) const;
-	void setInt(const std::string& name, int value) const;
-	void setFloat(const std::string& name, float value) const;
-	void setVec2f(const std::string& name, float x, float y) const;
-    void setVec3f(const std::string& name, float x, float y, float z) const;
-	void setMatrix4fv(const std::string& name, glm::mat4 value) const;
+	// Sends the uniforms that changed since the last flush. A linked program has to be in
+	// use for that, a pipeline doesn't. Draws only see what has been flushed.
+	void flush();
+
+	// These only keep the value, and mark it for flush if it's a different one.
+	void setBool(const std::string& name, bool value);
+	void setInt(const std::string& name, int value);
+	void setFloat(const std::string& name, float value);
+	void setVec2f(const std::string& name, float x, float y);
+    void setVec3f(const std::string& name, float x, float y, float z);
+	void setMatrix4fv(const std::string& name, glm::mat4 value);
+
+	static ShaderUniformStats getUniformStats();
+	static void resetUniformStats();
 };
@@ -0,0 +1,101 @@
+#include "ShaderBuilder.hpp"
+#include "ShaderPreprocessor.hpp"
+#include <glad/glad.h>
+#include <iostream>
+
+ShaderBuilder::ShaderBuilder(const VirtualFileSystem& files)
+	: files(files)
+{
+}
+
+ShaderBuilder::~ShaderBuilder()
+{
+	for (Program& program : programs) {
+		if (program.taken)
+			continue;
+
+		// Deleting doesn't wait for the driver, it drops whatever it was still doing.
+		glDeleteShader(program.build.vertex);
+		glDeleteShader(program.build.fragment);
+		glDeleteProgram(program.build.program);
+	}
+}
+
+unsigned int ShaderBuilder::add(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+{
+	PreprocessedShader vertexShader;
+	PreprocessedShader fragmentShader;
+
+	if (!ShaderPreprocessor::preprocess(files, vertexPath, defines, vertexShader) || !ShaderPreprocessor::preprocess(files, fragmentPath, defines, fragmentShader))
+		std::cout << "ERROR::SHADER_BUILDER::FILE_NOT_SUCCESFULLY_READ " << vertexPath << " " << fragmentPath << std::endl;
+
+	return addSources(vertexPath, fragmentPath, defines, vertexShader.source, fragmentShader.source);
+}
+
+unsigned int ShaderBuilder::addSources(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines,
+	const std::string& vertexSource, const std::string& fragmentSource)
+{
+	// GL copies the sources, so they can go right after.
+	programs.push_back({ vertexPath, fragmentPath, defines, Shader::beginBuild(vertexSource, fragmentSource), false });
+	return (unsigned int)programs.size() - 1;
+}
+
+unsigned int ShaderBuilder::addStage(unsigned int type, const std::string& path, const std::string& source)
+{
+	programs.push_back({ path, "", {}, Shader::beginStageBuild(type, source), false });
+	return (unsigned int)programs.size() - 1;
+}
+
+unsigned int ShaderBuilder::addModules(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines,
+	const std::vector<uint32_t>& vertexModule, const std::vector<uint32_t>& fragmentModule)
+{
+	programs.push_back({ vertexPath, fragmentPath, defines, Shader::beginBuild(vertexModule, fragmentModule), false });
+	return (unsigned int)programs.size() - 1;
+}
+
+unsigned int ShaderBuilder::addStage(unsigned int type, const std::string& path, const std::vector<uint32_t>& module)
+{
+	programs.push_back({ path, "", {}, Shader::beginStageBuild(type, module), false });
+	return (unsigned int)programs.size() - 1;
+}
+
+bool ShaderBuilder::isReady(unsigned int index) const
+{
+	return !programs[index].taken && Shader::isBuildDone(programs[index].build);
+}
+
+size_t ShaderBuilder::getPendingCount() const
+{
+	size_t pending = 0;
+
+	for (const Program& program : programs) {
+		if (!program.taken && !Shader::isBuildDone(program.build))
+			pending++;
+	}
+
+	return pending;
+}
+
+Shader* ShaderBuilder::take(unsigned int index)
+{
+	if (programs[index].taken) {
+		std::cout << "ERROR::SHADER_BUILDER::ALREADY_TAKEN " << programs[index].vertexPath << std::endl;
+		return nullptr;
+	}
+
+	Program& program = programs[index];
+	return new Shader(takeProgram(index), program.vertexPath, program.fragmentPath, program.defines);
+}
+
+unsigned int ShaderBuilder::takeProgram(unsigned int index)
+{
+	Program& program = programs[index];
+	if (program.taken) {
+		std::cout << "ERROR::SHADER_BUILDER::ALREADY_TAKEN " << program.vertexPath << std::endl;
+		return 0;
+	}
+
+	// finishBuild asks for the statuses, which is where an unfinished build gets waited for.
+	program.taken = true;
+	return Shader::finishBuild(program.build);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Shader.hpp"
+
+class VirtualFileSystem;
+
+// Builds many programs at once instead of one after the other.
+//
+// Asking for GL_COMPILE_STATUS right after glCompileShader (what the Shader constructor
+// does) makes the driver finish that compile on the spot, so every program waits for the
+// one before it. Here add() only hands the sources to GL and goes on to the next one.
+// With KHR_parallel_shader_compile the driver then compiles them on its own threads
+// (GLExtensions::load lets it use as many as it wants), and isReady asks
+// GL_COMPLETION_STATUS_KHR, which never waits. Only take() checks the result, so a
+// program is only waited for once it's actually needed, and by then it's usually done.
+//
+// Without the extension it's no worse than building them one by one: the work happens
+// in take().
+class ShaderBuilder {
+    private:
+	struct Program {
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::vector<std::string> defines;
+		ShaderBuild build;
+		bool taken;
+	};
+
+	const VirtualFileSystem& files;
+	std::vector<Program> programs;
+    public:
+	ShaderBuilder(const VirtualFileSystem& files);
+	// Deletes the programs nobody took.
+	~ShaderBuilder();
+
+	ShaderBuilder(const ShaderBuilder&) = delete;
+	ShaderBuilder& operator=(const ShaderBuilder&) = delete;
+
+	// Preprocesses both files with 'defines' (see ShaderPreprocessor) and starts building
+	// them. Returns what to pass to isReady and take.
+	unsigned int add(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {});
+	// The same with sources preprocessed already. The paths and defines are only kept for
+	// the Shader.
+	unsigned int addSources(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines,
+		const std::string& vertexSource, const std::string& fragmentSource);
+	// A single stage as a separable program (see Shader::beginStageBuild), built the same
+	// way. Take it with takeProgram.
+	unsigned int addStage(unsigned int type, const std::string& path, const std::string& source);
+	// Both again from SPIR-V modules (see Shader::beginBuild).
+	unsigned int addModules(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines,
+		const std::vector<uint32_t>& vertexModule, const std::vector<uint32_t>& fragmentModule);
+	unsigned int addStage(unsigned int type, const std::string& path, const std::vector<uint32_t>& module);
+
+	// True once the driver is done with the program, without waiting for it.
+	bool isReady(unsigned int index) const;
+	// How many programs that haven't been taken are still building.
+	size_t getPendingCount() const;
+
+	// The finished program as a Shader, waiting for it if it isn't done yet. It belongs to
+	// the caller. Failures print their log and give a Shader with program 0.
+	Shader* take(unsigned int index);
+	// The same as the bare program, 0 if it failed.
+	unsigned int takeProgram(unsigned int index);
+};
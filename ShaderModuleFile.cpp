@@ -0,0 +1,135 @@
+#include "ShaderModuleFile.hpp"
+#include "AssetCooker.hpp"
+#include "VirtualFileSystem.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// The few bits of the SPIR-V spec findUniforms needs.
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+constexpr size_t SPIRV_HEADER_WORDS = 5;
+constexpr uint32_t SPIRV_OP_NAME = 5;
+constexpr uint32_t SPIRV_OP_VARIABLE = 59;
+constexpr uint32_t SPIRV_OP_DECORATE = 71;
+constexpr uint32_t SPIRV_DECORATION_LOCATION = 30;
+constexpr uint32_t SPIRV_STORAGE_UNIFORM_CONSTANT = 0;
+
+uint64_t ShaderModuleFile::hashStage(unsigned int type, const std::string& source)
+{
+	return AssetCooker::hashBytes(source.data(), source.size(), type);
+}
+
+bool ShaderModuleFile::write(const std::string& path, const std::unordered_map<uint64_t, std::vector<uint32_t>>& modules)
+{
+	// Sorted, so cooking the same thing twice writes the same file.
+	std::vector<uint64_t> keys;
+	for (const auto& module : modules) {
+		keys.push_back(module.first);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	ShaderModuleFileHeader header = {};
+	memcpy(header.magic, "SPVM", 4);
+	header.version = SHADER_MODULE_FILE_VERSION;
+	header.moduleCount = (uint32_t)keys.size();
+
+	std::vector<ShaderModuleEntry> entries;
+	uint64_t offset = sizeof(ShaderModuleFileHeader) + keys.size() * sizeof(ShaderModuleEntry);
+	for (uint64_t key : keys) {
+		size_t wordCount = modules.at(key).size();
+		entries.push_back({ key, offset, wordCount });
+		offset += wordCount * sizeof(uint32_t);
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(ShaderModuleEntry)));
+	for (uint64_t key : keys) {
+		const std::vector<uint32_t>& words = modules.at(key);
+		out.write((const char*)words.data(), (std::streamsize)(words.size() * sizeof(uint32_t)));
+	}
+
+	if (!out) {
+		std::cout << "ERROR::SHADER_MODULE_FILE::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool ShaderModuleFile::read(const VirtualFileSystem& files, const std::string& path, std::unordered_map<uint64_t, std::vector<uint32_t>>& modules)
+{
+	FileData file;
+	if (!files.read(path, file))
+		return false;
+
+	ShaderModuleFileHeader header;
+	bool valid = file.size() >= sizeof(header);
+	if (valid) {
+		memcpy(&header, file.data(), sizeof(header));
+		valid = memcmp(header.magic, "SPVM", 4) == 0 && header.version == SHADER_MODULE_FILE_VERSION
+			&& file.size() >= sizeof(header) + (uint64_t)header.moduleCount * sizeof(ShaderModuleEntry);
+	}
+
+	for (uint32_t i = 0; valid && i < header.moduleCount; i++) {
+		ShaderModuleEntry entry;
+		memcpy(&entry, file.data() + sizeof(header) + i * sizeof(ShaderModuleEntry), sizeof(entry));
+
+		valid = entry.offset <= file.size() && entry.wordCount <= (file.size() - entry.offset) / sizeof(uint32_t);
+		if (!valid)
+			break;
+
+		std::vector<uint32_t>& words = modules[entry.key];
+		words.resize((size_t)entry.wordCount);
+		memcpy(words.data(), file.data() + entry.offset, words.size() * sizeof(uint32_t));
+	}
+
+	if (!valid) {
+		std::cout << "ERROR::SHADER_MODULE_FILE::INVALID_FILE " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void ShaderModuleFile::findUniforms(const std::vector<uint32_t>& module, std::unordered_map<std::string, int>& locations)
+{
+	if (module.size() < SPIRV_HEADER_WORDS || module[0] != SPIRV_MAGIC)
+		return;
+
+	std::unordered_map<uint32_t, std::string> names;
+	std::unordered_map<uint32_t, int> decoratedLocations;
+	std::vector<uint32_t> uniforms;
+
+	// Every instruction starts with its length in words and its opcode.
+	for (size_t i = SPIRV_HEADER_WORDS; i < module.size();) {
+		uint32_t length = module[i] >> 16;
+		uint32_t opcode = module[i] & 0xFFFF;
+		if (length == 0 || i + length > module.size())
+			break;
+
+		const uint32_t* operands = &module[i + 1];
+
+		if (opcode == SPIRV_OP_NAME && length >= 3) {
+			// Null terminated, padded to a whole word.
+			const char* name = (const char*)&operands[1];
+			names[operands[0]] = std::string(name, strnlen(name, (length - 2) * sizeof(uint32_t)));
+		}
+		else if (opcode == SPIRV_OP_DECORATE && length >= 4 && operands[1] == SPIRV_DECORATION_LOCATION) {
+			decoratedLocations[operands[0]] = (int)operands[2];
+		}
+		else if (opcode == SPIRV_OP_VARIABLE && length >= 4 && operands[2] == SPIRV_STORAGE_UNIFORM_CONSTANT) {
+			uniforms.push_back(operands[1]);
+		}
+
+		i += length;
+	}
+
+	for (uint32_t id : uniforms) {
+		auto name = names.find(id);
+		auto location = decoratedLocations.find(id);
+		if (name != names.end() && location != decoratedLocations.end())
+			locations[name->second] = location->second;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class VirtualFileSystem;
+
+// Shader stages compiled offline to SPIR-V (.spirv), what the AssetCooker makes of a
+// .variants manifest for ARB_gl_spirv:
+//
+//   ShaderModuleFileHeader
+//   ShaderModuleEntry[moduleCount]
+//   the SPIR-V of every module, in 4 byte words
+//
+// A module is found by the hash of the preprocessed GLSL it was compiled from (hashStage),
+// which the runtime gets again by preprocessing the same variant. A source that changed
+// after the cook hashes to something else, so it's built from GLSL instead of from a
+// module that's out of date.
+
+constexpr uint32_t SHADER_MODULE_FILE_VERSION = 1;
+
+struct ShaderModuleFileHeader {
+	char magic[4]; // "SPVM"
+	uint32_t version;
+	uint32_t moduleCount;
+	uint32_t reserved;
+};
+
+struct ShaderModuleEntry {
+	uint64_t key;
+	uint64_t offset; // in bytes, from the start of the file
+	uint64_t wordCount;
+};
+
+class ShaderModuleFile {
+    public:
+	// 'type' is GL_VERTEX_SHADER or GL_FRAGMENT_SHADER: the same source as either one is
+	// a different module.
+	static uint64_t hashStage(unsigned int type, const std::string& source);
+
+	static bool write(const std::string& path, const std::unordered_map<uint64_t, std::vector<uint32_t>>& modules);
+	// Adds the modules in 'path' to 'modules'.
+	static bool read(const VirtualFileSystem& files, const std::string& path, std::unordered_map<uint64_t, std::vector<uint32_t>>& modules);
+
+	// The location of every uniform outside a block (samplers too) by name, taken from
+	// the debug names in the module. GL doesn't look at those, so the uniforms of a SPIR-V
+	// program can't be found with glGetUniformLocation.
+	static void findUniforms(const std::vector<uint32_t>& module, std::unordered_map<std::string, int>& locations);
+};
@@ -0,0 +1,203 @@
+#include "ShaderPreprocessor.hpp"
+#include "VirtualFileSystem.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// Deeper than this is an include cycle (or close enough to one).
+constexpr int MAX_INCLUDE_DEPTH = 32;
+
+static std::string defineLine(const std::string& define)
+{
+	size_t equals = define.find('=');
+	if (equals == std::string::npos)
+		return "#define " + define + " 1\n";
+
+	return "#define " + define.substr(0, equals) + " " + define.substr(equals + 1) + "\n";
+}
+
+bool ShaderPreprocessor::preprocess(const VirtualFileSystem& files, const std::string& path, const std::vector<std::string>& defines,
+	PreprocessedShader& result)
+{
+	result = {};
+	return processFile(files, path, defines, result, 0);
+}
+
+bool ShaderPreprocessor::preprocessVariant(const VirtualFileSystem& files, const std::string& vertexPath, const std::string& fragmentPath,
+	std::vector<std::string> keywords, bool separateStages, PreprocessedVariant& result)
+{
+	// The order they're asked for in doesn't make a different variant.
+	std::sort(keywords.begin(), keywords.end());
+	keywords.erase(std::unique(keywords.begin(), keywords.end()), keywords.end());
+
+	result = {};
+	bool ok = preprocess(files, vertexPath, keywords, result.vertex) && preprocess(files, fragmentPath, keywords, result.fragment);
+
+	// Only the keywords these files have make a difference. Preprocessed again without
+	// the others, so they don't change the hash. Separate stages only get their own, or a
+	// fragment keyword would make a new vertex stage.
+	std::vector<std::string> vertexDefines, fragmentDefines;
+	for (const std::string& keyword : keywords) {
+		bool vertex = std::count(result.vertex.keywords.begin(), result.vertex.keywords.end(), keyword) != 0;
+		bool fragment = std::count(result.fragment.keywords.begin(), result.fragment.keywords.end(), keyword) != 0;
+		if (vertex || fragment)
+			result.defines.push_back(keyword);
+		if (vertex || (fragment && !separateStages))
+			vertexDefines.push_back(keyword);
+		if (fragment || (vertex && !separateStages))
+			fragmentDefines.push_back(keyword);
+	}
+
+	if (separateStages)
+		vertexDefines.push_back("SEPARATE_STAGES");
+
+	if (ok && vertexDefines != keywords)
+		ok = preprocess(files, vertexPath, vertexDefines, result.vertex);
+	if (ok && fragmentDefines != keywords)
+		ok = preprocess(files, fragmentPath, fragmentDefines, result.fragment);
+
+	return ok;
+}
+
+bool ShaderPreprocessor::readVariants(const VirtualFileSystem& files, const std::string& manifestPath, std::vector<ShaderVariantRequest>& requests)
+{
+	FileData manifest;
+	if (!files.read(manifestPath, manifest)) {
+		std::cout << "ERROR::SHADER_PREPROCESSOR::FILE_NOT_SUCCESFULLY_READ " << manifestPath << std::endl;
+		return false;
+	}
+
+	fs::path directory = fs::path(manifestPath).parent_path();
+	std::istringstream lines(std::string((const char*)manifest.data(), manifest.size()));
+	std::string line;
+
+	while (std::getline(lines, line)) {
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream words(line);
+		ShaderVariantRequest request;
+		if (!(words >> request.vertexPath >> request.fragmentPath))
+			continue;
+
+		std::string keyword;
+		while (words >> keyword) {
+			request.keywords.push_back(keyword);
+		}
+
+		request.vertexPath = (directory / request.vertexPath).generic_string();
+		request.fragmentPath = (directory / request.fragmentPath).generic_string();
+		requests.push_back(request);
+	}
+
+	return true;
+}
+
+bool ShaderPreprocessor::processFile(const VirtualFileSystem& files, const std::string& path, const std::vector<std::string>& defines,
+	PreprocessedShader& result, int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH) {
+		std::cout << "ERROR::SHADER_PREPROCESSOR::INCLUDES_TOO_DEEP " << path << std::endl;
+		return false;
+	}
+
+	FileData file;
+	if (!files.read(path, file)) {
+		std::cout << "ERROR::SHADER_PREPROCESSOR::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return false;
+	}
+
+	size_t fileIndex = result.files.size();
+	result.files.push_back(path);
+
+	std::string text((const char*)file.data(), file.size());
+	text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+
+	// Without a #version the defines still have to go somewhere.
+	bool definesAdded = false;
+	if (depth == 0 && text.find("#version") == std::string::npos) {
+		for (const std::string& define : defines) {
+			result.source += defineLine(define);
+		}
+		result.source += "#line 1 0\n";
+		definesAdded = true;
+	}
+
+	std::istringstream lines(text);
+	std::string line;
+	int lineNumber = 0;
+	bool ok = true;
+
+	while (std::getline(lines, line)) {
+		lineNumber++;
+
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line[start] != '#') {
+			result.source += line + "\n";
+			continue;
+		}
+
+		std::istringstream directive(line.substr(start + 1));
+		std::string name;
+		directive >> name;
+
+		if (name == "version") {
+			// Only the shader's own: it has to come first, so an included one can't.
+			if (depth > 0 || definesAdded) {
+				result.source += "\n";
+				continue;
+			}
+
+			result.source += line + "\n";
+			for (const std::string& define : defines) {
+				result.source += defineLine(define);
+			}
+			result.source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			definesAdded = true;
+		}
+		else if (name == "include") {
+			size_t open = line.find('"');
+			size_t close = open != std::string::npos ? line.find('"', open + 1) : std::string::npos;
+			if (close == std::string::npos) {
+				std::cout << "ERROR::SHADER_PREPROCESSOR::BAD_INCLUDE " << path << "(" << lineNumber << ")" << std::endl;
+				ok = false;
+				result.source += "\n";
+				continue;
+			}
+
+			std::string included = (fs::path(path).parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal().generic_string();
+
+			if (std::find(result.files.begin(), result.files.end(), included) != result.files.end()) {
+				result.source += "\n";
+				continue;
+			}
+
+			result.source += "#line 1 " + std::to_string(result.files.size()) + "\n";
+			ok = processFile(files, included, defines, result, depth + 1) && ok;
+			result.source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+		}
+		else if (name == "pragma") {
+			std::string pragma;
+			directive >> pragma;
+
+			if (pragma != "keywords") {
+				result.source += line + "\n";
+				continue;
+			}
+
+			std::string keyword;
+			while (directive >> keyword) {
+				if (std::find(result.keywords.begin(), result.keywords.end(), keyword) == result.keywords.end())
+					result.keywords.push_back(keyword);
+			}
+			result.source += "\n";
+		}
+		else {
+			result.source += line + "\n";
+		}
+	}
+
+	return ok;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class VirtualFileSystem;
+
+// A shader after ShaderPreprocessor::preprocess, ready for glShaderSource.
+struct PreprocessedShader {
+	std::string source;
+	// Every file that went into it, the shader itself first. The index of a file is the
+	// source string number GL puts in front of the line numbers in its error log.
+	std::vector<std::string> files;
+	// What the files declared with #pragma keywords.
+	std::vector<std::string> keywords;
+};
+
+// Both stages of a variant (see ShaderPreprocessor::preprocessVariant).
+struct PreprocessedVariant {
+	PreprocessedShader vertex;
+	PreprocessedShader fragment;
+	// The keywords asked for that either stage declares, sorted.
+	std::vector<std::string> defines;
+};
+
+// A line of a .variants manifest, with the paths relative to where the manifest is.
+struct ShaderVariantRequest {
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::vector<std::string> keywords;
+};
+
+// The few things GLSL doesn't do by itself, done before GL sees the source:
+//
+//   #include "file"          pasted in, the path relative to the file including it. A file
+//                             is only included once, however often it's asked for.
+//   #pragma keywords A B ...  the switches this shader has. A variant is the shader with
+//                             some of them #defined (see ShaderVariantCache).
+//
+// 'defines' are added as "#define NAME 1" right after #version, or "#define NAME VALUE"
+// for "NAME=VALUE". #line directives keep the line numbers in GL's error log pointing
+// into the right file.
+class ShaderPreprocessor {
+    private:
+	static bool processFile(const VirtualFileSystem& files, const std::string& path, const std::vector<std::string>& defines,
+		PreprocessedShader& result, int depth);
+    public:
+	static bool preprocess(const VirtualFileSystem& files, const std::string& path, const std::vector<std::string>& defines,
+		PreprocessedShader& result);
+
+	// A vertex and fragment shader with those of 'keywords' defined that one of them
+	// declares, so asking for one they don't have gives the same sources. With
+	// 'separateStages' each stage only gets its own, plus SEPARATE_STAGES for the vertex
+	// shader, to be built on its own (see ShaderVariantCache). The AssetCooker goes
+	// through here too, so it compiles exactly the sources the runtime asks for.
+	static bool preprocessVariant(const VirtualFileSystem& files, const std::string& vertexPath, const std::string& fragmentPath,
+		std::vector<std::string> keywords, bool separateStages, PreprocessedVariant& result);
+
+	// One request per line:
+	//     vertex.vs fragment.fs KEYWORD KEYWORD...
+	// with the files relative to the manifest, and # for comments.
+	static bool readVariants(const VirtualFileSystem& files, const std::string& manifestPath, std::vector<ShaderVariantRequest>& requests);
+};
@@ -0,0 +1,242 @@
+#include "ShaderVariantCache.hpp"
+#include "AssetCooker.hpp"
+#include "GLExtensions.hpp"
+#include "ShaderModuleFile.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "StateCache.hpp"
+#include "VirtualFileSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+ShaderVariantCache::ShaderVariantCache(const VirtualFileSystem& files)
+	: files(files), builder(files), separateStages(GLExtensions::separateShaderObjects), spirv(GLExtensions::spirv), deduplicated(0), links(0),
+	  fromSpirv(0), milliseconds(0.0)
+{
+}
+
+ShaderVariantCache::~ShaderVariantCache()
+{
+	// The builder deletes the programs that were never taken.
+	for (auto& program : programs) {
+		delete program.second.shader;
+	}
+
+	for (auto& stage : stages) {
+		if (stage.second.taken)
+			glDeleteProgram(stage.second.program);
+	}
+
+	for (auto& pipeline : pipelines) {
+		StateCache::current().forgetProgramPipeline(pipeline.second);
+		GLExtensions::glDeleteProgramPipelines(1, &pipeline.second);
+	}
+}
+
+void ShaderVariantCache::setOnCreate(std::function<void(Shader&)> callback)
+{
+	onCreate = std::move(callback);
+}
+
+uint64_t ShaderVariantCache::hashSources(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	return AssetCooker::hashBytes(fragmentSource.data(), fragmentSource.size(), AssetCooker::hashBytes(vertexSource.data(), vertexSource.size()));
+}
+
+std::string ShaderVariantCache::variantKey(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string>& keywords)
+{
+	// The order they're asked for in doesn't make a different variant.
+	std::sort(keywords.begin(), keywords.end());
+	keywords.erase(std::unique(keywords.begin(), keywords.end()), keywords.end());
+
+	std::string key = vertexPath + "|" + fragmentPath + "|";
+	for (const std::string& keyword : keywords) {
+		key += keyword + " ";
+	}
+
+	return key;
+}
+
+uint64_t ShaderVariantCache::request(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> keywords)
+{
+	std::string key = variantKey(vertexPath, fragmentPath, keywords);
+	auto known = variants.find(key);
+	if (known != variants.end())
+		return known->second;
+
+	PreprocessedVariant variant;
+	ShaderPreprocessor::preprocessVariant(files, vertexPath, fragmentPath, keywords, separateStages, variant);
+
+	uint64_t hash = hashSources(variant.vertex.source, variant.fragment.source);
+	variants[key] = hash;
+
+	if (programs.count(hash) != 0) {
+		deduplicated++;
+		return hash;
+	}
+
+	// Handing the sources over is cheap with KHR_parallel_shader_compile, and where most
+	// of the compile happens without it.
+	auto start = std::chrono::steady_clock::now();
+
+	Program program = { 0, 0, 0, vertexPath, fragmentPath, variant.defines, nullptr, false, {} };
+	if (separateStages) {
+		program.vertexStage = requestStage(GL_VERTEX_SHADER, vertexPath, variant.vertex.source);
+		program.fragmentStage = requestStage(GL_FRAGMENT_SHADER, fragmentPath, variant.fragment.source);
+		programs[hash] = std::move(program);
+		milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return hash;
+	}
+
+	auto vertexModule = modules.find(ShaderModuleFile::hashStage(GL_VERTEX_SHADER, variant.vertex.source));
+	auto fragmentModule = modules.find(ShaderModuleFile::hashStage(GL_FRAGMENT_SHADER, variant.fragment.source));
+
+	if (vertexModule != modules.end() && fragmentModule != modules.end()) {
+		program.build = builder.addModules(vertexPath, fragmentPath, variant.defines, vertexModule->second, fragmentModule->second);
+		program.spirv = true;
+		ShaderModuleFile::findUniforms(vertexModule->second, program.uniforms[0]);
+		ShaderModuleFile::findUniforms(fragmentModule->second, program.uniforms[1]);
+		fromSpirv++;
+	}
+	else {
+		program.build = builder.addSources(vertexPath, fragmentPath, variant.defines, variant.vertex.source, variant.fragment.source);
+	}
+	links++;
+
+	programs[hash] = std::move(program);
+	milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return hash;
+}
+
+uint64_t ShaderVariantCache::requestStage(unsigned int type, const std::string& path, const std::string& source)
+{
+	uint64_t hash = ShaderModuleFile::hashStage(type, source);
+	if (stages.count(hash) != 0)
+		return hash;
+
+	// Pipelines don't mind one stage being SPIR-V and the other GLSL.
+	Stage& stage = stages[hash];
+	auto module = modules.find(hash);
+
+	if (module != modules.end()) {
+		stage.build = builder.addStage(type, path, module->second);
+		stage.spirv = true;
+		ShaderModuleFile::findUniforms(module->second, stage.uniforms);
+		fromSpirv++;
+	}
+	else {
+		stage.build = builder.addStage(type, path, source);
+	}
+	links++;
+
+	return hash;
+}
+
+unsigned int ShaderVariantCache::takeStage(uint64_t hash)
+{
+	Stage& stage = stages[hash];
+	if (!stage.taken) {
+		stage.program = builder.takeProgram(stage.build);
+		stage.taken = true;
+	}
+
+	return stage.program;
+}
+
+Shader* ShaderVariantCache::createPipelineShader(const Program& program)
+{
+	unsigned int vertex = takeStage(program.vertexStage);
+	unsigned int fragment = takeStage(program.fragmentStage);
+
+	// The stage that failed already printed its log.
+	if (vertex == 0 || fragment == 0)
+		return new Shader(0u, program.vertexPath, program.fragmentPath, program.defines);
+
+	// Variants that only differ in their fragment shader share the vertex stage, and the
+	// other way around. Only the pair needs a pipeline of its own, and that's no link.
+	uint64_t key = (uint64_t)vertex << 32 | fragment;
+	auto known = pipelines.find(key);
+	GLuint pipeline = 0;
+
+	if (known != pipelines.end()) {
+		pipeline = known->second;
+	}
+	else {
+		GLExtensions::glGenProgramPipelines(1, &pipeline);
+		GLExtensions::glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT, vertex);
+		GLExtensions::glUseProgramStages(pipeline, GL_FRAGMENT_SHADER_BIT, fragment);
+		pipelines[key] = pipeline;
+	}
+
+	Shader* shader = new Shader(ShaderPipelineStages{ pipeline, vertex, fragment }, program.vertexPath, program.fragmentPath, program.defines);
+
+	const Stage& vertexStage = stages[program.vertexStage];
+	const Stage& fragmentStage = stages[program.fragmentStage];
+	if (vertexStage.spirv)
+		shader->setSpirvUniforms(0, vertexStage.uniforms);
+	if (fragmentStage.spirv)
+		shader->setSpirvUniforms(1, fragmentStage.uniforms);
+
+	return shader;
+}
+
+Shader* ShaderVariantCache::get(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& keywords)
+{
+	Program& program = programs[request(vertexPath, fragmentPath, keywords)];
+
+	if (program.shader == nullptr) {
+		// Taking it waits for whatever the driver hasn't finished.
+		auto start = std::chrono::steady_clock::now();
+		if (separateStages) {
+			program.shader = createPipelineShader(program);
+		}
+		else {
+			program.shader = builder.take(program.build);
+			if (program.spirv) {
+				program.shader->setSpirvUniforms(0, program.uniforms[0]);
+				program.shader->setSpirvUniforms(1, program.uniforms[1]);
+			}
+		}
+		milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (onCreate)
+			onCreate(*program.shader);
+	}
+
+	return program.shader;
+}
+
+size_t ShaderVariantCache::prewarm(const std::string& manifestPath)
+{
+	std::vector<ShaderVariantRequest> requests;
+	if (!ShaderPreprocessor::readVariants(files, manifestPath, requests))
+		return 0;
+
+	// Not cooked when the cooker had no SPIR-V compiler, then it's all GLSL.
+	std::string modulePath = fs::path(manifestPath).replace_extension(".spirv").generic_string();
+	if (spirv && files.exists(modulePath))
+		ShaderModuleFile::read(files, modulePath, modules);
+
+	for (const ShaderVariantRequest& variant : requests) {
+		request(variant.vertexPath, variant.fragmentPath, variant.keywords);
+	}
+
+	return requests.size();
+}
+
+ShaderVariantStats ShaderVariantCache::getStats() const
+{
+	ShaderVariantStats stats = {};
+	stats.variants = variants.size();
+	stats.programs = programs.size();
+	stats.deduplicated = deduplicated;
+	stats.stages = stages.size();
+	stats.pipelines = pipelines.size();
+	stats.links = links;
+	stats.fromSpirv = fromSpirv;
+	stats.milliseconds = milliseconds;
+	stats.building = builder.getPendingCount();
+	return stats;
+}
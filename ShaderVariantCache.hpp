@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ShaderBuilder.hpp"
+
+class VirtualFileSystem;
+
+struct ShaderVariantStats {
+	size_t variants;     // different (shader, keywords) asked for
+	size_t programs;     // different sources asked for
+	size_t deduplicated; // variants that came out the same as another one
+	size_t stages;       // separable stage programs
+	size_t pipelines;    // pipelines putting them together
+	size_t links;        // programs linked, stage or whole
+	size_t fromSpirv;    // of those, the ones built from SPIR-V
+	size_t building;     // programs not taken yet that the driver is still working on
+	double milliseconds; // spent in GL building them, on this thread
+};
+
+// Every variant of a shader that's been asked for, built once.
+//
+// A variant is a vertex and fragment shader with some of their keywords (#pragma keywords,
+// see ShaderPreprocessor) defined, so a feature that's off costs nothing instead of a
+// branch on a uniform. Variants are built the first time get() asks for one, or ahead of
+// time from a manifest (prewarm), in which case the driver builds them all in parallel
+// and get() usually finds them done.
+//
+// Programs are keyed by a 64 bit hash of both preprocessed sources, defines included:
+// keywords neither file declares are dropped, and two variants that end up with the same
+// source share one program.
+//
+// With ARB_separate_shader_objects the two stages aren't linked together at all. Each
+// stage is its own separable program, keyed by the hash of its source, and a variant is a
+// program pipeline over two of them, cached by the pair. So M vertex and N fragment
+// variants take M + N links instead of M * N. Vertex shaders get SEPARATE_STAGES defined
+// then, to redeclare gl_PerVertex the way separable programs need it.
+//
+// With ARB_gl_spirv, prewarm also loads the SPIR-V the AssetCooker compiled for the
+// manifest (shader.variants -> shader.spirv), and any stage whose preprocessed source
+// has a module there is built from that instead of from GLSL. Everything else, and all of
+// it on drivers without the extension, still builds from GLSL.
+class ShaderVariantCache {
+    private:
+	struct Stage {
+		unsigned int build; // in 'builder' until it's taken
+		unsigned int program;
+		bool taken;
+		bool spirv;
+		std::unordered_map<std::string, int> uniforms; // SPIR-V only
+	};
+
+	struct Program {
+		unsigned int build; // in 'builder' until 'shader' is taken out of it
+		uint64_t vertexStage;   // or these two, with separate stages
+		uint64_t fragmentStage;
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::vector<std::string> defines;
+		Shader* shader;
+		bool spirv;
+		std::unordered_map<std::string, int> uniforms[2]; // SPIR-V only, per stage
+	};
+
+	const VirtualFileSystem& files;
+	ShaderBuilder builder;
+	std::unordered_map<std::string, uint64_t> variants; // "vertex|fragment|KEYWORD KEYWORD" -> program
+	std::unordered_map<uint64_t, Program> programs;
+	std::unordered_map<uint64_t, Stage> stages;
+	std::unordered_map<uint64_t, unsigned int> pipelines; // both stage programs -> pipeline
+	std::unordered_map<uint64_t, std::vector<uint32_t>> modules; // see ShaderModuleFile
+	std::function<void(Shader&)> onCreate;
+	bool separateStages;
+	bool spirv;
+	size_t deduplicated;
+	size_t links;
+	size_t fromSpirv;
+	double milliseconds;
+
+	static std::string variantKey(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string>& keywords);
+	uint64_t request(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> keywords);
+	uint64_t requestStage(unsigned int type, const std::string& path, const std::string& source);
+	unsigned int takeStage(uint64_t hash);
+	Shader* createPipelineShader(const Program& program);
+    public:
+	explicit ShaderVariantCache(const VirtualFileSystem& files);
+	// Deletes every Shader it gave out.
+	~ShaderVariantCache();
+
+	ShaderVariantCache(const ShaderVariantCache&) = delete;
+	ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+	// Starts building the variants listed in 'manifestPath' (see
+	// ShaderPreprocessor::readVariants), with the SPIR-V cooked next to it if there is any.
+	// Returns how many.
+	size_t prewarm(const std::string& manifestPath);
+
+	// The variant with 'keywords' defined, built (or waited for) if this is the first time.
+	// Cheap after that. The Shader belongs to the cache.
+	Shader* get(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& keywords = {});
+
+	// Called on every new Shader when it's first handed out, to set its uniforms.
+	void setOnCreate(std::function<void(Shader&)> callback);
+
+	// A hash of the two sources, what programs are found by.
+	static uint64_t hashSources(const std::string& vertexSource, const std::string& fragmentSource);
+
+	ShaderVariantStats getStats() const;
+};
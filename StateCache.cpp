@@ -0,0 +1,204 @@
+#include "StateCache.hpp"
+#include "GLExtensions.hpp"
+
+StateCache::StateCache()
+	: stats()
+{
+	// Whatever ran before the cache existed may have bound anything.
+	invalidate();
+}
+
+StateCache& StateCache::current()
+{
+	static StateCache cache;
+	return cache;
+}
+
+void StateCache::invalidate()
+{
+	program = UNKNOWN;
+	pipeline = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeUnit = UNKNOWN;
+	arrayBuffer = UNKNOWN;
+	copyWriteBuffer = UNKNOWN;
+	pixelUnpackBuffer = UNKNOWN;
+
+	for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++) {
+		textures[unit] = UNKNOWN;
+		samplers[unit] = UNKNOWN;
+	}
+}
+
+void StateCache::useProgram(GLuint program)
+{
+	if (this->program == program) {
+		stats.skipped++;
+		return;
+	}
+
+	glUseProgram(program);
+	this->program = program;
+	stats.binds++;
+}
+
+void StateCache::bindProgramPipeline(GLuint pipeline)
+{
+	useProgram(0);
+
+	if (this->pipeline == pipeline) {
+		stats.skipped++;
+		return;
+	}
+
+	GLExtensions::glBindProgramPipeline(pipeline);
+	this->pipeline = pipeline;
+	stats.binds++;
+}
+
+void StateCache::bindVertexArray(GLuint vertexArray)
+{
+	if (this->vertexArray == vertexArray) {
+		stats.skipped++;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	this->vertexArray = vertexArray;
+	stats.binds++;
+}
+
+GLuint StateCache::getVertexArray() const
+{
+	return vertexArray;
+}
+
+void StateCache::activate(GLuint unit)
+{
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+}
+
+void StateCache::bindTexture(GLuint unit, GLuint texture)
+{
+	if (unit < TEXTURE_UNITS && textures[unit] == texture) {
+		stats.skipped++;
+		return;
+	}
+
+	// With DSA there's no active unit to switch to first.
+	if (GLExtensions::directStateAccess) {
+		GLExtensions::glBindTextureUnit(unit, texture);
+	}
+	else {
+		activate(unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+
+	if (unit < TEXTURE_UNITS)
+		textures[unit] = texture;
+	stats.binds++;
+}
+
+void StateCache::bindTextureForEdit(GLuint texture)
+{
+	activate(EDIT_UNIT);
+
+	if (textures[EDIT_UNIT] == texture) {
+		stats.skipped++;
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	textures[EDIT_UNIT] = texture;
+	stats.binds++;
+}
+
+void StateCache::bindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit < TEXTURE_UNITS && samplers[unit] == sampler) {
+		stats.skipped++;
+		return;
+	}
+
+	// Samplers are bound to a unit by number, there's no active unit involved.
+	glBindSampler(unit, sampler);
+
+	if (unit < TEXTURE_UNITS)
+		samplers[unit] = sampler;
+	stats.binds++;
+}
+
+GLuint* StateCache::bufferBinding(GLenum target)
+{
+	switch (target) {
+	case GL_ARRAY_BUFFER: return &arrayBuffer;
+	case GL_COPY_WRITE_BUFFER: return &copyWriteBuffer;
+	case GL_PIXEL_UNPACK_BUFFER: return &pixelUnpackBuffer;
+	default: return nullptr;
+	}
+}
+
+void StateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* bound = bufferBinding(target);
+	if (bound != nullptr && *bound == buffer) {
+		stats.skipped++;
+		return;
+	}
+
+	glBindBuffer(target, buffer);
+	if (bound != nullptr)
+		*bound = buffer;
+	stats.binds++;
+}
+
+void StateCache::forgetTexture(GLuint texture)
+{
+	for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++) {
+		if (textures[unit] == texture)
+			textures[unit] = 0;
+	}
+}
+
+void StateCache::forgetSampler(GLuint sampler)
+{
+	for (GLuint unit = 0; unit < TEXTURE_UNITS; unit++) {
+		if (samplers[unit] == sampler)
+			samplers[unit] = 0;
+	}
+}
+
+void StateCache::forgetBuffer(GLuint buffer)
+{
+	GLuint* bindings[] = { &arrayBuffer, &copyWriteBuffer, &pixelUnpackBuffer };
+
+	for (GLuint* bound : bindings) {
+		if (*bound == buffer)
+			*bound = 0;
+	}
+}
+
+void StateCache::forgetVertexArray(GLuint vertexArray)
+{
+	if (this->vertexArray == vertexArray)
+		this->vertexArray = 0;
+}
+
+void StateCache::forgetProgramPipeline(GLuint pipeline)
+{
+	if (this->pipeline == pipeline)
+		this->pipeline = 0;
+}
+
+StateCacheStats StateCache::getStats() const
+{
+	return stats;
+}
+
+void StateCache::resetStats()
+{
+	stats = {};
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+
+struct StateCacheStats {
+	size_t binds;   // that went to GL
+	size_t skipped; // already bound
+};
+
+// What's bound in the GL context, so binding the same thing again costs nothing. There's
+// one context, so there's one of these (current()), and like GL it's only for the GL
+// thread.
+//
+// Everything that binds has to go through here, or the cache ends up believing in
+// bindings that aren't there any more: GLResources does for creating and editing
+// objects, the renderer for drawing. Objects that are deleted have to be forgotten too,
+// GL unbinds them and hands their names out again (GLResources does that as well).
+//
+// Without direct state access, GLResources edits textures on EDIT_UNIT and buffers
+// through GL_COPY_WRITE_BUFFER, which nothing draws with, so loading and streaming only
+// ever change bindings the renderer doesn't look at.
+class StateCache {
+    private:
+	static constexpr GLuint TEXTURE_UNITS = 16; // every fragment shader has this many
+
+	GLuint program;
+	GLuint pipeline;
+	GLuint vertexArray;
+	GLuint activeUnit;
+	GLuint textures[TEXTURE_UNITS]; // GL_TEXTURE_2D
+	GLuint samplers[TEXTURE_UNITS];
+	GLuint arrayBuffer;
+	GLuint copyWriteBuffer;
+	GLuint pixelUnpackBuffer;
+	StateCacheStats stats;
+
+	StateCache();
+	GLuint* bufferBinding(GLenum target);
+	void activate(GLuint unit);
+    public:
+	// Never a GL name: what the cache has for bindings it doesn't know.
+	static constexpr GLuint UNKNOWN = 0xFFFFFFFFu;
+	// The last unit, for editing textures without direct state access. Never sampled.
+	static constexpr GLuint EDIT_UNIT = TEXTURE_UNITS - 1;
+
+	static StateCache& current();
+
+	StateCache(const StateCache&) = delete;
+	StateCache& operator=(const StateCache&) = delete;
+
+	void useProgram(GLuint program);
+	// A bound program wins over the bound pipeline, so this also unbinds the program.
+	void bindProgramPipeline(GLuint pipeline);
+	void bindVertexArray(GLuint vertexArray);
+	// Or UNKNOWN.
+	GLuint getVertexArray() const;
+	// A 2D texture for sampling on 'unit'.
+	void bindTexture(GLuint unit, GLuint texture);
+	// 'texture' on EDIT_UNIT, with EDIT_UNIT active, for glTex* calls (GLResources).
+	void bindTextureForEdit(GLuint texture);
+	// How 'unit' samples whatever texture is on it (see SamplerCache). 0 goes back to the
+	// texture's own parameters.
+	void bindSampler(GLuint unit, GLuint sampler);
+	// GL_ARRAY_BUFFER, GL_COPY_WRITE_BUFFER or GL_PIXEL_UNPACK_BUFFER. The element array
+	// buffer belongs to the VAO and isn't cached.
+	void bindBuffer(GLenum target, GLuint buffer);
+
+	// For deleted objects: wherever they were bound, GL has 0 bound now.
+	void forgetTexture(GLuint texture);
+	void forgetSampler(GLuint sampler);
+	void forgetBuffer(GLuint buffer);
+	void forgetVertexArray(GLuint vertexArray);
+	void forgetProgramPipeline(GLuint pipeline);
+
+	// After something bound behind the cache's back: everything is bound again next time.
+	void invalidate();
+
+	StateCacheStats getStats() const;
+	void resetStats();
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// A C++20 coroutine returning a T. Tasks are lazy: nothing runs until the task is
+// co_awaited, and then it runs on the awaiting thread until its own first co_await.
+// When it finishes, the awaiting coroutine resumes straight away on whatever thread
+// the task finished on (symmetric transfer, so long chains don't grow the stack).
+//
+// Which thread code runs on is decided by what is awaited: AssetLoader::onWorker,
+// AssetLoader::onGLThread, or a read that completes on the job system.
+//
+//   Task<bool> loadThing(AssetLoader& loader)
+//   {
+//       LoadedFile file = co_await loader.readFile("Cooked/thing");  // no thread blocked
+//       co_await loader.onWorker();                                  // decode here
+//       co_await loader.onGLThread();                                // upload here
+//       co_return true;
+//   }
+//
+// Nothing here throws (the repo doesn't use exceptions), so an exception escaping a
+// task ends the program.
+template <typename T>
+class Task;
+
+namespace TaskDetail {
+	// Resumes whoever awaited the task, or nothing for a detached one.
+	struct FinalAwaiter {
+		bool await_ready() const noexcept { return false; }
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	struct PromiseBase {
+		std::coroutine_handle<> continuation;
+
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void unhandled_exception() const noexcept { std::terminate(); }
+	};
+}
+
+template <typename T>
+class Task {
+    public:
+	struct promise_type : TaskDetail::PromiseBase {
+		std::optional<T> value;
+
+		Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		void return_value(T result) { value.emplace(std::move(result)); }
+	};
+    private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    public:
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task()
+	{
+		if (handle)
+			handle.destroy();
+	}
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter {
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() const noexcept { return false; }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept
+			{
+				handle.promise().continuation = awaiting;
+				return handle;
+			}
+
+			T await_resume() { return std::move(*handle.promise().value); }
+		};
+
+		return Awaiter{ handle };
+	}
+};
+
+template <>
+class Task<void> {
+    public:
+	struct promise_type : TaskDetail::PromiseBase {
+		Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		void return_void() const noexcept {}
+	};
+    private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    public:
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task()
+	{
+		if (handle)
+			handle.destroy();
+	}
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter {
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() const noexcept { return false; }
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept
+			{
+				handle.promise().continuation = awaiting;
+				return handle;
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		return Awaiter{ handle };
+	}
+};
+
+namespace TaskDetail {
+	// The coroutine behind spawn: starts right away and frees itself when done.
+	struct Detached {
+		struct promise_type {
+			Detached get_return_object() const noexcept { return {}; }
+			std::suspend_never initial_suspend() const noexcept { return {}; }
+			std::suspend_never final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			void unhandled_exception() const noexcept { std::terminate(); }
+		};
+	};
+
+	inline Detached runDetached(Task<void> task)
+	{
+		co_await std::move(task);
+	}
+}
+
+// Starts a task nobody waits for. It runs on this thread until its first co_await and
+// cleans up after itself, so whatever it uses has to outlive it (signal the end
+// through something it was given).
+inline void spawn(Task<void> task)
+{
+	TaskDetail::runDetached(std::move(task));
+}
@@ -0,0 +1,622 @@
+#include "TextureStreamer.hpp"
+#include "AsyncIO.hpp"
+#include "GLResources.hpp"
+#include "JobSystem.hpp"
+#include "PixelOps.hpp"
+#include "VirtualFileSystem.hpp"
+#include "stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+static int levelCountFor(int width, int height)
+{
+	return MipGenerator::levelCount(width, height);
+}
+
+static int tailLevelFor(int width, int height, int levelCount)
+{
+	for (int level = 0; level < levelCount; level++) {
+		if (std::max(std::max(width >> level, 1), std::max(height >> level, 1)) <= TextureStreamer::RESIDENT_TAIL_SIZE)
+			return level;
+	}
+
+	return levelCount - 1;
+}
+
+TextureStreamer::TextureStreamer(JobSystem& jobs, const VirtualFileSystem& files, AsyncIO* io, size_t budgetBytes, const MipSettings& mipSettings, const std::string& cacheDirectory, size_t uploadBytesPerFrame)
+	: jobs(jobs), files(files), io(io), mipGenerator(jobs, mipSettings), cacheDirectory(cacheDirectory), budgetBytes(budgetBytes),
+	uploadBytesPerFrame(uploadBytesPerFrame), residentBytes(0), frame(0), jobsInFlight(0)
+{
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Jobs and reads write into 'completed', so they have to be finished before we go away.
+	if (io != nullptr)
+		io->submit();
+
+	std::unique_lock<std::mutex> lock(inFlightMutex);
+	inFlightDone.wait(lock, [this] { return jobsInFlight.load() == 0; });
+
+	for (LevelData& data : completed) {
+		if (data.pixelBuffer != 0) {
+			GLResources::unmapBuffer(data.pixelBuffer);
+			GLResources::deleteBuffers(1, &data.pixelBuffer);
+		}
+	}
+
+	for (auto& file : ioFiles) {
+		io->closeFile(file.second.id);
+	}
+
+	for (int file : staleIOFiles) {
+		io->closeFile(file);
+	}
+
+	for (StreamedTexture& texture : textures) {
+		GLResources::deleteTextures(1, &texture.id);
+	}
+}
+
+unsigned int TextureStreamer::load(const std::string& path, bool flipVertically)
+{
+	StreamedTexture texture = {};
+	texture.path = path;
+	texture.flipVertically = flipVertically;
+	texture.requestedLevel = -1;
+	texture.ready = false;
+	texture.ioFile = io != nullptr && isCooked(path) ? -2 : -1;
+
+	// Filtering and wrapping come from the sampler it's drawn with (see SamplerCache).
+	texture.id = GLResources::createTexture();
+
+	unsigned int handle = (unsigned int)textures.size();
+	textures.push_back(texture);
+
+	// -1 asks the job for the whole resident tail, whatever size the image turns out to be.
+	jobsInFlight++;
+	jobs.submit([this, handle, path, flipVertically]() { decodeJob(handle, path, flipVertically, -1, -1); });
+
+	return handle;
+}
+
+bool TextureStreamer::isCooked(const std::string& path)
+{
+	return path.size() >= 5 && path.compare(path.size() - 5, 5, ".mips") == 0;
+}
+
+std::string TextureStreamer::cachePathFor(const std::string& path, bool flipVertically) const
+{
+	// FNV-1a over everything that changes the generated chain.
+	std::error_code error;
+	std::string key = path + (flipVertically ? "|flip|" : "|noflip|") + mipGenerator.settingsKey();
+	key += "|" + std::to_string(std::filesystem::file_size(path, error));
+	key += "|" + std::to_string(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+
+	unsigned long long hash = 14695981039346656037ull;
+	for (unsigned char c : key) {
+		hash = (hash ^ c) * 1099511628211ull;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.mips", hash);
+	return (std::filesystem::path(cacheDirectory) / name).string();
+}
+
+void TextureStreamer::decodeJob(unsigned int texture, std::string path, bool flipVertically, int firstLevel, int lastLevel)
+{
+	// A cooked chain (AssetCooker) already is what the cache would hold.
+	bool cooked = isCooked(path);
+	bool tail = firstLevel < 0;
+	std::string cachePath = cooked ? path : cachePathFor(path, flipVertically);
+	std::vector<MipLevel> mips;
+	int width = 0, height = 0;
+
+	// Cached chain: read just the levels we want, no decoding at all. An empty range
+	// only reads the sizes, which is what the tail needs first. Cooked chains come through
+	// the file system (usually mapped out of the pack), the streamer's own cache from disk.
+	FileData cookedFile;
+	bool cached = cooked ? files.read(path, cookedFile) && MipGenerator::readCache(cookedFile.data(), cookedFile.size(), 1, 0, mips, width, height)
+		: MipGenerator::readCache(cachePath, 1, 0, mips, width, height);
+
+	if (cached) {
+		if (firstLevel < 0) {
+			firstLevel = tailLevelFor(width, height, levelCountFor(width, height));
+			lastLevel = levelCountFor(width, height) - 1;
+		}
+
+		cached = cooked ? MipGenerator::readCache(cookedFile.data(), cookedFile.size(), firstLevel, lastLevel, mips, width, height)
+			: MipGenerator::readCache(cachePath, firstLevel, lastLevel, mips, width, height);
+	}
+
+	if (!cached && cooked) {
+		std::cout << "ERROR::TEXTURE_STREAMER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		failJob(texture, tail);
+		return;
+	}
+
+	if (!cached) {
+		// A read that failed partway may have left some levels behind.
+		mips.clear();
+
+		int channels;
+		FileData source;
+		unsigned char* data = files.read(path, source) && source.size() <= INT32_MAX
+			? stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 0) : nullptr;
+
+		if (data == nullptr) {
+			std::cout << "ERROR::TEXTURE_STREAMER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			failJob(texture, tail);
+			return;
+		}
+
+		// Everything goes to the GPU as RGBA8, whatever the file had, so the driver never
+		// has to convert (or drop the alpha channel) on upload.
+		std::vector<unsigned char> rgba((size_t)width * height * 4);
+		PixelOps::expandToRGBA(data, channels, rgba.data(), (size_t)width * height);
+		stbi_image_free(data);
+
+		if (flipVertically)
+			PixelOps::flipVertically(rgba.data(), width, height, 4);
+
+		if (firstLevel < 0) {
+			firstLevel = tailLevelFor(width, height, levelCountFor(width, height));
+			lastLevel = levelCountFor(width, height) - 1;
+		}
+
+		// Build the whole chain once and keep it on disk; from now on finer levels
+		// come straight out of the cache file.
+		std::vector<MipLevel> chain = mipGenerator.generate(rgba.data(), width, height);
+		if (!MipGenerator::writeCache(cachePath, chain))
+			std::cout << "ERROR::TEXTURE_STREAMER::CACHE_NOT_SUCCESFULLY_WRITTEN " << cachePath << std::endl;
+
+		for (int level = firstLevel; level <= lastLevel; level++) {
+			mips.push_back(std::move(chain[level]));
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(completedMutex);
+
+		// Coarsest first, so each upload extends a complete chain.
+		for (int i = (int)mips.size() - 1; i >= 0; i--) {
+			completed.push_back({ texture, firstLevel + i, mips[i].width, mips[i].height, width, height, std::move(mips[i].pixels), 0, false });
+		}
+	}
+
+	finishJob();
+}
+
+void TextureStreamer::failJob(unsigned int texture, bool tail)
+{
+	// Goes through upload like any level, which is where 'textures' can be touched. A
+	// finer level that failed just stays requested, so it isn't retried every frame.
+	if (tail) {
+		std::lock_guard<std::mutex> lock(completedMutex);
+		completed.push_back({ texture, -1, 0, 0, 0, 0, {}, 0, true });
+	}
+
+	finishJob();
+}
+
+void TextureStreamer::finishJob()
+{
+	std::lock_guard<std::mutex> lock(inFlightMutex);
+
+	if (--jobsInFlight == 0)
+		inFlightDone.notify_all();
+}
+
+size_t TextureStreamer::levelBytes(const StreamedTexture& texture, int level) const
+{
+	return (size_t)std::max(texture.width >> level, 1) * std::max(texture.height >> level, 1) * 4;
+}
+
+void TextureStreamer::applyLevelClamp(const StreamedTexture& texture) const
+{
+	GLResources::textureParameter(texture.id, GL_TEXTURE_BASE_LEVEL, texture.residentLevel);
+	GLResources::textureParameter(texture.id, GL_TEXTURE_MAX_LEVEL, texture.levelCount - 1);
+}
+
+bool TextureStreamer::locateLevels(StreamedTexture& texture)
+{
+	texture.ioFile = -1;
+
+	// Compressed pack entries can't be read a level at a time.
+	std::string filePath;
+	uint64_t offset, size;
+	if (!files.locate(texture.path, filePath, offset, size))
+		return false;
+
+	// The table at the start was just read by the tail's job, so it's in memory anyway.
+	FileData file;
+	if (!files.read(texture.path, file) || !MipGenerator::readCacheOffsets(file.data(), file.size(), texture.levelOffsets)
+		|| (int)texture.levelOffsets.size() != texture.levelCount)
+		return false;
+
+	// The offsets just read are the ones of the file as it is now. If it's been replaced
+	// since it was opened the open one is the old file, so the new one gets opened too.
+	std::error_code error;
+	std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(filePath, error);
+	uintmax_t fileSize = std::filesystem::file_size(filePath, error);
+	if (error)
+		return false;
+
+	auto it = ioFiles.find(filePath);
+	if (it != ioFiles.end() && (it->second.writeTime != writeTime || it->second.size != fileSize)) {
+		staleIOFiles.push_back(it->second.id);
+		ioFiles.erase(it);
+		it = ioFiles.end();
+	}
+
+	if (it == ioFiles.end()) {
+		int id = io->openFile(filePath);
+		if (id < 0)
+			return false;
+
+		it = ioFiles.emplace(filePath, IOFile{ id, writeTime, fileSize }).first;
+	}
+
+	texture.ioFile = it->second.id;
+	texture.ioOffset = offset;
+	return true;
+}
+
+void TextureStreamer::closeStaleFiles()
+{
+	// The old version of a reloaded texture goes on reading its file until it's unloaded,
+	// and a level it asked for before that may still be on its way.
+	for (size_t i = 0; i < staleIOFiles.size();) {
+		bool used = false;
+		for (const StreamedTexture& texture : textures) {
+			used = used || (texture.ioFile == staleIOFiles[i] && (texture.id != 0 || texture.requestedLevel != -1));
+		}
+
+		if (used) {
+			i++;
+			continue;
+		}
+
+		io->closeFile(staleIOFiles[i]);
+		staleIOFiles[i] = staleIOFiles.back();
+		staleIOFiles.pop_back();
+	}
+}
+
+bool TextureStreamer::requestWithIO(unsigned int handle, int level)
+{
+	StreamedTexture& texture = textures[handle];
+	size_t size = levelBytes(texture, level);
+
+	// GL 3.3 can't keep a buffer mapped while it's used (that's ARB_buffer_storage), so
+	// every level gets its own buffer, mapped until the read is done and the level is
+	// uploaded. INVALIDATE lets the driver hand out fresh memory without waiting.
+	GLuint pixelBuffer = GLResources::createBuffer();
+	GLResources::bufferData(pixelBuffer, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+	void* destination = GLResources::mapBufferRange(pixelBuffer, 0, (GLsizeiptr)size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	if (destination == nullptr) {
+		GLResources::deleteBuffers(1, &pixelBuffer);
+		return false;
+	}
+
+	LevelData data = { handle, level, std::max(texture.width >> level, 1), std::max(texture.height >> level, 1),
+		texture.width, texture.height, {}, pixelBuffer, false };
+
+	// Runs on an I/O thread, which mustn't touch 'textures' (load can grow it).
+	std::string path = texture.path;
+	jobsInFlight++;
+	io->read(texture.ioFile, texture.ioOffset + texture.levelOffsets[level], destination, size, [this, data, path](bool ok) mutable {
+		if (!ok)
+			std::cout << "ERROR::TEXTURE_STREAMER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+
+		data.failed = !ok;
+		{
+			std::lock_guard<std::mutex> lock(completedMutex);
+			completed.push_back(std::move(data));
+		}
+
+		finishJob();
+	});
+
+	return true;
+}
+
+void TextureStreamer::upload(LevelData& data)
+{
+	StreamedTexture& texture = textures[data.texture];
+
+	// Unloaded while this level was on its way.
+	if (texture.id == 0)
+		data.failed = true;
+
+	// Read into a pixel buffer: it has to be unmapped before GL can use it, and goes away
+	// once the level is (or isn't) uploaded.
+	GLuint pixelBuffer = data.pixelBuffer;
+	if (pixelBuffer != 0 && !GLResources::unmapBuffer(pixelBuffer))
+		data.failed = true;
+
+	if (data.failed) {
+		if (texture.requestedLevel == data.level)
+			texture.requestedLevel = -1;
+
+		// Without its small mips the texture is never going to be usable.
+		if (!texture.ready && texture.id != 0)
+			texture.failed = true;
+
+		GLResources::deleteBuffers(1, &pixelBuffer);
+		return;
+	}
+
+	if (!texture.ready) {
+		texture.width = data.baseWidth;
+		texture.height = data.baseHeight;
+		texture.levelCount = levelCountFor(texture.width, texture.height);
+		texture.residentLevel = texture.levelCount;
+		texture.wantedLevel = texture.levelCount - 1;
+		texture.ready = true;
+	}
+
+	// A level only makes sense right above what's resident. Anything else raced with
+	// an eviction and would leave a hole in the chain.
+	if (data.level != texture.residentLevel - 1) {
+		if (texture.requestedLevel == data.level)
+			texture.requestedLevel = -1;
+
+		if (pixelBuffer != 0)
+			GLResources::deleteBuffers(1, &pixelBuffer);
+
+		return;
+	}
+
+	if (pixelBuffer != 0) {
+		// From the start of the buffer.
+		GLResources::textureImage(texture.id, data.level, data.width, data.height, nullptr, pixelBuffer);
+		GLResources::deleteBuffers(1, &pixelBuffer);
+	}
+	else {
+		GLResources::textureImage(texture.id, data.level, data.width, data.height, data.pixels.data());
+	}
+
+	texture.residentLevel = data.level;
+	residentBytes += levelBytes(texture, data.level);
+
+	if (texture.requestedLevel == data.level)
+		texture.requestedLevel = -1;
+
+	applyLevelClamp(texture);
+
+	// The new level is sharper than what was on screen a frame ago. MIN_LOD is relative
+	// to the base level, so starting at 1 and walking down hides the pop.
+	texture.fade = 1.0f;
+}
+
+void TextureStreamer::evict(StreamedTexture& texture)
+{
+	int level = texture.residentLevel;
+	residentBytes -= levelBytes(texture, level);
+	texture.residentLevel++;
+
+	applyLevelClamp(texture);
+	texture.fade = 0.0f;
+
+	// Levels below the base level don't count for completeness, so shrinking the
+	// evicted one to 1x1 gives its memory back without breaking the texture.
+	unsigned char texel[4] = { 0, 0, 0, 0 };
+	GLResources::textureImage(texture.id, level, 1, 1, texel);
+}
+
+GLuint TextureStreamer::getTexture(unsigned int handle) const
+{
+	return textures[handle].id;
+}
+
+float TextureStreamer::getMinLod(unsigned int handle) const
+{
+	return textures[handle].fade;
+}
+
+GLuint TextureStreamer::unload(unsigned int handle)
+{
+	StreamedTexture& texture = textures[handle];
+	GLuint id = texture.id;
+
+	residentBytes -= getResidentBytes(handle);
+
+	// Not ready means nothing is requested or evicted for it any more.
+	texture.id = 0;
+	texture.ready = false;
+	texture.path.clear();
+	texture.levelOffsets.clear();
+	texture.levelOffsets.shrink_to_fit();
+	return id;
+}
+
+void TextureStreamer::requestScreenSize(unsigned int handle, float screenPixels)
+{
+	StreamedTexture& texture = textures[handle];
+
+	if (!texture.ready)
+		return;
+
+	int level = 0;
+	if (screenPixels > 0.0f) {
+		// One texel per pixel: every halving of the screen size is one mip further away.
+		level = (int)std::floor(std::log2(std::max(texture.width, texture.height) / screenPixels));
+	}
+	else {
+		level = texture.levelCount - 1;
+	}
+
+	level = std::max(0, std::min(level, texture.levelCount - 1));
+	texture.wantedLevel = std::min(texture.wantedLevel, level);
+	texture.lastUsedFrame = frame;
+}
+
+void TextureStreamer::update()
+{
+	// 1. Upload what the workers finished, up to the per frame budget.
+	std::vector<LevelData> pending;
+	{
+		std::lock_guard<std::mutex> lock(completedMutex);
+		pending.swap(completed);
+	}
+
+	size_t uploaded = 0;
+	size_t processed = 0;
+
+	for (; processed < pending.size(); processed++) {
+		LevelData& data = pending[processed];
+		StreamedTexture& texture = textures[data.texture];
+
+		// Tail levels are tiny and the texture is unusable without them, so they ignore the budget.
+		bool isTail = !texture.ready || std::max(data.width, data.height) <= RESIDENT_TAIL_SIZE;
+		if (!isTail && uploaded >= uploadBytesPerFrame)
+			break;
+
+		uploaded += (size_t)data.width * data.height * 4;
+		upload(data);
+	}
+
+	if (processed < pending.size()) {
+		std::lock_guard<std::mutex> lock(completedMutex);
+		completed.insert(completed.begin(), std::make_move_iterator(pending.begin() + processed), std::make_move_iterator(pending.end()));
+	}
+
+	// Walk the fade-in of recently uploaded levels back down to zero.
+	for (StreamedTexture& texture : textures) {
+		if (!texture.ready || texture.fade <= 0.0f)
+			continue;
+
+		texture.fade = std::max(texture.fade - 0.25f, 0.0f);
+	}
+
+	// 2. Drop levels that nobody needs any more, but only while over the budget.
+	while (residentBytes > budgetBytes) {
+		StreamedTexture* victim = nullptr;
+
+		for (StreamedTexture& texture : textures) {
+			int tail = texture.ready ? tailLevelFor(texture.width, texture.height, texture.levelCount) : 0;
+			if (!texture.ready || texture.residentLevel >= tail || texture.residentLevel >= texture.wantedLevel)
+				continue;
+
+			if (victim == nullptr || texture.wantedLevel - texture.residentLevel > victim->wantedLevel - victim->residentLevel)
+				victim = &texture;
+		}
+
+		if (victim == nullptr)
+			break;
+
+		evict(*victim);
+	}
+
+	// 3. Ask for the next finer level of anything that needs it and still fits.
+	for (unsigned int i = 0; i < textures.size(); i++) {
+		StreamedTexture& texture = textures[i];
+
+		if (!texture.ready || texture.requestedLevel != -1 || texture.wantedLevel >= texture.residentLevel)
+			continue;
+
+		int level = texture.residentLevel - 1;
+		if (residentBytes + levelBytes(texture, level) > budgetBytes)
+			continue;
+
+		texture.requestedLevel = level;
+
+		if (texture.ioFile == -2)
+			locateLevels(texture);
+
+		if (texture.ioFile >= 0 && requestWithIO(i, level))
+			continue;
+
+		jobsInFlight++;
+		std::string path = texture.path;
+		bool flip = texture.flipVertically;
+		jobs.submit([this, i, path, flip, level]() { decodeJob(i, path, flip, level, level); });
+	}
+
+	// Everything asked for this frame goes to the disk in one batch.
+	if (io != nullptr)
+		io->submit();
+
+	if (!staleIOFiles.empty())
+		closeStaleFiles();
+
+	// 4. Still over? Then the budget is smaller than what's on screen, and the least
+	// recently used textures have to give up detail they'd like to keep.
+	while (residentBytes > budgetBytes) {
+		StreamedTexture* victim = nullptr;
+
+		for (StreamedTexture& texture : textures) {
+			int tail = texture.ready ? tailLevelFor(texture.width, texture.height, texture.levelCount) : 0;
+			if (!texture.ready || texture.residentLevel >= tail)
+				continue;
+
+			if (victim == nullptr || texture.lastUsedFrame < victim->lastUsedFrame)
+				victim = &texture;
+		}
+
+		if (victim == nullptr)
+			break;
+
+		evict(*victim);
+	}
+
+	// Next frame's requests start from scratch.
+	for (StreamedTexture& texture : textures) {
+		if (texture.ready)
+			texture.wantedLevel = texture.levelCount - 1;
+	}
+
+	frame++;
+}
+
+size_t TextureStreamer::getResidentBytes() const
+{
+	return residentBytes;
+}
+
+size_t TextureStreamer::getResidentBytes(unsigned int handle) const
+{
+	const StreamedTexture& texture = textures[handle];
+	size_t bytes = 0;
+
+	for (int level = texture.ready ? texture.residentLevel : texture.levelCount; level < texture.levelCount; level++) {
+		bytes += levelBytes(texture, level);
+	}
+
+	return bytes;
+}
+
+bool TextureStreamer::isReady(unsigned int handle) const
+{
+	return textures[handle].ready;
+}
+
+bool TextureStreamer::hasFailed(unsigned int handle) const
+{
+	return textures[handle].failed;
+}
+
+int TextureStreamer::getResidentLevel(unsigned int handle) const
+{
+	return textures[handle].residentLevel;
+}
+
+float TextureStreamer::projectedDiameter(const glm::vec3& center, float radius, const glm::mat4& view, float fovRadians, int viewportHeight)
+{
+	glm::vec4 viewPosition = view * glm::vec4(center, 1.0f);
+	float depth = -viewPosition.z;
+
+	// Camera inside (or behind) the bounds: just ask for full detail.
+	if (depth <= radius)
+		return (float)viewportHeight * 4.0f;
+
+	return radius / (depth * std::tan(fovRadians * 0.5f)) * (float)viewportHeight;
+}
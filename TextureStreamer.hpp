@@ -0,0 +1,157 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include "MipGenerator.hpp"
+
+class AsyncIO;
+class JobSystem;
+class VirtualFileSystem;
+
+// Streams mip levels of 2D textures in and out of GPU memory.
+//
+// A texture starts with only its small mips resident (everything at or below
+// RESIDENT_TAIL_SIZE). Every frame the renderer tells the streamer how big the objects
+// using a texture are on screen, and the streamer works out which mip is actually
+// needed. The first load builds the whole chain with the MipGenerator and keeps it in
+// a cache file; finer levels are read back from it on the job system (or by AsyncIO)
+// and uploaded on the GL thread a few per frame; when the total goes over the budget the least needed levels are
+// dropped again. GL_TEXTURE_BASE_LEVEL/GL_TEXTURE_MAX_LEVEL keep sampling away from
+// the levels that are not resident, and getMinLod fades new ones in.
+class TextureStreamer {
+    private:
+	struct LevelData {
+		unsigned int texture;
+		int level;
+		int width;
+		int height;
+		int baseWidth;
+		int baseHeight;
+		std::vector<unsigned char> pixels;
+		GLuint pixelBuffer; // read straight into this mapped PBO instead of 'pixels', or 0
+		bool failed;
+	};
+
+	struct StreamedTexture {
+		std::string path;
+		GLuint id;
+		int width;
+		int height;
+		int levelCount;
+		int residentLevel;  // finest level currently in GPU memory (the base level)
+		int requestedLevel; // finest level that is being decoded right now, or -1
+		int wantedLevel;    // finest level needed by this frame's objects
+		float fade;         // minimum LOD while a new level blends in (see getMinLod)
+		unsigned long long lastUsedFrame;
+		bool flipVertically;
+		bool ready;
+		bool failed;        // the small mips couldn't be loaded, it never will be ready
+		// Cooked chains read through AsyncIO: the file, where the chain starts in it (a
+		// pack entry or a loose file) and where each level starts in the chain. ioFile is
+		// -2 until it's been looked up and -1 when the levels go through the jobs.
+		int ioFile;
+		uint64_t ioOffset;
+		std::vector<uint64_t> levelOffsets;
+	};
+
+	JobSystem& jobs;
+	const VirtualFileSystem& files;
+	AsyncIO* io;
+	// A file opened for AsyncIO, as it was when it was opened. Hot reload renames a new
+	// file over the old one, and an open file keeps reading the old one.
+	struct IOFile {
+		int id;
+		std::filesystem::file_time_type writeTime;
+		uintmax_t size;
+	};
+
+	std::unordered_map<std::string, IOFile> ioFiles; // by path, packs are shared
+	// Replaced by a newer version of the same path, closed once nothing reads them.
+	std::vector<int> staleIOFiles;
+	MipGenerator mipGenerator;
+	std::string cacheDirectory;
+	size_t budgetBytes;
+	size_t uploadBytesPerFrame;
+	size_t residentBytes;
+	unsigned long long frame;
+
+	std::vector<StreamedTexture> textures;
+
+	// Finished decodes waiting to be uploaded on the GL thread.
+	std::mutex completedMutex;
+	std::vector<LevelData> completed;
+
+	std::atomic<int> jobsInFlight;
+	std::mutex inFlightMutex;
+	std::condition_variable inFlightDone;
+
+	void decodeJob(unsigned int texture, std::string path, bool flipVertically, int firstLevel, int lastLevel);
+	void finishJob();
+	// For a job that couldn't read or decode its levels: a texture whose small mips
+	// failed is marked as failed (see hasFailed).
+	void failJob(unsigned int texture, bool tail);
+	std::string cachePathFor(const std::string& path, bool flipVertically) const;
+	static bool isCooked(const std::string& path);
+	bool locateLevels(StreamedTexture& texture);
+	void closeStaleFiles();
+	bool requestWithIO(unsigned int handle, int level);
+	void upload(LevelData& data);
+	void evict(StreamedTexture& texture);
+	void applyLevelClamp(const StreamedTexture& texture) const;
+	size_t levelBytes(const StreamedTexture& texture, int level) const;
+    public:
+	// Levels whose biggest side is at or below this are loaded up front and never evicted.
+	static constexpr int RESIDENT_TAIL_SIZE = 64;
+
+	// With 'io', finer levels of cooked textures are read by AsyncIO straight into mapped
+	// pixel buffer objects, which are the driver's own staging memory, and the texture is
+	// filled from them. Without it (or for chains it can't locate) they're read by jobs.
+	TextureStreamer(JobSystem& jobs, const VirtualFileSystem& files, AsyncIO* io, size_t budgetBytes, const MipSettings& mipSettings = MipSettings(),
+		const std::string& cacheDirectory = "Cache", size_t uploadBytesPerFrame = 4 * 1024 * 1024);
+	~TextureStreamer();
+
+	// Starts loading a texture and returns its handle. The GL texture exists right
+	// away but has no data until the low mips arrive (usually a frame or two).
+	// Textures are always stored as RGBA8. A cooked ".mips" file is read as it is (it is
+	// already flipped); anything else is decoded once and its chain cached. Both come
+	// through the file system, so they can be in a pack.
+	unsigned int load(const std::string& path, bool flipVertically = true);
+
+	GLuint getTexture(unsigned int handle) const;
+	// What the sampler it's drawn with needs as GL_TEXTURE_MIN_LOD while a new level
+	// blends in, 0 otherwise. Sampler objects override the texture's own (see
+	// SamplerDesc::minLod), so the streamer can't set it on the texture.
+	float getMinLod(unsigned int handle) const;
+
+	// Stops streaming the texture and hands its GL texture over to the caller, who
+	// deletes it once the GPU is done with it (see AssetManager). Levels still on their
+	// way for it are dropped when they arrive. The handle isn't reused, since jobs in
+	// flight still know the texture by it.
+	GLuint unload(unsigned int handle);
+
+	// Tells the streamer that an object using this texture covers 'screenPixels'
+	// pixels (diameter) on screen this frame.
+	void requestScreenSize(unsigned int handle, float screenPixels);
+
+	// Uploads finished levels, asks for finer ones and evicts over the budget.
+	// Must be called on the GL thread once per frame.
+	void update();
+
+	size_t getResidentBytes() const;
+	size_t getResidentBytes(unsigned int handle) const;
+	// Whether the small mips are in (the texture can be used), or never will be.
+	bool isReady(unsigned int handle) const;
+	bool hasFailed(unsigned int handle) const;
+	int getResidentLevel(unsigned int handle) const;
+
+	// Approximate on screen diameter, in pixels, of a sphere seen through a perspective camera.
+	static float projectedDiameter(const glm::vec3& center, float radius, const glm::mat4& view, float fovRadians, int viewportHeight);
+};
@@ -0,0 +1,281 @@
+#include "VertexArrayCache.hpp"
+#include "AssetCooker.hpp"
+#include "GLExtensions.hpp"
+#include "GLResources.hpp"
+#include "StateCache.hpp"
+#include <iostream>
+
+VertexArrayDesc::VertexArrayDesc()
+	: attributes(), bindings(), attributeCount(0), bindingCount(0)
+{
+}
+
+VertexArrayDesc VertexArrayDesc::fromLayout(const VertexLayout& layout)
+{
+	VertexArrayDesc desc;
+	uint32_t binding = desc.addBinding(layout.stride);
+
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		if (layout.formats[s] != VertexFormat::None)
+			desc.addAttribute(s, binding, layout.formats[s], layout.offsets[s]);
+	}
+
+	return desc;
+}
+
+uint32_t VertexArrayDesc::addBinding(uint32_t stride, uint32_t divisor)
+{
+	if (bindingCount == MAX_BINDINGS) {
+		std::cout << "ERROR::VERTEX_ARRAY::TOO_MANY_BINDINGS" << std::endl;
+		return MAX_BINDINGS - 1;
+	}
+
+	bindings[bindingCount] = { stride, divisor };
+	return bindingCount++;
+}
+
+void VertexArrayDesc::addAttribute(uint32_t location, uint32_t binding, VertexFormat format, uint32_t offset)
+{
+	if (attributeCount == MAX_ATTRIBUTES) {
+		std::cout << "ERROR::VERTEX_ARRAY::TOO_MANY_ATTRIBUTES" << std::endl;
+		return;
+	}
+
+	attributes[attributeCount++] = { location, binding, format, offset };
+}
+
+uint64_t VertexArrayDesc::hash() const
+{
+	// Only what's in use, field by field, so leftovers and padding don't count.
+	uint32_t counts[2] = { attributeCount, bindingCount };
+	uint64_t hash = AssetCooker::hashBytes(counts, sizeof(counts));
+
+	for (uint32_t i = 0; i < attributeCount; i++) {
+		const VertexAttributeDesc& attribute = attributes[i];
+		uint32_t words[4] = { attribute.location, attribute.binding, (uint32_t)attribute.format, attribute.offset };
+		hash = AssetCooker::hashBytes(words, sizeof(words), hash);
+	}
+
+	for (uint32_t i = 0; i < bindingCount; i++) {
+		uint32_t words[2] = { bindings[i].stride, bindings[i].divisor };
+		hash = AssetCooker::hashBytes(words, sizeof(words), hash);
+	}
+
+	return hash;
+}
+
+bool VertexArrayDesc::operator==(const VertexArrayDesc& other) const
+{
+	if (attributeCount != other.attributeCount || bindingCount != other.bindingCount)
+		return false;
+
+	for (uint32_t i = 0; i < attributeCount; i++) {
+		const VertexAttributeDesc& a = attributes[i];
+		const VertexAttributeDesc& b = other.attributes[i];
+		if (a.location != b.location || a.binding != b.binding || a.format != b.format || a.offset != b.offset)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < bindingCount; i++) {
+		if (bindings[i].stride != other.bindings[i].stride || bindings[i].divisor != other.bindings[i].divisor)
+			return false;
+	}
+
+	return true;
+}
+
+VertexArrayCache::VertexArrayCache()
+	: stats()
+{
+}
+
+VertexArrayCache& VertexArrayCache::current()
+{
+	static VertexArrayCache cache;
+	return cache;
+}
+
+uint64_t VertexArrayCache::keyOf(const VertexArrayDesc& desc, const VertexStream* streams, GLuint indexBuffer) const
+{
+	uint64_t key = desc.hash();
+	if (GLExtensions::vertexAttribBinding)
+		return key;
+
+	// Without separate bindings the buffers are baked into the attributes.
+	for (uint32_t i = 0; i < desc.bindingCount; i++) {
+		key = AssetCooker::hashBytes(&streams[i].buffer, sizeof(GLuint), key);
+	}
+
+	return AssetCooker::hashBytes(&indexBuffer, sizeof(GLuint), key);
+}
+
+void VertexArrayCache::pointAttributes(const VertexArray& vertexArray, uint32_t binding) const
+{
+	const VertexArrayDesc& desc = vertexArray.desc;
+	const VertexStream& stream = vertexArray.streams[binding];
+
+	for (uint32_t i = 0; i < desc.attributeCount; i++) {
+		const VertexAttributeDesc& attribute = desc.attributes[i];
+		if (attribute.binding != binding)
+			continue;
+
+		VertexAttributeFormat format = vertexAttributeFormat(attribute.format);
+		GLResources::vertexArrayAttribute(vertexArray.vertexArray, attribute.location, stream.buffer, stream.offset + attribute.offset,
+			desc.bindings[binding].stride, format.components, format.type, format.normalized, desc.bindings[binding].divisor);
+	}
+}
+
+VertexArrayCache::VertexArray VertexArrayCache::create(const VertexArrayDesc& desc, const VertexStream* streams, GLuint indexBuffer)
+{
+	VertexArray vertexArray = {};
+	vertexArray.vertexArray = GLResources::createVertexArray();
+	vertexArray.desc = desc;
+	vertexArray.indexBuffer = indexBuffer;
+
+	// It's about to be bound for drawing anyway, and without DSA binding it first saves
+	// every call below from binding it and putting the old one back.
+	StateCache::current().bindVertexArray(vertexArray.vertexArray);
+	GLResources::vertexArrayElementBuffer(vertexArray.vertexArray, indexBuffer);
+
+	for (uint32_t i = 0; i < desc.bindingCount; i++) {
+		vertexArray.streams[i] = streams[i];
+	}
+
+	stats.created++;
+
+	if (!GLExtensions::vertexAttribBinding) {
+		for (uint32_t i = 0; i < desc.bindingCount; i++) {
+			pointAttributes(vertexArray, i);
+		}
+
+		return vertexArray;
+	}
+
+	// The formats are set once here and never again.
+	for (uint32_t i = 0; i < desc.attributeCount; i++) {
+		const VertexAttributeDesc& attribute = desc.attributes[i];
+		VertexAttributeFormat format = vertexAttributeFormat(attribute.format);
+		GLResources::vertexArrayAttributeFormat(vertexArray.vertexArray, attribute.location, attribute.binding, format.components, format.type,
+			format.normalized, attribute.offset);
+	}
+
+	for (uint32_t i = 0; i < desc.bindingCount; i++) {
+		if (desc.bindings[i].divisor != 0)
+			GLResources::vertexArrayBindingDivisor(vertexArray.vertexArray, i, desc.bindings[i].divisor);
+		GLResources::vertexArrayVertexBuffer(vertexArray.vertexArray, i, streams[i].buffer, streams[i].offset, desc.bindings[i].stride);
+	}
+
+	return vertexArray;
+}
+
+GLuint VertexArrayCache::bind(const VertexArrayDesc& desc, const VertexStream* streams, GLuint indexBuffer)
+{
+	StateCache& state = StateCache::current();
+	GLuint previous = state.getVertexArray();
+
+	uint64_t key = keyOf(desc, streams, indexBuffer);
+	auto found = vertexArrays.find(key);
+	bool changed = false;
+
+	if (found == vertexArrays.end()) {
+		found = vertexArrays.emplace(key, create(desc, streams, indexBuffer)).first;
+		changed = true;
+	}
+
+	VertexArray& vertexArray = found->second;
+
+	if (previous != vertexArray.vertexArray)
+		stats.switches++;
+	state.bindVertexArray(vertexArray.vertexArray);
+
+	for (uint32_t i = 0; i < desc.bindingCount; i++) {
+		VertexStream& bound = vertexArray.streams[i];
+		if (bound.buffer == streams[i].buffer && bound.offset == streams[i].offset)
+			continue;
+
+		bound = streams[i];
+		if (GLExtensions::vertexAttribBinding)
+			GLResources::vertexArrayVertexBuffer(vertexArray.vertexArray, i, bound.buffer, bound.offset, desc.bindings[i].stride);
+		else
+			pointAttributes(vertexArray, i);
+
+		stats.bufferChanges++;
+		changed = true;
+	}
+
+	if (vertexArray.indexBuffer != indexBuffer) {
+		vertexArray.indexBuffer = indexBuffer;
+		GLResources::vertexArrayElementBuffer(vertexArray.vertexArray, indexBuffer);
+		stats.bufferChanges++;
+		changed = true;
+	}
+
+	if (!changed)
+		stats.skipped++;
+
+	return vertexArray.vertexArray;
+}
+
+void VertexArrayCache::forgetBuffer(GLuint buffer)
+{
+	// Deleting a buffer only unbinds it from the VAO that's bound, the others would keep
+	// its memory alive, and a new buffer getting the same name would look already bound.
+	for (auto it = vertexArrays.begin(); it != vertexArrays.end();) {
+		VertexArray& vertexArray = it->second;
+		const VertexArrayDesc& desc = vertexArray.desc;
+
+		bool uses = vertexArray.indexBuffer == buffer;
+		for (uint32_t i = 0; i < desc.bindingCount; i++) {
+			uses = uses || vertexArray.streams[i].buffer == buffer;
+		}
+
+		if (!uses) {
+			++it;
+			continue;
+		}
+
+		if (!GLExtensions::vertexAttribBinding) {
+			GLResources::deleteVertexArrays(1, &vertexArray.vertexArray);
+			it = vertexArrays.erase(it);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < desc.bindingCount; i++) {
+			if (vertexArray.streams[i].buffer == buffer) {
+				vertexArray.streams[i] = { 0, 0 };
+				GLResources::vertexArrayVertexBuffer(vertexArray.vertexArray, i, 0, 0, desc.bindings[i].stride);
+			}
+		}
+
+		if (vertexArray.indexBuffer == buffer) {
+			vertexArray.indexBuffer = 0;
+			GLResources::vertexArrayElementBuffer(vertexArray.vertexArray, 0);
+		}
+
+		++it;
+	}
+}
+
+void VertexArrayCache::clear()
+{
+	for (auto& vertexArray : vertexArrays) {
+		GLResources::deleteVertexArrays(1, &vertexArray.second.vertexArray);
+	}
+
+	vertexArrays.clear();
+}
+
+size_t VertexArrayCache::size() const
+{
+	return vertexArrays.size();
+}
+
+VertexArrayCacheStats VertexArrayCache::getStats() const
+{
+	return stats;
+}
+
+void VertexArrayCache::resetStats()
+{
+	stats = {};
+}
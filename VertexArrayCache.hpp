@@ -0,0 +1,114 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "VertexFormat.hpp"
+
+// One attribute of a VertexArrayDesc: shader location 'location' reads 'format' at
+// 'offset' into each element of binding 'binding'.
+struct VertexAttributeDesc {
+	uint32_t location;
+	uint32_t binding;
+	VertexFormat format;
+	uint32_t offset;
+};
+
+// A stream of elements the attributes read: 'stride' bytes apart, one per vertex, or one
+// per 'divisor' instances.
+struct VertexBindingDesc {
+	uint32_t stride;
+	uint32_t divisor;
+};
+
+// Everything a VAO holds except the buffers themselves. Two meshes with equal
+// descriptions can be drawn through the same VAO.
+struct VertexArrayDesc {
+	static constexpr uint32_t MAX_ATTRIBUTES = 16; // what every GL 3.3 driver has
+	static constexpr uint32_t MAX_BINDINGS = 4;
+
+	VertexAttributeDesc attributes[MAX_ATTRIBUTES];
+	VertexBindingDesc bindings[MAX_BINDINGS];
+	uint32_t attributeCount;
+	uint32_t bindingCount;
+
+	VertexArrayDesc();
+
+	// A mesh's interleaved vertices on binding 0, each semantic at its own location (see
+	// VertexSemantic).
+	static VertexArrayDesc fromLayout(const VertexLayout& layout);
+
+	// Returns the new binding's number.
+	uint32_t addBinding(uint32_t stride, uint32_t divisor = 0);
+	void addAttribute(uint32_t location, uint32_t binding, VertexFormat format, uint32_t offset);
+
+	uint64_t hash() const;
+	// Like hash, only what's in use is compared.
+	bool operator==(const VertexArrayDesc& other) const;
+};
+
+// Where a binding of a VertexArrayDesc reads from for a draw.
+struct VertexStream {
+	GLuint buffer;
+	GLintptr offset;
+};
+
+struct VertexArrayCacheStats {
+	size_t created;
+	size_t switches;      // binds that changed the VAO
+	size_t bufferChanges; // bindings or index buffers pointed somewhere else
+	size_t skipped;       // binds where everything was already in place
+};
+
+// VAOs found by the hash of their VertexArrayDesc, instead of one per mesh.
+//
+// With ARB_vertex_attrib_binding there is a single VAO per description, and drawing
+// another mesh with it only points its bindings at other buffers and offsets
+// (glBindVertexBuffer, and the index buffer), which is much cheaper for the driver than
+// switching VAOs and validating all their formats again. Meshes sharing one buffer only
+// move the offset. On plain 3.3 the buffers are part of the VAO's attributes, so there's
+// one per description and set of buffers, which still shares the VAO between everything
+// drawn from the same buffers, and a new offset re-points the attributes of its binding.
+//
+// One per context (like the StateCache), GL thread only. GLResources::deleteBuffers
+// tells it about deleted buffers.
+class VertexArrayCache {
+    private:
+	struct VertexArray {
+		GLuint vertexArray;
+		VertexArrayDesc desc;
+		VertexStream streams[VertexArrayDesc::MAX_BINDINGS];
+		GLuint indexBuffer;
+	};
+
+	std::unordered_map<uint64_t, VertexArray> vertexArrays;
+	VertexArrayCacheStats stats;
+
+	VertexArrayCache();
+
+	uint64_t keyOf(const VertexArrayDesc& desc, const VertexStream* streams, GLuint indexBuffer) const;
+	VertexArray create(const VertexArrayDesc& desc, const VertexStream* streams, GLuint indexBuffer);
+	void pointAttributes(const VertexArray& vertexArray, uint32_t binding) const;
+    public:
+	static VertexArrayCache& current();
+
+	VertexArrayCache(const VertexArrayCache&) = delete;
+	VertexArrayCache& operator=(const VertexArrayCache&) = delete;
+
+	// Binds the VAO for 'desc' reading binding i from streams[i] and indices from
+	// 'indexBuffer', making it the first time, and returns it. Whatever is already in place
+	// isn't sent again.
+	GLuint bind(const VertexArrayDesc& desc, const VertexStream* streams, GLuint indexBuffer);
+
+	// 'buffer' is about to be deleted: VAOs stop reading it (or, on 3.3, the ones made for
+	// it go), so neither its memory nor its name stays tied to them.
+	void forgetBuffer(GLuint buffer);
+
+	// Deletes every VAO, while the context is still there.
+	void clear();
+
+	size_t size() const;
+
+	VertexArrayCacheStats getStats() const;
+	void resetStats();
+};
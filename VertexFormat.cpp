@@ -0,0 +1,115 @@
+#include "VertexFormat.hpp"
+#include <glad/glad.h>
+
+VertexAttributeFormat vertexAttributeFormat(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Float2: return { 2, GL_FLOAT, GL_FALSE };
+	case VertexFormat::Float3: return { 3, GL_FLOAT, GL_FALSE };
+	case VertexFormat::Float4: return { 4, GL_FLOAT, GL_FALSE };
+	case VertexFormat::Half2: return { 2, GL_HALF_FLOAT, GL_FALSE };
+	case VertexFormat::Half3: return { 3, GL_HALF_FLOAT, GL_FALSE };
+	case VertexFormat::Snorm16x3: return { 3, GL_SHORT, GL_TRUE };
+	case VertexFormat::Unorm16x2: return { 2, GL_UNSIGNED_SHORT, GL_TRUE };
+	case VertexFormat::Octahedral16: return { 2, GL_SHORT, GL_TRUE };
+	case VertexFormat::Snorm10x3_2: return { 4, GL_INT_2_10_10_10_REV, GL_TRUE };
+	default: return { 0, GL_FLOAT, GL_FALSE };
+	}
+}
+
+uint32_t vertexFormatSize(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Float2: return 8;
+	case VertexFormat::Float3: return 12;
+	case VertexFormat::Float4: return 16;
+	case VertexFormat::Half2: return 4;
+	case VertexFormat::Half3: return 8;
+	case VertexFormat::Snorm16x3: return 8;
+	case VertexFormat::Unorm16x2: return 4;
+	case VertexFormat::Octahedral16: return 4;
+	case VertexFormat::Snorm10x3_2: return 4;
+	default: return 0;
+	}
+}
+
+const char* vertexFormatName(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Float2: return "float2";
+	case VertexFormat::Float3: return "float3";
+	case VertexFormat::Float4: return "float4";
+	case VertexFormat::Half2: return "half2";
+	case VertexFormat::Half3: return "half3";
+	case VertexFormat::Snorm16x3: return "snorm16x3";
+	case VertexFormat::Unorm16x2: return "unorm16x2";
+	case VertexFormat::Octahedral16: return "octahedral16";
+	case VertexFormat::Snorm10x3_2: return "snorm10x3_2";
+	default: return "none";
+	}
+}
+
+VertexDequantization VertexDequantization::identity()
+{
+	return { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 1.0f } };
+}
+
+VertexLayout::VertexLayout()
+	: stride(0)
+{
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		formats[s] = VertexFormat::None;
+		offsets[s] = 0;
+	}
+}
+
+VertexLayout VertexLayout::fromFormats(VertexFormat position, VertexFormat texcoord, VertexFormat normal, VertexFormat tangent)
+{
+	VertexLayout layout;
+	layout.formats[VERTEX_POSITION] = position;
+	layout.formats[VERTEX_TEXCOORD] = texcoord;
+	layout.formats[VERTEX_NORMAL] = normal;
+	layout.formats[VERTEX_TANGENT] = tangent;
+
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		layout.offsets[s] = layout.stride;
+		layout.stride += vertexFormatSize(layout.formats[s]);
+	}
+
+	return layout;
+}
+
+VertexLayout VertexLayout::floats(uint32_t attributes)
+{
+	return fromFormats(
+		(attributes & (1 << VERTEX_POSITION)) ? VertexFormat::Float3 : VertexFormat::None,
+		(attributes & (1 << VERTEX_TEXCOORD)) ? VertexFormat::Float2 : VertexFormat::None,
+		(attributes & (1 << VERTEX_NORMAL)) ? VertexFormat::Float3 : VertexFormat::None,
+		(attributes & (1 << VERTEX_TANGENT)) ? VertexFormat::Float4 : VertexFormat::None);
+}
+
+VertexLayout VertexLayout::quantized(uint32_t attributes)
+{
+	return fromFormats(
+		(attributes & (1 << VERTEX_POSITION)) ? VertexFormat::Snorm16x3 : VertexFormat::None,
+		(attributes & (1 << VERTEX_TEXCOORD)) ? VertexFormat::Unorm16x2 : VertexFormat::None,
+		(attributes & (1 << VERTEX_NORMAL)) ? VertexFormat::Octahedral16 : VertexFormat::None,
+		(attributes & (1 << VERTEX_TANGENT)) ? VertexFormat::Snorm10x3_2 : VertexFormat::None);
+}
+
+bool VertexLayout::has(VertexSemantic semantic) const
+{
+	return formats[semantic] != VertexFormat::None;
+}
+
+uint32_t VertexLayout::attributes() const
+{
+	uint32_t bits = 0;
+
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		if (formats[s] != VertexFormat::None)
+			bits |= 1 << s;
+	}
+
+	return bits;
+}
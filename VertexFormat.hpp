@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+
+// What each vertex attribute means. The value is also the attribute location in the
+// shaders, and 1 << value is the matching MeshAttribute bit.
+enum VertexSemantic {
+	VERTEX_POSITION = 0,
+	VERTEX_TEXCOORD = 1,
+	VERTEX_NORMAL = 2,
+	VERTEX_TANGENT = 3,
+	VERTEX_SEMANTIC_COUNT = 4
+};
+
+// How an attribute is stored. Everything except the plain floats is a quantized
+// encoding the GPU expands on fetch:
+//  - Half3: three half floats (padded to 8 bytes).
+//  - Snorm16x3: three normalized shorts (padded to 8 bytes). The shader turns them back
+//    into positions with positionOffset + value * positionScale.
+//  - Unorm16x2: two normalized unsigned shorts, texcoordOffset + value * texcoordScale.
+//  - Octahedral16: a unit vector folded onto an octahedron and unwrapped into a square,
+//    stored as two normalized shorts. Decoded in the shader with
+//        n = vec3(e, 1 - |e.x| - |e.y|); if (n.z < 0) n.xy = (1 - |n.yx|) * sign(n.xy);
+//  - Snorm10x3_2: xyz in 10 bits each plus a 2 bit w, for tangents and their handedness
+//    (use sign(w), GL 3.3 drivers may expand -1 to -1/3).
+enum class VertexFormat : uint8_t {
+	None = 0,
+	Float2,
+	Float3,
+	Float4,
+	Half2,
+	Half3,
+	Snorm16x3,
+	Unorm16x2,
+	Octahedral16,
+	Snorm10x3_2
+};
+
+// Bytes one value of 'format' takes in a vertex (always a multiple of 4).
+uint32_t vertexFormatSize(VertexFormat format);
+const char* vertexFormatName(VertexFormat format);
+
+// What GL is told about an attribute stored as 'format' (size, type and normalized of
+// glVertexAttribFormat). Normalized integers arrive in the shader as floats in [-1, 1]
+// or [0, 1], so a quantized attribute is still just a vec2/vec3/vec4 input there.
+struct VertexAttributeFormat {
+	int components;
+	unsigned int type;
+	unsigned char normalized;
+};
+
+VertexAttributeFormat vertexAttributeFormat(VertexFormat format);
+
+// Undoes the range mapping of the normalized formats. Formats that don't need it use
+// the identity (offset 0, scale 1), so the shader can always apply it.
+struct VertexDequantization {
+	float positionOffset[3];
+	float positionScale[3];
+	float texcoordOffset[2];
+	float texcoordScale[2];
+
+	static VertexDequantization identity();
+};
+
+// The interleaved layout of a vertex buffer: which semantics it has, how each one is
+// stored and where it is inside the vertex.
+struct VertexLayout {
+	VertexFormat formats[VERTEX_SEMANTIC_COUNT];
+	uint32_t offsets[VERTEX_SEMANTIC_COUNT];
+	uint32_t stride;
+
+	VertexLayout();
+
+	// Attributes are packed in semantic order.
+	static VertexLayout fromFormats(VertexFormat position, VertexFormat texcoord, VertexFormat normal = VertexFormat::None, VertexFormat tangent = VertexFormat::None);
+
+	// Plain float layout for a set of MeshAttribute bits (3/2/3/4 floats).
+	static VertexLayout floats(uint32_t attributes);
+
+	// The smallest formats for the same attributes: snorm16 positions, unorm16 texcoords,
+	// octahedral normals and 10_10_10_2 tangents.
+	static VertexLayout quantized(uint32_t attributes);
+
+	bool has(VertexSemantic semantic) const;
+	uint32_t attributes() const;
+};
@@ -0,0 +1,384 @@
+#include "VertexQuantizer.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace VertexQuantizer {
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	// Infinity stays infinity, NaN stays a (quiet) NaN.
+	if (magnitude >= 0x7F800000)
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+
+	// 65520 and up rounds past the largest half (65504).
+	if (magnitude >= 0x477FF000)
+		return sign | 0x7C00;
+
+	// Below the smallest normal half: count in steps of 2^-24, rounded to nearest even.
+	// 1024 steps carries over into the smallest normal, which has exactly that encoding.
+	if (magnitude < 0x38800000) {
+		float absolute;
+		memcpy(&absolute, &magnitude, sizeof(absolute));
+		return sign | (uint16_t)std::nearbyint(absolute * 16777216.0f);
+	}
+
+	// Rebias the exponent and round the 13 dropped mantissa bits to nearest even (a carry
+	// out of the mantissa just bumps the exponent).
+	uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+	return sign | (uint16_t)((rounded - 0x38000000) >> 13);
+}
+
+float halfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	if (exponent == 0) {
+		float result = mantissa * (1.0f / 16777216.0f);
+		return sign ? -result : result;
+	}
+
+	uint32_t bits = exponent == 31
+		? sign | 0x7F800000 | (mantissa << 13)
+		: sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void encodeOctahedral(const float* normal, float* encoded)
+{
+	float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = normal[0] / length;
+	float y = normal[1] / length;
+
+	// The lower half of the octahedron is folded over the diagonals onto the corners.
+	if (normal[2] < 0.0f) {
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = x;
+	encoded[1] = y;
+}
+
+void decodeOctahedral(const float* encoded, float* normal)
+{
+	float x = encoded[0];
+	float y = encoded[1];
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+	float fold = std::max(-z, 0.0f);
+
+	x += x >= 0.0f ? -fold : fold;
+	y += y >= 0.0f ? -fold : fold;
+
+	float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+// GL 4.2+ conversion of normalized signed integers (3.3 drivers use (2c + 1) / (2^b - 1),
+// which is off by at most half a step).
+static float snormToFloat(int value, int maximum)
+{
+	return std::max((float)value / maximum, -1.0f);
+}
+
+static int floatToSnorm(float value, int maximum)
+{
+	return (int)std::lround(std::min(std::max(value, -1.0f), 1.0f) * maximum);
+}
+
+// atan2 instead of acos, which has no precision left for tiny angles.
+static float angleDegrees(const float* a, const float* b)
+{
+	float cross[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+	float sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+	float cosine = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	return std::atan2(sine, cosine) * (180.0f / 3.14159265f);
+}
+
+static void normalize3(const float* value, float* result)
+{
+	float length = std::sqrt(value[0] * value[0] + value[1] * value[1] + value[2] * value[2]);
+
+	if (length > 0.0f) {
+		result[0] = value[0] / length;
+		result[1] = value[1] / length;
+		result[2] = value[2] / length;
+	}
+	else {
+		result[0] = 0.0f;
+		result[1] = 0.0f;
+		result[2] = 1.0f;
+	}
+}
+
+static bool formatFits(VertexSemantic semantic, VertexFormat format)
+{
+	switch (semantic) {
+	case VERTEX_POSITION: return format == VertexFormat::Float3 || format == VertexFormat::Half3 || format == VertexFormat::Snorm16x3;
+	case VERTEX_TEXCOORD: return format == VertexFormat::Float2 || format == VertexFormat::Half2 || format == VertexFormat::Unorm16x2;
+	case VERTEX_NORMAL: return format == VertexFormat::Float3 || format == VertexFormat::Octahedral16;
+	case VERTEX_TANGENT: return format == VertexFormat::Float4 || format == VertexFormat::Snorm10x3_2;
+	default: return false;
+	}
+}
+
+bool quantize(const MeshData& mesh, uint32_t attributes, const VertexLayout& layout, QuantizedVertices& result)
+{
+	VertexLayout source = VertexLayout::floats(attributes);
+
+	if (layout.attributes() != attributes || !layout.has(VERTEX_POSITION) || source.stride != mesh.floatsPerVertex * sizeof(float)) {
+		std::cout << "ERROR::VERTEX_QUANTIZER::LAYOUT_MISMATCH" << std::endl;
+		return false;
+	}
+
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		if (layout.has((VertexSemantic)s) && !formatFits((VertexSemantic)s, layout.formats[s])) {
+			std::cout << "ERROR::VERTEX_QUANTIZER::UNSUPPORTED_FORMAT " << vertexFormatName(layout.formats[s]) << std::endl;
+			return false;
+		}
+	}
+
+	size_t vertexCount = mesh.vertexCount();
+	auto sourceOf = [&](size_t vertex, VertexSemantic semantic) {
+		return &mesh.vertices[vertex * mesh.floatsPerVertex + source.offsets[semantic] / sizeof(float)];
+	};
+
+	result.layout = layout;
+	result.dequantization = VertexDequantization::identity();
+	result.data.assign(vertexCount * layout.stride, 0);
+	result.error = {};
+	result.error.floatBytes = vertexCount * source.stride;
+	result.error.quantizedBytes = result.data.size();
+
+	VertexDequantization& dequantization = result.dequantization;
+
+	// Ranges for the normalized formats. Flat axes keep a scale of 1 so nothing divides by 0.
+	if (layout.formats[VERTEX_POSITION] == VertexFormat::Snorm16x3) {
+		for (int c = 0; c < 3; c++) {
+			float low = FLT_MAX, high = -FLT_MAX;
+
+			for (size_t v = 0; v < vertexCount; v++) {
+				low = std::min(low, sourceOf(v, VERTEX_POSITION)[c]);
+				high = std::max(high, sourceOf(v, VERTEX_POSITION)[c]);
+			}
+
+			dequantization.positionOffset[c] = vertexCount > 0 ? (low + high) * 0.5f : 0.0f;
+			dequantization.positionScale[c] = high > low ? (high - low) * 0.5f : 1.0f;
+		}
+	}
+
+	if (layout.formats[VERTEX_TEXCOORD] == VertexFormat::Unorm16x2) {
+		for (int c = 0; c < 2; c++) {
+			float low = FLT_MAX, high = -FLT_MAX;
+
+			for (size_t v = 0; v < vertexCount; v++) {
+				low = std::min(low, sourceOf(v, VERTEX_TEXCOORD)[c]);
+				high = std::max(high, sourceOf(v, VERTEX_TEXCOORD)[c]);
+			}
+
+			dequantization.texcoordOffset[c] = vertexCount > 0 ? low : 0.0f;
+			dequantization.texcoordScale[c] = high > low ? high - low : 1.0f;
+		}
+	}
+
+	double positionSquaredSum = 0.0;
+	QuantizationError& error = result.error;
+
+	for (size_t v = 0; v < vertexCount; v++) {
+		unsigned char* vertex = &result.data[v * layout.stride];
+
+		// Each attribute is encoded into 'vertex' and decoded again into 'decoded'.
+		float decoded[4];
+
+		const float* position = sourceOf(v, VERTEX_POSITION);
+		unsigned char* out = vertex + layout.offsets[VERTEX_POSITION];
+
+		switch (layout.formats[VERTEX_POSITION]) {
+		case VertexFormat::Half3: {
+			uint16_t halves[4] = { floatToHalf(position[0]), floatToHalf(position[1]), floatToHalf(position[2]), 0 };
+			memcpy(out, halves, sizeof(halves));
+			for (int c = 0; c < 3; c++) {
+				decoded[c] = halfToFloat(halves[c]);
+			}
+			break;
+		}
+		case VertexFormat::Snorm16x3: {
+			int16_t shorts[4] = { 0, 0, 0, 0 };
+			for (int c = 0; c < 3; c++) {
+				shorts[c] = (int16_t)floatToSnorm((position[c] - dequantization.positionOffset[c]) / dequantization.positionScale[c], 32767);
+				decoded[c] = dequantization.positionOffset[c] + snormToFloat(shorts[c], 32767) * dequantization.positionScale[c];
+			}
+			memcpy(out, shorts, sizeof(shorts));
+			break;
+		}
+		default:
+			memcpy(out, position, 3 * sizeof(float));
+			memcpy(decoded, position, 3 * sizeof(float));
+			break;
+		}
+
+		float positionError = std::sqrt((decoded[0] - position[0]) * (decoded[0] - position[0])
+			+ (decoded[1] - position[1]) * (decoded[1] - position[1])
+			+ (decoded[2] - position[2]) * (decoded[2] - position[2]));
+		error.positionMax = std::max(error.positionMax, positionError);
+		positionSquaredSum += (double)positionError * positionError;
+
+		if (layout.has(VERTEX_TEXCOORD)) {
+			const float* texcoord = sourceOf(v, VERTEX_TEXCOORD);
+			out = vertex + layout.offsets[VERTEX_TEXCOORD];
+
+			switch (layout.formats[VERTEX_TEXCOORD]) {
+			case VertexFormat::Half2: {
+				uint16_t halves[2] = { floatToHalf(texcoord[0]), floatToHalf(texcoord[1]) };
+				memcpy(out, halves, sizeof(halves));
+				decoded[0] = halfToFloat(halves[0]);
+				decoded[1] = halfToFloat(halves[1]);
+				break;
+			}
+			case VertexFormat::Unorm16x2: {
+				uint16_t shorts[2];
+				for (int c = 0; c < 2; c++) {
+					float unit = (texcoord[c] - dequantization.texcoordOffset[c]) / dequantization.texcoordScale[c];
+					shorts[c] = (uint16_t)std::lround(std::min(std::max(unit, 0.0f), 1.0f) * 65535.0f);
+					decoded[c] = dequantization.texcoordOffset[c] + shorts[c] / 65535.0f * dequantization.texcoordScale[c];
+				}
+				memcpy(out, shorts, sizeof(shorts));
+				break;
+			}
+			default:
+				memcpy(out, texcoord, 2 * sizeof(float));
+				memcpy(decoded, texcoord, 2 * sizeof(float));
+				break;
+			}
+
+			error.texcoordMax = std::max(error.texcoordMax, std::max(std::fabs(decoded[0] - texcoord[0]), std::fabs(decoded[1] - texcoord[1])));
+		}
+
+		if (layout.has(VERTEX_NORMAL)) {
+			float normal[3];
+			normalize3(sourceOf(v, VERTEX_NORMAL), normal);
+			out = vertex + layout.offsets[VERTEX_NORMAL];
+
+			if (layout.formats[VERTEX_NORMAL] == VertexFormat::Octahedral16) {
+				float encoded[2];
+				encodeOctahedral(normal, encoded);
+
+				// Rounding both coordinates to nearest isn't always the closest direction,
+				// so try the four neighbouring grid points and keep the best one.
+				int16_t best[2] = { 0, 0 };
+				float bestCosine = -2.0f;
+
+				for (int corner = 0; corner < 4; corner++) {
+					int16_t candidate[2];
+					float candidateEncoded[2], candidateNormal[3];
+
+					for (int c = 0; c < 2; c++) {
+						float scaled = encoded[c] * 32767.0f;
+						float rounded = (corner >> c) & 1 ? std::ceil(scaled) : std::floor(scaled);
+						candidate[c] = (int16_t)std::min(std::max(rounded, -32767.0f), 32767.0f);
+						candidateEncoded[c] = snormToFloat(candidate[c], 32767);
+					}
+
+					decodeOctahedral(candidateEncoded, candidateNormal);
+					float cosine = candidateNormal[0] * normal[0] + candidateNormal[1] * normal[1] + candidateNormal[2] * normal[2];
+
+					if (cosine > bestCosine) {
+						bestCosine = cosine;
+						best[0] = candidate[0];
+						best[1] = candidate[1];
+						memcpy(decoded, candidateNormal, sizeof(candidateNormal));
+					}
+				}
+
+				memcpy(out, best, sizeof(best));
+			}
+			else {
+				memcpy(out, sourceOf(v, VERTEX_NORMAL), 3 * sizeof(float));
+				memcpy(decoded, normal, sizeof(normal));
+			}
+
+			error.normalMaxDegrees = std::max(error.normalMaxDegrees, angleDegrees(decoded, normal));
+		}
+
+		if (layout.has(VERTEX_TANGENT)) {
+			const float* tangent = sourceOf(v, VERTEX_TANGENT);
+			float direction[3];
+			normalize3(tangent, direction);
+			out = vertex + layout.offsets[VERTEX_TANGENT];
+
+			if (layout.formats[VERTEX_TANGENT] == VertexFormat::Snorm10x3_2) {
+				uint32_t packed = 0;
+
+				for (int c = 0; c < 3; c++) {
+					int value = floatToSnorm(direction[c], 511);
+					packed |= (uint32_t)(value & 0x3FF) << (c * 10);
+					decoded[c] = snormToFloat(value, 511);
+				}
+
+				// w is the bitangent sign: 1 is 01, -1 is 11 in two bit two's complement.
+				int handedness = tangent[3] < 0.0f ? -1 : 1;
+				packed |= (uint32_t)(handedness & 0x3) << 30;
+				decoded[3] = (float)handedness;
+
+				memcpy(out, &packed, sizeof(packed));
+				normalize3(decoded, decoded);
+			}
+			else {
+				memcpy(out, tangent, 4 * sizeof(float));
+				memcpy(decoded, direction, sizeof(direction));
+				decoded[3] = tangent[3];
+			}
+
+			error.tangentMaxDegrees = std::max(error.tangentMaxDegrees, angleDegrees(decoded, direction));
+
+			if ((decoded[3] < 0.0f) != (tangent[3] < 0.0f))
+				error.handednessFlips++;
+		}
+	}
+
+	error.positionRms = vertexCount > 0 ? (float)std::sqrt(positionSquaredSum / vertexCount) : 0.0f;
+	return true;
+}
+
+void printReport(const VertexLayout& layout, const QuantizationError& error)
+{
+	size_t vertexCount = layout.stride > 0 ? error.quantizedBytes / layout.stride : 0;
+
+	std::cout << "Vertices:";
+	for (int s = 0; s < VERTEX_SEMANTIC_COUNT; s++) {
+		if (layout.has((VertexSemantic)s))
+			std::cout << " " << vertexFormatName(layout.formats[s]);
+	}
+
+	std::cout << ", " << (vertexCount > 0 ? error.floatBytes / vertexCount : 0) << " -> " << layout.stride << " bytes per vertex ("
+		<< (error.quantizedBytes > 0 ? (float)error.floatBytes / error.quantizedBytes : 0.0f) << "x)"
+		<< ", position error max " << error.positionMax << " rms " << error.positionRms;
+
+	if (layout.has(VERTEX_TEXCOORD))
+		std::cout << ", texcoord error max " << error.texcoordMax;
+	if (layout.has(VERTEX_NORMAL))
+		std::cout << ", normal error max " << error.normalMaxDegrees << " deg";
+	if (layout.has(VERTEX_TANGENT))
+		std::cout << ", tangent error max " << error.tangentMaxDegrees << " deg (" << error.handednessFlips << " flipped)";
+
+	std::cout << std::endl;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MeshOptimizer.hpp"
+#include "VertexFormat.hpp"
+
+// How far the quantized vertices are from the float ones, measured by decoding them
+// back the way the GPU does.
+struct QuantizationError {
+	float positionMax;       // object space units
+	float positionRms;
+	float texcoordMax;       // texture space units
+	float normalMaxDegrees;
+	float tangentMaxDegrees;
+	size_t handednessFlips;  // tangents whose w changed sign
+	size_t floatBytes;       // the vertex buffer size before and after
+	size_t quantizedBytes;
+};
+
+struct QuantizedVertices {
+	VertexLayout layout;
+	VertexDequantization dequantization;
+	std::vector<unsigned char> data;
+	QuantizationError error;
+};
+
+// Offline packing of float vertices into the smaller VertexFormats. Positions get the
+// mesh bounds mapped onto [-1, 1] and texcoords their range onto [0, 1], which is what
+// the dequantization uniforms undo.
+namespace VertexQuantizer {
+	// 'attributes' are the MeshAttribute bits of the float vertices in 'mesh' and have
+	// to match the semantics 'layout' has. Fails on formats that don't fit a semantic
+	// (octahedral positions and such).
+	bool quantize(const MeshData& mesh, uint32_t attributes, const VertexLayout& layout, QuantizedVertices& result);
+
+	// Prints formats, size and error of a quantization on one line.
+	void printReport(const VertexLayout& layout, const QuantizationError& error);
+
+	uint16_t floatToHalf(float value);
+	float halfToFloat(uint16_t value);
+
+	// Unit vector <-> point in [-1, 1]^2.
+	void encodeOctahedral(const float* normal, float* encoded);
+	void decodeOctahedral(const float* encoded, float* normal);
+}
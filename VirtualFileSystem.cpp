@@ -0,0 +1,201 @@
+#include "VirtualFileSystem.hpp"
+#include "EmbeddedFiles.hpp"
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <utility>
+
+FileData::FileData()
+	: bytes(nullptr), length(0)
+{
+}
+
+FileData::FileData(std::vector<unsigned char> bytes)
+	: buffer(std::move(bytes))
+{
+	this->bytes = buffer.data();
+	length = buffer.size();
+}
+
+FileData::FileData(FileData&& other) noexcept
+	: bytes(other.bytes), length(other.length), buffer(std::move(other.buffer)), loose(std::move(other.loose))
+{
+	other.bytes = nullptr;
+	other.length = 0;
+}
+
+FileData& FileData::operator=(FileData&& other) noexcept
+{
+	if (this != &other) {
+		bytes = other.bytes;
+		length = other.length;
+		buffer = std::move(other.buffer);
+		loose = std::move(other.loose);
+		other.bytes = nullptr;
+		other.length = 0;
+	}
+
+	return *this;
+}
+
+void FileData::clear()
+{
+	bytes = nullptr;
+	length = 0;
+	buffer.clear();
+	buffer.shrink_to_fit();
+	loose.reset();
+}
+
+const unsigned char* FileData::data() const
+{
+	return bytes;
+}
+
+size_t FileData::size() const
+{
+	return length;
+}
+
+bool FileData::isMapped() const
+{
+	return buffer.empty();
+}
+
+VirtualFileSystem::VirtualFileSystem(bool looseFiles)
+	: looseFiles(looseFiles), hasOverrides(false)
+{
+}
+
+void VirtualFileSystem::preferLooseFile(const std::string& path)
+{
+	std::unique_lock<std::shared_mutex> lock(overridesMutex);
+	overrides.insert(AssetPack::normalizePath(path));
+	hasOverrides = true;
+}
+
+bool VirtualFileSystem::isOverridden(const std::string& path) const
+{
+	// Nearly always false, and then there's no lock to take.
+	if (!hasOverrides)
+		return false;
+
+	std::shared_lock<std::shared_mutex> lock(overridesMutex);
+	return overrides.count(AssetPack::normalizePath(path)) != 0;
+}
+
+bool VirtualFileSystem::mount(const std::string& packPath)
+{
+	std::unique_ptr<AssetPack> pack(new AssetPack());
+
+	if (!pack->open(packPath))
+		return false;
+
+	packs.push_back(std::move(pack));
+	return true;
+}
+
+size_t VirtualFileSystem::mountedPacks() const
+{
+	return packs.size();
+}
+
+bool VirtualFileSystem::exists(const std::string& path) const
+{
+	bool overridden = isOverridden(path);
+	if (!overridden && EmbeddedFiles::find(path) != nullptr)
+		return true;
+
+	for (size_t i = overridden ? 0 : packs.size(); i > 0; i--) {
+		if (packs[i - 1]->find(path) >= 0)
+			return true;
+	}
+
+	std::error_code error;
+	return looseFiles && std::filesystem::is_regular_file(path, error);
+}
+
+bool VirtualFileSystem::read(const std::string& path, FileData& file) const
+{
+	file.clear();
+
+	bool overridden = isOverridden(path);
+	const EmbeddedFile* embedded = overridden ? nullptr : EmbeddedFiles::find(path);
+	if (embedded != nullptr) {
+		file.bytes = embedded->data;
+		file.length = embedded->size;
+		return true;
+	}
+
+	for (size_t i = overridden ? 0 : packs.size(); i > 0; i--) {
+		const AssetPack& pack = *packs[i - 1];
+		int index = pack.find(path);
+
+		if (index < 0)
+			continue;
+
+		const AssetPackEntry& entry = pack.getEntry(index);
+		if ((entry.flags & ASSET_PACK_COMPRESSED) == 0) {
+			file.bytes = pack.getStoredData(index);
+			file.length = entry.size;
+			return true;
+		}
+
+		file.buffer.resize(entry.size);
+		if (!pack.extract(index, file.buffer.data())) {
+			file.clear();
+			return false;
+		}
+
+		file.bytes = file.buffer.data();
+		file.length = file.buffer.size();
+		return true;
+	}
+
+	if (!looseFiles)
+		return false;
+
+	file.loose.reset(new MappedFile());
+	if (!file.loose->open(path)) {
+		file.loose.reset();
+		return false;
+	}
+
+	file.bytes = file.loose->data();
+	file.length = file.loose->size();
+	return true;
+}
+
+bool VirtualFileSystem::locate(const std::string& path, std::string& filePath, uint64_t& offset, uint64_t& size) const
+{
+	bool overridden = isOverridden(path);
+	if (!overridden && EmbeddedFiles::find(path) != nullptr)
+		return false;
+
+	for (size_t i = overridden ? 0 : packs.size(); i > 0; i--) {
+		const AssetPack& pack = *packs[i - 1];
+		int index = pack.find(path);
+
+		if (index < 0)
+			continue;
+
+		const AssetPackEntry& entry = pack.getEntry(index);
+		if ((entry.flags & ASSET_PACK_COMPRESSED) != 0)
+			return false;
+
+		filePath = pack.getPath();
+		offset = entry.offset;
+		size = entry.size;
+		return true;
+	}
+
+	std::error_code error;
+	uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (!looseFiles || error)
+		return false;
+
+	filePath = path;
+	offset = 0;
+	size = (uint64_t)fileSize;
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "AssetPack.hpp"
+#include "MappedFile.hpp"
+
+// The bytes of one file from the VirtualFileSystem. Stored pack entries and loose files
+// are views of a mapping (no copy at all), embedded files views of the executable's own
+// data; compressed entries are decompressed into a
+// buffer the FileData owns, and so are files read into memory by the AssetLoader. Either way they stay valid for as long as the FileData does
+// (and the file system it came from).
+class FileData {
+    private:
+	const unsigned char* bytes;
+	size_t length;
+	std::vector<unsigned char> buffer;
+	std::unique_ptr<MappedFile> loose;
+
+	friend class VirtualFileSystem;
+    public:
+	FileData();
+	// Takes over bytes read some other way (see AssetLoader).
+	explicit FileData(std::vector<unsigned char> bytes);
+
+	FileData(FileData&& other) noexcept;
+	FileData& operator=(FileData&& other) noexcept;
+
+	void clear();
+
+	const unsigned char* data() const;
+	size_t size() const;
+	// False when the bytes had to be decompressed.
+	bool isMapped() const;
+};
+
+// Where every asset loader gets its files from. Files compiled into the executable come
+// first (see EmbeddedFiles, only release builds have any). Then packs are searched from
+// the last mounted to the first, so a later pack can override single files of an earlier
+// one, and paths no pack has are read from disk (mapped) unless 'looseFiles' is off.
+// Reading is const and safe from any thread.
+class VirtualFileSystem {
+    private:
+	std::vector<std::unique_ptr<AssetPack>> packs;
+	bool looseFiles;
+
+	// Paths read from disk even though a pack has them (see preferLooseFile).
+	mutable std::shared_mutex overridesMutex;
+	std::unordered_set<std::string> overrides;
+	std::atomic<bool> hasOverrides;
+
+	bool isOverridden(const std::string& path) const;
+    public:
+	VirtualFileSystem(bool looseFiles = true);
+
+	VirtualFileSystem(const VirtualFileSystem&) = delete;
+	VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+
+	bool mount(const std::string& packPath);
+	size_t mountedPacks() const;
+
+	bool exists(const std::string& path) const;
+	bool read(const std::string& path, FileData& file) const;
+
+	// Where the bytes of 'path' are on disk, for reading them without the mapping (see
+	// AsyncIO): the pack and the entry's offset in it, or the loose file itself. False
+	// for compressed entries and embedded files, those have to go through read().
+	bool locate(const std::string& path, std::string& filePath, uint64_t& offset, uint64_t& size) const;
+
+	// From now on 'path' comes from the loose file, whatever the packs (or the embedded
+	// files) say. For hot
+	// reload: the cooker rewrites the loose file, while the mounted pack still has the
+	// old one (and can't be replaced while it's mapped on Windows). Safe from any thread.
+	void preferLooseFile(const std::string& path);
+};
@@ -1,3 +1,14 @@
 @ECHO OFF
 
-g++ -o program.exe -g -Wall -IVendor/include -LVendor/lib Main.cpp glad.c Shader.cpp -lopengl32 -lglfw3
\ No newline at end of file
+SET SOURCES=Main.cpp glad.c Shader.cpp JobSystem.cpp TextureStreamer.cpp PixelOps.cpp MipGenerator.cpp MeshOptimizer.cpp MappedFile.cpp MeshFile.cpp VertexFormat.cpp VertexQuantizer.cpp MeshCodec.cpp Meshlets.cpp MeshSimplifier.cpp LodSelector.cpp AssetCooker.cpp FastLz.cpp AssetPack.cpp VirtualFileSystem.cpp AsyncIO.cpp AssetLoader.cpp AssetManager.cpp GLExtensions.cpp FileWatcher.cpp HotReloader.cpp ShaderBuilder.cpp ShaderPreprocessor.cpp ShaderVariantCache.cpp GpuTimer.cpp ShaderModuleFile.cpp EmbeddedFiles.cpp StateCache.cpp GLResources.cpp SamplerCache.cpp VertexArrayCache.cpp PipelineState.cpp
+
+REM Vendor/include is a system directory so -Wall only warns about our own code (glm's
+REM half floats trip -Wvolatile under C++20).
+g++ -std=c++20 -o program.exe -g -Wall -isystem Vendor/include -LVendor/lib %SOURCES% -lopengl32 -lglfw3
+
+REM Cook whatever changed under Assets/ into Cooked/, which is what the program loads.
+if %errorlevel% == 0 program.exe --cook
+
+REM build.bat release: then once more, optimized and with the shaders just cooked compiled in
+REM (Cooked/EmbeddedShaders.inc, see EmbeddedFiles), so it reads none of them from disk.
+if %errorlevel% == 0 if "%1" == "release" g++ -std=c++20 -o program.exe -O2 -DNDEBUG -Wall -isystem Vendor/include -LVendor/lib %SOURCES% -lopengl32 -lglfw3